@@ -0,0 +1,115 @@
+#include "bench.h"
+#include "lexer/instrument.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// With instrumentation compiled in, instrument.cpp replaces operator new and
+// does the counting
+#ifndef LEXER_INSTRUMENT
+
+namespace {
+
+size_t allocations = 0;
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+#endif // LEXER_INSTRUMENT
+
+namespace bench {
+
+size_t allocation_count() {
+#ifdef LEXER_INSTRUMENT
+    return lexer::instrument::process_allocations();
+#else
+    return allocations;
+#endif
+}
+
+Suite::Suite(const char* title, int argc, char** argv) : title_(title) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--filter=", 0) == 0) {
+            filter_ = arg.substr(9);
+        } else if (arg.rfind("--json=", 0) == 0) {
+            json_path_ = arg.substr(7);
+        } else if (arg.rfind("--repeat=", 0) == 0) {
+            repeat_ = std::max(1, std::atoi(arg.c_str() + 9));
+        } else if (arg.rfind("--size=", 0) == 0) {
+            corpus_size_ = std::max<size_t>(1, std::strtoull(arg.c_str() + 7, nullptr, 10)) << 20;
+        } else {
+            inputs_.push_back(arg);
+        }
+    }
+
+    std::printf("%-36s %12s %12s %10s %12s\n", title_.c_str(), "items", "Mitems/s", "MB/s",
+                "allocs/item");
+}
+
+bool Suite::enabled(const std::string& name) const {
+    return filter_.empty() || name.find(filter_) != std::string::npos;
+}
+
+void Suite::report(const Result& result) {
+    double items = static_cast<double>(result.work.items);
+    std::printf("%-36s %12zu %12.2f %10.2f %12.4f  %s\n", result.name.c_str(),
+                result.work.items, items / result.seconds / 1e6,
+                result.work.bytes / result.seconds / 1e6,
+                result.work.items ? result.allocations / items : 0.0, result.unit.c_str());
+    results_.push_back(result);
+}
+
+int Suite::finish() const {
+    if (lexer::instrument::kEnabled) {
+        std::printf("\n%s", lexer::instrument::report().c_str());
+    }
+    if (json_path_.empty()) {
+        return 0;
+    }
+
+    FILE* out = std::fopen(json_path_.c_str(), "w");
+    if (!out) {
+        std::perror(json_path_.c_str());
+        return 1;
+    }
+
+    std::fprintf(out, "{\n  \"suite\": \"%s\",\n  \"benchmarks\": [\n", title_.c_str());
+    for (size_t i = 0; i < results_.size(); ++i) {
+        const Result& r = results_[i];
+        double items = static_cast<double>(r.work.items);
+        std::fprintf(out,
+                     "    {\"name\": \"%s\", \"unit\": \"%s\", \"items\": %zu, \"bytes\": %zu, "
+                     "\"seconds\": %.9f, \"items_per_second\": %.1f, \"bytes_per_second\": %.1f, "
+                     "\"allocations\": %zu, \"allocations_per_item\": %.6f}%s\n",
+                     r.name.c_str(), r.unit.c_str(), r.work.items, r.work.bytes, r.seconds,
+                     items / r.seconds, r.work.bytes / r.seconds, r.allocations,
+                     r.work.items ? r.allocations / items : 0.0,
+                     i + 1 < results_.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]");
+    if (lexer::instrument::kEnabled) {
+        std::fprintf(out, ",\n  \"instrument\": %s", lexer::instrument::report_json().c_str());
+    }
+    std::fprintf(out, "\n}\n");
+    std::fclose(out);
+    return 0;
+}
+
+} // namespace bench
@@ -0,0 +1,95 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Heap allocations made by the whole process so far. Linking bench.cpp
+// replaces the global operator new to keep this count, unless the build has
+// instrumentation (lexer/instrument.h), which counts them itself.
+size_t allocation_count();
+
+// What one run of a benchmark body processed.
+struct Work {
+    size_t items; // Tokens, lookups, nodes, ...
+    size_t bytes; // Input bytes, 0 if not meaningful
+};
+
+struct Result {
+    std::string name;
+    std::string unit;
+    Work work;
+    double seconds;     // Best of all repetitions
+    size_t allocations; // During the best repetition
+};
+
+// Runs named benchmark bodies, prints a table row for each, and optionally
+// writes every result as JSON for tracking across commits.
+//
+//   --filter=TEXT   only run benchmarks whose name contains TEXT
+//   --json=PATH     write results to PATH
+//   --repeat=N      repetitions per benchmark (default 5, best is kept)
+//   --size=MB       size of generated corpora (default 8)
+//
+// Other arguments are left in inputs() for the benchmark to interpret.
+class Suite {
+public:
+    Suite(const char* title, int argc, char** argv);
+
+    bool enabled(const std::string& name) const;
+    size_t corpus_size() const { return corpus_size_; }
+    const std::vector<std::string>& inputs() const { return inputs_; }
+
+    // Times body(), which returns the Work it did. unit names the items.
+    template <typename Body>
+    void run(const std::string& name, const char* unit, Body&& body) {
+        if (!enabled(name)) {
+            return;
+        }
+        Result result{name, unit, {0, 0}, 0.0, 0};
+        for (int i = 0; i < repeat_; ++i) {
+            size_t allocations = allocation_count();
+            auto start = std::chrono::steady_clock::now();
+            Work work = body();
+            auto end = std::chrono::steady_clock::now();
+            allocations = allocation_count() - allocations;
+
+            double seconds = std::chrono::duration<double>(end - start).count();
+            if (i == 0 || seconds < result.seconds) {
+                result.work = work;
+                result.seconds = seconds;
+                result.allocations = allocations;
+            }
+        }
+        report(result);
+    }
+
+    // Adds a result measured by the caller.
+    void report(const Result& result);
+
+    // Writes the JSON file if one was requested; returns the exit status.
+    int finish() const;
+
+private:
+    std::string title_;
+    std::string filter_;
+    std::string json_path_;
+    int repeat_ = 5;
+    size_t corpus_size_ = 8 << 20;
+    std::vector<std::string> inputs_;
+    std::vector<Result> results_;
+};
+
+// Keeps the compiler from discarding a computed value.
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace bench
+
+#endif // BENCH_H
@@ -0,0 +1,549 @@
+#include "corpus.h"
+#include "lexer/source_buffer.h"
+#include <cstdio>
+#include <random>
+
+namespace bench {
+
+namespace {
+
+const char* const kWords[] = {
+    "int", "char", "return", "if", "while", "for", "static", "const", "unsigned",
+    "struct", "void", "sizeof", "buffer", "length", "index", "node", "next", "count",
+    "result", "value", "ctx", "p", "i", "j", "tmp", "data_ptr", "hash_table_insert",
+    "MAX_BUFFER_SIZE", "_internal_state", "xmlParseCharData", "uint32_t", "size_t",
+};
+
+template <typename Piece>
+std::string generate(size_t size, Piece&& piece) {
+    std::mt19937 rng(42);
+    std::string out;
+    out.reserve(size + 256);
+    while (out.size() < size) {
+        piece(rng, out);
+    }
+    return out;
+}
+
+size_t pick(std::mt19937& rng, size_t n) {
+    return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+}
+
+const char* const kBinaryOperators[] = {
+    " + ", " - ", " * ", " / ", " % ", " << ", " >> ", " & ", " | ", " ^ ",
+    " && ", " || ", " == ", " != ", " < ", " > ", " <= ", " >= ",
+};
+
+const char* const kOperands[] = {"x", "y", "count", "table[i]", "p->len", "f(a, b)", "0x7f", "3"};
+
+// Operands joined by random binary operators, some of them parenthesized,
+// negated, cast or conditional sub-expressions
+void random_expression(std::mt19937& rng, std::string& out, int depth, size_t operands) {
+    for (size_t i = 0; i < operands; ++i) {
+        if (i > 0) {
+            out += kBinaryOperators[pick(rng, std::size(kBinaryOperators))];
+        }
+        switch (depth < 3 ? pick(rng, 10) : 9) {
+        case 0:
+            out += '(';
+            random_expression(rng, out, depth + 1, 2 + pick(rng, 6));
+            out += ')';
+            break;
+        case 1:
+            out += "(long)-";
+            out += kOperands[pick(rng, std::size(kOperands))];
+            break;
+        case 2:
+            out += '(';
+            random_expression(rng, out, depth + 1, 2);
+            out += " ? ";
+            random_expression(rng, out, depth + 1, 1 + pick(rng, 3));
+            out += " : ";
+            random_expression(rng, out, depth + 1, 1 + pick(rng, 3));
+            out += ')';
+            break;
+        default:
+            out += kOperands[pick(rng, std::size(kOperands))];
+        }
+    }
+}
+
+} // namespace
+
+std::string identifier_corpus(size_t size) {
+    return generate(size, [](std::mt19937& rng, std::string& out) {
+        out += kWords[pick(rng, std::size(kWords))];
+        if (pick(rng, 4) == 0) {
+            out += '_';
+            out += std::to_string(pick(rng, 1000));
+        }
+        out += pick(rng, 12) == 0 ? '\n' : ' ';
+    });
+}
+
+std::string numeric_corpus(size_t size) {
+    return generate(size, [](std::mt19937& rng, std::string& out) {
+        switch (pick(rng, 5)) {
+            case 0:
+                out += std::to_string(pick(rng, 1000000));
+                break;
+            case 1:
+                out += "0x";
+                out += std::to_string(pick(rng, 90000) + 10000);
+                out += 'F';
+                break;
+            case 2: {
+                char octal[16];
+                std::snprintf(octal, sizeof(octal), "0%zo", pick(rng, 7000));
+                out += octal;
+                break;
+            }
+            case 3:
+                out += std::to_string(pick(rng, 1000));
+                out += '.';
+                out += std::to_string(pick(rng, 100000));
+                break;
+            default:
+                out += std::to_string(pick(rng, 10));
+                out += ".5e-";
+                out += std::to_string(pick(rng, 30));
+                break;
+        }
+        out += pick(rng, 8) == 0 ? ",\n    " : ", ";
+    });
+}
+
+std::string table_corpus(size_t size) {
+    size_t table = 0;
+    return generate(size, [&table](std::mt19937& rng, std::string& out) {
+        char line[64];
+        bool floats = table % 2 == 1;
+        out += floats ? "static const float weights_" : "static const uint32_t crc_table_";
+        out += std::to_string(table++);
+        out += "[256] = {\n";
+        for (int row = 0; row < 32; ++row) {
+            out += "   ";
+            for (int column = 0; column < 8; ++column) {
+                if (floats) {
+                    double value = (static_cast<double>(rng()) / rng.max() - 0.5) * 8;
+                    std::snprintf(line, sizeof(line), pick(rng, 4) == 0 ? " %.7ef," : " %.7ff,", value);
+                } else {
+                    std::snprintf(line, sizeof(line), " 0x%08XU,", static_cast<unsigned>(rng()));
+                }
+                out += line;
+            }
+            out += '\n';
+        }
+        out += "};\n\n";
+    });
+}
+
+std::string comment_corpus(size_t size) {
+    return generate(size, [](std::mt19937& rng, std::string& out) {
+        switch (pick(rng, 3)) {
+            case 0:
+                out += "/*\n * Copyright (c) The Authors. All rights reserved.\n"
+                       " * Redistribution and use in source and binary forms, with or without\n"
+                       " * modification, are permitted provided that the conditions are met.\n"
+                       " */\n";
+                break;
+            case 1:
+                out += "/**\n * Returns the number of bytes written to the buffer, or -1 with\n"
+                       " * errno set when the underlying descriptor is not ready.\n */\n";
+                break;
+            default:
+                out += "        // trailing remark about the following declaration\n";
+                break;
+        }
+        out += "extern int ";
+        out += kWords[pick(rng, std::size(kWords))];
+        out += "(void);\n\n";
+    });
+}
+
+std::string string_corpus(size_t size) {
+    return generate(size, [](std::mt19937& rng, std::string& out) {
+        out += "    { \"";
+        size_t length = 8 + pick(rng, 60);
+        for (size_t i = 0; i < length; ++i) {
+            if (pick(rng, 20) == 0) {
+                out += "\\n";
+            } else if (pick(rng, 40) == 0) {
+                out += "\\\"";
+            } else {
+                out += static_cast<char>('a' + pick(rng, 26));
+            }
+        }
+        out += "\", '";
+        out += static_cast<char>('a' + pick(rng, 26));
+        out += "' },\n";
+    });
+}
+
+std::string resource_corpus(size_t size) {
+    size_t resource = 0;
+    return generate(size, [&resource](std::mt19937& rng, std::string& out) {
+        char escape[8];
+        out += "static const char resource_";
+        out += std::to_string(resource++);
+        out += "[] =\n";
+        for (int row = 0; row < 64; ++row) {
+            out += "    \"";
+            for (int column = 0; column < 24; ++column) {
+                // Letters past 'f' so none extends a preceding hex escape
+                unsigned byte = pick(rng, 4) == 0 ? 'g' + pick(rng, 20) : pick(rng, 256);
+                if (byte >= 'g' && byte <= 'z') {
+                    out += static_cast<char>(byte);
+                } else {
+                    std::snprintf(escape, sizeof(escape), pick(rng, 2) ? "\\x%02x" : "\\%03o", byte);
+                    out += escape;
+                }
+            }
+            out += "\"\n";
+        }
+        out += ";\n\n";
+    });
+}
+
+std::string operator_corpus(size_t size) {
+    static const char* const ops[] = {
+        "+", "-", "*", "/", "%", "=", "==", "!=", "<", ">", "<=", ">=", "&&", "||", "!",
+        "&", "|", "^", "~", "<<", ">>", "+=", "-=", "<<=", ">>=", "->", "++", "--",
+        "(", ")", "[", "]", "{", "}", ";", ",", ".", "...", "?", ":",
+    };
+    return generate(size, [](std::mt19937& rng, std::string& out) {
+        out += "a";
+        out += ops[pick(rng, std::size(ops))];
+        out += ops[pick(rng, std::size(ops))];
+        out += pick(rng, 3) == 0 ? "b\n" : "b ";
+    });
+}
+
+std::string c_source_corpus(size_t size) {
+    static const char* const unit = R"(/*
+ * Open-addressing hash table mapping strings to integers.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLE_MIN_CAPACITY 16
+#define TABLE_LOAD_FACTOR 0.75
+
+struct entry {
+    const char *key;
+    unsigned long hash;
+    long value;
+};
+
+struct table {
+    struct entry *entries;
+    size_t capacity;
+    size_t count;
+};
+
+static unsigned long hash_string(const char *s)
+{
+    unsigned long h = 5381UL;
+    int c;
+
+    while ((c = *s++) != '\0')
+        h = ((h << 5) + h) ^ (unsigned long)c; /* djb2 variant */
+    return h;
+}
+
+static struct entry *find_slot(struct entry *entries, size_t capacity,
+                               const char *key, unsigned long hash)
+{
+    size_t i = hash & (capacity - 1);
+
+    for (;;) {
+        struct entry *e = &entries[i];
+        if (e->key == NULL || (e->hash == hash && strcmp(e->key, key) == 0))
+            return e;
+        i = (i + 1) & (capacity - 1);
+    }
+}
+
+int table_grow(struct table *t)
+{
+    size_t capacity = t->capacity ? t->capacity * 2 : TABLE_MIN_CAPACITY;
+    struct entry *entries = calloc(capacity, sizeof(*entries));
+    size_t i;
+
+    if (!entries)
+        return -1;
+    for (i = 0; i < t->capacity; ++i) {
+        struct entry *old = &t->entries[i];
+        if (old->key != NULL)
+            *find_slot(entries, capacity, old->key, old->hash) = *old;
+    }
+    free(t->entries);
+    t->entries = entries;
+    t->capacity = capacity;
+    return 0;
+}
+
+int table_put(struct table *t, const char *key, long value)
+{
+    unsigned long hash = hash_string(key);
+    struct entry *e;
+
+    if (t->count + 1 > t->capacity * TABLE_LOAD_FACTOR && table_grow(t) != 0) {
+        fprintf(stderr, "table_put: out of memory (%zu entries)\n", t->count);
+        return -1;
+    }
+    e = find_slot(t->entries, t->capacity, key, hash);
+    if (e->key == NULL)
+        t->count++;
+    e->key = key;
+    e->hash = hash;
+    e->value = value;
+    return 0;
+}
+
+)";
+    std::string out;
+    out.reserve(size + 4096);
+    while (out.size() < size) {
+        out += unit;
+    }
+    return out;
+}
+
+std::string macro_corpus(size_t size) {
+    static const char* const header = R"(#define NULL ((void *)0)
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define CLAMP(x, lo, hi) MIN(MAX(x, lo), hi)
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define offsetof(type, member) ((unsigned long)&((type *)0)->member)
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+#define list_for_each(pos, head) \
+    for (pos = (head)->next; pos != (head); pos = pos->next)
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define CAT(a, b) a ## b
+#define FIELD(type, name) type CAT(m_, name);
+#define GETTER(type, name) \
+    static type CAT(get_, name)(const struct object *o) { return o->CAT(m_, name); }
+#define ASSERT(cond) \
+    ((cond) ? (void)0 : assert_fail(#cond, SOURCE_NAME, __LINE__))
+#define LOG(level, ...) log_message(level, __VA_ARGS__)
+#define VERSION_MAJOR 3
+#define VERSION_MINOR 14
+#define VERSION ((VERSION_MAJOR << 16) | VERSION_MINOR)
+#define SOURCE_NAME "corpus.c"
+
+struct list_head { struct list_head *next, *prev; };
+void assert_fail(const char *, const char *, int);
+void log_message(int, const char *, ...);
+
+)";
+    static const char* const unit = R"(struct object {
+    FIELD(int, id)
+    FIELD(long, size)
+    FIELD(const char *, name)
+    struct list_head link;
+};
+
+GETTER(int, id)
+GETTER(long, size)
+
+#if VERSION >= ((3 << 16) | 10) && defined(LOG)
+static long total_size(struct list_head *head, long limit)
+{
+    struct list_head *pos;
+    long total = 0;
+
+    list_for_each(pos, head) {
+        struct object *o = container_of(pos, struct object, link);
+        ASSERT(o != NULL && get_id(o) >= 0);
+        total += CLAMP(get_size(o), 0, limit);
+        if (total > limit)
+            LOG(2, "total %ld over " XSTR(VERSION) " limit %ld", total, limit);
+    }
+    return MIN(total, limit);
+}
+#else
+static long total_size(struct list_head *head, long limit) { return 0; }
+#endif
+
+#ifdef DEBUG
+static const char *object_name(struct object *o) { return o->m_name; }
+#endif
+
+static int table[] = { MAX(1, 2), MIN(3, 4), CAT(1, 0), VERSION_MINOR };
+static unsigned long table_size = ARRAY_SIZE(table);
+
+)";
+    std::string out = header;
+    out.reserve(size + 4096);
+    while (out.size() < size) {
+        out += unit;
+    }
+    return out;
+}
+
+std::string program_corpus(size_t size) {
+    static const char* const unit = R"(typedef unsigned long size_@;
+typedef struct node_@ node_@;
+
+struct node_@ {
+    node_@ *next, *prev;
+    size_@ length;
+    unsigned flags : 4, kind : 3;
+    union { long integer; double real; const char *text; } value;
+    int (*compare)(const node_@ *, const node_@ *);
+};
+
+enum color_@ { RED_@, GREEN_@ = 4, BLUE_@ = GREEN_@ * 2 + 1 };
+
+static const int weights_@[8] = { 1, 2, 3, 5, 8, 13, [6] = 21, 34 };
+static node_@ sentinel_@ = { .next = &sentinel_@, .prev = &sentinel_@, .length = 0 };
+
+static size_@ list_length_@(const node_@ *head, size_@ limit)
+{
+    size_@ count = 0;
+    const node_@ *p;
+
+    for (p = head->next; p != head && count < limit; p = p->next) {
+        if (p->flags & 1)
+            continue;
+        count += (p->length > 16 ? p->length / 2 : p->length) + weights_@[count % 8];
+    }
+    return count;
+}
+
+double mix_@(double a, double b, int steps, const double *table)
+{
+    double total = 0.0;
+    int i;
+
+    for (i = 0; i < steps; ++i) {
+        double t = (double)i / steps;
+        total += a * (1.0 - t) + b * t - table[i & 7] * (t * t - 0.5) / 3.0;
+        switch (i % 3) {
+        case 0:
+            total *= 0.5;
+            break;
+        case 1:
+            total -= sizeof(node_@) + sizeof total;
+            break;
+        default:
+            total = total < 0 ? -total : total;
+        }
+    }
+    do {
+        total /= 2;
+    } while (total > 1e6 && !(steps < 0 || a == b));
+    return total;
+}
+
+int insert_@(node_@ *head, node_@ *node, enum color_@ color)
+{
+    node_@ **link = &head->next;
+
+    while (*link != head && (*link)->compare(*link, node) < 0)
+        link = &(*link)->next;
+    node->next = *link;
+    node->prev = (*link)->prev;
+    (*link)->prev = node;
+    *link = node;
+    node->value.integer = (long)color << 8 | (node->flags ^ 0x5a) >> 1;
+    return color == RED_@ ? 0 : ((node_@ *){ 0 } == 0) + list_length_@(head, 100) > 10;
+}
+
+)";
+    std::string out;
+    out.reserve(size + 4096);
+    for (size_t i = 0; out.size() < size; ++i) {
+        std::string number = std::to_string(i);
+        for (const char* p = unit; *p; ++p) {
+            if (*p == '@') {
+                out += number;
+            } else {
+                out += *p;
+            }
+        }
+    }
+    return out;
+}
+
+std::string expression_corpus(size_t size) {
+    size_t count = 0;
+    return generate(size, [&count](std::mt19937& rng, std::string& out) {
+        out += "static const long e" + std::to_string(count++) + " = ";
+        random_expression(rng, out, 0, 64 + pick(rng, 192));
+        out += ";\n";
+    });
+}
+
+std::string expression_macro_corpus(size_t size) {
+    static const char* const header = R"(#define MIX(x) ((x) * 31 + 7 ^ (x) >> 3)
+#define MIX2(x) MIX(MIX(x) | 1)
+#define SELECT(c, a, b) ((c) ? (a) : (b))
+#define HASH(a, b) SELECT((a) < (b), MIX2(a) + (b), MIX(b) - (a))
+
+)";
+    std::string out = header;
+    out.reserve(size + 256);
+    for (size_t i = 0; out.size() < size; ++i) {
+        std::string n = std::to_string(i);
+        out += "unsigned long h" + n + "(unsigned long a, unsigned long b) { return HASH(a + " + n +
+               ", b) << 1 | MIX(a * b); }\n";
+    }
+    return out;
+}
+
+std::string globals_corpus(size_t size) {
+    std::string out;
+    out.reserve(size + 256);
+    size_t count = 0;
+    for (; out.size() < size; ++count) {
+        std::string n = std::to_string(count);
+        if (count % 4 == 0) {
+            out += "typedef struct s" + n + " t" + n + ";\n";
+        } else if (count % 4 == 1) {
+            out += 't';
+            out += std::to_string(count - 1);
+            out += " *g" + n + ";\n";
+        } else {
+            out += "static long g" + n + " = " + n + ";\n";
+        }
+    }
+    // Uses of names from all over the file
+    out += "long use_globals(void)\n{\n    long sum = 0;\n";
+    for (size_t i = 3; i < count; i += 97) {
+        out += "    sum += g" + std::to_string(i - i % 4 + 2) + ";\n";
+    }
+    out += "    return sum;\n}\n";
+    return out;
+}
+
+std::string nested_blocks_corpus(size_t size) {
+    std::string out = "typedef int T;\nint x;\n\n";
+    out.reserve(size + 4096);
+    for (size_t i = 0; out.size() < size; ++i) {
+        out += "void nest" + std::to_string(i) + "(void)\n{\n";
+        for (int depth = 0; depth < 100; ++depth) {
+            std::string d = std::to_string(depth);
+            out += "{ T *p" + d + " = 0; int x" + d + " = x + " + d + ";";
+            out += depth % 2 ? " typedef long T; T y = x" + d + ";\n" : " int T = x" + d + ";\n";
+        }
+        out += std::string(100, '}');
+        out += "\n}\n";
+    }
+    return out;
+}
+
+std::string read_files(const std::vector<std::string>& paths) {
+    std::string out;
+    for (const std::string& path : paths) {
+        out += lexer::SourceBuffer::from_file(path)->text();
+        out += '\n';
+    }
+    return out;
+}
+
+} // namespace bench
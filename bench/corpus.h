@@ -0,0 +1,55 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Synthetic inputs of roughly `size` bytes, each dominated by one kind of
+// token. They are generated from a fixed seed so runs are comparable.
+std::string identifier_corpus(size_t size);
+std::string numeric_corpus(size_t size);
+std::string table_corpus(size_t size); // Generated lookup arrays of hex and float constants
+std::string comment_corpus(size_t size);
+std::string string_corpus(size_t size);
+std::string resource_corpus(size_t size); // Embedded binary blobs as escaped string literals
+std::string operator_corpus(size_t size);
+
+// A small but realistic C translation unit repeated to `size` bytes.
+std::string c_source_corpus(size_t size);
+
+// C that leans on the preprocessor: a block of macro definitions, then code
+// using function-like macros, # and ##, and #if, repeated to `size` bytes.
+// It includes nothing, so any preprocessor can run it standalone.
+std::string macro_corpus(size_t size);
+
+// Self-contained C with no directives and names made unique in each copy:
+// typedefs, structs, unions, enums, initializers and functions using every
+// kind of statement and most operators, repeated to `size` bytes.
+std::string program_corpus(size_t size);
+
+// File-scope initializers of 64 to 256 operands each, joined by every
+// binary operator and mixing in parentheses, casts and conditionals.
+std::string expression_corpus(size_t size);
+
+// Functions whose bodies are a few nested function-like macros that expand
+// into large arithmetic expressions, repeated to `size` bytes.
+std::string expression_macro_corpus(size_t size);
+
+// File-scope declarations, a quarter of them typedefs, one per line until
+// `size` bytes, then a function using globals from all over the file.
+std::string globals_corpus(size_t size);
+
+// Functions whose bodies are blocks nested 100 deep, each declaring
+// variables and alternately hiding the typedef T with an object or another
+// typedef, repeated to `size` bytes.
+std::string nested_blocks_corpus(size_t size);
+
+// Concatenation of the files at paths. Throws std::system_error on failure.
+std::string read_files(const std::vector<std::string>& paths);
+
+} // namespace bench
+
+#endif // CORPUS_H
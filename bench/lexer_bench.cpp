@@ -0,0 +1,428 @@
+#include "bench.h"
+#include "corpus.h"
+#include "lexer/lexer.h"
+#include "lexer/hash.h"
+#include "lexer/keywords.h"
+#include "lexer/incremental_lexer.h"
+#include "lexer/parallel_lexer.h"
+#include "lexer/pipelined_lexer.h"
+#include "lexer/streaming_lexer.h"
+#include "lexer/scan.h"
+#include "lexer/token_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+using Buffer = std::shared_ptr<const lexer::SourceBuffer>;
+
+// Pulls every token through next_token() of a lexer configuration
+template <typename Lexer = lexer::Lexer>
+bench::Work lex(const Buffer& buffer) {
+    Lexer lex(buffer);
+    size_t tokens = 0;
+    while (lex.next_token().type != lexer::TokenType::END_OF_FILE) {
+        ++tokens;
+    }
+    return {tokens, buffer->size()};
+}
+
+// Lexes source from a memory-mapped temporary file, mapping included
+void run_mapped(bench::Suite& suite, const std::string& name, const std::string& source) {
+    if (!suite.enabled(name)) {
+        return;
+    }
+    char path[] = "/tmp/lexer_bench_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    std::ofstream(path, std::ios::binary) << source;
+
+    suite.run(name, "tokens", [&] {
+        return lex(lexer::SourceBuffer::from_file(path));
+    });
+    std::remove(path);
+}
+
+// Compares the compile-time keyword table against the std::unordered_map
+// lookup it replaced, which built a std::string for every identifier.
+void run_keyword_lookup(bench::Suite& suite) {
+    std::unordered_map<std::string, lexer::TokenType> map;
+    std::vector<std::string_view> names;
+    for (const lexer::Keyword& keyword : lexer::c99_keywords) {
+        map.emplace(std::string(keyword.spelling), keyword.type);
+        names.push_back(keyword.spelling);
+    }
+    for (const char* name : {"i", "count", "buffer_length", "next", "node", "printf",
+                             "size_t", "uint32_t", "result", "p", "dest", "src",
+                             "memcpy", "index", "value", "ctx", "len", "flags"}) {
+        names.push_back(name);
+    }
+    const size_t rounds = 100000;
+
+    suite.run("keywords/unordered_map", "lookups", [&] {
+        size_t keywords = 0;
+        for (size_t r = 0; r < rounds; ++r) {
+            for (std::string_view name : names) {
+                keywords += map.find(std::string(name)) != map.end();
+            }
+        }
+        bench::do_not_optimize(keywords);
+        return bench::Work{rounds * names.size(), 0};
+    });
+
+    suite.run("keywords/perfect_hash", "lookups", [&] {
+        size_t keywords = 0;
+        for (size_t r = 0; r < rounds; ++r) {
+            for (std::string_view name : names) {
+                keywords += lexer::c99_keyword_table.lookup(name.data(), name.size()) !=
+                            lexer::TokenType::IDENTIFIER;
+            }
+        }
+        bench::do_not_optimize(keywords);
+        return bench::Work{rounds * names.size(), 0};
+    });
+}
+
+// Lexes a set of headers from disk, interning identifiers, once from
+// scratch and once from a token cache filled beforehand. Uses the files
+// named on the command line, or else cuts text into 256 generated headers.
+void run_token_cache(bench::Suite& suite, const std::vector<std::string>& inputs,
+                     std::string_view text) {
+    if (!suite.enabled("token_cache/")) {
+        return;
+    }
+    char directory[] = "/tmp/lexer_bench_cache_XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::perror("mkdtemp");
+        return;
+    }
+
+    std::vector<std::string> paths = inputs;
+    std::vector<std::string> generated;
+    if (paths.empty()) {
+        const size_t count = 256;
+        for (size_t k = 0, begin = 0; k < count && begin < text.size(); ++k) {
+            size_t end = k + 1 == count ? text.size()
+                                        : std::min(text.find('\n', text.size() * (k + 1) / count),
+                                                   text.size());
+            std::string path = std::string(directory) + "/header" + std::to_string(k) + ".h";
+            std::ofstream(path, std::ios::binary) << text.substr(begin, end - begin);
+            generated.push_back(path);
+            begin = end;
+        }
+        paths = generated;
+    }
+
+    lexer::TokenCache cache(directory);
+    size_t bytes = 0;
+    for (const std::string& path : paths) {
+        auto buffer = lexer::SourceBuffer::from_file(path);
+        cache.store(lexer::Lexer(buffer).tokenize_all());
+        bytes += buffer->size();
+    }
+
+    suite.run("token_cache/lex", "tokens", [&] {
+        lexer::IdentifierTable identifiers;
+        size_t tokens = 0;
+        for (const std::string& path : paths) {
+            tokens += lexer::Lexer(lexer::SourceBuffer::from_file(path), &identifiers).tokenize_all().size();
+        }
+        return bench::Work{tokens, bytes};
+    });
+    suite.run("token_cache/load", "tokens", [&] {
+        lexer::IdentifierTable identifiers;
+        size_t tokens = 0;
+        for (const std::string& path : paths) {
+            tokens += cache.load(lexer::SourceBuffer::from_file(path), &identifiers)->size();
+        }
+        return bench::Work{tokens, bytes};
+    });
+
+    for (const std::string& path : paths) {
+        std::remove(cache.path(lexer::hash_bytes(lexer::SourceBuffer::from_file(path)->text())).c_str());
+    }
+    for (const std::string& path : generated) {
+        std::remove(path.c_str());
+    }
+    rmdir(directory);
+}
+
+// Edits one identifier in the middle of buffer and undoes it again, the
+// pattern of typing in an editor. Replacing a character leaves every offset
+// in place; inserting and deleting one also shifts the tokens after it.
+void run_relex(bench::Suite& suite, const std::string& name, const Buffer& buffer) {
+    lexer::TokenStream tokens = lexer::Lexer(buffer).tokenize_all();
+    size_t i = tokens.lower_bound(static_cast<uint32_t>(buffer->size() / 2));
+    while (tokens.kind(i) != lexer::TokenType::IDENTIFIER) {
+        ++i;
+    }
+    const uint32_t at = tokens.offset(i);
+    const std::string original(1, buffer->data()[at]);
+
+    struct Case {
+        const char* name;
+        lexer::TextEdit edit;
+        lexer::TextEdit undo;
+        size_t rounds;
+    };
+    for (const Case& c : {Case{"replace_char", {at, 1, "q"}, {at, 1, original}, 20000},
+                          Case{"insert_delete_char", {at, 0, "q"}, {at, 1, ""}, 100}}) {
+        Buffer edited = lexer::apply_edit(*buffer, c.edit);
+        suite.run("relex/" + name + "/" + c.name, "edits", [&] {
+            for (size_t r = 0; r < c.rounds; ++r) {
+                lexer::relex(tokens, edited, c.edit);
+                lexer::relex(tokens, buffer, c.undo);
+            }
+            return bench::Work{2 * c.rounds, 0};
+        });
+    }
+}
+
+// Stands in for a parser: a fixed amount of dependent work per token,
+// roughly what lexing the token costs
+uint64_t consume(const lexer::Token& token, uint64_t state) {
+    for (int i = 0; i < 5; ++i) {
+        state = (state ^ token.offset ^ static_cast<uint64_t>(token.type)) * 0x9E3779B97F4A7C15ull;
+        state ^= state >> 29;
+    }
+    return state;
+}
+
+// Lexing and consuming one after the other on this thread, against a
+// pipelined lexer feeding the consumer at several batch sizes. consume_only
+// is the consumer alone over tokens lexed beforehand, the best the pipeline
+// can do with a producer that keeps up.
+void run_pipeline(bench::Suite& suite, const std::string& name, const Buffer& buffer) {
+    if (!suite.enabled("pipeline/")) {
+        return;
+    }
+    std::vector<lexer::Token> lexed;
+    lexer::Lexer all(buffer);
+    do {
+        lexed.push_back(all.next_token());
+    } while (lexed.back().type != lexer::TokenType::END_OF_FILE);
+
+    suite.run("pipeline/" + name + "/consume_only", "tokens", [&] {
+        uint64_t state = 0;
+        for (const lexer::Token& token : lexed) {
+            state = consume(token, state);
+        }
+        bench::do_not_optimize(state);
+        return bench::Work{lexed.size(), buffer->size()};
+    });
+
+    suite.run("pipeline/" + name + "/sequential", "tokens", [&] {
+        lexer::Lexer lex(buffer);
+        uint64_t state = 0;
+        size_t tokens = 0;
+        for (lexer::Token token = lex.next_token(); token.type != lexer::TokenType::END_OF_FILE;
+             token = lex.next_token(), ++tokens) {
+            state = consume(token, state);
+        }
+        bench::do_not_optimize(state);
+        return bench::Work{tokens, buffer->size()};
+    });
+
+    for (size_t batch : {1, 16, 64, 256, 1024, 4096}) {
+        suite.run("pipeline/" + name + "/batch_" + std::to_string(batch), "tokens", [&] {
+            lexer::PipelinedLexer lex(buffer, nullptr, batch);
+            uint64_t state = 0;
+            size_t tokens = 0;
+            for (lexer::Token token = lex.next_token(); token.type != lexer::TokenType::END_OF_FILE;
+                 token = lex.next_token(), ++tokens) {
+                state = consume(token, state);
+            }
+            bench::do_not_optimize(state);
+            return bench::Work{tokens, buffer->size()};
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Suite suite("lexer_bench", argc, argv);
+    size_t size = suite.corpus_size();
+
+    std::vector<std::pair<std::string, Buffer>> corpora = {
+        {"identifiers", lexer::SourceBuffer::from_string(bench::identifier_corpus(size))},
+        {"numbers", lexer::SourceBuffer::from_string(bench::numeric_corpus(size))},
+        {"comments", lexer::SourceBuffer::from_string(bench::comment_corpus(size))},
+        {"strings", lexer::SourceBuffer::from_string(bench::string_corpus(size))},
+        {"operators", lexer::SourceBuffer::from_string(bench::operator_corpus(size))},
+        {"c_source", lexer::SourceBuffer::from_string(bench::c_source_corpus(size))},
+        {"tables", lexer::SourceBuffer::from_string(bench::table_corpus(size))},
+        {"resources", lexer::SourceBuffer::from_string(bench::resource_corpus(size))},
+    };
+    if (!suite.inputs().empty()) {
+        corpora.emplace_back("files", lexer::SourceBuffer::from_string(bench::read_files(suite.inputs())));
+    }
+
+    for (const auto& [name, buffer] : corpora) {
+        suite.run("next_token/" + name, "tokens", [&] { return lex(buffer); });
+    }
+
+    suite.run("next_token/identifiers_interned", "tokens", [&] {
+        lexer::IdentifierTable identifiers;
+        lexer::Lexer lex(corpora[0].second, &identifiers);
+        size_t tokens = 0;
+        while (lex.next_token().type != lexer::TokenType::END_OF_FILE) {
+            ++tokens;
+        }
+        return bench::Work{tokens, corpora[0].second->size()};
+    });
+
+    // Values now come out of next_token(); this is what each consumer used
+    // to do on top of lexing to get them
+    const Buffer& tables = corpora[6].second;
+    suite.run("next_token/tables_strtod", "tokens", [&] {
+        lexer::Lexer lex(tables);
+        size_t tokens = 0;
+        double sum = 0;
+        for (lexer::Token token = lex.next_token(); token.type != lexer::TokenType::END_OF_FILE;
+             token = lex.next_token(), ++tokens) {
+            if (token.type == lexer::TokenType::CONSTANT_INT) {
+                sum += std::strtoull(std::string(token.value).c_str(), nullptr, 0);
+            } else if (token.type == lexer::TokenType::CONSTANT_FLOAT) {
+                sum += std::strtod(std::string(token.value).c_str(), nullptr);
+            }
+        }
+        bench::do_not_optimize(sum);
+        return bench::Work{tokens, tables->size()};
+    });
+
+    // Adjacent literals joined into one string per resource
+    const Buffer& resources = corpora[7].second;
+    suite.run("concatenate/resources", "tokens", [&] {
+        lexer::Lexer lex(resources);
+        std::vector<lexer::Token> pieces;
+        size_t tokens = 0;
+        size_t bytes = 0;
+        for (lexer::Token token = lex.next_token(); token.type != lexer::TokenType::END_OF_FILE;
+             token = lex.next_token(), ++tokens) {
+            if (token.type == lexer::TokenType::CONSTANT_STRING) {
+                pieces.push_back(token);
+            } else if (!pieces.empty()) {
+                bytes += lex.concatenate(pieces)->bytes.size();
+                pieces.clear();
+            }
+        }
+        bench::do_not_optimize(bytes);
+        return bench::Work{tokens, resources->size()};
+    });
+
+    const Buffer& c_source = corpora[5].second;
+    run_mapped(suite, "next_token/c_source_mmap", std::string(c_source->text()));
+
+    // Phases 1 and 2: the up-front scan every buffer pays, and lexing a copy
+    // of the same source with its argument lists continued across lines
+    std::string continued(c_source->text());
+    for (size_t i = 0; (i = continued.find(",\n", i)) != std::string::npos; i += 3) {
+        continued.insert(i + 1, "\\");
+    }
+    Buffer spliced = lexer::SourceBuffer::from_string(continued);
+    const std::pair<const char*, Buffer> splice_inputs[] = {{"c_source", c_source},
+                                                            {"c_source_spliced", spliced}};
+    for (const auto& [name, buffer] : splice_inputs) {
+        suite.run(std::string("splice_scan/") + name, "bytes", [&] {
+            auto text = lexer::SplicedText::build(buffer->text());
+            bench::do_not_optimize(text);
+            return bench::Work{buffer->size(), buffer->size()};
+        });
+    }
+    suite.run("next_token/c_source_spliced", "tokens", [&] { return lex(spliced); });
+
+    // The other lexer configurations, against next_token/ above: the dialects
+    // differ only in their keyword table, and keeping comments or dropping
+    // positions should cost nothing for the lexers that do neither
+    for (const auto& [name, buffer] : splice_inputs) {
+        suite.run(std::string("policy/c89/") + name, "tokens", [&] { return lex<lexer::C89Lexer>(buffer); });
+        suite.run(std::string("policy/c11/") + name, "tokens", [&] { return lex<lexer::C11Lexer>(buffer); });
+        suite.run(std::string("policy/comments/") + name, "tokens",
+                  [&] { return lex<lexer::CommentLexer>(buffer); });
+        suite.run(std::string("policy/positionless/") + name, "tokens",
+                  [&] { return lex<lexer::PositionlessLexer>(buffer); });
+    }
+
+    suite.run("tokenize_all/c_source", "tokens", [&] {
+        lexer::Lexer lex(c_source);
+        return bench::Work{lex.tokenize_all().size(), c_source->size()};
+    });
+
+    suite.run("stream/c_source/64KiB", "tokens", [&] {
+        std::string_view text = c_source->text();
+        size_t fed = 0;
+        lexer::StreamingLexer lex([&](char* data, size_t size) {
+            size_t n = std::min({size, size_t{64 << 10}, text.size() - fed});
+            std::memcpy(data, text.data() + fed, n);
+            fed += n;
+            return n;
+        }, size_t{64} << 10);
+        size_t tokens = 0;
+        while (lex.next_token().type != lexer::TokenType::END_OF_FILE) {
+            ++tokens;
+        }
+        return bench::Work{tokens, text.size()};
+    });
+
+    // A parser looking two tokens ahead at every step, and one backtracking
+    // over every eight tokens it reads
+    suite.run("peek_token/c_source", "tokens", [&] {
+        lexer::Lexer lex(c_source);
+        size_t tokens = 0;
+        while (lex.peek_token(1).type != lexer::TokenType::END_OF_FILE) {
+            lex.next_token();
+            ++tokens;
+        }
+        return bench::Work{tokens, c_source->size()};
+    });
+    suite.run("checkpoint/c_source", "tokens", [&] {
+        lexer::Lexer lex(c_source);
+        size_t tokens = 0;
+        for (;;) {
+            lexer::Lexer::Checkpoint checkpoint = lex.checkpoint();
+            for (int i = 0; i < 8; ++i) {
+                lex.next_token();
+            }
+            lex.restore(checkpoint);
+            for (int i = 0; i < 8; ++i, ++tokens) {
+                if (lex.next_token().type == lexer::TokenType::END_OF_FILE) {
+                    return bench::Work{tokens, c_source->size()};
+                }
+            }
+        }
+    });
+
+    run_pipeline(suite, "c_source", c_source);
+    run_relex(suite, "c_source", c_source);
+    run_token_cache(suite, suite.inputs(), c_source->text());
+
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    suite.run("tokenize_parallel/c_source/" + std::to_string(threads), "tokens", [&] {
+        return bench::Work{lexer::tokenize_parallel(c_source, threads).size(), c_source->size()};
+    });
+
+    const Buffer& comments = corpora[2].second;
+    for (lexer::scan::Isa isa : {lexer::scan::Isa::SCALAR, lexer::scan::Isa::SSE2,
+                                 lexer::scan::Isa::AVX2}) {
+        if (static_cast<int>(isa) > static_cast<int>(lexer::scan::best_isa())) {
+            continue;
+        }
+        lexer::scan::use_isa(isa);
+        suite.run(std::string("scan/") + lexer::scan::isa_name(isa) + "/comments", "tokens",
+                  [&] { return lex(comments); });
+    }
+    lexer::scan::use_isa(lexer::scan::best_isa());
+
+    run_keyword_lookup(suite);
+    return suite.finish();
+}
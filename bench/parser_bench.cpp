@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "corpus.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "preprocessor/preprocessor.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Buffer = std::shared_ptr<const lexer::SourceBuffer>;
+
+// The tokens the parser reads, and what keeps their spellings and string
+// literals alive
+struct Input {
+    std::unique_ptr<preprocessor::Preprocessor> preprocessor;
+    std::unique_ptr<lexer::Lexer> lexer;
+    std::vector<lexer::Token> tokens;
+};
+
+Input tokenize(const Buffer& buffer, lexer::IdentifierTable& identifiers, bool preprocess) {
+    Input input;
+    input.tokens.reserve(buffer->size() / 4);
+    if (preprocess) {
+        input.preprocessor = std::make_unique<preprocessor::Preprocessor>(buffer, identifiers);
+        do {
+            input.tokens.push_back(input.preprocessor->next_token());
+        } while (input.tokens.back().type != lexer::TokenType::END_OF_FILE);
+    } else {
+        input.lexer = std::make_unique<lexer::Lexer>(buffer, &identifiers);
+        do {
+            input.tokens.push_back(input.lexer->next_token());
+        } while (input.tokens.back().type != lexer::TokenType::END_OF_FILE);
+    }
+    return input;
+}
+
+// Parsing tokens already in memory, and tokenizing and parsing together.
+// Nodes are the unit, so rows show nodes per second; the AST's size is
+// printed after them.
+void run_corpus(bench::Suite& suite, const std::string& name, const std::string& source,
+                bool preprocess) {
+    if (!suite.enabled("parse/" + name) && !suite.enabled("tokenize_and_parse/" + name)) {
+        return;
+    }
+    Buffer buffer = lexer::SourceBuffer::from_string(source);
+    lexer::IdentifierTable identifiers;
+    Input input = tokenize(buffer, identifiers, preprocess);
+
+    suite.run("parse/" + name, "nodes", [&] {
+        parser::Parser parser(input.tokens, identifiers);
+        parser.parse_translation_unit();
+        return bench::Work{parser.ast().size() - 1, buffer->size()};
+    });
+
+    suite.run("tokenize_and_parse/" + name, "nodes", [&] {
+        lexer::IdentifierTable fresh;
+        Input fresh_input = tokenize(buffer, fresh, preprocess);
+        parser::Parser parser(fresh_input.tokens, fresh);
+        parser.parse_translation_unit();
+        return bench::Work{parser.ast().size() - 1, buffer->size()};
+    });
+
+    parser::Parser parser(input.tokens, identifiers);
+    parser.parse_translation_unit();
+    const parser::Ast& ast = parser.ast();
+    size_t nodes = ast.size() - 1;
+    std::printf("  %s: %zu nodes from %zu tokens, AST %zu bytes: %.2f per source byte, "
+                "%.1f per node; nesting depth %zu; %zu diagnostics\n",
+                name.c_str(), nodes, input.tokens.size(), ast.memory_usage(),
+                static_cast<double>(ast.memory_usage()) / buffer->size(),
+                static_cast<double>(ast.memory_usage()) / nodes, parser.max_depth(),
+                parser.diagnostics().size());
+}
+
+// The expression corpus at 1/16, 1/4 and all of the corpus size: with parse
+// time linear in tokens, the three rows show the same nodes per second.
+void run_scaling(bench::Suite& suite) {
+    for (size_t fraction : {16, 4, 1}) {
+        std::string name = "parse/expressions/x" + std::to_string(16 / fraction);
+        if (!suite.enabled(name)) {
+            continue;
+        }
+        Buffer buffer =
+            lexer::SourceBuffer::from_string(bench::expression_corpus(suite.corpus_size() / fraction));
+        lexer::IdentifierTable identifiers;
+        Input input = tokenize(buffer, identifiers, false);
+        suite.run(name, "nodes", [&] {
+            parser::Parser parser(input.tokens, identifiers);
+            parser.parse_translation_unit();
+            return bench::Work{parser.ast().size() - 1, buffer->size()};
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Suite suite("parser_bench", argc, argv);
+    // Declarations and statements of every kind, lexed without preprocessing
+    run_corpus(suite, "program", bench::program_corpus(suite.corpus_size()), false);
+    // Code written with macros, parsed after expansion
+    run_corpus(suite, "macros", bench::macro_corpus(suite.corpus_size()), true);
+    // Long arithmetic initializers, and macros expanding into big expressions
+    run_corpus(suite, "expressions", bench::expression_corpus(suite.corpus_size()), false);
+    run_corpus(suite, "expression_macros", bench::expression_macro_corpus(suite.corpus_size()),
+               true);
+    // Typedef-name feedback: 100k+ globals, and blocks nested 100 deep
+    run_corpus(suite, "globals", bench::globals_corpus(suite.corpus_size() / 2), false);
+    run_corpus(suite, "nested_blocks", bench::nested_blocks_corpus(suite.corpus_size() / 2),
+               false);
+    run_scaling(suite);
+    return suite.finish();
+}
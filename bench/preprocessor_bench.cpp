@@ -0,0 +1,172 @@
+#include "bench.h"
+#include "corpus.h"
+#include "lexer/lexer.h"
+#include "preprocessor/preprocessor.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+using Buffer = std::shared_ptr<const lexer::SourceBuffer>;
+
+bench::Work preprocess(const Buffer& buffer) {
+    lexer::IdentifierTable identifiers;
+    preprocessor::Preprocessor preprocessor(buffer, identifiers);
+    size_t tokens = 0;
+    while (preprocessor.next_token().type != lexer::TokenType::END_OF_FILE) {
+        ++tokens;
+    }
+    return {tokens, buffer->size()};
+}
+
+// The separate-pass baseline: cpp writes preprocessed text, which is lexed
+// again. Returns no work if cpp cannot be run.
+bench::Work cpp_then_lex(const std::string& path, size_t source_size) {
+    std::string command = "cpp -P " + path + " 2>/dev/null";
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        return {0, 0};
+    }
+    std::string text;
+    char chunk[65536];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), pipe)) > 0;) {
+        text.append(chunk, n);
+    }
+    if (pclose(pipe) != 0) {
+        return {0, 0};
+    }
+    lexer::IdentifierTable identifiers;
+    lexer::Lexer lex(lexer::SourceBuffer::from_string(text), &identifiers);
+    size_t tokens = 0;
+    while (lex.next_token().type != lexer::TokenType::END_OF_FILE) {
+        ++tokens;
+    }
+    return {tokens, source_size};
+}
+
+// A project of guarded headers that include each other, and translation
+// units that each include a random selection of them, written under
+// directory. Returns the paths of the translation units.
+std::vector<std::string> write_project(const std::string& directory, size_t headers,
+                                       size_t units) {
+    std::mt19937 rng(42);
+    auto header = [](size_t i) { return "header_" + std::to_string(i) + ".h"; };
+    for (size_t i = 0; i < headers; ++i) {
+        std::string guard = "HEADER_" + std::to_string(i) + "_H";
+        std::ofstream out(directory + "/" + header(i));
+        out << "#ifndef " << guard << "\n#define " << guard << "\n\n";
+        for (size_t j = 0; i > 0 && j < 8; ++j) {
+            out << "#include \"" << header(rng() % i) << "\"\n";
+        }
+        out << "\n#define FIELD_" << i << "(x) x.field_" << i << "\n";
+        out << "struct record_" << i << " {\n    int id;\n    long field_" << i
+            << ";\n    const char *name;\n};\n";
+        out << "static inline long get_" << i << "(const struct record_" << i
+            << " *r) { return r->field_" << i << " + " << i << "; }\n\n#endif\n";
+    }
+    std::vector<std::string> paths;
+    for (size_t u = 0; u < units; ++u) {
+        std::string path = directory + "/unit_" + std::to_string(u) + ".c";
+        std::ofstream out(path);
+        for (size_t j = 0; j < 30; ++j) {
+            out << "#include \"" << header(rng() % headers) << "\"\n";
+        }
+        out << "\nint main(void) { return 0; }\n";
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+bench::Work preprocess_units(const std::vector<std::string>& units, preprocessor::FileCache& cache) {
+    size_t tokens = 0;
+    for (const std::string& path : units) {
+        preprocessor::Preprocessor preprocessor(path, cache);
+        while (preprocessor.next_token().type != lexer::TokenType::END_OF_FILE) {
+            ++tokens;
+        }
+    }
+    return {tokens, 0};
+}
+
+// Many translation units including the same headers: with a fresh cache each
+// time, every header is read and lexed once per run; with one cache kept
+// across runs, never again. cpp reads them for every unit.
+void run_includes(bench::Suite& suite) {
+    if (!suite.enabled("include/cold_cache") && !suite.enabled("include/warm_cache") &&
+        !suite.enabled("include/cpp_then_lex")) {
+        return;
+    }
+    char directory[] = "/tmp/preprocessor_bench_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return;
+    }
+    std::vector<std::string> units = write_project(directory, 400, 50);
+
+    suite.run("include/cold_cache", "tokens", [&] {
+        lexer::IdentifierTable identifiers;
+        preprocessor::FileCache cache(identifiers);
+        return preprocess_units(units, cache);
+    });
+
+    lexer::IdentifierTable identifiers;
+    preprocessor::FileCache cache(identifiers);
+    suite.run("include/warm_cache", "tokens", [&] { return preprocess_units(units, cache); });
+    std::printf("\n%s\n", cache.report().c_str());
+
+    suite.run("include/cpp_then_lex", "tokens", [&] {
+        bench::Work total{0, 0};
+        for (const std::string& path : units) {
+            total.items += cpp_then_lex(path, 0).items;
+        }
+        return total;
+    });
+
+    std::filesystem::remove_all(directory);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Suite suite("preprocessor_bench", argc, argv);
+    std::string source = bench::macro_corpus(suite.corpus_size());
+    Buffer buffer = lexer::SourceBuffer::from_string(source);
+
+    // What lexing alone costs, with directives and macros left unprocessed
+    suite.run("lex_only/macros", "tokens", [&] {
+        lexer::IdentifierTable identifiers;
+        lexer::Lexer lex(buffer, &identifiers);
+        size_t tokens = 0;
+        while (lex.next_token().type != lexer::TokenType::END_OF_FILE) {
+            ++tokens;
+        }
+        return bench::Work{tokens, buffer->size()};
+    });
+
+    suite.run("preprocess/macros", "tokens", [&] { return preprocess(buffer); });
+
+    if (suite.enabled("cpp_then_lex/macros")) {
+        char path[] = "/tmp/preprocessor_bench_XXXXXX.c";
+        int fd = mkstemps(path, 2);
+        close(fd);
+        std::ofstream(path, std::ios::binary) << source;
+        bench::Work expected = preprocess(buffer);
+        suite.run("cpp_then_lex/macros", "tokens", [&] {
+            bench::Work work = cpp_then_lex(path, source.size());
+            if (work.items != expected.items) {
+                std::fprintf(stderr, "cpp_then_lex: %zu tokens, preprocess: %zu\n",
+                             work.items, expected.items);
+            }
+            return work;
+        });
+        std::remove(path);
+    }
+
+    run_includes(suite);
+    return suite.finish();
+}
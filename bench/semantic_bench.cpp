@@ -0,0 +1,127 @@
+#include "bench.h"
+#include "lexer/identifier_table.h"
+#include "semantic/symbol_table.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using lexer::IdentifierId;
+using semantic::Symbol;
+using semantic::SymbolKind;
+
+// The baseline: a hash map per scope, searched innermost first, as the
+// parser tracked typedef names before it used SymbolTable
+class MapStack {
+public:
+    explicit MapStack(size_t) { scopes_.emplace_back(); }
+
+    void push_scope() { scopes_.emplace_back(); }
+    void pop_scope() { scopes_.pop_back(); }
+
+    void declare(IdentifierId name, SymbolKind kind, uint32_t declaration) {
+        scopes_.back()[name] = Symbol{name, kind, static_cast<uint32_t>(scopes_.size() - 1),
+                                      declaration, 0};
+    }
+
+    const Symbol* lookup(IdentifierId name) const {
+        for (auto scope = scopes_.rbegin(); scope != scopes_.rend(); ++scope) {
+            if (auto it = scope->find(name); it != scope->end()) {
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<std::unordered_map<IdentifierId, Symbol>> scopes_;
+};
+
+// Declares every global at file scope, then looks each one up from inside a
+// function's nested blocks, as the uses in its body would.
+template <typename Table>
+bench::Work globals(const std::vector<IdentifierId>& names,
+                    const std::vector<IdentifierId>& locals, size_t table_size) {
+    Table table(table_size);
+    for (uint32_t i = 0; i < names.size(); ++i) {
+        table.declare(names[i], i % 4 == 0 ? SymbolKind::TYPEDEF : SymbolKind::OBJECT, i);
+    }
+    for (IdentifierId local : locals) {
+        table.push_scope();
+        table.declare(local, SymbolKind::OBJECT, 0);
+    }
+    uint64_t sum = 0;
+    for (int pass = 0; pass < 4; ++pass) {
+        for (IdentifierId name : names) {
+            sum += table.lookup(name)->declaration;
+        }
+    }
+    bench::do_not_optimize(sum);
+    return {names.size() * 5, 0};
+}
+
+// Enters blocks nested depth deep, each declaring a few names, some hiding
+// outer ones, and looking up names from every level, then leaves them all;
+// many times over.
+template <typename Table>
+bench::Work nested(const std::vector<IdentifierId>& names, size_t depth, size_t repeat,
+                   size_t table_size) {
+    Table table(table_size);
+    for (IdentifierId name : names) {
+        table.declare(name, SymbolKind::OBJECT, 0);
+    }
+    size_t operations = 0;
+    uint64_t found = 0;
+    for (size_t r = 0; r < repeat; ++r) {
+        for (size_t level = 0; level < depth; ++level) {
+            table.push_scope();
+            for (size_t k = 0; k < 3; ++k) {
+                table.declare(names[(level * 3 + k) % names.size()], SymbolKind::OBJECT,
+                              static_cast<uint32_t>(level));
+            }
+            for (size_t k = 0; k < 4; ++k) {
+                found += table.lookup(names[(level * 7 + k * 13) % names.size()]) != nullptr;
+            }
+            operations += 9; // Push, declarations, lookups and the pop below
+        }
+        for (size_t level = 0; level < depth; ++level) {
+            table.pop_scope();
+        }
+    }
+    bench::do_not_optimize(found);
+    return {operations, 0};
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Suite suite("semantic_bench", argc, argv);
+
+    lexer::IdentifierTable identifiers;
+    std::vector<IdentifierId> names;
+    for (size_t i = 0; i < 100000; ++i) {
+        names.push_back(identifiers.intern("global_" + std::to_string(i)));
+    }
+    std::vector<IdentifierId> locals;
+    for (const char* local : {"i", "j", "p", "tmp"}) {
+        locals.push_back(identifiers.intern(local));
+    }
+    size_t table_size = identifiers.size();
+
+    // 100k globals: declared, then each looked up four times from four
+    // blocks down. Items are declarations plus lookups.
+    suite.run("globals/symbol_table", "ops",
+              [&] { return globals<semantic::SymbolTable>(names, locals, table_size); });
+    suite.run("globals/map_stack", "ops",
+              [&] { return globals<MapStack>(names, locals, table_size); });
+
+    // Blocks nested 1000 deep over 64 names, entered and left 100 times
+    std::vector<IdentifierId> few(names.begin(), names.begin() + 64);
+    suite.run("nested/symbol_table", "ops",
+              [&] { return nested<semantic::SymbolTable>(few, 1000, 100, table_size); });
+    suite.run("nested/map_stack", "ops",
+              [&] { return nested<MapStack>(few, 1000, 100, table_size); });
+    return suite.finish();
+}
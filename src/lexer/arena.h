@@ -0,0 +1,97 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lexer {
+
+// Bump allocator for data that lives as long as its owner: decoded literals,
+// and anything else built once and never freed piecemeal. Allocations never
+// move, and moving the arena keeps them valid. Not thread-safe.
+class Arena {
+public:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    Arena() = default;
+    Arena(Arena&& other) noexcept { *this = std::move(other); }
+    Arena& operator=(Arena&& other) noexcept {
+        chunks_ = std::move(other.chunks_);
+        pos_ = std::exchange(other.pos_, nullptr);
+        left_ = std::exchange(other.left_, 0);
+        capacity_ = std::exchange(other.capacity_, 0);
+        return *this;
+    }
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // size bytes aligned to align, which must be a power of two no larger
+    // than alignof(std::max_align_t).
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        size_t skip = (align - reinterpret_cast<uintptr_t>(pos_)) & (align - 1);
+        if (size + skip > left_) {
+            new_chunk(size);
+            skip = 0;
+        }
+        char* result = pos_ + skip;
+        pos_ = result + size;
+        left_ -= size + skip;
+        return result;
+    }
+
+    // Gives back the tail of the most recent allocation, shrinking it from
+    // old_size to new_size bytes; does nothing for an earlier allocation.
+    void shrink(void* p, size_t old_size, size_t new_size) {
+        if (static_cast<char*>(p) + old_size == pos_) {
+            pos_ -= old_size - new_size;
+            left_ += old_size - new_size;
+        }
+    }
+
+    // Constructs a T in the arena. Destructors are never run, so T must be
+    // trivially destructible.
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copy of text, followed by a NUL that is not part of the view.
+    std::string_view copy(std::string_view text) {
+        char* p = static_cast<char*>(allocate(text.size() + 1, 1));
+        std::memcpy(p, text.data(), text.size());
+        p[text.size()] = '\0';
+        return std::string_view(p, text.size());
+    }
+
+    // Bytes reserved from the system, including unused chunk tails.
+    size_t capacity() const { return capacity_; }
+
+private:
+    // Oversized requests get a chunk of their own
+    void new_chunk(size_t size) {
+        size_t chunk = std::max(size, kChunkSize);
+        chunks_.push_back(std::make_unique<std::max_align_t[]>(
+            (chunk + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)));
+        pos_ = reinterpret_cast<char*>(chunks_.back().get());
+        left_ = chunk;
+        capacity_ += chunk;
+    }
+
+    std::vector<std::unique_ptr<std::max_align_t[]>> chunks_;
+    char* pos_ = nullptr;
+    size_t left_ = 0;
+    size_t capacity_ = 0;
+};
+
+} // namespace lexer
+
+#endif // ARENA_H
@@ -0,0 +1,43 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace lexer {
+
+// Fast non-cryptographic 64-bit hash. Reads eight bytes per step with
+// unaligned loads and finishes with a multiply-xorshift mix, which is plenty
+// for hash tables keyed by identifiers and for content-addressed caches.
+inline uint64_t hash_bytes(const char* data, size_t size, uint64_t seed = 0) {
+    constexpr uint64_t kMul = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = seed ^ (size * kMul);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * kMul;
+        h ^= h >> 29;
+    }
+    if (i < size) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, size - i);
+        h = (h ^ word) * kMul;
+        h ^= h >> 29;
+    }
+
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t hash_bytes(std::string_view text, uint64_t seed = 0) {
+    return hash_bytes(text.data(), text.size(), seed);
+}
+
+} // namespace lexer
+
+#endif // HASH_H
@@ -0,0 +1,90 @@
+#include "identifier_table.h"
+#include "hash.h"
+#include <algorithm>
+#include <cstring>
+
+namespace lexer {
+
+namespace {
+
+constexpr size_t kInitialSlots = 1024;
+constexpr size_t kChunkSize = 64 * 1024;
+
+} // namespace
+
+IdentifierTable::IdentifierTable() : slots_(kInitialSlots, Slot{0, kNoIdentifier}) {
+    spellings_.emplace_back(); // kNoIdentifier
+}
+
+IdentifierId IdentifierTable::intern(std::string_view spelling) {
+    uint32_t hash = static_cast<uint32_t>(hash_bytes(spelling));
+    size_t index = probe(spelling, hash);
+    if (slots_[index].id != kNoIdentifier) {
+        return slots_[index].id;
+    }
+
+    IdentifierId id = static_cast<IdentifierId>(spellings_.size());
+    spellings_.push_back(store(spelling));
+    slots_[index] = Slot{hash, id};
+
+    // Keep the load factor at or below one half
+    if (spellings_.size() * 2 > slots_.size()) {
+        grow();
+    }
+    return id;
+}
+
+IdentifierId IdentifierTable::find(std::string_view spelling) const {
+    uint32_t hash = static_cast<uint32_t>(hash_bytes(spelling));
+    return slots_[probe(spelling, hash)].id;
+}
+
+// Index of spelling's slot, or of the empty slot where it would go
+size_t IdentifierTable::probe(std::string_view spelling, uint32_t hash) const {
+    size_t mask = slots_.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+        const Slot& slot = slots_[index];
+        if (slot.id == kNoIdentifier ||
+            (slot.hash == hash && spellings_[slot.id] == spelling)) {
+            return index;
+        }
+    }
+}
+
+void IdentifierTable::grow() {
+    std::vector<Slot> old(slots_.size() * 2, Slot{0, kNoIdentifier});
+    old.swap(slots_);
+
+    size_t mask = slots_.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.id == kNoIdentifier) {
+            continue;
+        }
+        size_t index = slot.hash & mask;
+        while (slots_[index].id != kNoIdentifier) {
+            index = (index + 1) & mask;
+        }
+        slots_[index] = slot;
+    }
+}
+
+// Copies spelling into the current chunk, starting a new one when it is full
+std::string_view IdentifierTable::store(std::string_view spelling) {
+    if (spelling.empty()) {
+        return spelling;
+    }
+    if (spelling.size() > chunk_left_) {
+        size_t size = std::max(kChunkSize, spelling.size());
+        chunks_.push_back(std::make_unique<char[]>(size));
+        chunk_pos_ = chunks_.back().get();
+        chunk_left_ = size;
+    }
+
+    char* copy = chunk_pos_;
+    std::memcpy(copy, spelling.data(), spelling.size());
+    chunk_pos_ += spelling.size();
+    chunk_left_ -= spelling.size();
+    return std::string_view(copy, spelling.size());
+}
+
+} // namespace lexer
@@ -0,0 +1,59 @@
+#ifndef IDENTIFIER_TABLE_H
+#define IDENTIFIER_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace lexer {
+
+// Small dense integer naming an interned identifier spelling. Equal IDs mean
+// equal spellings, so later stages compare and index identifiers without
+// touching strings. 0 means "not an identifier".
+using IdentifierId = uint32_t;
+inline constexpr IdentifierId kNoIdentifier = 0;
+
+// Interns identifier spellings into dense IDs. Spellings are copied into
+// storage owned by the table, so IDs and spelling() views stay valid after
+// the source buffers they came from are released, and one table can be
+// shared by every lexer in a compilation. Not thread-safe.
+class IdentifierTable {
+public:
+    IdentifierTable();
+
+    IdentifierTable(const IdentifierTable&) = delete;
+    IdentifierTable& operator=(const IdentifierTable&) = delete;
+
+    // ID for spelling, interning it on first sight.
+    IdentifierId intern(std::string_view spelling);
+
+    // ID for spelling if it has been interned, otherwise kNoIdentifier.
+    IdentifierId find(std::string_view spelling) const;
+
+    std::string_view spelling(IdentifierId id) const { return spellings_[id]; }
+
+    // Number of IDs handed out, plus one for kNoIdentifier.
+    size_t size() const { return spellings_.size(); }
+
+private:
+    struct Slot {
+        uint32_t hash; // Low bits of the spelling's hash, to skip most compares
+        IdentifierId id;
+    };
+
+    size_t probe(std::string_view spelling, uint32_t hash) const;
+    void grow();
+    std::string_view store(std::string_view spelling);
+
+    std::vector<Slot> slots_; // Open addressing, power-of-two size, id 0 = empty
+    std::vector<std::string_view> spellings_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* chunk_pos_ = nullptr;
+    size_t chunk_left_ = 0;
+};
+
+} // namespace lexer
+
+#endif // IDENTIFIER_TABLE_H
@@ -0,0 +1,110 @@
+#include "incremental_lexer.h"
+#include "lexer.h"
+#include <stdexcept>
+#include <string>
+
+namespace lexer {
+
+namespace {
+
+void check_edit(const SourceBuffer& buffer, const TextEdit& edit) {
+    if (edit.offset > buffer.size() || edit.removed > buffer.size() - edit.offset) {
+        throw std::out_of_range("edit lies outside the buffer");
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const SourceBuffer> apply_edit(const SourceBuffer& buffer, const TextEdit& edit) {
+    check_edit(buffer, edit);
+    std::string_view text = buffer.text();
+    std::string edited;
+    edited.reserve(text.size() - edit.removed + edit.inserted.size());
+    edited.append(text.substr(0, edit.offset));
+    edited.append(edit.inserted);
+    edited.append(text.substr(edit.offset + edit.removed));
+    return SourceBuffer::from_string(edited);
+}
+
+RelexRange relex(TokenStream& tokens, std::shared_ptr<const SourceBuffer> edited,
+                 const TextEdit& edit, IdentifierTable* identifiers) {
+    const SourceBuffer& old_buffer = *tokens.buffer();
+    check_edit(old_buffer, edit);
+    if (edited->size() != old_buffer.size() - edit.removed + edit.inserted.size()) {
+        throw std::invalid_argument("edited buffer does not match the edit");
+    }
+    if (tokens.has_identifiers() && !identifiers) {
+        throw std::invalid_argument("stream records identifiers but no table was given");
+    }
+    const int64_t delta = static_cast<int64_t>(edit.inserted.size()) - edit.removed;
+    const uint64_t inserted_end = static_cast<uint64_t>(edit.offset) + edit.inserted.size();
+
+    Lexer lexer(edited, tokens.has_identifiers() ? identifiers : nullptr);
+
+    // Keep every token the lexer finished deciding before reaching the edit.
+    // With trigraphs or splices in either buffer, lookahead counts spliced
+    // characters, and the edit may complete a splice or trigraph that starts
+    // up to three bytes before it.
+    const SplicedText* spliced = old_buffer.spliced();
+    uint64_t limit = edit.offset;
+    if (spliced || edited->spliced()) {
+        uint32_t stable = edit.offset >= 3 ? edit.offset - 3 : 0;
+        limit = spliced ? spliced->to_spliced(stable) : stable;
+    }
+    auto decided = [&](size_t i) {
+        uint64_t end = uint64_t{tokens.offset(i)} + tokens.length(i);
+        if (spliced) {
+            end = spliced->to_spliced(static_cast<uint32_t>(end));
+        }
+        return end + Lexer::kMaxLookahead <= limit;
+    };
+
+    // Token ends increase with the index, so binary search for the last one
+    size_t keep = 0;
+    for (size_t count = tokens.size(); count > 0;) {
+        size_t half = count / 2;
+        size_t i = keep + half;
+        if (decided(i)) {
+            keep = i + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+
+    if (keep > 0) {
+        lexer.reset(tokens.offset(keep - 1) + tokens.length(keep - 1));
+    }
+
+    // Lex until a token lands on the shifted start of an old token after the edit
+    TokenStream changed(edited, tokens.has_identifiers());
+    size_t old = keep;
+    for (;;) {
+        Token token = lexer.next_token();
+        if (token.offset >= inserted_end) {
+            uint32_t old_offset = static_cast<uint32_t>(token.offset - delta);
+            while (old < tokens.size() && tokens.offset(old) < old_offset) {
+                ++old;
+            }
+            if (old < tokens.size() && tokens.offset(old) == old_offset) {
+                break;
+            }
+        }
+        changed.push_back(token.type, token.offset,
+                          static_cast<uint32_t>(lexer.position() - token.offset),
+                          token.type <= TokenType::IDENTIFIER ? token.ident : kNoIdentifier);
+        if (token.type == TokenType::END_OF_FILE) {
+            old = tokens.size();
+            break;
+        }
+    }
+
+    tokens.replace(keep, old, changed, delta);
+    return RelexRange{keep, old - keep, changed.size()};
+}
+
+RelexRange relex(TokenStream& tokens, const TextEdit& edit, IdentifierTable* identifiers) {
+    return relex(tokens, apply_edit(*tokens.buffer(), edit), edit, identifiers);
+}
+
+} // namespace lexer
@@ -0,0 +1,59 @@
+#ifndef INCREMENTAL_LEXER_H
+#define INCREMENTAL_LEXER_H
+
+#include "identifier_table.h"
+#include "source_buffer.h"
+#include "token_stream.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace lexer {
+
+// Replacement of `removed` bytes at `offset` with `inserted`.
+struct TextEdit {
+    uint32_t offset;
+    uint32_t removed;
+    std::string_view inserted;
+};
+
+// Tokens [first, first + removed) of the old stream became tokens
+// [first, first + inserted) of the new one; every other token kept its kind
+// and length, and those after the range moved by the edit's size change.
+struct RelexRange {
+    size_t first;
+    size_t removed;
+    size_t inserted;
+};
+
+// A copy of buffer's text with edit applied.
+// Throws std::out_of_range if the edit does not lie within the buffer.
+std::shared_ptr<const SourceBuffer> apply_edit(const SourceBuffer& buffer, const TextEdit& edit);
+
+// Updates tokens, the complete stream of some buffer, to the stream of
+// edited, which must be that buffer with edit applied. The result is exactly
+// what Lexer(edited).tokenize_all() would return.
+//
+// Tokens that end more than the lexer's lookahead before the edit cannot
+// have changed, so lexing restarts at the end of the last of them. (In a
+// buffer with trigraphs or line splices the lookahead is counted in spliced
+// characters, with a margin for splices the edit completes.) Because
+// a lexer's only state between tokens is its position, as soon as a new
+// token starts where an old token past the edit started (after shifting by
+// the edit's size change), every token from there on is the old one
+// shifted. An edit that opens or closes a comment or literal re-lexes as far
+// as it changes tokens; typing inside a line re-lexes a token or two.
+//
+// A stream that records identifier IDs needs the table it was interned
+// with; std::invalid_argument is thrown without one.
+RelexRange relex(TokenStream& tokens, std::shared_ptr<const SourceBuffer> edited,
+                 const TextEdit& edit, IdentifierTable* identifiers = nullptr);
+
+// Applies edit to the stream's buffer and updates tokens to match.
+RelexRange relex(TokenStream& tokens, const TextEdit& edit,
+                 IdentifierTable* identifiers = nullptr);
+
+} // namespace lexer
+
+#endif // INCREMENTAL_LEXER_H
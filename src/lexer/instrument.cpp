@@ -0,0 +1,156 @@
+#include "instrument.h"
+#include <atomic>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+
+namespace lexer {
+namespace instrument {
+
+namespace {
+
+std::atomic<uint64_t> process_allocation_count{0};
+
+constexpr const char* kPhaseNames[] = {
+    "next_token", "parse_identifier", "parse_number", "parse_string", "parse_char_literal",
+    "parse_operator", "directive", "macro_expansion",
+};
+static_assert(std::size(kPhaseNames) == kPhaseCount);
+
+constexpr const char* kTokenNames[] = {
+    "KW_AUTO", "KW_BREAK", "KW_CASE", "KW_CHAR", "KW_CONST", "KW_CONTINUE", "KW_DEFAULT",
+    "KW_DO", "KW_DOUBLE", "KW_ELSE", "KW_ENUM", "KW_EXTERN", "KW_FLOAT", "KW_FOR", "KW_GOTO",
+    "KW_IF", "KW_INLINE", "KW_INT", "KW_LONG", "KW_REGISTER", "KW_RESTRICT", "KW_RETURN",
+    "KW_SHORT", "KW_SIGNED", "KW_SIZEOF", "KW_STATIC", "KW_STRUCT", "KW_SWITCH", "KW_TYPEDEF",
+    "KW_UNION", "KW_UNSIGNED", "KW_VOID", "KW_VOLATILE", "KW_WHILE", "KW__BOOL", "KW__COMPLEX",
+    "KW__IMAGINARY", "KW__ALIGNAS", "KW__ALIGNOF", "KW__ATOMIC", "KW__GENERIC", "KW__NORETURN",
+    "KW__STATIC_ASSERT", "KW__THREAD_LOCAL", "IDENTIFIER", "CONSTANT_INT", "CONSTANT_FLOAT",
+    "CONSTANT_CHAR", "CONSTANT_STRING", "OP_PLUS", "OP_MINUS", "OP_INCREMENT", "OP_DECREMENT",
+    "OP_STAR", "OP_SLASH", "OP_PERCENT", "OP_ASSIGN", "OP_EQ", "OP_NE", "OP_LT", "OP_GT",
+    "OP_LE", "OP_GE", "OP_AND", "OP_OR", "OP_NOT", "OP_BITWISE_AND", "OP_BITWISE_OR",
+    "OP_BITWISE_XOR", "OP_BITWISE_NOT", "OP_LEFT_SHIFT", "OP_RIGHT_SHIFT", "OP_PLUS_ASSIGN",
+    "OP_MINUS_ASSIGN", "OP_STAR_ASSIGN", "OP_SLASH_ASSIGN", "OP_PERCENT_ASSIGN",
+    "OP_AND_ASSIGN", "OP_OR_ASSIGN", "OP_XOR_ASSIGN", "OP_LEFT_SHIFT_ASSIGN",
+    "OP_RIGHT_SHIFT_ASSIGN", "OP_QUESTION", "DELIMITER_LPAREN", "DELIMITER_RPAREN",
+    "DELIMITER_LBRACE", "DELIMITER_RBRACE", "DELIMITER_LBRACKET", "DELIMITER_RBRACKET",
+    "DELIMITER_COMMA", "DELIMITER_SEMICOLON", "DELIMITER_DOT", "DELIMITER_ARROW",
+    "DELIMITER_ELLIPSIS", "DELIMITER_COLON", "PREPROCESSOR_HASH", "PREPROCESSOR_HASH_HASH",
+    "COMMENT", "END_OF_FILE", "ERROR_TOKEN",
+};
+static_assert(std::size(kTokenNames) == static_cast<size_t>(TokenType::ERROR_TOKEN) + 1,
+              "every TokenType needs a name");
+
+std::string format(const char* pattern, ...) __attribute__((format(printf, 1, 2)));
+
+std::string format(const char* pattern, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, pattern);
+    std::vsnprintf(line, sizeof(line), pattern, args);
+    va_end(args);
+    return line;
+}
+
+} // namespace
+
+const char* phase_name(Phase phase) {
+    return kPhaseNames[static_cast<size_t>(phase)];
+}
+
+void reset() {
+    Stats& s = stats();
+    Phase current = s.current;
+    auto since = s.since;
+    s = Stats{};
+    s.current = current;
+    s.since = since;
+}
+
+uint64_t process_allocations() {
+    return process_allocation_count.load(std::memory_order_relaxed);
+}
+
+std::string report() {
+    const Stats& s = stats();
+    uint64_t total = 0;
+    for (uint64_t nanoseconds : s.phase_nanoseconds) {
+        total += nanoseconds;
+    }
+
+    std::string out = "Execution times (seconds)\n";
+    for (size_t i = 0; i < kPhaseCount; ++i) {
+        if (s.phase_calls[i] == 0) {
+            continue;
+        }
+        out += format(" %-24s: %12.6f (%5.1f%%) %12" PRIu64 " calls\n", kPhaseNames[i],
+                      s.phase_nanoseconds[i] / 1e9,
+                      total ? 100.0 * s.phase_nanoseconds[i] / total : 0.0, s.phase_calls[i]);
+    }
+    out += format(" %-24s: %12.6f\n", "TOTAL", total / 1e9);
+
+    out += "Counters\n";
+    out += format(" %-24s: %12" PRIu64 "\n", "bytes scanned", s.bytes_scanned);
+    out += format(" %-24s: %12" PRIu64 "\n", "heap allocations", s.allocations);
+    out += format(" %-24s: %12" PRIu64 "\n", "heap bytes", s.allocated_bytes);
+
+    out += "Tokens by kind\n";
+    for (size_t i = 0; i < std::size(kTokenNames); ++i) {
+        if (s.tokens[i] != 0) {
+            out += format(" %-24s: %12" PRIu64 "\n", kTokenNames[i], s.tokens[i]);
+        }
+    }
+    return out;
+}
+
+std::string report_json() {
+    const Stats& s = stats();
+    std::string out = "{\"phases\": [";
+    const char* separator = "";
+    for (size_t i = 0; i < kPhaseCount; ++i) {
+        out += format("%s{\"name\": \"%s\", \"seconds\": %.9f, \"calls\": %" PRIu64 "}",
+                      separator, kPhaseNames[i], s.phase_nanoseconds[i] / 1e9, s.phase_calls[i]);
+        separator = ", ";
+    }
+    out += format("], \"bytes_scanned\": %" PRIu64 ", \"allocations\": %" PRIu64
+                  ", \"allocated_bytes\": %" PRIu64 ", \"tokens\": {",
+                  s.bytes_scanned, s.allocations, s.allocated_bytes);
+    separator = "";
+    for (size_t i = 0; i < std::size(kTokenNames); ++i) {
+        if (s.tokens[i] != 0) {
+            out += format("%s\"%s\": %" PRIu64, separator, kTokenNames[i], s.tokens[i]);
+            separator = ", ";
+        }
+    }
+    out += "}}";
+    return out;
+}
+
+} // namespace instrument
+} // namespace lexer
+
+#ifdef LEXER_INSTRUMENT
+
+// The counting allocator hook: every global allocation goes through here
+void* operator new(size_t size) {
+    lexer::instrument::Stats& s = lexer::instrument::stats();
+    ++s.allocations;
+    s.allocated_bytes += size;
+    lexer::instrument::process_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+#endif // LEXER_INSTRUMENT
@@ -0,0 +1,144 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include "token.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Timers and counters for finding where time and memory go. They cost
+// nothing unless the build defines LEXER_INSTRUMENT (the CMake option of the
+// same name, on by default except in release builds): without it the
+// LEXER_PHASE and LEXER_COUNT_TOKEN macros expand to nothing and the global
+// operator new is left alone. The reporting functions exist either way and
+// report zeros.
+//
+// Statistics are kept per thread, so tests and tools see what their own
+// thread did; a PipelinedLexer's producer thread keeps its own.
+
+#ifdef LEXER_INSTRUMENT
+#define LEXER_PHASE(phase) ::lexer::instrument::ScopedPhase lexer_phase_(::lexer::instrument::Phase::phase)
+#define LEXER_COUNT_TOKEN(type, bytes) ::lexer::instrument::count_token(type, bytes)
+#else
+#define LEXER_PHASE(phase) static_cast<void>(0)
+#define LEXER_COUNT_TOKEN(type, bytes) static_cast<void>(0)
+#endif
+
+namespace lexer {
+namespace instrument {
+
+#ifdef LEXER_INSTRUMENT
+inline constexpr bool kEnabled = true;
+#else
+inline constexpr bool kEnabled = false;
+#endif
+
+// Timed phases. Time is charged to the innermost phase running, as with
+// -ftime-report, so next_token counts dispatch, whitespace and comments but
+// not the parse_* helpers it calls.
+enum class Phase : uint8_t {
+    NEXT_TOKEN,
+    PARSE_IDENTIFIER,
+    PARSE_NUMBER,
+    PARSE_STRING,
+    PARSE_CHAR_LITERAL,
+    PARSE_OPERATOR,
+    DIRECTIVE,       // Preprocessor
+    MACRO_EXPANSION,
+    COUNT
+};
+
+inline constexpr size_t kPhaseCount = static_cast<size_t>(Phase::COUNT);
+
+const char* phase_name(Phase phase);
+
+struct Stats {
+    uint64_t phase_nanoseconds[kPhaseCount] = {};
+    uint64_t phase_calls[kPhaseCount] = {};
+    uint64_t tokens[256] = {};     // Indexed by TokenType
+    uint64_t bytes_scanned = 0;    // Source bytes consumed by lexers
+    uint64_t allocations = 0;      // Calls to the global operator new
+    uint64_t allocated_bytes = 0;  // Bytes they asked for
+
+    // Phase bookkeeping: the phase running (COUNT for none), and when time
+    // was last charged to it
+    Phase current = Phase::COUNT;
+    std::chrono::steady_clock::time_point since;
+};
+
+// Constant-initialized, so reaching it costs no initialization check
+inline thread_local Stats thread_stats;
+
+// The calling thread's statistics.
+inline Stats& stats() {
+    return thread_stats;
+}
+
+// Zeroes the calling thread's counters and times.
+void reset();
+
+// Heap allocations made by all threads so far.
+uint64_t process_allocations();
+
+// The calling thread's statistics as a -ftime-report style table: time and
+// calls per phase, then the counters, then tokens by kind.
+std::string report();
+
+// The same as a JSON object.
+std::string report_json();
+
+// Charges time to phase while in scope.
+class ScopedPhase {
+public:
+    explicit ScopedPhase(Phase phase) : outer_(switch_to(phase)) {
+        ++stats().phase_calls[static_cast<size_t>(phase)];
+    }
+    ~ScopedPhase() { switch_to(outer_); }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    // Charges the time since the last switch to the phase running and
+    // returns it
+    static Phase switch_to(Phase phase) {
+        Stats& s = stats();
+        auto now = std::chrono::steady_clock::now();
+        Phase previous = s.current;
+        if (previous != Phase::COUNT) {
+            s.phase_nanoseconds[static_cast<size_t>(previous)] +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - s.since).count();
+        }
+        s.current = phase;
+        s.since = now;
+        return previous;
+    }
+
+    Phase outer_;
+};
+
+inline void count_token(TokenType type, size_t bytes) {
+    Stats& s = stats();
+    ++s.tokens[static_cast<size_t>(type)];
+    s.bytes_scanned += bytes;
+}
+
+// Allocations the calling thread makes while in scope, for asserting
+// allocation budgets in tests. Always zero unless kEnabled.
+class AllocationScope {
+public:
+    AllocationScope() : allocations_(stats().allocations), bytes_(stats().allocated_bytes) {}
+
+    uint64_t allocations() const { return stats().allocations - allocations_; }
+    uint64_t bytes() const { return stats().allocated_bytes - bytes_; }
+
+private:
+    uint64_t allocations_;
+    uint64_t bytes_;
+};
+
+} // namespace instrument
+} // namespace lexer
+
+#endif // INSTRUMENT_H
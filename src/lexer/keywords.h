@@ -0,0 +1,176 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include "token.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace lexer {
+
+struct Keyword {
+    std::string_view spelling;
+    TokenType type;
+};
+
+// The entries of base followed by those added, for building one dialect's
+// keyword or punctuator list from the previous one's
+template <typename T, size_t N, size_t M>
+constexpr std::array<T, N + M> extend(const std::array<T, N>& base, const T (&added)[M]) {
+    std::array<T, N + M> entries{};
+    for (size_t i = 0; i < N; ++i) {
+        entries[i] = base[i];
+    }
+    for (size_t i = 0; i < M; ++i) {
+        entries[N + i] = added[i];
+    }
+    return entries;
+}
+
+// Keywords of each dialect a lexer can be configured for (see LexerPolicy);
+// each is the previous one plus the keywords its standard added.
+inline constexpr std::array c89_keywords = std::to_array<Keyword>({
+    {"auto", TokenType::KW_AUTO},
+    {"break", TokenType::KW_BREAK},
+    {"case", TokenType::KW_CASE},
+    {"char", TokenType::KW_CHAR},
+    {"const", TokenType::KW_CONST},
+    {"continue", TokenType::KW_CONTINUE},
+    {"default", TokenType::KW_DEFAULT},
+    {"do", TokenType::KW_DO},
+    {"double", TokenType::KW_DOUBLE},
+    {"else", TokenType::KW_ELSE},
+    {"enum", TokenType::KW_ENUM},
+    {"extern", TokenType::KW_EXTERN},
+    {"float", TokenType::KW_FLOAT},
+    {"for", TokenType::KW_FOR},
+    {"goto", TokenType::KW_GOTO},
+    {"if", TokenType::KW_IF},
+    {"int", TokenType::KW_INT},
+    {"long", TokenType::KW_LONG},
+    {"register", TokenType::KW_REGISTER},
+    {"return", TokenType::KW_RETURN},
+    {"short", TokenType::KW_SHORT},
+    {"signed", TokenType::KW_SIGNED},
+    {"sizeof", TokenType::KW_SIZEOF},
+    {"static", TokenType::KW_STATIC},
+    {"struct", TokenType::KW_STRUCT},
+    {"switch", TokenType::KW_SWITCH},
+    {"typedef", TokenType::KW_TYPEDEF},
+    {"union", TokenType::KW_UNION},
+    {"unsigned", TokenType::KW_UNSIGNED},
+    {"void", TokenType::KW_VOID},
+    {"volatile", TokenType::KW_VOLATILE},
+    {"while", TokenType::KW_WHILE}
+});
+
+inline constexpr std::array c99_keywords = extend<Keyword>(c89_keywords, {
+    {"inline", TokenType::KW_INLINE},
+    {"restrict", TokenType::KW_RESTRICT},
+    {"_Bool", TokenType::KW__BOOL},
+    {"_Complex", TokenType::KW__COMPLEX},
+    {"_Imaginary", TokenType::KW__IMAGINARY}
+});
+
+inline constexpr std::array c11_keywords = extend<Keyword>(c99_keywords, {
+    {"_Alignas", TokenType::KW__ALIGNAS},
+    {"_Alignof", TokenType::KW__ALIGNOF},
+    {"_Atomic", TokenType::KW__ATOMIC},
+    {"_Generic", TokenType::KW__GENERIC},
+    {"_Noreturn", TokenType::KW__NORETURN},
+    {"_Static_assert", TokenType::KW__STATIC_ASSERT},
+    {"_Thread_local", TokenType::KW__THREAD_LOCAL}
+});
+
+// Perfect hash over a fixed keyword set. The hash combines an identifier's
+// length with its first and last characters; the multipliers are searched for
+// at compile time so that every keyword lands in its own slot, and the build
+// fails if the set cannot be hashed without collisions. Classifying an
+// identifier costs one table load plus at most one memcmp.
+template <size_t N>
+class KeywordTable {
+public:
+    consteval explicit KeywordTable(const std::array<Keyword, N>& keywords) {
+        for (const Keyword& keyword : keywords) {
+            if (keyword.spelling.size() < min_length_) {
+                min_length_ = keyword.spelling.size();
+            }
+            if (keyword.spelling.size() > max_length_) {
+                max_length_ = keyword.spelling.size();
+            }
+        }
+
+        for (uint32_t a = 1; a < 256; ++a) {
+            for (uint32_t b = 1; b < 256; ++b) {
+                if (try_build(keywords, a, b)) {
+                    return;
+                }
+            }
+        }
+        throw "no collision-free keyword hash found; grow kSlots";
+    }
+
+    // Returns the keyword's TokenType, or IDENTIFIER if [begin, begin + length)
+    // is not a keyword.
+    TokenType lookup(const char* begin, size_t length) const {
+        if (length < min_length_ || length > max_length_) {
+            return TokenType::IDENTIFIER;
+        }
+        const Slot& slot = slots_[hash(begin[0], begin[length - 1], length, a_, b_)];
+        if (slot.spelling.size() == length &&
+            std::memcmp(slot.spelling.data(), begin, length) == 0) {
+            return slot.type;
+        }
+        return TokenType::IDENTIFIER;
+    }
+
+    TokenType lookup(std::string_view spelling) const {
+        return spelling.empty() ? TokenType::IDENTIFIER
+                                : lookup(spelling.data(), spelling.size());
+    }
+
+private:
+    static constexpr size_t kSlots = 128;
+
+    struct Slot {
+        std::string_view spelling;
+        TokenType type = TokenType::IDENTIFIER;
+    };
+
+    static constexpr size_t hash(char first, char last, size_t length,
+                                 uint32_t a, uint32_t b) {
+        return (static_cast<unsigned char>(first) * a +
+                static_cast<unsigned char>(last) * b + length) & (kSlots - 1);
+    }
+
+    constexpr bool try_build(const std::array<Keyword, N>& keywords, uint32_t a, uint32_t b) {
+        slots_ = {};
+        for (const Keyword& keyword : keywords) {
+            std::string_view s = keyword.spelling;
+            Slot& slot = slots_[hash(s.front(), s.back(), s.size(), a, b)];
+            if (!slot.spelling.empty()) {
+                return false;
+            }
+            slot = Slot{s, keyword.type};
+        }
+        a_ = a;
+        b_ = b;
+        return true;
+    }
+
+    std::array<Slot, kSlots> slots_{};
+    uint32_t a_ = 0;
+    uint32_t b_ = 0;
+    size_t min_length_ = SIZE_MAX;
+    size_t max_length_ = 0;
+};
+
+inline constexpr KeywordTable c89_keyword_table(c89_keywords);
+inline constexpr KeywordTable c99_keyword_table(c99_keywords);
+inline constexpr KeywordTable c11_keyword_table(c11_keywords);
+
+} // namespace lexer
+
+#endif // KEYWORDS_H
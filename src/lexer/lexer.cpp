@@ -1,23 +1,331 @@
 #include "lexer.h"
+#include "instrument.h"
+#include "keywords.h"
+#include "punctuators.h"
+#include "scan.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
 #include <stdexcept>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <iomanip>
 
 namespace lexer {
 
-Lexer::Lexer(const std::string& source)
-    : source_(source), position_(0), line_(1), column_(1) {
-    init_keywords();
+namespace {
+
+bool is_hex_digit(char c) {
+    return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+int hex_value(char c) {
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+// C99 6.4.3: no UCN may name a character of the basic source set (everything
+// below U+00A0 except $, @ and `), a surrogate, or a value beyond Unicode.
+bool is_valid_ucn(uint32_t code) {
+    if (code < 0xA0) {
+        return code == '$' || code == '@' || code == '`';
+    }
+    return (code < 0xD800 || code > 0xDFFF) && code <= 0x10FFFF;
+}
+
+// Decodes one UTF-8 character at p and advances past it. A byte that does not
+// start a well-formed sequence stands for itself.
+uint32_t decode_utf8(const char*& p, const char* end) {
+    auto byte = [](char c) { return static_cast<unsigned char>(c); };
+    uint32_t lead = byte(*p);
+    int length = lead < 0x80 ? 1 : lead >= 0xC2 && lead < 0xE0 ? 2
+               : lead >= 0xE0 && lead < 0xF0 ? 3 : lead >= 0xF0 && lead < 0xF5 ? 4 : 0;
+    if (length <= 1 || end - p < length) {
+        ++p;
+        return lead;
+    }
+    uint32_t code = lead & (0x7F >> length);
+    for (int i = 1; i < length; ++i) {
+        if ((byte(p[i]) & 0xC0) != 0x80) {
+            ++p;
+            return lead;
+        }
+        code = (code << 6) | (byte(p[i]) & 0x3F);
+    }
+    static constexpr uint32_t kMinimum[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (code < kMinimum[length] || (code >= 0xD800 && code <= 0xDFFF) || code > 0x10FFFF) {
+        ++p;
+        return lead;
+    }
+    p += length;
+    return code;
+}
+
+// Calls emit with each code unit of the literal body, decoding every C99
+// escape sequence (6.4.4.4). Narrow literals get UCNs as UTF-8 and escapes
+// limited to a byte; wide literals get one unit per source character.
+// Unknown escapes stand for the escaped character, as in GCC. Returns an
+// error message for a malformed escape, otherwise nullptr.
+template <bool wide, typename Emit>
+const char* decode_escapes(std::string_view body, Emit&& emit) {
+    const char* p = body.data();
+    const char* end = p + body.size();
+    const uint32_t max_unit = wide ? UINT32_MAX : 0xFF;
+    while (p < end) {
+        if (*p != '\\') {
+            emit(wide ? decode_utf8(p, end) : static_cast<unsigned char>(*p++));
+            continue;
+        }
+        ++p;
+        char c = *p++;
+        switch (c) {
+            case 'a': emit(0x07); break;
+            case 'b': emit(0x08); break;
+            case 'f': emit(0x0C); break;
+            case 'n': emit(0x0A); break;
+            case 'r': emit(0x0D); break;
+            case 't': emit(0x09); break;
+            case 'v': emit(0x0B); break;
+            case '0': case '1': case '2': case '3':
+            case '4': case '5': case '6': case '7': {
+                uint32_t value = c - '0';
+                for (int i = 1; i < 3 && p < end && *p >= '0' && *p <= '7'; ++i) {
+                    value = value * 8 + (*p++ - '0');
+                }
+                if (value > max_unit) {
+                    return "Octal escape sequence out of range";
+                }
+                emit(value);
+                break;
+            }
+            case 'x': {
+                if (p == end || !is_hex_digit(*p)) {
+                    return "\\x used with no following hex digits";
+                }
+                uint64_t value = 0;
+                for (; p < end && is_hex_digit(*p); ++p) {
+                    value = std::min<uint64_t>(value * 16 + hex_value(*p), uint64_t{max_unit} + 1);
+                }
+                if (value > max_unit) {
+                    return "Hex escape sequence out of range";
+                }
+                emit(static_cast<uint32_t>(value));
+                break;
+            }
+            case 'u':
+            case 'U': {
+                int digits = c == 'u' ? 4 : 8;
+                uint32_t code = 0;
+                for (int i = 0; i < digits; ++i, ++p) {
+                    if (p == end || !is_hex_digit(*p)) {
+                        return "Incomplete universal character name";
+                    }
+                    code = code * 16 + hex_value(*p);
+                }
+                if (!is_valid_ucn(code)) {
+                    return "Invalid universal character name";
+                }
+                if (wide || code < 0x80) {
+                    emit(code);
+                } else if (code < 0x800) {
+                    emit(0xC0 | (code >> 6));
+                    emit(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    emit(0xE0 | (code >> 12));
+                    emit(0x80 | ((code >> 6) & 0x3F));
+                    emit(0x80 | (code & 0x3F));
+                } else {
+                    emit(0xF0 | (code >> 18));
+                    emit(0x80 | ((code >> 12) & 0x3F));
+                    emit(0x80 | ((code >> 6) & 0x3F));
+                    emit(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: // \' \" \? \\ and unknown escapes
+                emit(static_cast<unsigned char>(c));
+                break;
+        }
+    }
+    return nullptr;
+}
+
+template <typename T>
+bool fits(uint64_t value) {
+    return value <= static_cast<uint64_t>(std::numeric_limits<T>::max());
 }
 
-void Lexer::reset() {
-    position_ = 0;
-    line_ = 1;
-    column_ = 1;
+// First type of the C99 6.4.4.1 list for this suffix and base that can
+// represent value. Decimal constants without a u suffix are never given an
+// unsigned type; one too large for long long becomes unsigned long long, as
+// GCC does.
+NumericType integer_type(uint64_t value, bool decimal, bool is_unsigned, int longs) {
+    struct Candidate {
+        NumericType type;
+        bool is_unsigned;
+        bool fits;
+    };
+    const Candidate candidates[] = {
+        {NumericType::INT, false, fits<int>(value)},
+        {NumericType::UNSIGNED_INT, true, fits<unsigned int>(value)},
+        {NumericType::LONG, false, fits<long>(value)},
+        {NumericType::UNSIGNED_LONG, true, fits<unsigned long>(value)},
+        {NumericType::LONG_LONG, false, fits<long long>(value)},
+        {NumericType::UNSIGNED_LONG_LONG, true, true},
+    };
+    for (size_t i = 2 * longs; i < std::size(candidates); ++i) {
+        const Candidate& candidate = candidates[i];
+        if (candidate.is_unsigned ? (is_unsigned || !decimal) : !is_unsigned) {
+            if (candidate.fits) {
+                return candidate.type;
+            }
+        }
+    }
+    return NumericType::UNSIGNED_LONG_LONG;
 }
 
-Token Lexer::next_token() {
+// Correctly rounded value of the constant in [begin, end) (no 0x prefix or
+// suffix), rounded once to the precision of type. Long double constants are
+// rounded to double, the widest type a Token holds.
+double parse_float(const char* begin, const char* end, bool hex, NumericType type) {
+    std::chars_format format = hex ? std::chars_format::hex : std::chars_format::general;
+    std::errc error;
+    double value;
+    if (type == NumericType::FLOAT) {
+        float narrow = 0;
+        error = std::from_chars(begin, end, narrow, format).ec;
+        value = narrow;
+    } else {
+        value = 0;
+        error = std::from_chars(begin, end, value, format).ec;
+    }
+    if (error == std::errc()) {
+        return value;
+    }
+
+    // Overflow to infinity or underflow: let strtod pick the IEEE result
+    std::string text = (hex ? "0x" : "") + std::string(begin, end);
+    return type == NumericType::FLOAT ? std::strtof(text.c_str(), nullptr)
+                                      : std::strtod(text.c_str(), nullptr);
+}
+
+} // namespace
+
+template <typename Policy>
+BasicLexer<Policy>::BasicLexer(const std::string& source, IdentifierTable* identifiers)
+    : BasicLexer(SourceBuffer::from_string(source), identifiers) {}
+
+template <typename Policy>
+BasicLexer<Policy>::BasicLexer(std::shared_ptr<const SourceBuffer> buffer,
+                               IdentifierTable* identifiers)
+    : buffer_(std::move(buffer)), identifiers_(identifiers), position_(0), token_start_(0) {
+    if (buffer_->size() > UINT32_MAX) {
+        throw std::length_error("source buffer too large for 32-bit token offsets");
+    }
+    spliced_ = buffer_->spliced();
+    source_ = spliced_ ? spliced_->text() : buffer_->text();
+}
+
+template <typename Policy>
+BasicLexer<Policy> BasicLexer<Policy>::from_file(const std::string& path,
+                                                IdentifierTable* identifiers) {
+    return BasicLexer(SourceBuffer::from_file(path), identifiers);
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::reset() {
+    reset(0);
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::reset(uint32_t offset) {
+    position_ = std::min<size_t>(spliced_ ? spliced_->to_spliced(offset) : offset, source_.size());
+    token_start_ = position_;
+    retained_ = cursor_ = lexed_ = 0;
+    checkpoints_ = 0;
+}
+
+template <typename Policy>
+Token BasicLexer<Policy>::peek_token(size_t k) {
+    while (lexed_ - cursor_ <= k) {
+        cache_token();
+    }
+    return ring_[(cursor_ + k) & ring_mask_].token;
+}
+
+template <typename Policy>
+auto BasicLexer<Policy>::checkpoint() -> Checkpoint {
+    if (checkpoints_++ == 0) {
+        retained_ = cursor_;
+    }
+    return Checkpoint{cursor_};
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::restore(Checkpoint checkpoint) {
+    cursor_ = checkpoint.token;
+    --checkpoints_;
+}
+
+template <typename Policy>
+void BasicLexer<Policy>::commit(Checkpoint) {
+    --checkpoints_;
+}
+
+template <typename Policy>
+Token BasicLexer<Policy>::next_cached_token() {
+    if (cursor_ == lexed_) {
+        cache_token();
+    }
+    return ring_[cursor_++ & ring_mask_].token;
+}
+
+// Lexes one more token into the ring, dropping consumed tokens no checkpoint
+// can return to and doubling the ring when it is full
+template <typename Policy>
+void BasicLexer<Policy>::cache_token() {
+    if (checkpoints_ == 0) {
+        retained_ = cursor_;
+    }
+    if (lexed_ - retained_ == ring_.size()) {
+        CachedToken empty{Token(TokenType::END_OF_FILE, std::string_view(), 0), 0};
+        std::vector<CachedToken> grown(std::max<size_t>(ring_.size() * 2, 8), empty);
+        for (uint64_t i = retained_; i < lexed_; ++i) {
+            grown[i & (grown.size() - 1)] = ring_[i & ring_mask_];
+        }
+        ring_ = std::move(grown);
+        ring_mask_ = ring_.size() - 1;
+    }
+
+    size_t from = position_;
+    ring_[lexed_++ & ring_mask_] = CachedToken{lex_token(), from};
+}
+
+template <typename Policy>
+uint64_t BasicLexer<Policy>::lookahead_end() const {
+    if (!spliced_) {
+        return uint64_t{position()} + kMaxLookahead;
+    }
+    // Room for the longest splice, "??/\r\n", at the first character not looked at
+    size_t end = std::min<size_t>(spliced_->to_spliced(position()) + kMaxLookahead, source_.size());
+    return uint64_t{spliced_->to_source(static_cast<uint32_t>(end))} + 5;
+}
+
+// Lexes one token, recording it if instrumentation is compiled in
+template <typename Policy>
+Token BasicLexer<Policy>::lex_token() {
+    LEXER_PHASE(NEXT_TOKEN);
+    [[maybe_unused]] size_t start = position_;
+    Token token = scan_token();
+    LEXER_COUNT_TOKEN(token.type, position_ - start);
+    return token;
+}
+
+template <typename Policy>
+inline Token BasicLexer<Policy>::scan_token() {
     while (!is_eof()) {
         char c = peek();
         
@@ -26,496 +334,449 @@ Token Lexer::next_token() {
             continue;
         }
         
-        if (c == '/' && peek(1) == '/') {
-            skip_comment();
-            continue;
-        }
-        
-        if (c == '/' && peek(1) == '*') {
+        // C89 has no line comments: "//" is two slashes there
+        if (c == '/' && (peek(1) == '*' || (Policy::dialect != Dialect::C89 && peek(1) == '/'))) {
+            token_start_ = position_;
             skip_comment();
+            if constexpr (Policy::keep_comments) {
+                return make_token(TokenType::COMMENT, token_start_);
+            }
             continue;
         }
         
+        token_start_ = position_;
+
         if (is_alpha(c) || c == '_') {
+            if (c == 'L' && (peek(1) == '"' || peek(1) == '\'')) {
+                return peek(1) == '"' ? parse_string(true) : parse_char_literal(true);
+            }
             return parse_identifier();
         }
         
-        if (is_digit(c)) {
+        if (is_digit(c) || (c == '.' && is_digit(peek(1)))) {
             return parse_number();
         }
         
         if (c == '"') {
-            return parse_string();
+            return parse_string(false);
         }
         
         if (c == '\'') {
-            return parse_char_literal();
+            return parse_char_literal(false);
         }
         
         // Handle operators and delimiters
         return parse_operator();
     }
     
-    return Token(TokenType::END_OF_FILE, "", line_, column_);
+    token_start_ = position_;
+    return Token(TokenType::END_OF_FILE, std::string_view(), token_offset(position_));
+}
+
+template <typename Policy>
+TokenStream BasicLexer<Policy>::tokenize_all() requires Policy::track_positions {
+    TokenStream stream(buffer_, identifiers_ != nullptr);
+    stream.reserve((source_.size() - position_) / 8 + 1);
+    for (;;) {
+        Token token = next_token();
+        stream.push_back(token.type, token.offset, position() - token.offset,
+                         token.type <= TokenType::IDENTIFIER ? token.ident : kNoIdentifier);
+        if (token.type == TokenType::END_OF_FILE) {
+            return stream;
+        }
+    }
+}
+
+// The value runs from value_start to the current position; the token itself
+// starts at token_start_, which differs for quoted literals.
+template <typename Policy>
+Token BasicLexer<Policy>::make_token(TokenType type, size_t value_start) const {
+    return Token(type, source_.substr(value_start, position_ - value_start),
+                 token_offset(token_start_));
 }
 
-char Lexer::peek(size_t offset) const {
+template <typename Policy>
+Token BasicLexer<Policy>::make_error(std::string_view message) {
+    Token token(TokenType::ERROR_TOKEN, message, token_offset(token_start_));
+    token.string = literals_.make<StringLiteral>(
+        StringLiteral{source_.substr(token_start_, position_ - token_start_), false});
+    return token;
+}
+
+template <typename Policy>
+Token BasicLexer<Policy>::make_error(std::string message) {
+    messages_.push_back(std::move(message));
+    return make_error(std::string_view(messages_.back()));
+}
+
+template <typename Policy>
+char BasicLexer<Policy>::peek(size_t offset) const {
+    // The buffer's NUL sentinel makes the current position always readable
+    if (offset == 0) {
+        return source_.data()[position_];
+    }
     if (position_ + offset >= source_.length()) {
         return '\0';
     }
     return source_[position_ + offset];
 }
 
-char Lexer::advance() {
+template <typename Policy>
+char BasicLexer<Policy>::advance() {
     if (is_eof()) {
         return '\0';
     }
 
-    char c = source_[position_++];
-
-    if (c == '\n') {
-        line_++;
-        column_ = 1;
-    } else {
-        column_++;
-    }
-
-    return c;
+    return source_[position_++];
 }
 
-bool Lexer::is_eof() const {
+template <typename Policy>
+bool BasicLexer<Policy>::is_eof() const {
     return position_ >= source_.length();
 }
 
-bool Lexer::is_whitespace(char c) const {
+template <typename Policy>
+bool BasicLexer<Policy>::is_whitespace(char c) const {
     return c == ' ' || c == '\t' || c == '\n' || c == '\r';
 }
 
-bool Lexer::is_digit(char c) const {
+template <typename Policy>
+bool BasicLexer<Policy>::is_digit(char c) const {
     return c >= '0' && c <= '9';
 }
 
-bool Lexer::is_alpha(char c) const {
+template <typename Policy>
+bool BasicLexer<Policy>::is_alpha(char c) const {
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
 }
 
-bool Lexer::is_alphanumeric(char c) const {
+template <typename Policy>
+bool BasicLexer<Policy>::is_alphanumeric(char c) const {
     return is_alpha(c) || is_digit(c);
 }
 
-void Lexer::skip_whitespace() {
-    while (!is_eof() && is_whitespace(peek())) {
-        advance();
-    }
+template <typename Policy>
+void BasicLexer<Policy>::skip_whitespace() {
+    const char* begin = source_.data();
+    position_ = scan::skip_whitespace(begin + position_, begin + source_.size()) - begin;
 }
 
-void Lexer::skip_comment() {
-    char c = advance(); // Skip '/'
-    c = advance(); // Skip '*' or '/'
+template <typename Policy>
+void BasicLexer<Policy>::skip_comment() {
+    const char* begin = source_.data();
+    const char* end = begin + source_.size();
+    const char* body = begin + position_ + 2; // Past "//" or "/*"
 
-    if (c == '/') { // Single line comment
-        while (!is_eof() && peek() != '\n') {
-            advance();
-        }
+    if (source_[position_ + 1] == '/') { // Single line comment
+        const char* newline = static_cast<const char*>(std::memchr(body, '\n', end - body));
+        position_ = (newline ? newline : end) - begin;
     } else { // Multi-line comment
-        while (!is_eof()) {
-            if (peek() == '*' && peek(1) == '/') {
-                advance(); // Skip '*'
-                advance(); // Skip '/'
-                break;
-            }
-            advance();
-        }
+        const char* close = scan::find_comment_end(body, end);
+        position_ = (close == end ? end : close + 2) - begin;
     }
 }
 
-Token Lexer::parse_identifier() {
+template <typename Policy>
+Token BasicLexer<Policy>::parse_identifier() {
+    LEXER_PHASE(PARSE_IDENTIFIER);
     size_t start_pos = position_;
-    size_t start_col = column_;
-    
-    advance(); // Remove unused variable 'c'
-    while (!is_eof() && (is_alphanumeric(peek()) || peek() == '_')) {
-        advance();
+
+    const char* begin = source_.data();
+    position_ = scan::skip_identifier(begin + position_ + 1, begin + source_.size()) - begin;
+
+    TokenType type;
+    if constexpr (Policy::dialect == Dialect::C89) {
+        type = c89_keyword_table.lookup(begin + start_pos, position_ - start_pos);
+    } else if constexpr (Policy::dialect == Dialect::C99) {
+        type = c99_keyword_table.lookup(begin + start_pos, position_ - start_pos);
+    } else {
+        type = c11_keyword_table.lookup(begin + start_pos, position_ - start_pos);
     }
-    
-    std::string value = source_.substr(start_pos, position_ - start_pos);
-    
-    auto it = keywords_.find(value);
-    if (it != keywords_.end()) {
-        return Token(it->second, value, line_, start_col);
+    Token token = make_token(type, start_pos);
+    if (identifiers_) {
+        token.ident = identifiers_->intern(token.value);
     }
-    
-    return Token(TokenType::IDENTIFIER, value, line_, start_col);
+    return token;
 }
 
-Token Lexer::parse_number() {
+template <typename Policy>
+Token BasicLexer<Policy>::parse_number() {
+    LEXER_PHASE(PARSE_NUMBER);
     size_t start_pos = position_;
-    size_t start_col = column_;
-    bool is_float = false;
-
-    // Check for hex literals (0x or 0X)
-    if (peek() == '0' && !is_eof() && (peek(1) == 'x' || peek(1) == 'X')) {
-        advance(); // Skip '0'
-        advance(); // Skip 'x' or 'X'
-
-        // Parse hex digits
-        while (!is_eof() && (is_digit(peek()) ||
-               (tolower(peek()) >= 'a' && tolower(peek()) <= 'f'))) {
-            advance();
-        }
-
-        std::string value = source_.substr(start_pos, position_ - start_pos);
-        return Token(TokenType::CONSTANT_INT, value, line_, start_col);
-    }
+    const char* p = source_.data() + position_;
 
-    // Check for octal literals (starting with 0)
-    if (peek() == '0') {
-        advance(); // Skip first '0'
-
-        // Parse octal digits
-        while (!is_eof() && peek() >= '0' && peek() <= '7') {
-            advance();
-        }
-
-        // If we encounter an 8 or 9, it's not a valid octal, treat as decimal
-        if (!is_eof() && (peek() == '8' || peek() == '9')) {
-            // Continue with decimal parsing
-            while (!is_eof() && is_digit(peek())) {
-                advance();
-            }
-        }
-
-        std::string value = source_.substr(start_pos, position_ - start_pos);
-        return Token(TokenType::CONSTANT_INT, value, line_, start_col);
+    // Digits, point and exponent; the buffer's sentinel stops every loop
+    bool hex = p[0] == '0' && (p[1] == 'x' || p[1] == 'X') &&
+               (is_hex_digit(p[2]) || (p[2] == '.' && is_hex_digit(p[3])));
+    bool is_float = false;
+    if (hex) {
+        p += 2;
     }
-
-    // Parse decimal integer part
-    while (!is_eof() && is_digit(peek())) {
-        advance();
+    const char* digits = p;
+    auto digit = [hex](char c) { return hex ? is_hex_digit(c) : (c >= '0' && c <= '9'); };
+    while (digit(*p)) {
+        ++p;
     }
-
-    // Check for decimal point
-    if (!is_eof() && peek() == '.') {
+    if (*p == '.') {
         is_float = true;
-        advance(); // Skip '.'
-
-        // Parse fractional part
-        while (!is_eof() && is_digit(peek())) {
-            advance();
+        ++p;
+        while (digit(*p)) {
+            ++p;
         }
     }
-
-    // Check for exponent
-    if (!is_eof() && (peek() == 'e' || peek() == 'E')) {
+    if (hex ? (*p == 'p' || *p == 'P') : (*p == 'e' || *p == 'E')) {
         is_float = true;
-        advance(); // Skip 'e' or 'E'
-
-        // Check for sign
-        if (!is_eof() && (peek() == '+' || peek() == '-')) {
-            advance();
+        ++p;
+        if (*p == '+' || *p == '-') {
+            ++p;
         }
-
-        // Parse exponent digits
-        while (!is_eof() && is_digit(peek())) {
-            advance();
+        if (!is_digit(*p)) {
+            position_ = p - source_.data();
+            return make_error(std::string_view("Exponent has no digits"));
         }
+        while (is_digit(*p)) {
+            ++p;
+        }
+    } else if (hex && is_float) {
+        position_ = p - source_.data();
+        return make_error(std::string_view("Hexadecimal floating constant requires an exponent"));
     }
-
-    std::string value = source_.substr(start_pos, position_ - start_pos);
+    const char* digits_end = p;
 
     if (is_float) {
-        return Token(TokenType::CONSTANT_FLOAT, value, line_, start_col);
-    } else {
-        return Token(TokenType::CONSTANT_INT, value, line_, start_col);
-    }
-}
-
-Token Lexer::parse_string() {
-    size_t start_col = column_;
-    advance(); // Skip opening quote
+        NumericType type = NumericType::DOUBLE;
+        if (*p == 'f' || *p == 'F') {
+            type = NumericType::FLOAT;
+            ++p;
+        } else if (*p == 'l' || *p == 'L') {
+            type = NumericType::LONG_DOUBLE;
+            ++p;
+        }
+        position_ = p - source_.data();
 
-    std::string value;
-    std::string raw_value; // For storing the raw representation
-    while (!is_eof() && peek() != '"') {
-        if (peek() == '\\') {
-            raw_value += advance(); // Add backslash to raw value
-            char escaped = advance();
-            raw_value += escaped; // Add escaped character to raw value
+        Token token = make_token(TokenType::CONSTANT_FLOAT, start_pos);
+        token.numeric = type;
+        token.float_value = parse_float(digits, digits_end, hex, type);
+        return token;
+    }
 
-            switch (escaped) {
-                case 'n': value += '\n'; break;
-                case 't': value += '\t'; break;
-                case 'r': value += '\r'; break;
-                case '\\': value += '\\'; break;
-                case '"': value += '"'; break;
-                default: value += escaped; break;
-            }
-        } else {
-            char c = advance();
-            value += c;
-            raw_value += c;
+    bool is_unsigned = false;
+    int longs = 0;
+    for (int i = 0; i < 2; ++i) {
+        if (!is_unsigned && (*p == 'u' || *p == 'U')) {
+            is_unsigned = true;
+            ++p;
+        } else if (longs == 0 && (*p == 'l' || *p == 'L')) {
+            longs = p[1] == p[0] ? 2 : 1; // "ll" or "LL", not "lL"
+            p += longs;
         }
     }
+    position_ = p - source_.data();
 
-    if (is_eof()) {
-        return Token(TokenType::ERROR_TOKEN, "Unterminated string literal", line_, start_col);
+    int base = hex ? 16 : *digits == '0' ? 8 : 10;
+    uint64_t value = 0;
+    std::from_chars_result result = std::from_chars(digits, digits_end, value, base);
+    if (result.ptr != digits_end) {
+        return make_error(std::string_view("Invalid digit in octal constant"));
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+        return make_error(std::string_view("Integer constant is too large"));
     }
 
-    advance(); // Skip closing quote
-    return Token(TokenType::CONSTANT_STRING, raw_value, line_, start_col);
+    Token token = make_token(TokenType::CONSTANT_INT, start_pos);
+    token.numeric = integer_type(value, base == 10, is_unsigned, longs);
+    token.int_value = value;
+    return token;
 }
 
-Token Lexer::parse_char_literal() {
-    size_t start_col = column_;
-    advance(); // Skip opening quote
-
-    std::string value;
-    std::string raw_value; // For storing the raw representation
-    if (!is_eof() && peek() != '\'') {
-        if (peek() == '\\') {
-            raw_value += advance(); // Add backslash to raw value
-            char escaped = advance();
-            raw_value += escaped; // Add escaped character to raw value
-
-            switch (escaped) {
-                case 'n': value += '\n'; break;
-                case 't': value += '\t'; break;
-                case 'r': value += '\r'; break;
-                case '\\': value += '\\'; break;
-                case '\'': value += '\''; break;
-                default: value += escaped; break;
-            }
-        } else {
-            char c = advance();
-            value += c;
-            raw_value += c;
+// Finds the closing quote of the literal whose body starts at position_,
+// noting whether it contains escapes. An unterminated literal ends at the
+// newline or end of buffer that stopped it: position_ is left there and
+// nullptr returned. Only quotes and newlines stop the scan; whether a quote
+// is escaped is settled by counting the backslashes before it, so runs of
+// escapes cost nothing until they are decoded. Line splices are gone by
+// now, so every newline ends the literal.
+template <typename Policy>
+const char* BasicLexer<Policy>::find_literal_end(char quote, bool& escapes) {
+    const char* begin = source_.data();
+    const char* end = begin + source_.size();
+    const char* body = begin + position_;
+    const char* p = body;
+    for (;;) {
+        p = scan::find_literal_stop(p, end, quote);
+        if (p == end || *p == '\n') {
+            position_ = p - begin;
+            return nullptr;
         }
+        const char* backslashes = p;
+        while (backslashes > body && backslashes[-1] == '\\') {
+            --backslashes;
+        }
+        if ((p - backslashes) % 2 == 0) {
+            escapes = std::memchr(body, '\\', p - body) != nullptr;
+            return p;
+        }
+        ++p;
     }
-
-    if (is_eof() || peek() != '\'') {
-        return Token(TokenType::ERROR_TOKEN, "Unterminated character literal", line_, start_col);
-    }
-
-    advance(); // Skip closing quote
-    return Token(TokenType::CONSTANT_CHAR, raw_value, line_, start_col);
 }
 
-Token Lexer::parse_operator() {
-    size_t start_col = column_;
-    char c = advance();
+template <typename Policy>
+Token BasicLexer<Policy>::parse_string(bool wide) {
+    LEXER_PHASE(PARSE_STRING);
+    position_ += wide ? 2 : 1; // Skip prefix and opening quote
 
-    // Single character operators
-    switch (c) {
-        case '~':
-            return Token(TokenType::OP_BITWISE_NOT, "~", line_, start_col);
+    // The token value is the raw spelling between the quotes, escapes included
+    size_t start_pos = position_;
+    bool escapes = false;
+    const char* close = find_literal_end('"', escapes);
+    if (!close) {
+        return make_error(std::string_view("Unterminated string literal"));
     }
+    position_ = close - source_.data();
+    Token token = make_token(TokenType::CONSTANT_STRING, start_pos);
+    ++position_; // Skip closing quote
 
-    // Two-character operators
-    switch (c) {
-        case '=':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_EQ, "==", line_, start_col);
-            }
-            return Token(TokenType::OP_ASSIGN, "=", line_, start_col);
-
-        case '!':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_NE, "!=", line_, start_col);
-            }
-            return Token(TokenType::OP_NOT, "!", line_, start_col);
-
-        case '<':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_LE, "<=", line_, start_col);
-            }
-            if (!is_eof() && peek() == '<') {
-                advance();
-                if (!is_eof() && peek() == '=') {
-                    advance();
-                    return Token(TokenType::OP_LEFT_SHIFT_ASSIGN, "<<=", line_, start_col);
-                }
-                return Token(TokenType::OP_LEFT_SHIFT, "<<", line_, start_col);
-            }
-            return Token(TokenType::OP_LT, "<", line_, start_col);
-
-        case '>':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_GE, ">=", line_, start_col);
-            }
-            if (!is_eof() && peek() == '>') {
-                advance();
-                if (!is_eof() && peek() == '=') {
-                    advance();
-                    return Token(TokenType::OP_RIGHT_SHIFT_ASSIGN, ">>=", line_, start_col);
-                }
-                return Token(TokenType::OP_RIGHT_SHIFT, ">>", line_, start_col);
-            }
-            return Token(TokenType::OP_GT, ">", line_, start_col);
-
-        case '&':
-            if (!is_eof() && peek() == '&') {
-                advance();
-                return Token(TokenType::OP_AND, "&&", line_, start_col);
-            }
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_AND_ASSIGN, "&=", line_, start_col);
-            }
-            return Token(TokenType::OP_BITWISE_AND, "&", line_, start_col);
+    if (!escapes && !wide) {
+        token.string = literals_.make<StringLiteral>(StringLiteral{token.value, false});
+        return token;
+    }
+    if (wide) {
+        token.set(TokenFlag::WIDE);
+    }
 
-        case '|':
-            if (!is_eof() && peek() == '|') {
-                advance();
-                return Token(TokenType::OP_OR, "||", line_, start_col);
-            }
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_OR_ASSIGN, "|=", line_, start_col);
-            }
-            return Token(TokenType::OP_BITWISE_OR, "|", line_, start_col);
+    // Decoding never produces more code units than there are source bytes
+    const size_t unit = wide ? 4 : 1;
+    const size_t capacity = (token.value.size() + 1) * unit;
+    char* out = static_cast<char*>(literals_.allocate(capacity, unit));
+    char* q = out;
+    const char* error =
+        wide ? decode_escapes<true>(token.value, [&q](uint32_t code) {
+                   std::memcpy(q, &code, 4);
+                   q += 4;
+               })
+             : decode_escapes<false>(token.value, [&q](uint32_t code) { *q++ = static_cast<char>(code); });
+    if (error) {
+        literals_.shrink(out, capacity, 0);
+        return make_error(std::string_view(error));
+    }
+    size_t size = q - out;
+    std::memset(out + size, 0, unit);
+    literals_.shrink(out, capacity, size + unit);
+    token.string = literals_.make<StringLiteral>(StringLiteral{std::string_view(out, size), wide});
+    return token;
+}
 
-        case '^':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_XOR_ASSIGN, "^=", line_, start_col);
-            }
-            return Token(TokenType::OP_BITWISE_XOR, "^", line_, start_col);
+// Narrow constants take the int value of their char, so bytes above 0x7F are
+// negative; multi-character constants pack their bytes big-endian into an
+// int, and wide ones keep their last code unit, both as GCC does.
+template <typename Policy>
+Token BasicLexer<Policy>::parse_char_literal(bool wide) {
+    LEXER_PHASE(PARSE_CHAR_LITERAL);
+    position_ += wide ? 2 : 1; // Skip prefix and opening quote
 
-        case '+':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_PLUS_ASSIGN, "+=", line_, start_col);
-            }
-            if (!is_eof() && peek() == '+') {
-                advance();
-                return Token(TokenType::OP_PLUS, "++", line_, start_col); // Actually increment operator
-            }
-            return Token(TokenType::OP_PLUS, "+", line_, start_col);
+    size_t start_pos = position_;
+    bool escapes = false;
+    const char* close = find_literal_end('\'', escapes);
+    if (!close) {
+        return make_error(std::string_view("Unterminated character literal"));
+    }
+    position_ = close - source_.data();
+    Token token = make_token(TokenType::CONSTANT_CHAR, start_pos);
+    ++position_; // Skip closing quote
+
+    uint32_t value = 0;
+    size_t count = 0;
+    auto accumulate = [&](uint32_t code) {
+        value = wide ? code : (value << 8) | code;
+        ++count;
+    };
+    const char* error = wide ? decode_escapes<true>(token.value, accumulate)
+                             : decode_escapes<false>(token.value, accumulate);
+    if (error) {
+        return make_error(std::string_view(error));
+    }
+    if (count == 0) {
+        return make_error(std::string_view("Empty character constant"));
+    }
 
-        case '-':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_MINUS_ASSIGN, "-=", line_, start_col);
-            }
-            if (!is_eof() && peek() == '-') {
-                advance();
-                return Token(TokenType::OP_MINUS, "--", line_, start_col); // Actually decrement operator
-            }
-            if (!is_eof() && peek() == '>') {
-                advance();
-                return Token(TokenType::DELIMITER_ARROW, "->", line_, start_col);
-            }
-            return Token(TokenType::OP_MINUS, "-", line_, start_col);
+    int32_t result = !wide && count == 1 ? static_cast<signed char>(value)
+                                         : static_cast<int32_t>(value);
+    if (wide) {
+        token.set(TokenFlag::WIDE);
+    }
+    token.numeric = NumericType::INT;
+    token.int_value = static_cast<uint64_t>(int64_t{result});
+    return token;
+}
 
-        case '*':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_STAR_ASSIGN, "*=", line_, start_col);
-            }
-            return Token(TokenType::OP_STAR, "*", line_, start_col);
+template <typename Policy>
+const StringLiteral* BasicLexer<Policy>::concatenate(std::span<const Token> strings) {
+    if (strings.size() == 1) {
+        return strings[0].string;
+    }
+    bool wide = false;
+    for (const Token& token : strings) {
+        wide |= token.string->wide;
+    }
 
-        case '/':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_SLASH_ASSIGN, "/=", line_, start_col);
+    // Narrow pieces of a wide result are widened one UTF-8 character at a
+    // time, so size them first
+    size_t units = 0;
+    for (const Token& token : strings) {
+        const StringLiteral& piece = *token.string;
+        if (wide && !piece.wide) {
+            for (const char* p = piece.bytes.data(), *end = p + piece.bytes.size(); p < end;) {
+                decode_utf8(p, end);
+                ++units;
             }
-            return Token(TokenType::OP_SLASH, "/", line_, start_col);
+        } else {
+            units += piece.length();
+        }
+    }
 
-        case '%':
-            if (!is_eof() && peek() == '=') {
-                advance();
-                return Token(TokenType::OP_PERCENT_ASSIGN, "%=", line_, start_col);
+    const size_t unit = wide ? 4 : 1;
+    char* out = static_cast<char*>(literals_.allocate((units + 1) * unit, unit));
+    char* p = out;
+    for (const Token& token : strings) {
+        const StringLiteral& piece = *token.string;
+        if (wide && !piece.wide) {
+            for (const char* q = piece.bytes.data(), *end = q + piece.bytes.size(); q < end;) {
+                uint32_t code = decode_utf8(q, end);
+                std::memcpy(p, &code, 4);
+                p += 4;
             }
-            return Token(TokenType::OP_PERCENT, "%", line_, start_col);
-
-        case '(':
-            return Token(TokenType::DELIMITER_LPAREN, "(", line_, start_col);
-
-        case ')':
-            return Token(TokenType::DELIMITER_RPAREN, ")", line_, start_col);
-
-        case '{':
-            return Token(TokenType::DELIMITER_LBRACE, "{", line_, start_col);
-
-        case '}':
-            return Token(TokenType::DELIMITER_RBRACE, "}", line_, start_col);
-
-        case '[':
-            return Token(TokenType::DELIMITER_LBRACKET, "[", line_, start_col);
-
-        case ']':
-            return Token(TokenType::DELIMITER_RBRACKET, "]", line_, start_col);
-
-        case ',':
-            return Token(TokenType::DELIMITER_COMMA, ",", line_, start_col);
+        } else {
+            std::memcpy(p, piece.bytes.data(), piece.bytes.size());
+            p += piece.bytes.size();
+        }
+    }
+    std::memset(p, 0, unit);
+    return literals_.make<StringLiteral>(StringLiteral{std::string_view(out, units * unit), wide});
+}
 
-        case ';':
-            return Token(TokenType::DELIMITER_SEMICOLON, ";", line_, start_col);
+template <typename Policy>
+Token BasicLexer<Policy>::parse_operator() {
+    LEXER_PHASE(PARSE_OPERATOR);
+    size_t start_pos = position_;
+    PunctuatorMatch match;
+    if constexpr (Policy::dialect == Dialect::C89) {
+        match = c89_punctuator_table.match(source_.data() + position_);
+    } else {
+        match = c99_punctuator_table.match(source_.data() + position_);
+    }
+    if (match.length == 0) {
+        char c = advance();
+        return make_error("Unknown character: " + std::string(1, c));
+    }
 
-        case '.':
-            if (!is_eof() && peek() == '.' && peek(1) == '.') {
-                advance();
-                advance();
-                return Token(TokenType::DELIMITER_ELLIPSIS, "...", line_, start_col);
-            }
-            return Token(TokenType::DELIMITER_DOT, ".", line_, start_col);
-
-        case '#':
-            return Token(TokenType::PREPROCESSOR_HASH, "#", line_, start_col);
-
-        case ':':
-            return Token(TokenType::DELIMITER_COLON, ":", line_, start_col);
-
-        default:
-            std::string value(1, c);
-            return Token(TokenType::ERROR_TOKEN, "Unknown character: " + value, line_, start_col);
-    }
-}
-
-void Lexer::init_keywords() {
-    keywords_ = {
-        {"auto", TokenType::KW_AUTO},
-        {"break", TokenType::KW_BREAK},
-        {"case", TokenType::KW_CASE},
-        {"char", TokenType::KW_CHAR},
-        {"const", TokenType::KW_CONST},
-        {"continue", TokenType::KW_CONTINUE},
-        {"default", TokenType::KW_DEFAULT},
-        {"do", TokenType::KW_DO},
-        {"double", TokenType::KW_DOUBLE},
-        {"else", TokenType::KW_ELSE},
-        {"enum", TokenType::KW_ENUM},
-        {"extern", TokenType::KW_EXTERN},
-        {"float", TokenType::KW_FLOAT},
-        {"for", TokenType::KW_FOR},
-        {"goto", TokenType::KW_GOTO},
-        {"if", TokenType::KW_IF},
-        {"inline", TokenType::KW_INLINE},
-        {"int", TokenType::KW_INT},
-        {"long", TokenType::KW_LONG},
-        {"register", TokenType::KW_REGISTER},
-        {"restrict", TokenType::KW_RESTRICT},
-        {"return", TokenType::KW_RETURN},
-        {"short", TokenType::KW_SHORT},
-        {"signed", TokenType::KW_SIGNED},
-        {"sizeof", TokenType::KW_SIZEOF},
-        {"static", TokenType::KW_STATIC},
-        {"struct", TokenType::KW_STRUCT},
-        {"switch", TokenType::KW_SWITCH},
-        {"typedef", TokenType::KW_TYPEDEF},
-        {"union", TokenType::KW_UNION},
-        {"unsigned", TokenType::KW_UNSIGNED},
-        {"void", TokenType::KW_VOID},
-        {"volatile", TokenType::KW_VOLATILE},
-        {"while", TokenType::KW_WHILE},
-        {"_Bool", TokenType::KW__BOOL},
-        {"_Complex", TokenType::KW__COMPLEX},
-        {"_Imaginary", TokenType::KW__IMAGINARY}
-    };
+    position_ += match.length;
+    return make_token(match.type, start_pos);
 }
 
+template class BasicLexer<LexerPolicy<Dialect::C99>>;
+template class BasicLexer<LexerPolicy<Dialect::C89>>;
+template class BasicLexer<LexerPolicy<Dialect::C11>>;
+template class BasicLexer<LexerPolicy<Dialect::C99, true>>;
+template class BasicLexer<LexerPolicy<Dialect::C99, false, false>>;
+
 } // namespace lexer
\ No newline at end of file
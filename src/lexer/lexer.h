@@ -2,25 +2,187 @@
 #define LEXER_H
 
 #include "token.h"
+#include "arena.h"
+#include "identifier_table.h"
+#include "source_buffer.h"
+#include "token_stream.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
 
 namespace lexer {
 
-class Lexer {
+enum class Dialect : uint8_t {
+    C89, // No // comments; no inline, restrict, _Bool, _Complex, _Imaginary
+    C99,
+    C11  // C99 plus _Alignas, _Alignof, _Atomic, _Generic, _Noreturn,
+         // _Static_assert and _Thread_local
+};
+
+// Compile-time configuration of a BasicLexer. Each setting is a constant the
+// lexer branches on with if constexpr, so a disabled feature leaves no test
+// behind in the code that lexes a token.
+//
+//   keep_comments    return each comment as a COMMENT token, delimiters
+//                    included, instead of skipping it
+//   track_positions  give tokens their buffer offset; without it every
+//                    Token::offset is 0 and offsets are never mapped back
+//                    through a buffer's splices
+template <Dialect D, bool KeepComments = false, bool TrackPositions = true>
+struct LexerPolicy {
+    static constexpr Dialect dialect = D;
+    static constexpr bool keep_comments = KeepComments;
+    static constexpr bool track_positions = TrackPositions;
+};
+
+// The lexer, for the configuration its Policy (a LexerPolicy) describes.
+// Member functions are defined in lexer.cpp and explicitly instantiated for
+// the configurations named below; another combination must be added there
+// before it can be used.
+template <typename Policy>
+class BasicLexer {
 public:
-    explicit Lexer(const std::string& source);
+    // How far past the end of a token the lexer may look to decide where the
+    // token ends (e.g. "%:%" needs two bytes beyond "%:" to rule out "%:%:").
+    // Changing bytes further away than this cannot change the token. In a
+    // buffer with trigraphs or line splices this counts characters of the
+    // spliced text; see lookahead_end().
+    static constexpr uint32_t kMaxLookahead = 4;
+
+    // Lexers read the buffer after translation phases 1 and 2 (trigraphs and
+    // line splices, see SplicedText) without copying it unless it has any.
+    // Token offsets and position() are always offsets in the buffer itself;
+    // a token's value is its spelling after splicing.
+
+    // Copies source into a private buffer.
+    explicit BasicLexer(const std::string& source, IdentifierTable* identifiers = nullptr);
+
+    // Lexes buffer in place; tokens stay valid while the buffer is alive.
+    // Throws std::length_error for buffers of 4 GiB or more, whose offsets do
+    // not fit in Token::offset. When identifiers is given, every identifier
+    // and keyword token is interned into it and carries its ID in Token::ident.
+    explicit BasicLexer(std::shared_ptr<const SourceBuffer> buffer,
+                        IdentifierTable* identifiers = nullptr);
+
+    // Memory-maps path (see SourceBuffer::from_file) and lexes it.
+    static BasicLexer from_file(const std::string& path, IdentifierTable* identifiers = nullptr);
+
+    // Line and column of a token offset, computed from the buffer's newline
+    // table on demand.
+    SourceLocation location(uint32_t offset) const { return buffer_->location(offset); }
+    const std::shared_ptr<const SourceBuffer>& buffer() const { return buffer_; }
+
+    Token next_token() {
+        if (cursor_ == lexed_ && checkpoints_ == 0) {
+            return lex_token();
+        }
+        return next_cached_token();
+    }
+
+    // The token k places ahead without consuming it: peek_token(0) is what
+    // next_token() returns next. Peeked tokens are lexed once and kept in a
+    // ring buffer until they are consumed.
+    Token peek_token(size_t k = 0);
+
+    // Saved lexer state. Line and column are derived from offsets, so the
+    // state is just the place in the token sequence.
+    struct Checkpoint {
+        uint64_t token;
+    };
+
+    // Marks the current position so restore() can return to it. Tokens
+    // lexed while any checkpoint is live are kept, so replaying them after a
+    // restore does not lex them again. Every checkpoint must be ended by
+    // restore() or commit(), innermost first.
+    Checkpoint checkpoint();
+
+    // Rewinds to checkpoint and ends it.
+    void restore(Checkpoint checkpoint);
 
-    Token next_token();
+    // Ends checkpoint, keeping the current position.
+    void commit(Checkpoint checkpoint);
+
+    // Rewinds to the start of the buffer. Like reset(offset), this discards
+    // peeked tokens and ends every checkpoint.
     void reset();
 
+    // Continues lexing from offset, which must be a token boundary: the start
+    // of a token, or any position outside tokens, comments and literals.
+    void reset(uint32_t offset);
+
+    // Offset just past the last token returned. Available whether or not
+    // tokens carry positions.
+    uint32_t position() const {
+        return source_offset(cursor_ == lexed_ ? position_ : ring_[cursor_ & ring_mask_].from);
+    }
+
+    // Offset past every byte that can have affected the last token returned:
+    // kMaxLookahead characters past position(), plus room for a splice or
+    // trigraph that starts there.
+    uint64_t lookahead_end() const;
+
+    // The contents of adjacent string literal tokens joined into one, as
+    // translation phase 6 does; wide if any of them is wide. The result is
+    // built with a single allocation and lives as long as the lexer.
+    const StringLiteral* concatenate(std::span<const Token> strings);
+
+    // Lexes everything from the current position to the end of the buffer in
+    // one pass. The stream records identifier IDs if this lexer interns them.
+    TokenStream tokenize_all() requires Policy::track_positions;
+
 private:
-    std::string source_;
-    size_t position_;
-    size_t line_;
-    size_t column_;
-    std::unordered_map<std::string, TokenType> keywords_;
+    // A token lexed ahead of the caller, with the lexer position (in
+    // source_) before it
+    struct CachedToken {
+        Token token;
+        size_t from;
+    };
+
+    std::shared_ptr<const SourceBuffer> buffer_;
+    const SplicedText* spliced_; // Null when the buffer needs no splicing
+    std::string_view source_;    // The buffer's text, or its spliced text
+    IdentifierTable* identifiers_;
+    size_t position_;    // Where lexing continues; ahead of position() while tokens are cached
+    size_t token_start_; // Offset of the first character of the last token
+    // position_ and token_start_ are offsets in source_
+    std::deque<std::string> messages_; // Storage for formatted error messages
+    Arena literals_;                   // Decoded string literals
+
+    // Tokens [retained_, lexed_) of the sequence are cached in ring_, at
+    // index sequence & ring_mask_; cursor_ is the next one to return.
+    // Tokens before cursor_ are only kept while a checkpoint is live.
+    std::vector<CachedToken> ring_;
+    uint64_t ring_mask_ = 0;
+    uint64_t retained_ = 0;
+    uint64_t cursor_ = 0;
+    uint64_t lexed_ = 0;
+    size_t checkpoints_ = 0;
+    mutable size_t shift_hint_ = 0; // Speeds up source_offset(); see SplicedText
+
+    uint32_t source_offset(size_t offset) const {
+        return spliced_ ? spliced_->to_source(static_cast<uint32_t>(offset), shift_hint_)
+                        : static_cast<uint32_t>(offset);
+    }
+
+    // Token::offset for a token starting at offset in source_
+    uint32_t token_offset(size_t offset) const {
+        if constexpr (Policy::track_positions) {
+            return source_offset(offset);
+        } else {
+            return 0;
+        }
+    }
+
+    Token lex_token();
+    // The body of lex_token(), folded into it so that builds without
+    // instrumentation pay nothing for the split
+    __attribute__((always_inline)) Token scan_token();
+    Token next_cached_token();
+    void cache_token();
 
     char peek(size_t offset = 0) const;
     char advance();
@@ -35,13 +197,28 @@ private:
 
     Token parse_identifier();
     Token parse_number();
-    Token parse_string();
-    Token parse_char_literal();
+    Token parse_string(bool wide);
+    Token parse_char_literal(bool wide);
+    const char* find_literal_end(char quote, bool& escapes);
     Token parse_operator();
 
-    void init_keywords();
+    Token make_token(TokenType type, size_t value_start) const;
+    Token make_error(std::string_view message);
+    Token make_error(std::string message);
 };
 
+using Lexer = BasicLexer<LexerPolicy<Dialect::C99>>;
+using C89Lexer = BasicLexer<LexerPolicy<Dialect::C89>>;
+using C11Lexer = BasicLexer<LexerPolicy<Dialect::C11>>;
+using CommentLexer = BasicLexer<LexerPolicy<Dialect::C99, true>>;      // For formatters
+using PositionlessLexer = BasicLexer<LexerPolicy<Dialect::C99, false, false>>; // For hashing
+
+extern template class BasicLexer<LexerPolicy<Dialect::C99>>;
+extern template class BasicLexer<LexerPolicy<Dialect::C89>>;
+extern template class BasicLexer<LexerPolicy<Dialect::C11>>;
+extern template class BasicLexer<LexerPolicy<Dialect::C99, true>>;
+extern template class BasicLexer<LexerPolicy<Dialect::C99, false, false>>;
+
 } // namespace lexer
 
 #endif // LEXER_H
\ No newline at end of file
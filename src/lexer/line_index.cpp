@@ -0,0 +1,26 @@
+#include "line_index.h"
+#include "scan.h"
+#include <algorithm>
+#include <cstring>
+
+namespace lexer {
+
+LineIndex::LineIndex(std::string_view text) {
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+
+    line_starts_.reserve(scan::count_newlines(begin, end) + 1);
+    line_starts_.push_back(0);
+    for (const char* p = begin;
+         (p = static_cast<const char*>(std::memchr(p, '\n', end - p))) != nullptr; ++p) {
+        line_starts_.push_back(static_cast<uint32_t>(p - begin + 1));
+    }
+}
+
+SourceLocation LineIndex::location(uint32_t offset) const {
+    size_t line = std::upper_bound(line_starts_.begin(), line_starts_.end(), offset) -
+                  line_starts_.begin();
+    return SourceLocation{line, offset - line_starts_[line - 1] + 1};
+}
+
+} // namespace lexer
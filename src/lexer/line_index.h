@@ -0,0 +1,39 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace lexer {
+
+// 1-based line and column of a byte in a source buffer.
+struct SourceLocation {
+    size_t line;
+    size_t column;
+};
+
+// Offsets of the first byte of every line in a buffer, found with one memchr
+// sweep. Positions are stored as plain byte offsets everywhere else and only
+// turned into line/column here, by binary search, when something needs to be
+// shown to a user.
+class LineIndex {
+public:
+    explicit LineIndex(std::string_view text);
+
+    SourceLocation location(uint32_t offset) const;
+    size_t line_count() const { return line_starts_.size(); }
+
+    // Offset of the first byte of a 1-based line.
+    uint32_t line_start(size_t line) const { return line_starts_[line - 1]; }
+
+    size_t memory_usage() const { return line_starts_.capacity() * sizeof(uint32_t); }
+
+private:
+    std::vector<uint32_t> line_starts_;
+};
+
+} // namespace lexer
+
+#endif // LINE_INDEX_H
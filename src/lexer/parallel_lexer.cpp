@@ -0,0 +1,127 @@
+#include "parallel_lexer.h"
+#include "lexer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace lexer {
+
+namespace {
+
+// Chunk start offsets: roughly equal cuts moved forward to the next line
+std::vector<size_t> split_points(const SourceBuffer& buffer, size_t chunks) {
+    const char* data = buffer.data();
+    size_t size = buffer.size();
+
+    std::vector<size_t> starts{0};
+    for (size_t k = 1; k < chunks; ++k) {
+        size_t cut = std::max(size * k / chunks, starts.back() + 1);
+        if (cut >= size) {
+            break;
+        }
+        const char* newline = static_cast<const char*>(std::memchr(data + cut, '\n', size - cut));
+        if (!newline || newline + 1 == data + size) {
+            break;
+        }
+        starts.push_back(newline + 1 - data);
+    }
+    starts.push_back(size);
+    return starts;
+}
+
+// Tokens that start in [begin, end), lexed as if begin were a token boundary.
+// The chunk that reaches the end of the buffer also gets END_OF_FILE.
+TokenStream lex_chunk(const std::shared_ptr<const SourceBuffer>& buffer, size_t begin, size_t end) {
+    Lexer lexer(buffer);
+    lexer.reset(static_cast<uint32_t>(begin));
+
+    TokenStream stream(buffer);
+    stream.reserve((end - begin) / 8 + 1);
+    for (;;) {
+        Token token = lexer.next_token();
+        if (token.type != TokenType::END_OF_FILE && token.offset >= end) {
+            return stream;
+        }
+        stream.push_back(token.type, token.offset,
+                         static_cast<uint32_t>(lexer.position() - token.offset));
+        if (token.type == TokenType::END_OF_FILE) {
+            return stream;
+        }
+    }
+}
+
+} // namespace
+
+TokenStream tokenize_parallel(std::shared_ptr<const SourceBuffer> buffer,
+                              unsigned threads, size_t min_chunk_size) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunk_count = std::min<size_t>(threads, buffer->size() / std::max<size_t>(min_chunk_size, 1));
+    if (chunk_count < 2) {
+        return Lexer(buffer).tokenize_all();
+    }
+
+    std::vector<size_t> starts = split_points(*buffer, chunk_count);
+    buffer->spliced(); // Splice once here rather than in whichever worker gets there first
+    chunk_count = starts.size() - 1;
+
+    // Speculative pass: a fixed set of workers pulls chunks off a shared counter
+    std::vector<TokenStream> chunks(chunk_count, TokenStream(buffer));
+    std::atomic<size_t> next_chunk{0};
+    auto work = [&] {
+        for (size_t k; (k = next_chunk.fetch_add(1)) < chunk_count;) {
+            chunks[k] = lex_chunk(buffer, starts[k], starts[k + 1]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min<size_t>(threads, chunk_count); ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // Stitch: follow the real token stream and splice in each chunk from the
+    // first token it has in common with it
+    TokenStream result(buffer);
+    size_t total = 0;
+    for (const TokenStream& chunk : chunks) {
+        total += chunk.size();
+    }
+    result.reserve(total);
+
+    Lexer lexer(buffer);
+    size_t k = 0;
+    for (;;) {
+        Token token = lexer.next_token();
+        if (token.type == TokenType::END_OF_FILE) {
+            result.push_back(token.type, token.offset, 0);
+            return result;
+        }
+
+        while (token.offset >= starts[k + 1]) {
+            ++k;
+        }
+
+        const TokenStream& chunk = chunks[k];
+        size_t first = chunk.lower_bound(token.offset);
+        if (first < chunk.size() && chunk.offset(first) == token.offset) {
+            result.append(chunk, first, chunk.size());
+            const size_t last = chunk.size() - 1;
+            if (chunk.kind(last) == TokenType::END_OF_FILE) {
+                return result;
+            }
+            lexer.reset(chunk.offset(last) + chunk.length(last));
+            continue;
+        }
+
+        result.push_back(token.type, token.offset,
+                         static_cast<uint32_t>(lexer.position() - token.offset));
+    }
+}
+
+} // namespace lexer
@@ -0,0 +1,31 @@
+#ifndef PARALLEL_LEXER_H
+#define PARALLEL_LEXER_H
+
+#include "source_buffer.h"
+#include "token_stream.h"
+#include <cstddef>
+#include <memory>
+
+namespace lexer {
+
+// Tokenizes buffer on up to `threads` worker threads (0 means one per
+// hardware thread) and returns exactly what Lexer(buffer).tokenize_all()
+// would.
+//
+// The buffer is cut into chunks of at least min_chunk_size bytes, each
+// starting just after a newline, and every chunk is lexed speculatively as
+// if its first byte were outside any comment or literal. Because a lexer's
+// only state between tokens is its position, a speculative token that
+// starts at the same offset as a real one is identical to it, and so is
+// everything after it in that chunk. Stitching therefore re-lexes from the
+// end of each accepted chunk only until the real token stream lands on a
+// speculative token start, which is normally the very first token; a chunk
+// that began inside a comment or literal costs one extra sequential pass
+// over the part that was misread.
+TokenStream tokenize_parallel(std::shared_ptr<const SourceBuffer> buffer,
+                              unsigned threads = 0,
+                              size_t min_chunk_size = 1 << 20);
+
+} // namespace lexer
+
+#endif // PARALLEL_LEXER_H
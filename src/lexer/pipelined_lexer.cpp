@@ -0,0 +1,107 @@
+#include "pipelined_lexer.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+namespace lexer {
+
+namespace {
+
+// Waits a little longer on each call: the other side is normally only a
+// batch away, so spin first, then yield in case it is not running at all.
+void backoff(unsigned& spins) {
+    if (++spins < 64) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        _mm_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+PipelinedLexer::PipelinedLexer(std::shared_ptr<const SourceBuffer> buffer,
+                               IdentifierTable* identifiers, size_t batch_size,
+                               size_t queue_depth)
+    : buffer_(buffer), lexer_(std::move(buffer), identifiers),
+      batch_size_(batch_size ? batch_size : 1), queue_(queue_depth) {
+    producer_ = std::thread([this] { produce(); });
+}
+
+PipelinedLexer::~PipelinedLexer() {
+    stop_.store(true, std::memory_order_relaxed);
+    producer_.join();
+}
+
+// Moves on to the next batch, or returns END_OF_FILE again after the last
+Token PipelinedLexer::next_batch() {
+    if (finished_) {
+        return end_[-1];
+    }
+    if (failed_) {
+        std::rethrow_exception(error_);
+    }
+    if (holding_) {
+        queue_.pop();
+    }
+
+    Batch* batch;
+    for (unsigned spins = 0; !(batch = queue_.front());) {
+        backoff(spins);
+    }
+    holding_ = true;
+    if (batch->empty()) {
+        holding_ = false;
+        failed_ = true;
+        queue_.pop();
+        std::rethrow_exception(error_);
+    }
+    next_ = batch->data();
+    end_ = next_ + batch->size();
+    finished_ = end_[-1].type == TokenType::END_OF_FILE;
+    return *next_++;
+}
+
+void PipelinedLexer::produce() {
+    try {
+        for (;;) {
+            Batch* batch = wait_for_free_slot();
+            if (!batch) {
+                return;
+            }
+            batch->clear();
+            batch->reserve(batch_size_);
+            bool done = false;
+            while (batch->size() < batch_size_ && !done) {
+                batch->push_back(lexer_.next_token());
+                done = batch->back().type == TokenType::END_OF_FILE;
+            }
+            queue_.push();
+            if (done) {
+                return;
+            }
+        }
+    } catch (...) {
+        error_ = std::current_exception();
+        if (Batch* batch = wait_for_free_slot()) {
+            batch->clear();
+            queue_.push();
+        }
+    }
+}
+
+// Null once the consumer is going away
+PipelinedLexer::Batch* PipelinedLexer::wait_for_free_slot() {
+    Batch* batch;
+    for (unsigned spins = 0; !(batch = queue_.back());) {
+        if (stop_.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        backoff(spins);
+    }
+    return batch;
+}
+
+} // namespace lexer
@@ -0,0 +1,86 @@
+#ifndef PIPELINED_LEXER_H
+#define PIPELINED_LEXER_H
+
+#include "lexer.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace lexer {
+
+// Lexes on a thread of its own while the caller consumes tokens, so lexing
+// overlaps with parsing on a multi-core machine. The producer thread runs a
+// Lexer over the buffer and publishes tokens in batches through a bounded
+// SpscQueue; next_token() returns exactly what Lexer::next_token() would,
+// reading them out of the oldest batch.
+//
+// Larger batches cost less synchronization per token but take longer to
+// fill, so the consumer waits longer for the first one and they occupy more
+// cache. The queue holds queue_depth batches, which bounds how far the
+// producer can run ahead.
+//
+// The identifier table, if given, is written by the producer thread and must
+// not be used by anyone else until the lexer has returned END_OF_FILE or been
+// destroyed.
+class PipelinedLexer {
+public:
+    static constexpr size_t kDefaultBatchSize = 256;
+    static constexpr size_t kDefaultQueueDepth = 16;
+
+    // Starts lexing buffer. Throws like the Lexer constructor.
+    explicit PipelinedLexer(std::shared_ptr<const SourceBuffer> buffer,
+                            IdentifierTable* identifiers = nullptr,
+                            size_t batch_size = kDefaultBatchSize,
+                            size_t queue_depth = kDefaultQueueDepth);
+
+    // Stops the producer, which may not have reached the end of the buffer.
+    ~PipelinedLexer();
+
+    PipelinedLexer(const PipelinedLexer&) = delete;
+    PipelinedLexer& operator=(const PipelinedLexer&) = delete;
+
+    // Tokens stay valid until the lexer is destroyed. Rethrows anything the
+    // producer thread threw, in place of the token it was lexing and on
+    // every call after.
+    Token next_token() {
+        if (next_ != end_) {
+            return *next_++;
+        }
+        return next_batch();
+    }
+
+    SourceLocation location(uint32_t offset) const { return buffer_->location(offset); }
+    const std::shared_ptr<const SourceBuffer>& buffer() const { return buffer_; }
+
+private:
+    // Ends with END_OF_FILE if it is the last; empty if the producer failed
+    using Batch = std::vector<Token>;
+
+    Token next_batch();
+    void produce();
+    Batch* wait_for_free_slot();
+
+    std::shared_ptr<const SourceBuffer> buffer_;
+    Lexer lexer_; // Only touched by the producer thread once it starts
+    const size_t batch_size_;
+    SpscQueue<Batch> queue_;
+
+    // Consumer state: the rest of the batch at the front of the queue
+    const Token* next_ = nullptr;
+    const Token* end_ = nullptr;
+    bool holding_ = false; // Whether the front batch is being read
+    bool finished_ = false; // It ends with END_OF_FILE
+    bool failed_ = false;   // error_ has been rethrown, and is again on each call
+
+    std::atomic<bool> stop_{false};
+    std::exception_ptr error_; // Set before the producer publishes an empty batch
+    std::thread producer_;
+};
+
+} // namespace lexer
+
+#endif // PIPELINED_LEXER_H
@@ -0,0 +1,154 @@
+#ifndef PUNCTUATORS_H
+#define PUNCTUATORS_H
+
+#include "keywords.h"
+#include "token.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace lexer {
+
+struct Punctuator {
+    std::string_view spelling;
+    TokenType type;
+};
+
+// Punctuators of each dialect a lexer can be configured for (see
+// LexerPolicy). Adding an operator only needs a new row here. C89 has no
+// digraphs; they came with C95, so C99 is C89 plus the six of them.
+inline constexpr std::array c89_punctuators = std::to_array<Punctuator>({
+    {"[", TokenType::DELIMITER_LBRACKET},
+    {"]", TokenType::DELIMITER_RBRACKET},
+    {"(", TokenType::DELIMITER_LPAREN},
+    {")", TokenType::DELIMITER_RPAREN},
+    {"{", TokenType::DELIMITER_LBRACE},
+    {"}", TokenType::DELIMITER_RBRACE},
+    {".", TokenType::DELIMITER_DOT},
+    {"->", TokenType::DELIMITER_ARROW},
+    {"++", TokenType::OP_INCREMENT},
+    {"--", TokenType::OP_DECREMENT},
+    {"&", TokenType::OP_BITWISE_AND},
+    {"*", TokenType::OP_STAR},
+    {"+", TokenType::OP_PLUS},
+    {"-", TokenType::OP_MINUS},
+    {"~", TokenType::OP_BITWISE_NOT},
+    {"!", TokenType::OP_NOT},
+    {"/", TokenType::OP_SLASH},
+    {"%", TokenType::OP_PERCENT},
+    {"<<", TokenType::OP_LEFT_SHIFT},
+    {">>", TokenType::OP_RIGHT_SHIFT},
+    {"<", TokenType::OP_LT},
+    {">", TokenType::OP_GT},
+    {"<=", TokenType::OP_LE},
+    {">=", TokenType::OP_GE},
+    {"==", TokenType::OP_EQ},
+    {"!=", TokenType::OP_NE},
+    {"^", TokenType::OP_BITWISE_XOR},
+    {"|", TokenType::OP_BITWISE_OR},
+    {"&&", TokenType::OP_AND},
+    {"||", TokenType::OP_OR},
+    {"?", TokenType::OP_QUESTION},
+    {":", TokenType::DELIMITER_COLON},
+    {";", TokenType::DELIMITER_SEMICOLON},
+    {"...", TokenType::DELIMITER_ELLIPSIS},
+    {"=", TokenType::OP_ASSIGN},
+    {"*=", TokenType::OP_STAR_ASSIGN},
+    {"/=", TokenType::OP_SLASH_ASSIGN},
+    {"%=", TokenType::OP_PERCENT_ASSIGN},
+    {"+=", TokenType::OP_PLUS_ASSIGN},
+    {"-=", TokenType::OP_MINUS_ASSIGN},
+    {"<<=", TokenType::OP_LEFT_SHIFT_ASSIGN},
+    {">>=", TokenType::OP_RIGHT_SHIFT_ASSIGN},
+    {"&=", TokenType::OP_AND_ASSIGN},
+    {"^=", TokenType::OP_XOR_ASSIGN},
+    {"|=", TokenType::OP_OR_ASSIGN},
+    {",", TokenType::DELIMITER_COMMA},
+    {"#", TokenType::PREPROCESSOR_HASH},
+    {"##", TokenType::PREPROCESSOR_HASH_HASH}
+});
+
+inline constexpr std::array c99_punctuators = extend<Punctuator>(c89_punctuators, {
+    {"<:", TokenType::DELIMITER_LBRACKET},
+    {":>", TokenType::DELIMITER_RBRACKET},
+    {"<%", TokenType::DELIMITER_LBRACE},
+    {"%>", TokenType::DELIMITER_RBRACE},
+    {"%:", TokenType::PREPROCESSOR_HASH},
+    {"%:%:", TokenType::PREPROCESSOR_HASH_HASH}
+});
+
+struct PunctuatorMatch {
+    TokenType type;
+    size_t length; // 0 if no punctuator starts here
+};
+
+// Maximal-munch recognizer for a punctuator set, built at compile time as a
+// trie over character classes: one byte per source character to find its
+// class, one byte per step to follow the transition. The longest accepted
+// prefix wins, so "..", "%:%" and "<<<" fall back to their longest valid
+// punctuator exactly as the standard requires.
+template <size_t N>
+class PunctuatorTable {
+public:
+    using Match = PunctuatorMatch;
+
+    consteval explicit PunctuatorTable(const std::array<Punctuator, N>& punctuators) {
+        for (const Punctuator& punctuator : punctuators) {
+            uint8_t state = 0;
+            for (char c : punctuator.spelling) {
+                uint8_t& cls = classes_[static_cast<unsigned char>(c)];
+                if (cls == 0) {
+                    if (class_count_ + 1 == kMaxClasses) {
+                        throw "too many punctuator characters; grow kMaxClasses";
+                    }
+                    cls = ++class_count_;
+                }
+                uint8_t& next = transitions_[state][cls];
+                if (next == 0) {
+                    if (state_count_ + 1 == kMaxStates) {
+                        throw "too many punctuator prefixes; grow kMaxStates";
+                    }
+                    next = ++state_count_;
+                }
+                state = next;
+            }
+            accepts_[state] = true;
+            types_[state] = punctuator.type;
+        }
+    }
+
+    // Longest punctuator at p. The text must be NUL-terminated, which ends
+    // any match since NUL belongs to no punctuator.
+    Match match(const char* p) const {
+        Match result{TokenType::ERROR_TOKEN, 0};
+        uint8_t state = 0;
+        for (size_t i = 0;; ++i) {
+            state = transitions_[state][classes_[static_cast<unsigned char>(p[i])]];
+            if (state == 0) {
+                return result;
+            }
+            if (accepts_[state]) {
+                result = Match{types_[state], i + 1};
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kMaxStates = 96;
+    static constexpr size_t kMaxClasses = 32;
+
+    std::array<uint8_t, 256> classes_{};
+    std::array<std::array<uint8_t, kMaxClasses>, kMaxStates> transitions_{};
+    std::array<bool, kMaxStates> accepts_{};
+    std::array<TokenType, kMaxStates> types_{};
+    uint8_t class_count_ = 0;
+    uint8_t state_count_ = 0;
+};
+
+inline constexpr PunctuatorTable c89_punctuator_table(c89_punctuators);
+inline constexpr PunctuatorTable c99_punctuator_table(c99_punctuators);
+
+} // namespace lexer
+
+#endif // PUNCTUATORS_H
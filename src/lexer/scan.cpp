@@ -0,0 +1,408 @@
+#include "scan.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEXER_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace lexer {
+namespace scan {
+
+namespace {
+
+inline bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool is_identifier(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+const char* skip_whitespace_scalar(const char* p, const char* end) {
+    while (p < end && is_whitespace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* skip_identifier_scalar(const char* p, const char* end) {
+    while (p < end && is_identifier(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* find_comment_end_scalar(const char* p, const char* end) {
+    while (p + 1 < end) {
+        const char* star = static_cast<const char*>(std::memchr(p, '*', end - p - 1));
+        if (!star) {
+            break;
+        }
+        if (star[1] == '/') {
+            return star;
+        }
+        p = star + 1;
+    }
+    return end;
+}
+
+inline bool is_literal_stop(char c, char quote) {
+    return c == quote || c == '\n';
+}
+
+const char* find_literal_stop_scalar(const char* p, const char* end, char quote) {
+    while (p < end && !is_literal_stop(*p, quote)) {
+        ++p;
+    }
+    return p;
+}
+
+inline bool is_splice_or_trigraph(const char* p) {
+    return (p[0] == '\\' && (p[1] == '\n' || p[1] == '\r')) || (p[0] == '?' && p[1] == '?');
+}
+
+const char* find_splice_or_trigraph_scalar(const char* p, const char* end) {
+    for (; p + 1 < end; ++p) {
+        if (is_splice_or_trigraph(p)) {
+            return p;
+        }
+    }
+    return end;
+}
+
+size_t count_newlines_scalar(const char* p, const char* end) {
+    size_t count = 0;
+    for (; p < end; ++p) {
+        count += *p == '\n';
+    }
+    return count;
+}
+
+#ifdef LEXER_SCAN_X86
+
+// The vector versions classify a block, turn the result into a bit mask with
+// movemask, and finish the sub-block tail with the scalar loop.
+
+inline __m128i whitespace_mask_sse2(__m128i v) {
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+}
+
+// Signed byte range test lo <= v <= hi; bytes >= 0x80 compare negative and
+// so never fall inside an ASCII range.
+inline __m128i in_range_sse2(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                         _mm_cmpgt_epi8(_mm_set1_epi8(static_cast<char>(hi + 1)), v));
+}
+
+inline __m128i identifier_mask_sse2(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return _mm_or_si128(_mm_or_si128(in_range_sse2(lower, 'a', 'z'),
+                                     in_range_sse2(v, '0', '9')),
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+const char* skip_whitespace_sse2(const char* p, const char* end) {
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(whitespace_mask_sse2(v))) & 0xFFFF;
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_whitespace_scalar(p, end);
+}
+
+const char* skip_identifier_sse2(const char* p, const char* end) {
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(identifier_mask_sse2(v))) & 0xFFFF;
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_identifier_scalar(p, end);
+}
+
+const char* find_comment_end_sse2(const char* p, const char* end) {
+    for (; p + 17 <= end; p += 16) {
+        __m128i star = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i slash = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(star, _mm_set1_epi8('*')),
+                          _mm_cmpeq_epi8(slash, _mm_set1_epi8('/')))));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_comment_end_scalar(p, end);
+}
+
+const char* find_literal_stop_sse2(const char* p, const char* end, char quote) {
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(quote)),
+                                    _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(stop));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_literal_stop_scalar(p, end, quote);
+}
+
+const char* find_splice_or_trigraph_sse2(const char* p, const char* end) {
+    for (; p + 17 <= end; p += 16) {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        __m128i splice = _mm_and_si128(
+            _mm_cmpeq_epi8(first, _mm_set1_epi8('\\')),
+            _mm_or_si128(_mm_cmpeq_epi8(second, _mm_set1_epi8('\n')),
+                         _mm_cmpeq_epi8(second, _mm_set1_epi8('\r'))));
+        __m128i trigraph = _mm_and_si128(_mm_cmpeq_epi8(first, _mm_set1_epi8('?')),
+                                         _mm_cmpeq_epi8(second, _mm_set1_epi8('?')));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(splice, trigraph)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_splice_or_trigraph_scalar(p, end);
+}
+
+size_t count_newlines_sse2(const char* p, const char* end) {
+    size_t count = 0;
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        count += __builtin_popcount(static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')))));
+    }
+    return count + count_newlines_scalar(p, end);
+}
+
+#define LEXER_AVX2 __attribute__((target("avx2")))
+
+LEXER_AVX2 inline __m256i in_range_avx2(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), v));
+}
+
+LEXER_AVX2 const char* skip_whitespace_avx2(const char* p, const char* end) {
+    for (; p + 32 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(ws));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_whitespace_sse2(p, end);
+}
+
+LEXER_AVX2 const char* skip_identifier_avx2(const char* p, const char* end) {
+    for (; p + 32 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i ident = _mm256_or_si256(
+            _mm256_or_si256(in_range_avx2(lower, 'a', 'z'), in_range_avx2(v, '0', '9')),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(ident));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_identifier_sse2(p, end);
+}
+
+LEXER_AVX2 const char* find_comment_end_avx2(const char* p, const char* end) {
+    for (; p + 33 <= end; p += 32) {
+        __m256i star = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i slash = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(star, _mm256_set1_epi8('*')),
+                             _mm256_cmpeq_epi8(slash, _mm256_set1_epi8('/')))));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_comment_end_sse2(p, end);
+}
+
+LEXER_AVX2 const char* find_literal_stop_avx2(const char* p, const char* end, char quote) {
+    for (; p + 32 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(quote)),
+                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(stop));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_literal_stop_sse2(p, end, quote);
+}
+
+LEXER_AVX2 const char* find_splice_or_trigraph_avx2(const char* p, const char* end) {
+    for (; p + 33 <= end; p += 32) {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        __m256i splice = _mm256_and_si256(
+            _mm256_cmpeq_epi8(first, _mm256_set1_epi8('\\')),
+            _mm256_or_si256(_mm256_cmpeq_epi8(second, _mm256_set1_epi8('\n')),
+                            _mm256_cmpeq_epi8(second, _mm256_set1_epi8('\r'))));
+        __m256i trigraph = _mm256_and_si256(_mm256_cmpeq_epi8(first, _mm256_set1_epi8('?')),
+                                            _mm256_cmpeq_epi8(second, _mm256_set1_epi8('?')));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(splice, trigraph)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return find_splice_or_trigraph_sse2(p, end);
+}
+
+LEXER_AVX2 size_t count_newlines_avx2(const char* p, const char* end) {
+    size_t count = 0;
+    for (; p + 32 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        count += __builtin_popcount(static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')))));
+    }
+    return count + count_newlines_sse2(p, end);
+}
+
+#undef LEXER_AVX2
+
+#endif // LEXER_SCAN_X86
+
+struct Scanners {
+    const char* (*skip_whitespace)(const char*, const char*);
+    const char* (*skip_identifier)(const char*, const char*);
+    const char* (*find_comment_end)(const char*, const char*);
+    const char* (*find_literal_stop)(const char*, const char*, char);
+    const char* (*find_splice_or_trigraph)(const char*, const char*);
+    size_t (*count_newlines)(const char*, const char*);
+};
+
+Scanners scanners_for(Isa isa) {
+    switch (isa) {
+#ifdef LEXER_SCAN_X86
+        case Isa::AVX2:
+            return {skip_whitespace_avx2, skip_identifier_avx2,
+                    find_comment_end_avx2, find_literal_stop_avx2,
+                    find_splice_or_trigraph_avx2, count_newlines_avx2};
+        case Isa::SSE2:
+            return {skip_whitespace_sse2, skip_identifier_sse2,
+                    find_comment_end_sse2, find_literal_stop_sse2,
+                    find_splice_or_trigraph_sse2, count_newlines_sse2};
+#endif
+        default:
+            return {skip_whitespace_scalar, skip_identifier_scalar,
+                    find_comment_end_scalar, find_literal_stop_scalar,
+                    find_splice_or_trigraph_scalar, count_newlines_scalar};
+    }
+}
+
+Isa detect_isa() {
+#ifdef LEXER_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return Isa::SSE2;
+    }
+#endif
+    return Isa::SCALAR;
+}
+
+struct Active {
+    Isa isa;
+    Scanners scanners;
+};
+
+// Built on first use rather than during static initialization, so lexing
+// from another translation unit's static initializers finds it ready
+Active& active() {
+    static Active state{best_isa(), scanners_for(best_isa())};
+    return state;
+}
+
+} // namespace
+
+Isa best_isa() {
+    static const Isa isa = detect_isa();
+    return isa;
+}
+
+Isa active_isa() {
+    return active().isa;
+}
+
+void use_isa(Isa isa) {
+    if (static_cast<int>(isa) > static_cast<int>(best_isa())) {
+        isa = best_isa();
+    }
+    active() = Active{isa, scanners_for(isa)};
+}
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2: return "avx2";
+        case Isa::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+// Runs are usually a byte or two long, so the first few bytes are checked
+// inline before paying for the indirect call into the vector code.
+
+const char* skip_whitespace(const char* p, const char* end) {
+    for (int i = 0; i < 4; ++i, ++p) {
+        if (p == end || !is_whitespace(*p)) {
+            return p;
+        }
+    }
+    return active().scanners.skip_whitespace(p, end);
+}
+
+const char* skip_identifier(const char* p, const char* end) {
+    for (int i = 0; i < 8; ++i, ++p) {
+        if (p == end || !is_identifier(*p)) {
+            return p;
+        }
+    }
+    return active().scanners.skip_identifier(p, end);
+}
+
+const char* find_comment_end(const char* p, const char* end) {
+    return active().scanners.find_comment_end(p, end);
+}
+
+const char* find_literal_stop(const char* p, const char* end, char quote) {
+    for (int i = 0; i < 8; ++i, ++p) {
+        if (p == end || is_literal_stop(*p, quote)) {
+            return p;
+        }
+    }
+    return active().scanners.find_literal_stop(p, end, quote);
+}
+
+const char* find_splice_or_trigraph(const char* p, const char* end) {
+    return active().scanners.find_splice_or_trigraph(p, end);
+}
+
+size_t count_newlines(const char* p, const char* end) {
+    if (end - p < 16) {
+        return count_newlines_scalar(p, end);
+    }
+    return active().scanners.count_newlines(p, end);
+}
+
+} // namespace scan
+} // namespace lexer
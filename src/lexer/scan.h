@@ -0,0 +1,55 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+
+namespace lexer {
+namespace scan {
+
+// Byte-run scanners used by the lexer's hot loops. Each has a portable scalar
+// version and SSE2/AVX2 versions on x86; the widest one the CPU supports is
+// picked at startup. All of them take a half-open range [p, end) and never
+// read outside it.
+enum class Isa {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// Best instruction set available on this CPU.
+Isa best_isa();
+
+// Instruction set currently in use; defaults to best_isa().
+Isa active_isa();
+
+// Switches every scanner to isa, which must not exceed best_isa(). Intended
+// for tests and benchmarks; not thread-safe with concurrent lexing.
+void use_isa(Isa isa);
+
+const char* isa_name(Isa isa);
+
+// First byte in [p, end) that is not ' ', '\t', '\n' or '\r', or end.
+const char* skip_whitespace(const char* p, const char* end);
+
+// First byte in [p, end) that is not [A-Za-z0-9_], or end.
+const char* skip_identifier(const char* p, const char* end);
+
+// First "*/" in [p, end), or end if the comment is unterminated.
+const char* find_comment_end(const char* p, const char* end);
+
+// First byte in [p, end) that is quote or '\n', or end. Unless escaped, that
+// is where a string or character literal ends.
+const char* find_literal_stop(const char* p, const char* end, char quote);
+
+// First byte in [p, end - 1) that starts a possible line splice or trigraph
+// (a backslash followed by '\n' or '\r', or "??"), or end. The caller checks
+// the bytes after it.
+const char* find_splice_or_trigraph(const char* p, const char* end);
+
+// Number of '\n' bytes in [p, end).
+size_t count_newlines(const char* p, const char* end);
+
+} // namespace scan
+} // namespace lexer
+
+#endif // SCAN_H
@@ -0,0 +1,155 @@
+#include "source_buffer.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lexer {
+
+namespace {
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::from_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno("cannot open " + path);
+    }
+
+    try {
+        auto buffer = from_fd(fd);
+        ::close(fd);
+        return buffer;
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::from_fd(int fd) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        throw_errno("cannot stat file descriptor");
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        if (auto buffer = map(fd, static_cast<size_t>(st.st_size))) {
+            return buffer;
+        }
+    }
+    return read(fd);
+}
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::from_string(std::string_view text) {
+    char* data = static_cast<char*>(std::malloc(text.size() + 1));
+    if (!data) {
+        throw std::bad_alloc();
+    }
+    std::memcpy(data, text.data(), text.size());
+    data[text.size()] = '\0';
+    return std::shared_ptr<const SourceBuffer>(new SourceBuffer(data, text.size(), Storage::HEAP));
+}
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::borrow(std::string_view text) {
+    return std::shared_ptr<const SourceBuffer>(
+        new SourceBuffer(const_cast<char*>(text.data()), text.size(), Storage::BORROWED));
+}
+
+SourceBuffer::~SourceBuffer() {
+    switch (storage_) {
+        case Storage::MAPPED:
+            ::munmap(data_, mapping_size_);
+            break;
+        case Storage::HEAP:
+            std::free(data_);
+            break;
+        case Storage::BORROWED:
+            break;
+    }
+}
+
+const LineIndex& SourceBuffer::line_index() const {
+    std::call_once(line_index_once_, [this] {
+        line_index_ = std::make_unique<LineIndex>(text());
+    });
+    return *line_index_;
+}
+
+const SplicedText* SourceBuffer::spliced() const {
+    std::call_once(spliced_once_, [this] {
+        spliced_ = SplicedText::build(text());
+    });
+    return spliced_.get();
+}
+
+// Reserves a zero-filled region one byte longer than the file, rounded up to
+// whole pages, and maps the file over its start. The tail of the file's last
+// page is zeroed by the kernel, and a file that ends on a page boundary is
+// followed by the reserved anonymous page, so the sentinel never needs a copy.
+std::shared_ptr<const SourceBuffer> SourceBuffer::map(int fd, size_t size) {
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t mapping_size = (size + 1 + page - 1) / page * page;
+
+    void* region = ::mmap(nullptr, mapping_size, PROT_READ,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return nullptr;
+    }
+
+    void* file = ::mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (file == MAP_FAILED) {
+        ::munmap(region, mapping_size);
+        return nullptr;
+    }
+
+    return std::shared_ptr<const SourceBuffer>(
+        new SourceBuffer(static_cast<char*>(region), size, Storage::MAPPED, mapping_size));
+}
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::read(int fd) {
+    size_t capacity = 64 * 1024;
+    size_t size = 0;
+    char* data = static_cast<char*>(std::malloc(capacity));
+    if (!data) {
+        throw std::bad_alloc();
+    }
+
+    for (;;) {
+        if (size + 1 == capacity) {
+            char* grown = static_cast<char*>(std::realloc(data, capacity * 2));
+            if (!grown) {
+                std::free(data);
+                throw std::bad_alloc();
+            }
+            data = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = ::read(fd, data + size, capacity - size - 1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::free(data);
+            throw_errno("cannot read file descriptor");
+        }
+        if (n == 0) {
+            break;
+        }
+        size += static_cast<size_t>(n);
+    }
+
+    data[size] = '\0';
+    return std::shared_ptr<const SourceBuffer>(new SourceBuffer(data, size, Storage::HEAP));
+}
+
+} // namespace lexer
@@ -0,0 +1,77 @@
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include "line_index.h"
+#include "spliced_text.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace lexer {
+
+// Immutable source text for a Lexer. The bytes are always followed by a NUL
+// sentinel (data()[size()] == '\0') that the lexer may read without a bounds
+// check. Regular files are memory-mapped read-only; everything else is read
+// into a single heap block.
+class SourceBuffer {
+public:
+    // Maps the file at path, or reads it if it cannot be mapped.
+    // Throws std::system_error if the file cannot be opened or read.
+    static std::shared_ptr<const SourceBuffer> from_file(const std::string& path);
+
+    // Maps fd if it refers to a regular file, otherwise (stdin, pipes,
+    // sockets) reads it to end-of-file. Does not close fd.
+    static std::shared_ptr<const SourceBuffer> from_fd(int fd);
+
+    // Copies text into a new buffer.
+    static std::shared_ptr<const SourceBuffer> from_string(std::string_view text);
+
+    // Wraps memory owned by the caller without copying it. text.data() must
+    // be followed by a NUL byte and outlive the buffer.
+    static std::shared_ptr<const SourceBuffer> borrow(std::string_view text);
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer();
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view text() const { return std::string_view(data_, size_); }
+    bool is_mapped() const { return storage_ == Storage::MAPPED; }
+
+    // Newline table for this buffer, built on first use. Thread-safe.
+    const LineIndex& line_index() const;
+    SourceLocation location(uint32_t offset) const { return line_index().location(offset); }
+
+    // The text after trigraph replacement and line splicing, or nullptr if
+    // the buffer has neither. Built on first use. Thread-safe.
+    const SplicedText* spliced() const;
+
+private:
+    enum class Storage {
+        HEAP,    // malloc'd, freed on destruction
+        MAPPED,  // mmap'd region of mapping_size_ bytes
+        BORROWED // Owned by the caller
+    };
+
+    SourceBuffer(char* data, size_t size, Storage storage, size_t mapping_size = 0)
+        : data_(data), size_(size), storage_(storage), mapping_size_(mapping_size) {}
+
+    static std::shared_ptr<const SourceBuffer> map(int fd, size_t size);
+    static std::shared_ptr<const SourceBuffer> read(int fd);
+
+    char* data_;
+    size_t size_;
+    Storage storage_;
+    size_t mapping_size_; // Length of the mapping for MAPPED storage
+    mutable std::once_flag line_index_once_;
+    mutable std::unique_ptr<LineIndex> line_index_;
+    mutable std::once_flag spliced_once_;
+    mutable std::unique_ptr<SplicedText> spliced_;
+};
+
+} // namespace lexer
+
+#endif // SOURCE_BUFFER_H
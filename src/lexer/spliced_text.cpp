@@ -0,0 +1,120 @@
+#include "spliced_text.h"
+#include "scan.h"
+#include <algorithm>
+
+namespace lexer {
+
+namespace {
+
+// Character a trigraph's third byte stands for, or 0
+char trigraph(char c) {
+    switch (c) {
+        case '=': return '#';
+        case '(': return '[';
+        case '/': return '\\';
+        case ')': return ']';
+        case '\'': return '^';
+        case '<': return '{';
+        case '!': return '|';
+        case '>': return '}';
+        case '-': return '~';
+        default: return 0;
+    }
+}
+
+// Length of the line break at p: "\n" or "\r\n", or 0
+size_t newline_length(const char* p, const char* end) {
+    if (p < end && *p == '\n') {
+        return 1;
+    }
+    return end - p >= 2 && p[0] == '\r' && p[1] == '\n' ? 2 : 0;
+}
+
+// What phases 1 and 2 do at a candidate from scan::find_splice_or_trigraph:
+// replace `length` bytes with `replacement`, or with nothing if it is 0. A
+// length of 0 means the candidate was neither.
+struct Change {
+    size_t length;
+    char replacement;
+};
+
+Change change_at(const char* p, const char* end) {
+    if (*p == '\\') {
+        size_t newline = newline_length(p + 1, end);
+        return {newline ? 1 + newline : 0, 0};
+    }
+    char c = end - p >= 3 ? trigraph(p[2]) : 0;
+    if (c == '\\') {
+        // ??/ followed by a line break is a splice too
+        if (size_t newline = newline_length(p + 3, end)) {
+            return {3 + newline, 0};
+        }
+    }
+    return {c ? size_t{3} : 0, c};
+}
+
+} // namespace
+
+std::unique_ptr<SplicedText> SplicedText::build(std::string_view source) {
+    const char* begin = source.data();
+    const char* end = begin + source.size();
+    const char* p = scan::find_splice_or_trigraph(begin, end);
+    while (p < end && change_at(p, end).length == 0) {
+        p = scan::find_splice_or_trigraph(p + 1, end);
+    }
+    if (p == end) {
+        return nullptr;
+    }
+
+    std::unique_ptr<SplicedText> spliced(new SplicedText);
+    std::string& text = spliced->text_;
+    std::vector<Shift>& shifts = spliced->shifts_;
+    text.reserve(source.size());
+    shifts.push_back(Shift{0, 0});
+
+    const char* copied = begin;
+    uint32_t removed = 0;
+    while (p < end) {
+        Change change = change_at(p, end);
+        if (change.length == 0) {
+            p = scan::find_splice_or_trigraph(p + 1, end);
+            continue;
+        }
+        text.append(copied, p);
+        if (change.replacement) {
+            text.push_back(change.replacement);
+        }
+        copied = p + change.length;
+        removed += static_cast<uint32_t>(change.length - (change.replacement ? 1 : 0));
+
+        // Consecutive splices share one entry
+        uint32_t offset = static_cast<uint32_t>(text.size());
+        if (shifts.back().offset == offset) {
+            shifts.back().removed = removed;
+        } else {
+            shifts.push_back(Shift{offset, removed});
+        }
+        p = scan::find_splice_or_trigraph(copied, end);
+    }
+    text.append(copied, end);
+    return spliced;
+}
+
+size_t SplicedText::shift_index(uint32_t offset) const {
+    auto shift = std::upper_bound(shifts_.begin(), shifts_.end(), offset,
+                                  [](uint32_t value, const Shift& s) { return value < s.offset; });
+    return shift - shifts_.begin() - 1;
+}
+
+uint32_t SplicedText::to_source(uint32_t offset) const {
+    return offset + shifts_[shift_index(offset)].removed;
+}
+
+uint32_t SplicedText::to_spliced(uint32_t offset) const {
+    auto next = std::upper_bound(shifts_.begin(), shifts_.end(), offset,
+                                 [](uint32_t value, const Shift& s) { return value < s.offset + s.removed; });
+    uint32_t spliced = offset - next[-1].removed;
+    return next == shifts_.end() ? spliced : std::min(spliced, next->offset);
+}
+
+} // namespace lexer
@@ -0,0 +1,74 @@
+#ifndef SPLICED_TEXT_H
+#define SPLICED_TEXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lexer {
+
+// Source text after translation phases 1 and 2 (C99 5.1.1.2): trigraphs
+// replaced by the character they stand for, and every backslash-newline
+// deleted. Most files contain neither, so build() returns nullptr for them
+// after a single vectorized scan and the lexer reads the source directly;
+// only the rest pay for a copy and an offset map.
+class SplicedText {
+public:
+    // The spliced text of source, or nullptr if it is the source itself.
+    static std::unique_ptr<SplicedText> build(std::string_view source);
+
+    // Followed by a NUL sentinel, like SourceBuffer::text().
+    std::string_view text() const { return std::string_view(text_.data(), text_.size()); }
+
+    // Source offset of the byte at offset in the spliced text: the first
+    // byte of its trigraph, or the byte after any splices before it. The
+    // end of the text maps to the end of the source.
+    uint32_t to_source(uint32_t offset) const;
+
+    // to_source() for lookups that mostly move forward, as a lexer's do: hint
+    // is the index of the shift used last (initially 0), so the next lookup
+    // usually checks one or two entries instead of binary searching.
+    uint32_t to_source(uint32_t offset, size_t& hint) const {
+        size_t i = hint;
+        if (shifts_[i].offset > offset || (i + 4 < shifts_.size() && shifts_[i + 4].offset <= offset)) {
+            i = shift_index(offset);
+        } else {
+            while (i + 1 < shifts_.size() && shifts_[i + 1].offset <= offset) {
+                ++i;
+            }
+        }
+        hint = i;
+        return offset + shifts_[i].removed;
+    }
+
+    // Offset in the spliced text of the source byte at offset. Offsets inside
+    // a splice, or past the first byte of a trigraph, map to the character
+    // after it.
+    uint32_t to_spliced(uint32_t offset) const;
+
+    size_t memory_usage() const {
+        return text_.capacity() + shifts_.capacity() * sizeof(Shift);
+    }
+
+private:
+    // From spliced offset `offset` on, source offsets are `removed` further
+    struct Shift {
+        uint32_t offset;
+        uint32_t removed;
+    };
+
+    SplicedText() = default;
+
+    // Index of the last shift at or before offset
+    size_t shift_index(uint32_t offset) const;
+
+    std::string text_;
+    std::vector<Shift> shifts_; // Increasing offsets; the first is {0, 0}
+};
+
+} // namespace lexer
+
+#endif // SPLICED_TEXT_H
@@ -0,0 +1,79 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+
+namespace lexer {
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. Elements are written and read in place: the producer fills
+// the slot back() returns and publishes it with push(); the consumer reads
+// front() and hands the slot back with pop(). Slots are reused rather than
+// reconstructed, so an element that owns memory (a vector, say) keeps it from
+// one trip round the ring to the next.
+//
+// Each index is written by one side only, and each side keeps a copy of the
+// other's, so the two threads only touch each other's cache line when the
+// queue looks full or empty.
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SpscQueue(size_t capacity)
+        : slots_(std::make_unique<T[]>(std::bit_ceil(capacity ? capacity : 1))),
+          mask_(std::bit_ceil(capacity ? capacity : 1) - 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Producer: the next free slot, or nullptr if the queue is full.
+    T* back() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) {
+                return nullptr;
+            }
+        }
+        return &slots_[tail & mask_];
+    }
+
+    // Producer: publishes the slot back() returned.
+    void push() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer: the oldest published slot, or nullptr if the queue is empty.
+    T* front() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return nullptr;
+            }
+        }
+        return &slots_[head & mask_];
+    }
+
+    // Consumer: frees the slot front() returned for the producer to reuse.
+    void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    std::unique_ptr<T[]> slots_;
+    const size_t mask_;
+
+    // Indices only ever grow; a slot is index & mask_
+    alignas(kCacheLine) std::atomic<size_t> head_{0}; // Next slot to read; written by the consumer
+    size_t tail_cache_ = 0;                           // The consumer's last look at tail_
+    alignas(kCacheLine) std::atomic<size_t> tail_{0}; // Next slot to fill; written by the producer
+    size_t head_cache_ = 0;                           // The producer's last look at head_
+};
+
+} // namespace lexer
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,102 @@
+#include "streaming_lexer.h"
+#include "scan.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace lexer {
+
+StreamingLexer::StreamingLexer(ReadFunction read, size_t window_size, IdentifierTable* identifiers)
+    : read_(std::move(read)), identifiers_(identifiers),
+      window_(new char[std::max<size_t>(window_size, 64) + 1]),
+      capacity_(std::max<size_t>(window_size, 64)) {
+    window_[0] = '\0';
+    lexer_.emplace(SourceBuffer::borrow(std::string_view(window_.get(), 0)), identifiers_);
+}
+
+StreamingLexer StreamingLexer::from_fd(int fd, size_t window_size, IdentifierTable* identifiers) {
+    return StreamingLexer([fd](char* data, size_t size) -> size_t {
+        for (;;) {
+            ssize_t n = ::read(fd, data, size);
+            if (n >= 0) {
+                return static_cast<size_t>(n);
+            }
+            if (errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "cannot read input");
+            }
+        }
+    }, window_size, identifiers);
+}
+
+Token StreamingLexer::next_token() {
+    uint32_t resume = lexer_->position();
+    Token token = lexer_->next_token();
+
+    // A token ending closer than the lexer's lookahead to the end of the
+    // window might continue in input not read yet
+    while (!input_done_ && lexer_->lookahead_end() > size_) {
+        lexer_->reset(resume);
+        refill();
+        resume = lexer_->position();
+        token = lexer_->next_token();
+    }
+    token.offset += static_cast<uint32_t>(base_);
+    return token;
+}
+
+// Drops the consumed prefix of the window, reads until it is full or the
+// input ends, and restarts the lexer at the same token boundary
+void StreamingLexer::refill() {
+    size_t keep_from = lexer_->position();
+    size_t kept = size_ - keep_from;
+
+    const char* begin = window_.get();
+    const char* last_newline = static_cast<const char*>(memrchr(begin, '\n', keep_from));
+    if (last_newline) {
+        lines_ += scan::count_newlines(begin, last_newline + 1);
+        line_start_ = base_ + (last_newline + 1 - begin);
+    }
+    std::memmove(window_.get(), window_.get() + keep_from, kept);
+    base_ += keep_from;
+    size_ = kept;
+
+    // A token that fills the whole window needs a bigger one
+    if (size_ == capacity_) {
+        std::unique_ptr<char[]> grown(new char[capacity_ * 2 + 1]);
+        std::memcpy(grown.get(), window_.get(), size_);
+        window_ = std::move(grown);
+        capacity_ *= 2;
+    }
+
+    while (size_ < capacity_) {
+        size_t n = read_(window_.get() + size_, capacity_ - size_);
+        if (n == 0) {
+            input_done_ = true;
+            break;
+        }
+        size_ += n;
+    }
+    window_[size_] = '\0';
+
+    if (base_ + size_ > UINT32_MAX) {
+        throw std::length_error("stream too large for 32-bit token offsets");
+    }
+
+    lexer_.emplace(SourceBuffer::borrow(std::string_view(window_.get(), size_)), identifiers_);
+}
+
+SourceLocation StreamingLexer::location(uint32_t offset) const {
+    const char* begin = window_.get();
+    const char* at = begin + (offset - base_);
+    size_t newlines = scan::count_newlines(begin, at);
+
+    const char* newline = static_cast<const char*>(memrchr(begin, '\n', at - begin));
+    size_t line_start = newline ? base_ + (newline + 1 - begin) : line_start_;
+    return SourceLocation{lines_ + newlines + 1, offset - line_start + 1};
+}
+
+} // namespace lexer
@@ -0,0 +1,69 @@
+#ifndef STREAMING_LEXER_H
+#define STREAMING_LEXER_H
+
+#include "lexer.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace lexer {
+
+// Lexes input that arrives in pieces, from a file descriptor or a pull
+// callback, keeping only a sliding window of it in memory. Tokens are lexed
+// straight out of the window; one that runs into the unread part of the
+// input is discarded, the window is compacted and refilled, and the token is
+// lexed again, so tokens straddling chunk boundaries come out exactly as
+// Lexer would produce them.
+//
+// Memory is bounded by the window size, except that a single token (or
+// comment) longer than the window grows it to fit. Token::offset is the
+// offset in the whole stream, which like every Lexer input is limited to
+// 4 GiB.
+class StreamingLexer {
+public:
+    // Copies up to size bytes of input into data and returns how many were
+    // copied; returning 0 signals end of input.
+    using ReadFunction = std::function<size_t(char* data, size_t size)>;
+
+    static constexpr size_t kDefaultWindowSize = 1 << 20;
+
+    explicit StreamingLexer(ReadFunction read, size_t window_size = kDefaultWindowSize,
+                            IdentifierTable* identifiers = nullptr);
+
+    // Reads fd (a pipe, socket or file) until end of input. Does not close it.
+    // Read errors throw std::system_error.
+    static StreamingLexer from_fd(int fd, size_t window_size = kDefaultWindowSize,
+                                  IdentifierTable* identifiers = nullptr);
+
+    // The next token. Its value, if it views the input, and a string
+    // literal's decoded contents are only valid until the following call,
+    // which may slide the window.
+    Token next_token();
+
+    // Line and column of offset, which must lie in the current window (for
+    // example the offset of the token just returned).
+    SourceLocation location(uint32_t offset) const;
+
+    // Current window capacity in bytes.
+    size_t window_size() const { return capacity_; }
+
+private:
+    void refill();
+
+    ReadFunction read_;
+    IdentifierTable* identifiers_;
+    std::unique_ptr<char[]> window_; // capacity_ bytes plus a NUL sentinel
+    size_t capacity_;
+    size_t size_ = 0;       // Bytes of input in the window
+    size_t base_ = 0;       // Stream offset of window_[0]
+    size_t lines_ = 0;      // Newlines before window_[0]
+    size_t line_start_ = 0; // Stream offset of the line containing window_[0]
+    bool input_done_ = false;
+    std::optional<Lexer> lexer_; // Lexes the current window
+};
+
+} // namespace lexer
+
+#endif // STREAMING_LEXER_H
@@ -1,12 +1,13 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
-#include <string>
-#include <variant>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
 
 namespace lexer {
 
-enum class TokenType {
+enum class TokenType : uint8_t {
     // Keywords
     KW_AUTO,
     KW_BREAK,
@@ -45,6 +46,13 @@ enum class TokenType {
     KW__BOOL,
     KW__COMPLEX,
     KW__IMAGINARY,
+    KW__ALIGNAS,       // C11
+    KW__ALIGNOF,
+    KW__ATOMIC,
+    KW__GENERIC,
+    KW__NORETURN,
+    KW__STATIC_ASSERT,
+    KW__THREAD_LOCAL,
 
     // Identifiers
     IDENTIFIER,
@@ -58,6 +66,8 @@ enum class TokenType {
     // Operators
     OP_PLUS,           // +
     OP_MINUS,          // -
+    OP_INCREMENT,      // ++
+    OP_DECREMENT,      // --
     OP_STAR,           // *
     OP_SLASH,          // /
     OP_PERCENT,        // %
@@ -87,14 +97,15 @@ enum class TokenType {
     OP_XOR_ASSIGN,     // ^=
     OP_LEFT_SHIFT_ASSIGN,  // <<=
     OP_RIGHT_SHIFT_ASSIGN, // >>=
+    OP_QUESTION,       // ?
 
     // Delimiters
     DELIMITER_LPAREN,    // (
     DELIMITER_RPAREN,    // )
-    DELIMITER_LBRACE,    // {
-    DELIMITER_RBRACE,    // }
-    DELIMITER_LBRACKET,  // [
-    DELIMITER_RBRACKET,  // ]
+    DELIMITER_LBRACE,    // { <%
+    DELIMITER_RBRACE,    // } %>
+    DELIMITER_LBRACKET,  // [ <:
+    DELIMITER_RBRACKET,  // ] :>
     DELIMITER_COMMA,     // ,
     DELIMITER_SEMICOLON, // ;
     DELIMITER_DOT,       // .
@@ -103,7 +114,11 @@ enum class TokenType {
     DELIMITER_COLON,     // :
 
     // Preprocessor
-    PREPROCESSOR_HASH,   // #
+    PREPROCESSOR_HASH,   // # %:
+    PREPROCESSOR_HASH_HASH, // ## %:%:
+
+    // Comments, only from lexers whose policy keeps them
+    COMMENT,
 
     // End of file
     END_OF_FILE,
@@ -112,14 +127,74 @@ enum class TokenType {
     ERROR_TOKEN
 };
 
+// C99 type of an integer or floating constant (6.4.4.1, 6.4.4.2), chosen
+// from its suffix, base and value for the host's type sizes.
+enum class NumericType : uint8_t {
+    NONE, // Not a numeric constant
+    INT,
+    UNSIGNED_INT,
+    LONG,
+    UNSIGNED_LONG,
+    LONG_LONG,
+    UNSIGNED_LONG_LONG,
+    FLOAT,
+    DOUBLE,
+    LONG_DOUBLE
+};
+
+// Bits of Token::flags. The lexer only sets WIDE; the rest describe a
+// token's surroundings and are filled in by the preprocessor.
+enum class TokenFlag : uint8_t {
+    WIDE = 1 << 0,          // String or character literal with an L prefix
+    START_OF_LINE = 1 << 1, // First token on its line
+    LEADING_SPACE = 1 << 2, // Preceded by whitespace or a comment
+    NO_EXPAND = 1 << 3,     // Identifier that names a macro but must not be replaced
+    PARAMETER = 1 << 4      // In a macro body: stands for argument number `ident`
+};
+
+// Contents of a string literal after escape decoding, without the
+// terminating NUL. Narrow literals hold bytes, with universal character names
+// encoded as UTF-8; wide (L"...") literals hold 4-byte wchar_t code units in
+// host byte order. Literals without escapes may view the source directly, so
+// bytes is not necessarily NUL-terminated.
+struct StringLiteral {
+    std::string_view bytes;
+    bool wide = false;
+
+    // Number of code units
+    size_t length() const { return wide ? bytes.size() / 4 : bytes.size(); }
+};
+
+// A token's value is a non-owning view of its spelling in the buffer held by
+// the Lexer that produced it (or of a diagnostic for ERROR_TOKEN), so tokens
+// must not outlive that Lexer. Its position is the byte offset of its first
+// character; SourceBuffer::location() turns that into a line and column.
+// Identifiers and keywords lexed with an IdentifierTable also carry their
+// interned ID, which compares and hashes as a plain integer. Numeric
+// constants carry their type and decoded value instead, so consumers never
+// parse the spelling again; long double constants hold the nearest double.
+// Character constants are decoded to their int (or wchar_t) value, and string
+// literals point at their decoded contents, which the Lexer owns.
 struct Token {
     TokenType type;
-    std::string value;
-    size_t line;
-    size_t column;
+    NumericType numeric = NumericType::NONE;
+    uint8_t flags = 0; // TokenFlag bits
+    uint32_t offset;
+    std::string_view value;
+    union {
+        uint32_t ident = 0;  // IdentifierId of an identifier or keyword, 0 if not interned
+        uint64_t int_value;  // CONSTANT_INT, as unsigned long long; CONSTANT_CHAR, sign-extended
+        double float_value;  // CONSTANT_FLOAT
+        const StringLiteral* string; // CONSTANT_STRING; an ERROR_TOKEN's source text, if
+                                     // a Lexer made it
+    };
+
+    Token(TokenType t, std::string_view v, uint32_t o)
+        : type(t), offset(o), value(v) {}
 
-    Token(TokenType t, const std::string& v, size_t l, size_t c)
-        : type(t), value(v), line(l), column(c) {}
+    bool has(TokenFlag flag) const { return flags & static_cast<uint8_t>(flag); }
+    void set(TokenFlag flag) { flags |= static_cast<uint8_t>(flag); }
+    void clear(TokenFlag flag) { flags &= ~static_cast<uint8_t>(flag); }
 };
 
 } // namespace lexer
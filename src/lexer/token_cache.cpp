@@ -0,0 +1,285 @@
+#include "token_cache.h"
+#include "hash.h"
+#include "lexer.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace lexer {
+
+namespace {
+
+// Bump whenever the layout or the numbering of TokenType changes, so stale
+// entries are rejected instead of misread.
+constexpr uint32_t kFormatVersion = 2;
+
+// Numbers the temporary files of this process, so threads storing the same
+// entry at once never write to one file
+std::atomic<uint64_t> temp_counter{0};
+
+struct Header {
+    char magic[4];          // "LXTC"
+    uint32_t version;       // kFormatVersion, in host byte order
+    uint64_t content_hash;  // hash_bytes() of the source
+    uint64_t source_size;
+    uint32_t token_count;   // Followed by one kind byte per token
+    uint32_t string_count;  // Then the string table: varint length and bytes per string
+    uint64_t strings_size;  // Then the token bodies, up to the end of the data
+};
+
+// Kinds whose spelling goes in the string table
+bool has_table_spelling(TokenType type) {
+    return type <= TokenType::CONSTANT_STRING;
+}
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool get_varint(const unsigned char*& p, const unsigned char* end, uint32_t& value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        unsigned char byte = *p++;
+        result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            if (result > UINT32_MAX) {
+                return false;
+            }
+            value = static_cast<uint32_t>(result);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<TokenStream> decode(std::string_view data, std::shared_ptr<const SourceBuffer> buffer,
+                                  uint64_t content_hash, IdentifierTable* identifiers) {
+    Header header;
+    if (data.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, "LXTC", 4) != 0 || header.version != kFormatVersion ||
+        header.content_hash != content_hash || header.source_size != buffer->size()) {
+        return std::nullopt;
+    }
+
+    auto p = reinterpret_cast<const unsigned char*>(data.data()) + sizeof(header);
+    auto end = reinterpret_cast<const unsigned char*>(data.data()) + data.size();
+    if (header.token_count == 0 || header.token_count > static_cast<size_t>(end - p)) {
+        return std::nullopt;
+    }
+    const unsigned char* kinds = p;
+    p += header.token_count;
+    if (header.strings_size > static_cast<size_t>(end - p)) {
+        return std::nullopt;
+    }
+
+    const unsigned char* strings_end = p + header.strings_size;
+    std::vector<std::string_view> strings;
+    strings.reserve(std::min<size_t>(header.string_count, header.strings_size));
+    for (uint32_t i = 0; i < header.string_count; ++i) {
+        uint32_t length;
+        if (!get_varint(p, strings_end, length) || length > static_cast<size_t>(strings_end - p)) {
+            return std::nullopt;
+        }
+        strings.emplace_back(reinterpret_cast<const char*>(p), length);
+        p += length;
+    }
+    if (p != strings_end) {
+        return std::nullopt;
+    }
+
+    // Spellings are interned on first use, once per entry rather than per token
+    std::vector<IdentifierId> ids(identifiers ? strings.size() : 0, kNoIdentifier);
+
+    const std::string_view text = buffer->text();
+    const uint64_t size = text.size();
+    TokenStream tokens(std::move(buffer), identifiers != nullptr);
+    tokens.reserve(header.token_count);
+    uint64_t previous_end = 0;
+    for (uint32_t i = 0; i < header.token_count; ++i) {
+        if (kinds[i] > static_cast<uint8_t>(TokenType::ERROR_TOKEN)) {
+            return std::nullopt;
+        }
+        TokenType type = static_cast<TokenType>(kinds[i]);
+
+        uint32_t gap, value;
+        if (!get_varint(p, end, gap) || !get_varint(p, end, value)) {
+            return std::nullopt;
+        }
+        uint32_t length = value;
+        IdentifierId ident = kNoIdentifier;
+        if (has_table_spelling(type)) {
+            if (value >= strings.size()) {
+                return std::nullopt;
+            }
+            length = static_cast<uint32_t>(strings[value].size());
+            if (identifiers && type <= TokenType::IDENTIFIER) {
+                if (ids[value] == kNoIdentifier) {
+                    ids[value] = identifiers->intern(strings[value]);
+                }
+                ident = ids[value];
+            }
+        }
+
+        uint64_t offset = previous_end + gap;
+        if (offset + length > size) {
+            return std::nullopt;
+        }
+        // The hash can collide, so spellings that give tokens their value and
+        // identity must be those of the source
+        if (has_table_spelling(type) &&
+            std::memcmp(strings[value].data(), text.data() + offset, length) != 0) {
+            return std::nullopt;
+        }
+        tokens.push_back(type, static_cast<uint32_t>(offset), length, ident);
+        previous_end = offset + length;
+    }
+
+    if (p != end || tokens.kind(tokens.size() - 1) != TokenType::END_OF_FILE ||
+        tokens.offset(tokens.size() - 1) != size) {
+        return std::nullopt;
+    }
+    return tokens;
+}
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void write_file(const std::string& path, std::string_view data) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw_errno("cannot create " + path);
+    }
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int error = errno;
+            ::close(fd);
+            ::unlink(path.c_str());
+            throw std::system_error(error, std::generic_category(), "cannot write " + path);
+        }
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    if (::close(fd) != 0) {
+        int error = errno;
+        ::unlink(path.c_str());
+        throw std::system_error(error, std::generic_category(), "cannot write " + path);
+    }
+}
+
+} // namespace
+
+std::string encode_tokens(const TokenStream& tokens) {
+    // Number the distinct spellings in order of first use
+    std::unordered_map<std::string_view, uint32_t> string_index;
+    std::vector<std::string_view> strings;
+    std::string body;
+    body.reserve(tokens.size() * 3);
+    uint64_t previous_end = 0;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        put_varint(body, tokens.offset(i) - previous_end);
+        if (has_table_spelling(tokens.kind(i))) {
+            std::string_view spelling = tokens.spelling(i);
+            auto [it, inserted] = string_index.try_emplace(spelling, static_cast<uint32_t>(strings.size()));
+            if (inserted) {
+                strings.push_back(spelling);
+            }
+            put_varint(body, it->second);
+        } else {
+            put_varint(body, tokens.length(i));
+        }
+        previous_end = uint64_t{tokens.offset(i)} + tokens.length(i);
+    }
+
+    std::string table;
+    for (std::string_view spelling : strings) {
+        put_varint(table, spelling.size());
+        table.append(spelling);
+    }
+
+    const SourceBuffer& buffer = *tokens.buffer();
+    Header header{{'L', 'X', 'T', 'C'}, kFormatVersion, hash_bytes(buffer.text()), buffer.size(),
+                  static_cast<uint32_t>(tokens.size()), static_cast<uint32_t>(strings.size()),
+                  table.size()};
+
+    std::string out;
+    out.reserve(sizeof(header) + tokens.size() + table.size() + body.size());
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        out.push_back(static_cast<char>(tokens.kind(i)));
+    }
+    out.append(table);
+    out.append(body);
+    return out;
+}
+
+std::optional<TokenStream> decode_tokens(std::string_view data,
+                                         std::shared_ptr<const SourceBuffer> buffer,
+                                         IdentifierTable* identifiers) {
+    uint64_t content_hash = hash_bytes(buffer->text());
+    return decode(data, std::move(buffer), content_hash, identifiers);
+}
+
+std::optional<TokenStream> TokenCache::load(std::shared_ptr<const SourceBuffer> buffer,
+                                            IdentifierTable* identifiers) const {
+    uint64_t content_hash = hash_bytes(buffer->text());
+    std::shared_ptr<const SourceBuffer> entry;
+    try {
+        entry = SourceBuffer::from_file(path(content_hash));
+    } catch (const std::system_error&) {
+        return std::nullopt;
+    }
+    return decode(entry->text(), std::move(buffer), content_hash, identifiers);
+}
+
+void TokenCache::store(const TokenStream& tokens) const {
+    std::string data = encode_tokens(tokens);
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    std::string final_path = path(header.content_hash);
+    std::string temp_path = final_path + ".tmp." + std::to_string(::getpid()) + "." +
+                            std::to_string(temp_counter.fetch_add(1, std::memory_order_relaxed));
+
+    write_file(temp_path, data);
+    if (::rename(temp_path.c_str(), final_path.c_str()) != 0) {
+        int error = errno;
+        ::unlink(temp_path.c_str());
+        throw std::system_error(error, std::generic_category(), "cannot rename " + temp_path);
+    }
+}
+
+TokenStream TokenCache::tokenize(std::shared_ptr<const SourceBuffer> buffer,
+                                 IdentifierTable* identifiers) const {
+    if (std::optional<TokenStream> cached = load(buffer, identifiers)) {
+        return std::move(*cached);
+    }
+    TokenStream tokens = Lexer(std::move(buffer), identifiers).tokenize_all();
+    store(tokens);
+    return tokens;
+}
+
+std::string TokenCache::path(uint64_t content_hash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.tokens", static_cast<unsigned long long>(content_hash));
+    return directory_ + "/" + name;
+}
+
+} // namespace lexer
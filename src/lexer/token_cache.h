@@ -0,0 +1,61 @@
+#ifndef TOKEN_CACHE_H
+#define TOKEN_CACHE_H
+
+#include "identifier_table.h"
+#include "source_buffer.h"
+#include "token_stream.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace lexer {
+
+// Serializes a buffer's complete token stream. The format stores one byte of
+// kind per token, the gap since the previous token's end as a varint, and
+// either a varint length or, for identifiers, keywords and literals, a varint
+// index into a table holding each distinct spelling once. A typical token
+// takes three or four bytes, against nine in a TokenStream.
+std::string encode_tokens(const TokenStream& tokens);
+
+// Rebuilds the stream encode_tokens() produced for buffer. With identifiers,
+// each distinct spelling in the table is interned once and its ID shared by
+// all of its tokens. Returns nullopt if data is not a well-formed encoding of
+// a stream over a buffer of this size and content hash.
+std::optional<TokenStream> decode_tokens(std::string_view data,
+                                         std::shared_ptr<const SourceBuffer> buffer,
+                                         IdentifierTable* identifiers = nullptr);
+
+// A directory of encoded token streams named after the content hash of the
+// source they were lexed from, so unchanged files are never lexed twice.
+// Entries are written to a temporary name and renamed into place, so
+// concurrent builds sharing a directory only ever see complete files.
+class TokenCache {
+public:
+    // The directory must exist.
+    explicit TokenCache(std::string directory) : directory_(std::move(directory)) {}
+
+    // Memory-maps and decodes the entry for buffer's content, or returns
+    // nullopt if there is none or it cannot be used.
+    std::optional<TokenStream> load(std::shared_ptr<const SourceBuffer> buffer,
+                                    IdentifierTable* identifiers = nullptr) const;
+
+    // Writes the entry for tokens' buffer. Throws std::system_error if the
+    // file cannot be written.
+    void store(const TokenStream& tokens) const;
+
+    // The cached stream for buffer, lexing and storing it on a miss.
+    TokenStream tokenize(std::shared_ptr<const SourceBuffer> buffer,
+                         IdentifierTable* identifiers = nullptr) const;
+
+    // Path of the entry for content with this hash.
+    std::string path(uint64_t content_hash) const;
+
+private:
+    std::string directory_;
+};
+
+} // namespace lexer
+
+#endif // TOKEN_CACHE_H
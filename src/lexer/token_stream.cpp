@@ -0,0 +1,87 @@
+#include "token_stream.h"
+#include <algorithm>
+
+namespace lexer {
+
+namespace {
+
+// Overwrites v[first, last) with the elements of with, growing or shrinking
+// the hole in place so the tail is moved at most once
+template <typename T>
+void replace_range(std::vector<T>& v, size_t first, size_t last, const std::vector<T>& with) {
+    size_t removed = last - first;
+    if (with.size() > removed) {
+        v.insert(v.begin() + last, with.size() - removed, T());
+    } else {
+        v.erase(v.begin() + first + with.size(), v.begin() + last);
+    }
+    std::copy(with.begin(), with.end(), v.begin() + first);
+}
+
+} // namespace
+
+static_assert(static_cast<int>(TokenType::ERROR_TOKEN) <= UINT8_MAX,
+              "TokenStream stores token kinds in one byte");
+
+std::string_view TokenStream::value(size_t i) const {
+    std::string_view text = spelling(i);
+    switch (kind(i)) {
+        case TokenType::CONSTANT_STRING:
+        case TokenType::CONSTANT_CHAR: {
+            size_t prefix = text[0] == 'L' ? 1 : 0;
+            return text.substr(prefix + 1, text.size() - prefix - 2);
+        }
+        default:
+            return text;
+    }
+}
+
+void TokenStream::reserve(size_t n) {
+    kinds_.reserve(n);
+    offsets_.reserve(n);
+    lengths_.reserve(n);
+    if (with_identifiers_) {
+        idents_.reserve(n);
+    }
+}
+
+void TokenStream::append(const TokenStream& other, size_t first, size_t last) {
+    kinds_.insert(kinds_.end(), other.kinds_.begin() + first, other.kinds_.begin() + last);
+    offsets_.insert(offsets_.end(), other.offsets_.begin() + first, other.offsets_.begin() + last);
+    lengths_.insert(lengths_.end(), other.lengths_.begin() + first, other.lengths_.begin() + last);
+    if (with_identifiers_) {
+        idents_.insert(idents_.end(), other.idents_.begin() + first, other.idents_.begin() + last);
+    }
+}
+
+void TokenStream::replace(size_t first, size_t last, const TokenStream& replacement,
+                          int64_t delta) {
+    replace_range(kinds_, first, last, replacement.kinds_);
+    replace_range(offsets_, first, last, replacement.offsets_);
+    replace_range(lengths_, first, last, replacement.lengths_);
+    if (with_identifiers_) {
+        replace_range(idents_, first, last, replacement.idents_);
+    }
+    buffer_ = replacement.buffer_;
+
+    if (delta == 0) {
+        return;
+    }
+    uint32_t shift = static_cast<uint32_t>(delta); // Wraps correctly for negative deltas
+    for (size_t i = first + replacement.size(); i < offsets_.size(); ++i) {
+        offsets_[i] += shift;
+    }
+}
+
+size_t TokenStream::lower_bound(uint32_t offset) const {
+    return std::lower_bound(offsets_.begin(), offsets_.end(), offset) - offsets_.begin();
+}
+
+size_t TokenStream::memory_usage() const {
+    return kinds_.capacity() * sizeof(uint8_t) +
+           offsets_.capacity() * sizeof(uint32_t) +
+           lengths_.capacity() * sizeof(uint32_t) +
+           idents_.capacity() * sizeof(IdentifierId);
+}
+
+} // namespace lexer
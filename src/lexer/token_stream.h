@@ -0,0 +1,93 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include "token.h"
+#include "identifier_table.h"
+#include "source_buffer.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace lexer {
+
+// A whole buffer's tokens stored as parallel arrays: one byte of kind and two
+// 32-bit words (offset, length) per token. Spellings are views into the
+// shared source buffer, and line numbers come from the buffer's newline
+// table, which is only built the first time a line is asked for. The last token is always
+// END_OF_FILE, mirroring what Lexer::next_token() returns.
+//
+// A stream lexed with an IdentifierTable also keeps each token's
+// IdentifierId in a fourth array.
+class TokenStream {
+public:
+    explicit TokenStream(std::shared_ptr<const SourceBuffer> buffer, bool with_identifiers = false)
+        : buffer_(std::move(buffer)), with_identifiers_(with_identifiers) {}
+
+    size_t size() const { return kinds_.size(); }
+    bool empty() const { return kinds_.empty(); }
+
+    TokenType kind(size_t i) const { return static_cast<TokenType>(kinds_[i]); }
+    uint32_t offset(size_t i) const { return offsets_[i]; }
+    uint32_t length(size_t i) const { return lengths_[i]; }
+
+    // Whether ident() is recorded; otherwise it is always kNoIdentifier.
+    bool has_identifiers() const { return with_identifiers_; }
+    IdentifierId ident(size_t i) const { return with_identifiers_ ? idents_[i] : kNoIdentifier; }
+
+    // The token's full source text, including the quotes of literals.
+    std::string_view spelling(size_t i) const {
+        return buffer_->text().substr(offsets_[i], lengths_[i]);
+    }
+
+    // spelling() less the quotes and prefix of literals, which is Token::value
+    // unless the token contains a line splice or trigraph: this is a slice of
+    // the raw buffer, where Token::value holds the spliced spelling.
+    // ERROR_TOKEN entries yield the offending source text rather than a
+    // diagnostic message.
+    std::string_view value(size_t i) const;
+
+    // 1-based line and column of the token's first character.
+    SourceLocation location(size_t i) const { return buffer_->location(offsets_[i]); }
+
+    const std::shared_ptr<const SourceBuffer>& buffer() const { return buffer_; }
+
+    void reserve(size_t n);
+    void push_back(TokenType type, uint32_t offset, uint32_t length,
+                   IdentifierId ident = kNoIdentifier) {
+        kinds_.push_back(static_cast<uint8_t>(type));
+        offsets_.push_back(offset);
+        lengths_.push_back(length);
+        if (with_identifiers_) {
+            idents_.push_back(ident);
+        }
+    }
+
+    // Appends tokens [first, last) of other, which must share this buffer
+    // and record identifiers if this stream does.
+    void append(const TokenStream& other, size_t first, size_t last);
+
+    // Replaces tokens [first, last) with all of replacement's tokens and
+    // switches to its buffer, adding delta to the offsets of the tokens after
+    // them. replacement must record identifiers if this stream does. Used to
+    // patch a stream after an edit to its source.
+    void replace(size_t first, size_t last, const TokenStream& replacement, int64_t delta);
+
+    // Index of the first token whose offset is not less than offset.
+    size_t lower_bound(uint32_t offset) const;
+
+    // Bytes held by the token arrays.
+    size_t memory_usage() const;
+
+private:
+    std::shared_ptr<const SourceBuffer> buffer_;
+    std::vector<uint8_t> kinds_;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> lengths_;
+    std::vector<IdentifierId> idents_; // Empty unless with_identifiers_
+    bool with_identifiers_;
+};
+
+} // namespace lexer
+
+#endif // TOKEN_STREAM_H
@@ -0,0 +1,441 @@
+#include "ast.h"
+#include "../lexer/punctuators.h"
+#include <cinttypes>
+#include <cstdio>
+
+namespace parser {
+
+namespace {
+
+std::string_view operator_spelling(lexer::TokenType type) {
+    for (const lexer::Punctuator& punctuator : lexer::c99_punctuators) {
+        if (punctuator.type == type) {
+            return punctuator.spelling;
+        }
+    }
+    return "?";
+}
+
+constexpr std::pair<NodeFlag, const char*> kFlagNames[] = {
+    {NodeFlag::TYPEDEF, "typedef"},   {NodeFlag::EXTERN, "extern"},
+    {NodeFlag::STATIC, "static"},     {NodeFlag::AUTO, "auto"},
+    {NodeFlag::REGISTER, "register"}, {NodeFlag::INLINE, "inline"},
+    {NodeFlag::CONST, "const"},       {NodeFlag::RESTRICT, "restrict"},
+    {NodeFlag::VOLATILE, "volatile"}, {NodeFlag::STAR, "*"},
+};
+
+constexpr std::pair<TypeSpec, const char*> kTypeSpecNames[] = {
+    {TypeSpec::SIGNED, "signed"},   {TypeSpec::UNSIGNED, "unsigned"},
+    {TypeSpec::COMPLEX, "_Complex"}, {TypeSpec::IMAGINARY, "_Imaginary"},
+    {TypeSpec::VOID, "void"},       {TypeSpec::BOOL, "_Bool"},
+    {TypeSpec::CHAR, "char"},       {TypeSpec::SHORT, "short"},
+    {TypeSpec::LONG, "long"},       {TypeSpec::LONG_LONG, "long"},
+    {TypeSpec::INT, "int"},         {TypeSpec::FLOAT, "float"},
+    {TypeSpec::DOUBLE, "double"},
+};
+
+class Dumper {
+public:
+    Dumper(const Ast& ast, const lexer::IdentifierTable& identifiers, std::string& out)
+        : ast_(ast), identifiers_(identifiers), out_(out) {}
+
+    void dump(NodeId id) {
+        if (id == kNoNode) {
+            out_ += '-';
+            return;
+        }
+        const Node& node = ast_[id];
+        switch (node.kind) {
+        case NodeKind::NONE:
+            open("none");
+            break;
+        case NodeKind::IDENTIFIER:
+        case NodeKind::TYPEDEF_NAME:
+            name(node.a);
+            return;
+        case NodeKind::INT_CONSTANT:
+        case NodeKind::CHAR_CONSTANT:
+        case NodeKind::FLOAT_CONSTANT:
+            constant(node);
+            return;
+        case NodeKind::STRING_LITERAL:
+            string(node);
+            return;
+        case NodeKind::UNARY:
+            open(operator_spelling(node.token_type()));
+            children({node.a});
+            break;
+        case NodeKind::BINARY:
+            open(operator_spelling(node.token_type()));
+            children({node.a, node.b});
+            break;
+        case NodeKind::POSTFIX:
+            open("post");
+            out_ += operator_spelling(node.token_type());
+            children({node.a});
+            break;
+        case NodeKind::CONDITIONAL:
+            open("?");
+            children({node.a, ast_.extra(node.b), ast_.extra(node.b + 1)});
+            break;
+        case NodeKind::CALL:
+            open("call");
+            children({node.a});
+            list(node.b);
+            break;
+        case NodeKind::SUBSCRIPT:
+            open("[]");
+            children({node.a, node.b});
+            break;
+        case NodeKind::MEMBER:
+            open(operator_spelling(node.token_type()));
+            children({node.a});
+            out_ += ' ';
+            name(node.b);
+            break;
+        case NodeKind::CAST:
+            open("cast");
+            children({node.a, node.b});
+            break;
+        case NodeKind::SIZEOF_EXPRESSION:
+        case NodeKind::SIZEOF_TYPE:
+            open("sizeof");
+            children({node.a});
+            break;
+        case NodeKind::COMPOUND_LITERAL:
+            open("literal");
+            children({node.a, node.b});
+            break;
+        case NodeKind::INITIALIZER_LIST:
+            out_ += '{';
+            for (size_t i = 0; NodeId item : ast_.list(node.b)) {
+                out_ += i++ ? " " : "";
+                dump(item);
+            }
+            out_ += '}';
+            return;
+        case NodeKind::DESIGNATED:
+            open("=");
+            list(node.a);
+            children({node.b});
+            break;
+        case NodeKind::FIELD_DESIGNATOR:
+            out_ += '.';
+            name(node.a);
+            return;
+        case NodeKind::INDEX_DESIGNATOR:
+            out_ += '[';
+            dump(node.a);
+            out_ += ']';
+            return;
+        case NodeKind::COMPOUND:
+            open("compound");
+            list(node.b);
+            break;
+        case NodeKind::EXPRESSION:
+            open("expr");
+            if (node.a != kNoNode) {
+                children({node.a});
+            }
+            break;
+        case NodeKind::IF:
+            open("if");
+            children({node.a, ast_.extra(node.b)});
+            if (ast_.extra(node.b + 1) != kNoNode) {
+                children({ast_.extra(node.b + 1)});
+            }
+            break;
+        case NodeKind::WHILE:
+            open("while");
+            children({node.a, node.b});
+            break;
+        case NodeKind::DO:
+            open("do");
+            children({node.a, node.b});
+            break;
+        case NodeKind::FOR:
+            open("for");
+            children({ast_.extra(node.a), ast_.extra(node.a + 1), ast_.extra(node.a + 2), node.b});
+            break;
+        case NodeKind::SWITCH:
+            open("switch");
+            children({node.a, node.b});
+            break;
+        case NodeKind::CASE:
+            open("case");
+            children({node.a, node.b});
+            break;
+        case NodeKind::DEFAULT:
+            open("default");
+            children({node.b});
+            break;
+        case NodeKind::LABEL:
+            open("label ");
+            name(node.a);
+            children({node.b});
+            break;
+        case NodeKind::GOTO:
+            open("goto ");
+            name(node.a);
+            break;
+        case NodeKind::CONTINUE:
+            open("continue");
+            break;
+        case NodeKind::BREAK:
+            open("break");
+            break;
+        case NodeKind::RETURN:
+            open("return");
+            if (node.a != kNoNode) {
+                children({node.a});
+            }
+            break;
+        case NodeKind::TRANSLATION_UNIT:
+            for (size_t i = 0; NodeId item : ast_.list(node.b)) {
+                out_ += i++ ? "\n" : "";
+                dump(item);
+            }
+            return;
+        case NodeKind::DECLARATION:
+            open("declaration");
+            children({node.a});
+            list(node.b);
+            break;
+        case NodeKind::FUNCTION_DEFINITION:
+            open("function");
+            children({node.a, ast_.extra(node.b), ast_.extra(node.b + 1)});
+            break;
+        case NodeKind::DECL_SPECIFIERS:
+            specifiers(node);
+            break;
+        case NodeKind::INIT_DECLARATOR:
+            if (node.b == kNoNode) {
+                dump(node.a);
+                return;
+            }
+            open("init");
+            children({node.a, node.b});
+            break;
+        case NodeKind::BITFIELD:
+            open("bitfield");
+            children({node.a, node.b});
+            break;
+        case NodeKind::DECLARATOR:
+            open("declarator");
+            if (node.a != lexer::kNoIdentifier) {
+                out_ += ' ';
+                name(node.a);
+            }
+            for (NodeId derived = node.b; derived != kNoNode; derived = ast_[derived].a) {
+                out_ += ' ';
+                derivation(ast_[derived]);
+            }
+            break;
+        case NodeKind::POINTER:
+        case NodeKind::ARRAY:
+        case NodeKind::FUNCTION:
+            derivation(node);
+            return;
+        case NodeKind::PARAMETER:
+            open("parameter");
+            if (node.a != kNoNode) {
+                children({node.a});
+            }
+            children({node.b});
+            break;
+        case NodeKind::TYPE_NAME:
+            open("type");
+            children({node.a});
+            if (node.b != kNoNode) {
+                children({node.b});
+            }
+            break;
+        case NodeKind::STRUCT:
+        case NodeKind::UNION:
+        case NodeKind::ENUM:
+            open(node.kind == NodeKind::STRUCT  ? "struct"
+                 : node.kind == NodeKind::UNION ? "union"
+                                                : "enum");
+            out_ += ' ';
+            if (node.a != lexer::kNoIdentifier) {
+                name(node.a);
+            } else {
+                out_ += '-';
+            }
+            if (node.has(NodeFlag::DEFINITION)) {
+                out_ += " {";
+                list(node.b);
+                out_ += " }";
+            }
+            break;
+        case NodeKind::ENUMERATOR:
+            if (node.b == kNoNode) {
+                name(node.a);
+                return;
+            }
+            out_ += '(';
+            name(node.a);
+            children({node.b});
+            break;
+        case NodeKind::ERROR:
+            out_ += "(error)";
+            return;
+        }
+        out_ += ')';
+    }
+
+private:
+    void open(std::string_view head) {
+        out_ += '(';
+        out_ += head;
+    }
+
+    void children(std::initializer_list<NodeId> ids) {
+        for (NodeId id : ids) {
+            out_ += ' ';
+            dump(id);
+        }
+    }
+
+    void list(uint32_t index) {
+        for (NodeId id : ast_.list(index)) {
+            out_ += ' ';
+            dump(id);
+        }
+    }
+
+    void name(IdentifierId id) { out_ += identifiers_.spelling(id); }
+
+    void constant(const Node& node) {
+        char text[32];
+        if (node.kind == NodeKind::FLOAT_CONSTANT) {
+            std::snprintf(text, sizeof(text), "%g", node.float_value());
+        } else if (node.kind == NodeKind::CHAR_CONSTANT) {
+            std::snprintf(text, sizeof(text), "%" PRId64, static_cast<int64_t>(node.int_value()));
+        } else {
+            std::snprintf(text, sizeof(text), "%" PRIu64, node.int_value());
+        }
+        out_ += text;
+    }
+
+    void flags(const Node& node) {
+        for (auto [flag, spelling] : kFlagNames) {
+            if (node.has(flag)) {
+                out_ += ' ';
+                out_ += spelling;
+            }
+        }
+    }
+
+    void specifiers(const Node& node) {
+        open("specifiers");
+        flags(node);
+        for (auto [spec, spelling] : kTypeSpecNames) {
+            if (node.a & static_cast<uint32_t>(spec)) {
+                out_ += ' ';
+                out_ += spelling;
+            }
+        }
+        if (node.b != kNoNode) {
+            children({node.b});
+        }
+    }
+
+    void derivation(const Node& node) {
+        switch (node.kind) {
+        case NodeKind::POINTER:
+            if (node.flags == 0) {
+                out_ += "pointer";
+                return;
+            }
+            open("pointer");
+            flags(node);
+            break;
+        case NodeKind::ARRAY:
+            open("array");
+            flags(node);
+            if (node.b != kNoNode) {
+                children({node.b});
+            }
+            break;
+        case NodeKind::FUNCTION:
+            open("function");
+            list(node.b);
+            if (node.has(NodeFlag::VARIADIC)) {
+                out_ += " ...";
+            }
+            break;
+        default:
+            out_ += '?';
+            return;
+        }
+        out_ += ')';
+    }
+
+    void string(const Node& node) {
+        if (node.has(NodeFlag::WIDE)) {
+            out_ += 'L';
+        }
+        out_ += '"';
+        for (uint32_t i = node.a; i < node.a + node.b; ++i) {
+            const lexer::StringLiteral* literal = ast_.string(i);
+            for (size_t j = 0; j < literal->length(); ++j) {
+                uint32_t c;
+                if (literal->wide) {
+                    std::memcpy(&c, literal->bytes.data() + 4 * j, 4);
+                } else {
+                    c = static_cast<unsigned char>(literal->bytes[j]);
+                }
+                if (c == '"' || c == '\\') {
+                    out_ += '\\';
+                    out_ += static_cast<char>(c);
+                } else if (c >= 0x20 && c < 0x7f) {
+                    out_ += static_cast<char>(c);
+                } else {
+                    char escape[16];
+                    std::snprintf(escape, sizeof(escape), "\\x%x", c);
+                    out_ += escape;
+                }
+            }
+        }
+        out_ += '"';
+    }
+
+    const Ast& ast_;
+    const lexer::IdentifierTable& identifiers_;
+    std::string& out_;
+};
+
+} // namespace
+
+Ast::Ast() {
+    add(NodeKind::NONE, 0);
+    extra_.push_back(0); // The empty list
+}
+
+void Ast::new_chunk() {
+    chunks_.push_back(std::make_unique_for_overwrite<Node[]>(size_t{1} << kChunkBits));
+}
+
+uint32_t Ast::add_list(std::span<const NodeId> items) {
+    if (items.empty()) {
+        return 0;
+    }
+    uint32_t index = static_cast<uint32_t>(extra_.size());
+    extra_.push_back(static_cast<NodeId>(items.size()));
+    extra_.insert(extra_.end(), items.begin(), items.end());
+    return index;
+}
+
+size_t Ast::memory_usage() const {
+    return chunks_.size() * (sizeof(Node) << kChunkBits) + extra_.capacity() * sizeof(NodeId) +
+           strings_.capacity() * sizeof(const lexer::StringLiteral*);
+}
+
+std::string Ast::dump(NodeId id, const lexer::IdentifierTable& identifiers) const {
+    std::string out;
+    Dumper(*this, identifiers, out).dump(id);
+    return out;
+}
+
+} // namespace parser
@@ -0,0 +1,230 @@
+#ifndef AST_H
+#define AST_H
+
+#include "../lexer/identifier_table.h"
+#include "../lexer/token.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace parser {
+
+using lexer::IdentifierId;
+
+// Index of a node in its Ast. Node 0 is never a real node, so kNoNode marks
+// an absent child.
+using NodeId = uint32_t;
+inline constexpr NodeId kNoNode = 0;
+
+// What a node is, and what its a and b words hold. "list" means b is the
+// index of a list in the Ast's extra array (see Ast::list()); "extra [x, y]"
+// means b indexes that many consecutive NodeIds there (see Ast::extra()).
+enum class NodeKind : uint8_t {
+    NONE,
+
+    // Expressions
+    IDENTIFIER,       // a: IdentifierId
+    INT_CONSTANT,     // a, b: value (Node::int_value()); op: NumericType
+    CHAR_CONSTANT,    // a, b: value, sign-extended; flags: WIDE
+    FLOAT_CONSTANT,   // a, b: value (Node::float_value()); op: NumericType
+    STRING_LITERAL,   // a: first index in Ast::strings(), b: how many adjacent
+                      // literals it concatenates; flags: WIDE if any is
+    UNARY,            // op: + - ! ~ * & ++ --; a: operand
+    POSTFIX,          // op: ++ --; a: operand
+    BINARY,           // op: the operator, assignments and comma included; a, b: operands
+    CONDITIONAL,      // a: condition; extra [then, else]
+    CALL,             // a: callee; list of arguments
+    SUBSCRIPT,        // a: array; b: index
+    MEMBER,           // op: . or ->; a: object; b: IdentifierId of the member
+    CAST,             // a: TYPE_NAME; b: operand
+    SIZEOF_EXPRESSION, // a: operand
+    SIZEOF_TYPE,      // a: TYPE_NAME
+    COMPOUND_LITERAL, // a: TYPE_NAME; b: INITIALIZER_LIST
+
+    // Initializers
+    INITIALIZER_LIST, // list of expressions, INITIALIZER_LISTs and DESIGNATEDs
+    DESIGNATED,       // a: list of designators; b: initializer
+    FIELD_DESIGNATOR, // a: IdentifierId
+    INDEX_DESIGNATOR, // a: constant expression
+
+    // Statements
+    COMPOUND,         // list of declarations and statements
+    EXPRESSION,       // a: expression, kNoNode for a null statement
+    IF,               // a: condition; extra [then, else]
+    WHILE,            // a: condition; b: body
+    DO,               // a: body; b: condition
+    FOR,              // a: extra [init, condition, step], any of them kNoNode,
+                      // init a DECLARATION or expression; b: body
+    SWITCH,           // a: condition; b: body
+    CASE,             // a: constant expression; b: statement
+    DEFAULT,          // b: statement
+    LABEL,            // a: IdentifierId; b: statement
+    GOTO,             // a: IdentifierId
+    CONTINUE,
+    BREAK,
+    RETURN,           // a: expression or kNoNode
+
+    // Declarations
+    TRANSLATION_UNIT,    // list of DECLARATIONs and FUNCTION_DEFINITIONs
+    DECLARATION,         // a: DECL_SPECIFIERS; list of INIT_DECLARATORs, or in a
+                         // struct of DECLARATORs and BITFIELDs
+    FUNCTION_DEFINITION, // a: DECL_SPECIFIERS; extra [DECLARATOR, COMPOUND]
+    DECL_SPECIFIERS,     // flags: storage class, qualifiers, INLINE; a: TypeSpec
+                         // bits; b: STRUCT, UNION, ENUM or TYPEDEF_NAME
+    INIT_DECLARATOR,     // a: DECLARATOR; b: initializer or kNoNode
+    BITFIELD,            // a: DECLARATOR or kNoNode; b: width
+    DECLARATOR,          // a: IdentifierId, kNoIdentifier if abstract; b: the
+                         // first derivation, or kNoNode for the base type itself
+    POINTER,             // flags: qualifiers; a: next derivation
+    ARRAY,               // flags: qualifiers, STATIC, STAR; a: next; b: size or kNoNode
+    FUNCTION,            // flags: VARIADIC, NO_PROTOTYPE; a: next; list of PARAMETERs
+    PARAMETER,           // a: DECL_SPECIFIERS (kNoNode in an identifier list, unless
+                         // an old-style definition declares it); b: DECLARATOR,
+                         // possibly abstract
+    TYPE_NAME,           // a: DECL_SPECIFIERS; b: abstract DECLARATOR or kNoNode
+    STRUCT,              // a: tag or kNoIdentifier; list of member DECLARATIONs;
+    UNION,               //   flags: DEFINITION if it has a body
+    ENUM,                // a: tag or kNoIdentifier; list of ENUMERATORs; flags: DEFINITION
+    ENUMERATOR,          // a: IdentifierId; b: value or kNoNode
+    TYPEDEF_NAME,        // a: IdentifierId
+
+    ERROR                // Stands in for what could not be parsed
+};
+
+// Bits of Node::flags; each applies to the kinds noted above
+enum class NodeFlag : uint16_t {
+    TYPEDEF = 1 << 0,
+    EXTERN = 1 << 1,
+    STATIC = 1 << 2,
+    AUTO = 1 << 3,
+    REGISTER = 1 << 4,
+    INLINE = 1 << 5,
+    CONST = 1 << 6,
+    RESTRICT = 1 << 7,
+    VOLATILE = 1 << 8,
+    VARIADIC = 1 << 9,
+    NO_PROTOTYPE = 1 << 10, // f() or an identifier list
+    STAR = 1 << 11,         // [*]
+    DEFINITION = 1 << 12,
+    WIDE = 1 << 13
+};
+
+// Bits of DECL_SPECIFIERS' a word: the type specifier keywords seen, in any
+// order. Checking that they make a type is left to semantic analysis.
+enum class TypeSpec : uint32_t {
+    VOID = 1 << 0,
+    CHAR = 1 << 1,
+    SHORT = 1 << 2,
+    INT = 1 << 3,
+    LONG = 1 << 4,
+    LONG_LONG = 1 << 5, // A second long
+    FLOAT = 1 << 6,
+    DOUBLE = 1 << 7,
+    SIGNED = 1 << 8,
+    UNSIGNED = 1 << 9,
+    BOOL = 1 << 10,
+    COMPLEX = 1 << 11,
+    IMAGINARY = 1 << 12
+};
+
+// One AST node: a kind, a one-byte operator or literal type, flags, the
+// offset of the token that names it, and two 32-bit words whose meaning
+// depends on the kind. Children are NodeIds, names IdentifierIds, and
+// constants carry their value, so nothing in a node points anywhere.
+struct Node {
+    NodeKind kind;
+    uint8_t op;     // lexer::TokenType or lexer::NumericType, by kind
+    uint16_t flags; // NodeFlag bits
+    uint32_t offset;
+    uint32_t a;
+    uint32_t b;
+
+    bool has(NodeFlag flag) const { return flags & static_cast<uint16_t>(flag); }
+    lexer::TokenType token_type() const { return static_cast<lexer::TokenType>(op); }
+
+    uint64_t int_value() const { return a | static_cast<uint64_t>(b) << 32; }
+    double float_value() const {
+        double value;
+        uint64_t bits = int_value();
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+static_assert(sizeof(Node) == 16);
+
+// The nodes of one parse. They are bump-allocated in fixed-size chunks, so
+// adding one never moves the others and a NodeId is a chunk number and an
+// index into it, and they are freed together with the Ast. Lists of children
+// (arguments, block items, declarators, ...) are runs of NodeIds in a second
+// array, each preceded by its length. String literals are not copied: the
+// AST keeps pointers to the decoded literals the lexer owns, so it must not
+// outlive the tokens it was parsed from.
+class Ast {
+public:
+    static constexpr size_t kChunkBits = 13; // 8192 nodes, 128 KiB
+
+    Ast();
+
+    const Node& operator[](NodeId id) const { return chunks_[id >> kChunkBits][id & kChunkMask]; }
+    Node& operator[](NodeId id) { return chunks_[id >> kChunkBits][id & kChunkMask]; }
+
+    NodeId add(NodeKind kind, uint32_t offset, uint32_t a = 0, uint32_t b = 0, uint8_t op = 0,
+               uint16_t flags = 0) {
+        if ((size_ & kChunkMask) == 0) {
+            new_chunk();
+        }
+        NodeId id = size_++;
+        (*this)[id] = Node{kind, op, flags, offset, a, b};
+        return id;
+    }
+
+    // Stores items as a list and returns its index; index 0 is the empty list.
+    uint32_t add_list(std::span<const NodeId> items);
+    std::span<const NodeId> list(uint32_t index) const {
+        return {extra_.data() + index + 1, extra_[index]};
+    }
+
+    // Stores a fixed number of children and returns the index of the first.
+    uint32_t add_extra(std::initializer_list<NodeId> items) {
+        uint32_t index = static_cast<uint32_t>(extra_.size());
+        extra_.insert(extra_.end(), items);
+        return index;
+    }
+    NodeId extra(uint32_t index) const { return extra_[index]; }
+
+    uint32_t add_string(const lexer::StringLiteral* literal) {
+        strings_.push_back(literal);
+        return static_cast<uint32_t>(strings_.size() - 1);
+    }
+    const lexer::StringLiteral* string(uint32_t index) const { return strings_[index]; }
+
+    // Number of nodes, counting node 0.
+    size_t size() const { return size_; }
+
+    // Bytes held by the node, list and string arrays.
+    size_t memory_usage() const;
+
+    // id and its children as an S-expression, for tests and debugging. A
+    // TRANSLATION_UNIT prints one external declaration per line.
+    std::string dump(NodeId id, const lexer::IdentifierTable& identifiers) const;
+
+private:
+    static constexpr size_t kChunkMask = (size_t{1} << kChunkBits) - 1;
+
+    void new_chunk();
+
+    std::vector<std::unique_ptr<Node[]>> chunks_;
+    NodeId size_ = 0;
+    std::vector<NodeId> extra_;
+    std::vector<const lexer::StringLiteral*> strings_;
+};
+
+} // namespace parser
+
+#endif // AST_H
@@ -0,0 +1,1090 @@
+#include "parser.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <initializer_list>
+
+namespace parser {
+
+using lexer::TokenFlag;
+using semantic::SymbolKind;
+
+namespace {
+
+constexpr uint16_t bit(NodeFlag flag) {
+    return static_cast<uint16_t>(flag);
+}
+
+constexpr uint32_t bit(TypeSpec spec) {
+    return static_cast<uint32_t>(spec);
+}
+
+constexpr uint8_t op(TokenType type) {
+    return static_cast<uint8_t>(type);
+}
+
+// The flag a storage class, function specifier or type qualifier sets
+uint16_t specifier_flag(TokenType type) {
+    switch (type) {
+    case TokenType::KW_TYPEDEF: return bit(NodeFlag::TYPEDEF);
+    case TokenType::KW_EXTERN: return bit(NodeFlag::EXTERN);
+    case TokenType::KW_STATIC: return bit(NodeFlag::STATIC);
+    case TokenType::KW_AUTO: return bit(NodeFlag::AUTO);
+    case TokenType::KW_REGISTER: return bit(NodeFlag::REGISTER);
+    case TokenType::KW_INLINE: return bit(NodeFlag::INLINE);
+    case TokenType::KW_CONST: return bit(NodeFlag::CONST);
+    case TokenType::KW_RESTRICT: return bit(NodeFlag::RESTRICT);
+    case TokenType::KW_VOLATILE: return bit(NodeFlag::VOLATILE);
+    default: return 0;
+    }
+}
+
+constexpr uint16_t kQualifiers =
+    bit(NodeFlag::CONST) | bit(NodeFlag::RESTRICT) | bit(NodeFlag::VOLATILE);
+
+uint16_t qualifier(TokenType type) {
+    return specifier_flag(type) & kQualifiers;
+}
+
+uint32_t type_spec(TokenType type) {
+    switch (type) {
+    case TokenType::KW_VOID: return bit(TypeSpec::VOID);
+    case TokenType::KW_CHAR: return bit(TypeSpec::CHAR);
+    case TokenType::KW_SHORT: return bit(TypeSpec::SHORT);
+    case TokenType::KW_INT: return bit(TypeSpec::INT);
+    case TokenType::KW_LONG: return bit(TypeSpec::LONG);
+    case TokenType::KW_FLOAT: return bit(TypeSpec::FLOAT);
+    case TokenType::KW_DOUBLE: return bit(TypeSpec::DOUBLE);
+    case TokenType::KW_SIGNED: return bit(TypeSpec::SIGNED);
+    case TokenType::KW_UNSIGNED: return bit(TypeSpec::UNSIGNED);
+    case TokenType::KW__BOOL: return bit(TypeSpec::BOOL);
+    case TokenType::KW__COMPLEX: return bit(TypeSpec::COMPLEX);
+    case TokenType::KW__IMAGINARY: return bit(TypeSpec::IMAGINARY);
+    default: return 0;
+    }
+}
+
+// Binding powers of the infix operators, from the comma operator (loosest)
+// to * / % (tightest). An operator continues an expression parsed with
+// minimum power p when its left power is at least p, and its right operand is
+// parsed with its right power: one more than the left for left-associative
+// operators, the same for right-associative ones.
+enum Precedence : uint8_t {
+    COMMA = 1,
+    ASSIGNMENT,
+    CONDITIONAL,
+    LOGICAL_OR,
+    LOGICAL_AND,
+    BITWISE_OR,
+    BITWISE_XOR,
+    BITWISE_AND,
+    EQUALITY,
+    RELATIONAL,
+    SHIFT,
+    ADDITIVE,
+    MULTIPLICATIVE
+};
+
+struct BindingPower {
+    uint8_t left = 0; // 0 if the token is not an infix operator
+    uint8_t right = 0;
+};
+
+constexpr size_t kTokenTypes = static_cast<size_t>(TokenType::ERROR_TOKEN) + 1;
+
+constexpr std::array<BindingPower, kTokenTypes> kBindingPowers = [] {
+    std::array<BindingPower, kTokenTypes> table{};
+    auto left = [&](Precedence precedence, std::initializer_list<TokenType> types) {
+        for (TokenType type : types) {
+            table[static_cast<size_t>(type)] = {uint8_t(2 * precedence), uint8_t(2 * precedence + 1)};
+        }
+    };
+    auto right = [&](Precedence precedence, std::initializer_list<TokenType> types) {
+        for (TokenType type : types) {
+            table[static_cast<size_t>(type)] = {uint8_t(2 * precedence), uint8_t(2 * precedence)};
+        }
+    };
+    left(COMMA, {TokenType::DELIMITER_COMMA});
+    right(ASSIGNMENT, {TokenType::OP_ASSIGN, TokenType::OP_PLUS_ASSIGN, TokenType::OP_MINUS_ASSIGN,
+                       TokenType::OP_STAR_ASSIGN, TokenType::OP_SLASH_ASSIGN,
+                       TokenType::OP_PERCENT_ASSIGN, TokenType::OP_AND_ASSIGN,
+                       TokenType::OP_OR_ASSIGN, TokenType::OP_XOR_ASSIGN,
+                       TokenType::OP_LEFT_SHIFT_ASSIGN, TokenType::OP_RIGHT_SHIFT_ASSIGN});
+    right(CONDITIONAL, {TokenType::OP_QUESTION});
+    left(LOGICAL_OR, {TokenType::OP_OR});
+    left(LOGICAL_AND, {TokenType::OP_AND});
+    left(BITWISE_OR, {TokenType::OP_BITWISE_OR});
+    left(BITWISE_XOR, {TokenType::OP_BITWISE_XOR});
+    left(BITWISE_AND, {TokenType::OP_BITWISE_AND});
+    left(EQUALITY, {TokenType::OP_EQ, TokenType::OP_NE});
+    left(RELATIONAL, {TokenType::OP_LT, TokenType::OP_GT, TokenType::OP_LE, TokenType::OP_GE});
+    left(SHIFT, {TokenType::OP_LEFT_SHIFT, TokenType::OP_RIGHT_SHIFT});
+    left(ADDITIVE, {TokenType::OP_PLUS, TokenType::OP_MINUS});
+    left(MULTIPLICATIVE, {TokenType::OP_STAR, TokenType::OP_SLASH, TokenType::OP_PERCENT});
+    return table;
+}();
+
+constexpr BindingPower binding_power(TokenType type) {
+    return kBindingPowers[static_cast<size_t>(type)];
+}
+
+static_assert(binding_power(TokenType::OP_STAR).left > binding_power(TokenType::OP_PLUS).left);
+static_assert(binding_power(TokenType::OP_MINUS).right > binding_power(TokenType::OP_MINUS).left);
+static_assert(binding_power(TokenType::OP_ASSIGN).right == binding_power(TokenType::OP_ASSIGN).left);
+static_assert(binding_power(TokenType::IDENTIFIER).left == 0);
+
+// Counts a level of nesting while in scope
+class Nesting {
+public:
+    Nesting(size_t& depth, size_t& deepest) : depth_(depth) {
+        deepest = std::max(deepest, ++depth_);
+    }
+    ~Nesting() { --depth_; }
+
+    Nesting(const Nesting&) = delete;
+    Nesting& operator=(const Nesting&) = delete;
+
+private:
+    size_t& depth_;
+};
+
+} // namespace
+
+Parser::Parser(std::span<const Token> tokens, lexer::IdentifierTable& identifiers)
+    : next_(tokens.data()), end_(tokens.data() + tokens.size()), identifiers_(identifiers),
+      symbols_(identifiers.size()) {
+    skip_error_tokens();
+}
+
+NodeId Parser::parse_translation_unit() {
+    const Token& first = *next_;
+    size_t mark = pending_.size();
+    while (!at(TokenType::END_OF_FILE)) {
+        const Token* before = next_;
+        if (accept(TokenType::DELIMITER_SEMICOLON)) {
+            continue;
+        }
+        pending_.push_back(external_declaration());
+        if (next_ == before) {
+            advance();
+        }
+    }
+    return add(NodeKind::TRANSLATION_UNIT, first, 0, finish_list(mark));
+}
+
+NodeId Parser::parse_expression() {
+    return expression();
+}
+
+bool Parser::is_typedef_name(IdentifierId name) const {
+    const semantic::Symbol* symbol = symbols_.lookup(name);
+    return symbol && symbol->kind == SymbolKind::TYPEDEF;
+}
+
+void Parser::declare(IdentifierId name, SymbolKind kind, NodeId declaration) {
+    if (name != lexer::kNoIdentifier) {
+        symbols_.declare(name, kind, declaration);
+    }
+}
+
+bool Parser::starts_type_name(const Token& token) const {
+    if (token.type == TokenType::IDENTIFIER) {
+        return is_typedef_name(token.ident);
+    }
+    return type_spec(token.type) != 0 || qualifier(token.type) != 0 ||
+           token.type == TokenType::KW_STRUCT || token.type == TokenType::KW_UNION ||
+           token.type == TokenType::KW_ENUM;
+}
+
+bool Parser::starts_declaration(const Token& token) const {
+    return specifier_flag(token.type) != 0 || starts_type_name(token);
+}
+
+const Token& Parser::advance() {
+    const Token& token = *next_;
+    if (token.type == TokenType::DELIMITER_SEMICOLON || token.type == TokenType::DELIMITER_RBRACE) {
+        recovering_ = false;
+    }
+    if (next_ + 1 < end_) {
+        ++next_;
+    }
+    skip_error_tokens();
+    return token;
+}
+
+void Parser::skip_error_tokens() {
+    while (next_->type == TokenType::ERROR_TOKEN && next_ + 1 < end_) {
+        diagnostics_.push_back(Diagnostic{next_->offset, std::string(next_->value)});
+        ++next_;
+    }
+}
+
+bool Parser::accept(TokenType type) {
+    if (!at(type)) {
+        return false;
+    }
+    advance();
+    return true;
+}
+
+bool Parser::expect(TokenType type, std::string_view what) {
+    if (accept(type)) {
+        return true;
+    }
+    std::string message = "expected ";
+    message += what;
+    report(message);
+    return false;
+}
+
+void Parser::report(std::string_view message) {
+    if (!recovering_) {
+        recovering_ = true;
+        diagnostics_.push_back(Diagnostic{next_->offset, std::string(message)});
+    }
+}
+
+NodeId Parser::error(std::string_view message) {
+    report(message);
+    return add(NodeKind::ERROR, *next_);
+}
+
+void Parser::synchronize() {
+    size_t depth = 0;
+    for (; !at(TokenType::END_OF_FILE); advance()) {
+        switch (next_->type) {
+        case TokenType::DELIMITER_LPAREN:
+        case TokenType::DELIMITER_LBRACKET:
+        case TokenType::DELIMITER_LBRACE:
+            ++depth;
+            break;
+        case TokenType::DELIMITER_RPAREN:
+        case TokenType::DELIMITER_RBRACKET:
+            depth -= depth > 0;
+            break;
+        case TokenType::DELIMITER_RBRACE:
+            if (depth == 0) {
+                return;
+            }
+            --depth;
+            break;
+        case TokenType::DELIMITER_SEMICOLON:
+            if (depth == 0) {
+                advance();
+                return;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Gives up on the construct being parsed, skipping to the `;` or `}` after
+// it, which are left for the enclosing parse. Brackets are not balanced on
+// the way: those opened before are what went too deep.
+NodeId Parser::too_deep() {
+    NodeId node = error("nesting too deep");
+    while (!at(TokenType::END_OF_FILE) && !at(TokenType::DELIMITER_SEMICOLON) &&
+           !at(TokenType::DELIMITER_RBRACE)) {
+        advance();
+    }
+    return node;
+}
+
+void Parser::end_statement() {
+    if (!expect(TokenType::DELIMITER_SEMICOLON, "';'")) {
+        synchronize();
+    }
+}
+
+uint32_t Parser::finish_list(size_t mark) {
+    uint32_t index = ast_.add_list(std::span(pending_).subspan(mark));
+    pending_.resize(mark);
+    return index;
+}
+
+// Declarations
+
+NodeId Parser::external_declaration() {
+    const Token& first = *next_;
+    NodeId specifiers = declaration_specifiers(true);
+    if (specifiers == kNoNode) {
+        NodeId node = error("expected declaration");
+        synchronize();
+        return node;
+    }
+    if (accept(TokenType::DELIMITER_SEMICOLON)) {
+        return add(NodeKind::DECLARATION, first, specifiers);
+    }
+    NodeId name = declarator(false, true);
+    NodeId function = ast_[name].b;
+    bool is_function = function != kNoNode && ast_[function].kind == NodeKind::FUNCTION;
+    // An identifier list followed by declarations starts an old-style
+    // definition (C99 6.9.1)
+    bool old_style = is_function && ast_[function].has(NodeFlag::NO_PROTOTYPE) &&
+                     starts_declaration(*next_);
+    if (is_function && (old_style || at(TokenType::DELIMITER_LBRACE))) {
+        declare(ast_[name].a, SymbolKind::FUNCTION, name);
+        push_scope();
+        declare_parameters(name);
+        if (old_style) {
+            parameter_declarations(function);
+        }
+        if (!at(TokenType::DELIMITER_LBRACE)) {
+            pop_scope();
+            NodeId node = error("expected '{'");
+            synchronize();
+            return node;
+        }
+        NodeId body = compound_statement(false);
+        pop_scope();
+        return add(NodeKind::FUNCTION_DEFINITION, first, specifiers, ast_.add_extra({name, body}));
+    }
+    return declaration(first, specifiers, name);
+}
+
+NodeId Parser::declaration(const Token& first, NodeId specifiers, NodeId name) {
+    bool is_typedef = ast_[specifiers].has(NodeFlag::TYPEDEF);
+    size_t mark = pending_.size();
+    for (;;) {
+        NodeId derivation = ast_[name].b;
+        declare(ast_[name].a,
+                is_typedef ? SymbolKind::TYPEDEF
+                : derivation != kNoNode && ast_[derivation].kind == NodeKind::FUNCTION
+                    ? SymbolKind::FUNCTION
+                    : SymbolKind::OBJECT,
+                name);
+        NodeId value = accept(TokenType::OP_ASSIGN) ? initializer() : kNoNode;
+        pending_.push_back(ast_.add(NodeKind::INIT_DECLARATOR, ast_[name].offset, name, value));
+        if (!accept(TokenType::DELIMITER_COMMA)) {
+            break;
+        }
+        name = declarator(false, true);
+    }
+    uint32_t declarators = finish_list(mark);
+    end_statement();
+    return add(NodeKind::DECLARATION, first, specifiers, declarators);
+}
+
+NodeId Parser::declaration_specifiers(bool storage_allowed) {
+    const Token& first = *next_;
+    uint16_t flags = 0;
+    uint32_t specs = 0;
+    NodeId type = kNoNode;
+    bool any = false;
+    for (;; any = true) {
+        const Token& token = *next_;
+        if (uint16_t flag = specifier_flag(token.type)) {
+            if (!storage_allowed && !(flag & kQualifiers)) {
+                report("storage class not allowed here");
+            }
+            flags |= flag;
+            advance();
+        } else if (uint32_t spec = type_spec(token.type)) {
+            if (spec == bit(TypeSpec::LONG) && (specs & spec)) {
+                spec = bit(TypeSpec::LONG_LONG);
+            }
+            specs |= spec;
+            advance();
+        } else if (token.type == TokenType::KW_STRUCT || token.type == TokenType::KW_UNION ||
+                   token.type == TokenType::KW_ENUM) {
+            if (type != kNoNode) {
+                report("more than one type in declaration specifiers");
+            }
+            type = token.type == TokenType::KW_ENUM ? enum_specifier() : record_specifier();
+        } else if (token.type == TokenType::IDENTIFIER && type == kNoNode && specs == 0 &&
+                   is_typedef_name(token.ident)) {
+            // Once a type has been named, an identifier is the declarator
+            // even if it names a type too
+            type = add(NodeKind::TYPEDEF_NAME, token, token.ident);
+            advance();
+        } else {
+            break;
+        }
+    }
+    if (!any) {
+        return kNoNode;
+    }
+    return add(NodeKind::DECL_SPECIFIERS, first, specs, type, 0, flags);
+}
+
+NodeId Parser::record_specifier() {
+    Nesting nesting(depth_, deepest_);
+    if (depth_ > kMaxDepth) {
+        return too_deep();
+    }
+    const Token& keyword = advance();
+    NodeKind kind = keyword.type == TokenType::KW_STRUCT ? NodeKind::STRUCT : NodeKind::UNION;
+    IdentifierId tag = at(TokenType::IDENTIFIER) ? advance().ident : lexer::kNoIdentifier;
+    if (!at(TokenType::DELIMITER_LBRACE)) {
+        if (tag == lexer::kNoIdentifier) {
+            return error("expected identifier or '{'");
+        }
+        return add(kind, keyword, tag);
+    }
+    advance();
+    size_t mark = pending_.size();
+    while (!at(TokenType::DELIMITER_RBRACE) && !at(TokenType::END_OF_FILE)) {
+        const Token* before = next_;
+        pending_.push_back(member_declaration());
+        if (next_ == before) {
+            advance();
+        }
+    }
+    uint32_t members = finish_list(mark);
+    expect(TokenType::DELIMITER_RBRACE, "'}'");
+    return add(kind, keyword, tag, members, 0, bit(NodeFlag::DEFINITION));
+}
+
+NodeId Parser::member_declaration() {
+    const Token& first = *next_;
+    NodeId specifiers = declaration_specifiers(false);
+    if (specifiers == kNoNode) {
+        NodeId node = error("expected member declaration");
+        synchronize();
+        return node;
+    }
+    size_t mark = pending_.size();
+    if (!at(TokenType::DELIMITER_SEMICOLON)) {
+        do {
+            const Token& token = *next_;
+            NodeId name = at(TokenType::DELIMITER_COLON) ? kNoNode : declarator(false, true);
+            if (accept(TokenType::DELIMITER_COLON)) {
+                NodeId width = conditional();
+                name = add(NodeKind::BITFIELD, token, name, width);
+            }
+            pending_.push_back(name);
+        } while (accept(TokenType::DELIMITER_COMMA));
+    }
+    uint32_t members = finish_list(mark);
+    end_statement();
+    return add(NodeKind::DECLARATION, first, specifiers, members);
+}
+
+NodeId Parser::enum_specifier() {
+    const Token& keyword = advance();
+    IdentifierId tag = at(TokenType::IDENTIFIER) ? advance().ident : lexer::kNoIdentifier;
+    if (!at(TokenType::DELIMITER_LBRACE)) {
+        if (tag == lexer::kNoIdentifier) {
+            return error("expected identifier or '{'");
+        }
+        return add(NodeKind::ENUM, keyword, tag);
+    }
+    advance();
+    size_t mark = pending_.size();
+    while (at(TokenType::IDENTIFIER)) {
+        const Token& name = advance();
+        NodeId value = accept(TokenType::OP_ASSIGN) ? conditional() : kNoNode;
+        NodeId enumerator = add(NodeKind::ENUMERATOR, name, name.ident, value);
+        pending_.push_back(enumerator);
+        declare(name.ident, SymbolKind::ENUM_CONSTANT, enumerator);
+        if (!accept(TokenType::DELIMITER_COMMA)) {
+            break;
+        }
+    }
+    uint32_t enumerators = finish_list(mark);
+    expect(TokenType::DELIMITER_RBRACE, "'}'");
+    return add(NodeKind::ENUM, keyword, tag, enumerators, 0, bit(NodeFlag::DEFINITION));
+}
+
+// A declarator's derivations are collected in pending_ from the name
+// outward, which is the order they apply in, then linked into a chain
+NodeId Parser::declarator(bool abstract_allowed, bool concrete_allowed) {
+    size_t mark = pending_.size();
+    uint32_t offset = next_->offset;
+    IdentifierId name = direct_declarator(abstract_allowed, concrete_allowed, offset);
+    NodeId next = kNoNode;
+    for (size_t i = pending_.size(); i-- > mark;) {
+        ast_[pending_[i]].a = next;
+        next = pending_[i];
+    }
+    pending_.resize(mark);
+    return ast_.add(NodeKind::DECLARATOR, offset, name, next);
+}
+
+IdentifierId Parser::direct_declarator(bool abstract_allowed, bool concrete_allowed,
+                                       uint32_t& offset) {
+    Nesting nesting(depth_, deepest_);
+    if (depth_ > kMaxDepth) {
+        too_deep();
+        return lexer::kNoIdentifier;
+    }
+
+    // Pointers apply after everything to their right, so they are added last;
+    // their nodes are consecutive
+    NodeId first_pointer = static_cast<NodeId>(ast_.size());
+    size_t pointers = 0;
+    while (at(TokenType::OP_STAR)) {
+        const Token& star = advance();
+        uint16_t qualifiers = 0;
+        while (uint16_t flag = qualifier(next_->type)) {
+            qualifiers |= flag;
+            advance();
+        }
+        add(NodeKind::POINTER, star, 0, 0, 0, qualifiers);
+        ++pointers;
+    }
+
+    IdentifierId name = lexer::kNoIdentifier;
+    if (concrete_allowed && at(TokenType::IDENTIFIER)) {
+        offset = next_->offset;
+        name = advance().ident;
+    } else if (at(TokenType::DELIMITER_LPAREN) &&
+               (!abstract_allowed || peek().type == TokenType::OP_STAR ||
+                (concrete_allowed && peek().type == TokenType::IDENTIFIER &&
+                 !is_typedef_name(peek().ident)))) {
+        // A parenthesized declarator rather than a parameter list
+        advance();
+        name = direct_declarator(abstract_allowed, concrete_allowed, offset);
+        expect(TokenType::DELIMITER_RPAREN, "')'");
+    } else if (!abstract_allowed) {
+        report("expected identifier or '('");
+    }
+
+    for (;;) {
+        if (at(TokenType::DELIMITER_LBRACKET)) {
+            pending_.push_back(array_suffix());
+        } else if (at(TokenType::DELIMITER_LPAREN)) {
+            pending_.push_back(function_suffix());
+        } else {
+            break;
+        }
+    }
+    for (size_t i = pointers; i-- > 0;) {
+        pending_.push_back(first_pointer + static_cast<NodeId>(i));
+    }
+    return name;
+}
+
+NodeId Parser::array_suffix() {
+    const Token& open = advance();
+    uint16_t flags = 0;
+    for (;; advance()) {
+        if (uint16_t flag = qualifier(next_->type)) {
+            flags |= flag;
+        } else if (at(TokenType::KW_STATIC)) {
+            flags |= bit(NodeFlag::STATIC);
+        } else {
+            break;
+        }
+    }
+    NodeId size = kNoNode;
+    if (at(TokenType::OP_STAR) && peek().type == TokenType::DELIMITER_RBRACKET) {
+        advance();
+        flags |= bit(NodeFlag::STAR);
+    } else if (!at(TokenType::DELIMITER_RBRACKET)) {
+        size = assignment();
+    }
+    expect(TokenType::DELIMITER_RBRACKET, "']'");
+    return add(NodeKind::ARRAY, open, 0, size, 0, flags);
+}
+
+NodeId Parser::function_suffix() {
+    const Token& open = advance();
+    size_t mark = pending_.size();
+    uint16_t flags = 0;
+    push_scope();
+    if (at(TokenType::DELIMITER_RPAREN)) {
+        flags |= bit(NodeFlag::NO_PROTOTYPE);
+    } else if (at(TokenType::KW_VOID) && peek().type == TokenType::DELIMITER_RPAREN) {
+        advance();
+    } else if (at(TokenType::IDENTIFIER) && !is_typedef_name(next_->ident)) {
+        // The identifier list of an old-style definition
+        flags |= bit(NodeFlag::NO_PROTOTYPE);
+        do {
+            if (!at(TokenType::IDENTIFIER)) {
+                report("expected identifier");
+                break;
+            }
+            const Token& name = advance();
+            NodeId parameter = ast_.add(NodeKind::DECLARATOR, name.offset, name.ident);
+            pending_.push_back(add(NodeKind::PARAMETER, name, kNoNode, parameter));
+        } while (accept(TokenType::DELIMITER_COMMA));
+    } else {
+        do {
+            if (accept(TokenType::DELIMITER_ELLIPSIS)) {
+                flags |= bit(NodeFlag::VARIADIC);
+                break;
+            }
+            const Token& first = *next_;
+            NodeId specifiers = declaration_specifiers(true);
+            if (specifiers == kNoNode) {
+                report("expected parameter declaration");
+                break;
+            }
+            NodeId name = declarator(true, true);
+            declare(ast_[name].a, SymbolKind::OBJECT, name);
+            pending_.push_back(add(NodeKind::PARAMETER, first, specifiers, name));
+        } while (accept(TokenType::DELIMITER_COMMA));
+    }
+    pop_scope();
+    uint32_t parameters = finish_list(mark);
+    expect(TokenType::DELIMITER_RPAREN, "')'");
+    return add(NodeKind::FUNCTION, open, 0, parameters, 0, flags);
+}
+
+// Brings the parameters of a function definition into the scope of its body
+void Parser::declare_parameters(NodeId name) {
+    NodeId function = ast_[name].b;
+    for (NodeId parameter : ast_.list(ast_[function].b)) {
+        NodeId name = ast_[parameter].b;
+        declare(ast_[name].a, SymbolKind::OBJECT, name);
+    }
+}
+
+// The declaration list of an old-style definition: each declarator gives the
+// type of the identifier-list parameter it names, filling in its PARAMETER
+void Parser::parameter_declarations(NodeId function) {
+    uint32_t parameters = ast_[function].b;
+    while (starts_declaration(*next_)) {
+        NodeId specifiers = declaration_specifiers(true);
+        do {
+            NodeId name = declarator(false, true);
+            IdentifierId id = ast_[name].a;
+            NodeId parameter = kNoNode;
+            for (NodeId candidate : ast_.list(parameters)) {
+                if (ast_[ast_[candidate].b].a == id) {
+                    parameter = candidate;
+                }
+            }
+            if (parameter == kNoNode) {
+                report("declaration of a name not in the parameter list");
+                continue;
+            }
+            ast_[parameter].a = specifiers;
+            ast_[parameter].b = name;
+            declare(id, SymbolKind::OBJECT, name);
+        } while (accept(TokenType::DELIMITER_COMMA));
+        end_statement();
+    }
+}
+
+NodeId Parser::type_name() {
+    const Token& first = *next_;
+    NodeId specifiers = declaration_specifiers(false);
+    if (specifiers == kNoNode) {
+        return error("expected type name");
+    }
+    NodeId abstract = kNoNode;
+    if (at(TokenType::OP_STAR) || at(TokenType::DELIMITER_LPAREN) ||
+        at(TokenType::DELIMITER_LBRACKET)) {
+        abstract = declarator(true, false);
+    }
+    return add(NodeKind::TYPE_NAME, first, specifiers, abstract);
+}
+
+NodeId Parser::initializer() {
+    if (!at(TokenType::DELIMITER_LBRACE)) {
+        return assignment();
+    }
+    Nesting nesting(depth_, deepest_);
+    if (depth_ > kMaxDepth) {
+        return too_deep();
+    }
+    const Token& open = advance();
+    size_t mark = pending_.size();
+    while (!at(TokenType::DELIMITER_RBRACE) && !at(TokenType::END_OF_FILE)) {
+        const Token& first = *next_;
+        if (at(TokenType::DELIMITER_DOT) || at(TokenType::DELIMITER_LBRACKET)) {
+            size_t designators = pending_.size();
+            for (;;) {
+                const Token& token = *next_;
+                if (accept(TokenType::DELIMITER_DOT)) {
+                    IdentifierId field = lexer::kNoIdentifier;
+                    if (at(TokenType::IDENTIFIER)) {
+                        field = advance().ident;
+                    } else {
+                        report("expected field name");
+                    }
+                    pending_.push_back(add(NodeKind::FIELD_DESIGNATOR, token, field));
+                } else if (accept(TokenType::DELIMITER_LBRACKET)) {
+                    NodeId index = conditional();
+                    expect(TokenType::DELIMITER_RBRACKET, "']'");
+                    pending_.push_back(add(NodeKind::INDEX_DESIGNATOR, token, index));
+                } else {
+                    break;
+                }
+            }
+            uint32_t designation = finish_list(designators);
+            expect(TokenType::OP_ASSIGN, "'='");
+            NodeId value = initializer();
+            pending_.push_back(add(NodeKind::DESIGNATED, first, designation, value));
+        } else {
+            pending_.push_back(initializer());
+        }
+        if (!accept(TokenType::DELIMITER_COMMA)) {
+            break;
+        }
+    }
+    uint32_t items = finish_list(mark);
+    expect(TokenType::DELIMITER_RBRACE, "'}'");
+    return add(NodeKind::INITIALIZER_LIST, open, 0, items);
+}
+
+// Statements
+
+NodeId Parser::statement() {
+    Nesting nesting(depth_, deepest_);
+    if (depth_ > kMaxDepth) {
+        NodeId node = error("nesting too deep");
+        synchronize();
+        return node;
+    }
+    const Token& token = *next_;
+    switch (token.type) {
+    case TokenType::DELIMITER_LBRACE:
+        return compound_statement(true);
+    case TokenType::KW_IF: {
+        advance();
+        NodeId condition = parenthesized();
+        NodeId then = statement();
+        NodeId otherwise = accept(TokenType::KW_ELSE) ? statement() : kNoNode;
+        return add(NodeKind::IF, token, condition, ast_.add_extra({then, otherwise}));
+    }
+    case TokenType::KW_WHILE: {
+        advance();
+        NodeId condition = parenthesized();
+        NodeId body = statement();
+        return add(NodeKind::WHILE, token, condition, body);
+    }
+    case TokenType::KW_DO: {
+        advance();
+        NodeId body = statement();
+        expect(TokenType::KW_WHILE, "'while'");
+        NodeId condition = parenthesized();
+        end_statement();
+        return add(NodeKind::DO, token, body, condition);
+    }
+    case TokenType::KW_FOR:
+        return for_statement();
+    case TokenType::KW_SWITCH: {
+        advance();
+        NodeId condition = parenthesized();
+        NodeId body = statement();
+        return add(NodeKind::SWITCH, token, condition, body);
+    }
+    case TokenType::KW_CASE: {
+        advance();
+        NodeId value = conditional();
+        expect(TokenType::DELIMITER_COLON, "':'");
+        NodeId body = statement();
+        return add(NodeKind::CASE, token, value, body);
+    }
+    case TokenType::KW_DEFAULT: {
+        advance();
+        expect(TokenType::DELIMITER_COLON, "':'");
+        NodeId body = statement();
+        return add(NodeKind::DEFAULT, token, 0, body);
+    }
+    case TokenType::KW_GOTO: {
+        advance();
+        IdentifierId label = lexer::kNoIdentifier;
+        if (at(TokenType::IDENTIFIER)) {
+            label = advance().ident;
+        } else {
+            report("expected identifier");
+        }
+        end_statement();
+        return add(NodeKind::GOTO, token, label);
+    }
+    case TokenType::KW_CONTINUE:
+    case TokenType::KW_BREAK:
+        advance();
+        end_statement();
+        return add(token.type == TokenType::KW_BREAK ? NodeKind::BREAK : NodeKind::CONTINUE, token);
+    case TokenType::KW_RETURN: {
+        advance();
+        NodeId value = at(TokenType::DELIMITER_SEMICOLON) ? kNoNode : expression();
+        end_statement();
+        return add(NodeKind::RETURN, token, value);
+    }
+    case TokenType::DELIMITER_SEMICOLON:
+        advance();
+        return add(NodeKind::EXPRESSION, token);
+    case TokenType::IDENTIFIER:
+        if (peek().type == TokenType::DELIMITER_COLON) {
+            advance();
+            advance();
+            NodeId body = statement();
+            return add(NodeKind::LABEL, token, token.ident, body);
+        }
+        break;
+    default:
+        break;
+    }
+    NodeId value = expression();
+    end_statement();
+    return add(NodeKind::EXPRESSION, token, value);
+}
+
+NodeId Parser::parenthesized() {
+    expect(TokenType::DELIMITER_LPAREN, "'('");
+    NodeId value = expression();
+    expect(TokenType::DELIMITER_RPAREN, "')'");
+    return value;
+}
+
+NodeId Parser::for_statement() {
+    const Token& keyword = advance();
+    expect(TokenType::DELIMITER_LPAREN, "'('");
+    push_scope();
+    NodeId init = kNoNode;
+    if (starts_declaration(*next_)) {
+        const Token& first = *next_;
+        NodeId specifiers = declaration_specifiers(true);
+        init = declaration(first, specifiers, declarator(false, true));
+    } else {
+        if (!at(TokenType::DELIMITER_SEMICOLON)) {
+            init = expression();
+        }
+        expect(TokenType::DELIMITER_SEMICOLON, "';'");
+    }
+    NodeId condition = at(TokenType::DELIMITER_SEMICOLON) ? kNoNode : expression();
+    expect(TokenType::DELIMITER_SEMICOLON, "';'");
+    NodeId step = at(TokenType::DELIMITER_RPAREN) ? kNoNode : expression();
+    expect(TokenType::DELIMITER_RPAREN, "')'");
+    NodeId body = statement();
+    pop_scope();
+    return add(NodeKind::FOR, keyword, ast_.add_extra({init, condition, step}), body);
+}
+
+NodeId Parser::compound_statement(bool new_scope) {
+    const Token& open = advance();
+    if (new_scope) {
+        push_scope();
+    }
+    size_t mark = pending_.size();
+    while (!at(TokenType::DELIMITER_RBRACE) && !at(TokenType::END_OF_FILE)) {
+        const Token* before = next_;
+        pending_.push_back(block_item());
+        if (next_ == before) {
+            advance();
+        }
+    }
+    uint32_t items = finish_list(mark);
+    expect(TokenType::DELIMITER_RBRACE, "'}'");
+    if (new_scope) {
+        pop_scope();
+    }
+    return add(NodeKind::COMPOUND, open, 0, items);
+}
+
+NodeId Parser::block_item() {
+    if (!starts_declaration(*next_) ||
+        (at(TokenType::IDENTIFIER) && peek().type == TokenType::DELIMITER_COLON)) {
+        return statement();
+    }
+    const Token& first = *next_;
+    NodeId specifiers = declaration_specifiers(true);
+    if (accept(TokenType::DELIMITER_SEMICOLON)) {
+        return add(NodeKind::DECLARATION, first, specifiers);
+    }
+    return declaration(first, specifiers, declarator(false, true));
+}
+
+// Expressions: infix operators by precedence climbing over kBindingPowers,
+// then one function each for casts, prefix and postfix operators and
+// primary expressions
+
+NodeId Parser::expression() {
+    return binary(2 * COMMA);
+}
+
+// The left operand is parsed as a conditional expression and checking that
+// it is an lvalue left to semantic analysis, as for a cast or sizeof
+NodeId Parser::assignment() {
+    return binary(2 * ASSIGNMENT);
+}
+
+NodeId Parser::conditional() {
+    return binary(2 * CONDITIONAL);
+}
+
+// An operand and every operator after it binding at least min_power. Left
+// operands are folded in the loop, so recursion only goes as deep as
+// right-associative chains and rising precedence take it.
+NodeId Parser::binary(uint8_t min_power) {
+    Nesting nesting(depth_, deepest_);
+    if (depth_ > kMaxDepth) {
+        return too_deep();
+    }
+    NodeId left = cast();
+    for (;;) {
+        BindingPower power = binding_power(next_->type);
+        if (power.left < min_power) {
+            return left;
+        }
+        const Token& token = advance();
+        if (token.type == TokenType::OP_QUESTION) {
+            NodeId then = expression();
+            expect(TokenType::DELIMITER_COLON, "':'");
+            NodeId otherwise = binary(power.right);
+            left = add(NodeKind::CONDITIONAL, token, left, ast_.add_extra({then, otherwise}));
+        } else {
+            NodeId right = binary(power.right);
+            left = add(NodeKind::BINARY, token, left, right, op(token.type));
+        }
+    }
+}
+
+NodeId Parser::cast() {
+    Nesting nesting(depth_, deepest_);
+    if (depth_ > kMaxDepth) {
+        return too_deep();
+    }
+    if (!at(TokenType::DELIMITER_LPAREN) || !starts_type_name(peek())) {
+        return unary();
+    }
+    const Token& open = advance();
+    NodeId type = type_name();
+    expect(TokenType::DELIMITER_RPAREN, "')'");
+    if (at(TokenType::DELIMITER_LBRACE)) {
+        NodeId list = initializer();
+        return postfix(add(NodeKind::COMPOUND_LITERAL, open, type, list));
+    }
+    NodeId operand = cast();
+    return add(NodeKind::CAST, open, type, operand);
+}
+
+NodeId Parser::unary() {
+    const Token& token = *next_;
+    switch (token.type) {
+    case TokenType::OP_INCREMENT:
+    case TokenType::OP_DECREMENT: {
+        Nesting nesting(depth_, deepest_);
+        if (depth_ > kMaxDepth) {
+            return too_deep();
+        }
+        advance();
+        NodeId operand = unary();
+        return add(NodeKind::UNARY, token, operand, 0, op(token.type));
+    }
+    case TokenType::OP_BITWISE_AND:
+    case TokenType::OP_STAR:
+    case TokenType::OP_PLUS:
+    case TokenType::OP_MINUS:
+    case TokenType::OP_BITWISE_NOT:
+    case TokenType::OP_NOT: {
+        advance();
+        NodeId operand = cast();
+        return add(NodeKind::UNARY, token, operand, 0, op(token.type));
+    }
+    case TokenType::KW_SIZEOF: {
+        advance();
+        if (!at(TokenType::DELIMITER_LPAREN) || !starts_type_name(peek())) {
+            Nesting nesting(depth_, deepest_);
+            if (depth_ > kMaxDepth) {
+                return too_deep();
+            }
+            NodeId operand = unary();
+            return add(NodeKind::SIZEOF_EXPRESSION, token, operand);
+        }
+        const Token& open = advance();
+        NodeId type = type_name();
+        expect(TokenType::DELIMITER_RPAREN, "')'");
+        if (!at(TokenType::DELIMITER_LBRACE)) {
+            return add(NodeKind::SIZEOF_TYPE, token, type);
+        }
+        NodeId list = initializer();
+        NodeId operand = postfix(add(NodeKind::COMPOUND_LITERAL, open, type, list));
+        return add(NodeKind::SIZEOF_EXPRESSION, token, operand);
+    }
+    default:
+        return postfix(primary());
+    }
+}
+
+NodeId Parser::postfix(NodeId operand) {
+    for (;;) {
+        const Token& token = *next_;
+        switch (token.type) {
+        case TokenType::DELIMITER_LBRACKET: {
+            advance();
+            NodeId index = expression();
+            expect(TokenType::DELIMITER_RBRACKET, "']'");
+            operand = add(NodeKind::SUBSCRIPT, token, operand, index);
+            break;
+        }
+        case TokenType::DELIMITER_LPAREN: {
+            advance();
+            size_t mark = pending_.size();
+            if (!at(TokenType::DELIMITER_RPAREN)) {
+                do {
+                    pending_.push_back(assignment());
+                } while (accept(TokenType::DELIMITER_COMMA));
+            }
+            uint32_t arguments = finish_list(mark);
+            expect(TokenType::DELIMITER_RPAREN, "')'");
+            operand = add(NodeKind::CALL, token, operand, arguments);
+            break;
+        }
+        case TokenType::DELIMITER_DOT:
+        case TokenType::DELIMITER_ARROW: {
+            advance();
+            IdentifierId member = lexer::kNoIdentifier;
+            if (at(TokenType::IDENTIFIER)) {
+                member = advance().ident;
+            } else {
+                report("expected member name");
+            }
+            operand = add(NodeKind::MEMBER, token, operand, member, op(token.type));
+            break;
+        }
+        case TokenType::OP_INCREMENT:
+        case TokenType::OP_DECREMENT:
+            advance();
+            operand = add(NodeKind::POSTFIX, token, operand, 0, op(token.type));
+            break;
+        default:
+            return operand;
+        }
+    }
+}
+
+NodeId Parser::primary() {
+    const Token& token = *next_;
+    switch (token.type) {
+    case TokenType::IDENTIFIER:
+        advance();
+        return add(NodeKind::IDENTIFIER, token, token.ident);
+    case TokenType::CONSTANT_INT:
+    case TokenType::CONSTANT_CHAR:
+        advance();
+        return add(token.type == TokenType::CONSTANT_INT ? NodeKind::INT_CONSTANT
+                                                          : NodeKind::CHAR_CONSTANT,
+                   token, static_cast<uint32_t>(token.int_value),
+                   static_cast<uint32_t>(token.int_value >> 32), static_cast<uint8_t>(token.numeric),
+                   token.has(TokenFlag::WIDE) ? bit(NodeFlag::WIDE) : 0);
+    case TokenType::CONSTANT_FLOAT: {
+        advance();
+        uint64_t bits;
+        std::memcpy(&bits, &token.float_value, sizeof(bits));
+        return add(NodeKind::FLOAT_CONSTANT, token, static_cast<uint32_t>(bits),
+                   static_cast<uint32_t>(bits >> 32), static_cast<uint8_t>(token.numeric));
+    }
+    case TokenType::CONSTANT_STRING: {
+        // Adjacent literals are one string
+        uint32_t first = 0;
+        uint32_t count = 0;
+        uint16_t flags = 0;
+        while (at(TokenType::CONSTANT_STRING)) {
+            const Token& part = advance();
+            uint32_t index = ast_.add_string(part.string);
+            first = count++ == 0 ? index : first;
+            flags |= part.has(TokenFlag::WIDE) ? bit(NodeFlag::WIDE) : 0;
+        }
+        return add(NodeKind::STRING_LITERAL, token, first, count, 0, flags);
+    }
+    case TokenType::DELIMITER_LPAREN: {
+        advance();
+        NodeId inner = expression();
+        expect(TokenType::DELIMITER_RPAREN, "')'");
+        return inner;
+    }
+    default:
+        return error("expected expression");
+    }
+}
+
+} // namespace parser
@@ -0,0 +1,154 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "../lexer/identifier_table.h"
+#include "../lexer/token.h"
+#include "../semantic/symbol_table.h"
+#include "ast.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace parser {
+
+using lexer::Token;
+using lexer::TokenType;
+
+struct Diagnostic {
+    uint32_t offset; // Of the token the parser stopped at
+    std::string message;
+};
+
+// Recursive-descent parser for C99 translation units, building an Ast.
+//
+// It reads an array of tokens ending with END_OF_FILE, such as a
+// Preprocessor's output, whose identifiers and keywords were interned into
+// identifiers. Nodes refer to identifiers by IdentifierId and to everything
+// else by token offset, so the tokens' spellings are never copied; string
+// literals point at the lexer's decoded contents. Infix operators are parsed
+// by precedence climbing over a constexpr table of binding powers, so an
+// operand costs one call rather than one per precedence level.
+//
+// Ordinary identifiers are entered in a semantic::SymbolTable as
+// declarations are parsed, which is what decides whether `T * x;` declares x
+// or multiplies. ERROR_TOKENs from
+// the preprocessor and syntax errors become Diagnostics; after an error the
+// parser skips to the end of the statement or declaration and goes on.
+class Parser {
+public:
+    // Deepest nesting of statements, declarators and parenthesized or
+    // operand expressions before the parser gives up on a construct
+    static constexpr size_t kMaxDepth = 256;
+
+    // tokens must stay valid, and end with END_OF_FILE.
+    Parser(std::span<const Token> tokens, lexer::IdentifierTable& identifiers);
+
+    Parser(const Parser&) = delete;
+    Parser& operator=(const Parser&) = delete;
+
+    // Parses all the tokens as a translation unit.
+    NodeId parse_translation_unit();
+
+    // Parses one expression, comma operators included, for tests and tools.
+    NodeId parse_expression();
+
+    // Makes name a typedef name at file scope, as a header would.
+    void declare_typedef(IdentifierId name) { declare(name, semantic::SymbolKind::TYPEDEF); }
+    bool is_typedef_name(IdentifierId name) const;
+
+    // Deepest nesting reached so far, in the units of kMaxDepth
+    size_t max_depth() const { return deepest_; }
+
+    Ast& ast() { return ast_; }
+    const Ast& ast() const { return ast_; }
+    const std::vector<Diagnostic>& diagnostics() const { return diagnostics_; }
+
+private:
+    const Token& peek(size_t n = 1) const {
+        return next_ + n < end_ ? next_[n] : end_[-1];
+    }
+    bool at(TokenType type) const { return next_->type == type; }
+    const Token& advance();
+    void skip_error_tokens();
+    bool accept(TokenType type);
+    bool expect(TokenType type, std::string_view what);
+    // Reports message at the next token unless already recovering from an
+    // error
+    void report(std::string_view message);
+    // The same, returning an ERROR node to stand for what was expected
+    NodeId error(std::string_view message);
+    // Skips to just after the next `;` or to the next `}`, not counting those
+    // nested in brackets
+    void synchronize();
+    NodeId too_deep();
+    void end_statement();
+    NodeId add(NodeKind kind, const Token& token, uint32_t a = 0, uint32_t b = 0, uint8_t op = 0,
+               uint16_t flags = 0) {
+        return ast_.add(kind, token.offset, a, b, op, flags);
+    }
+    uint32_t finish_list(size_t mark);
+
+    // Scopes of ordinary identifiers
+    void push_scope() { symbols_.push_scope(); }
+    void pop_scope() { symbols_.pop_scope(); }
+    void declare(IdentifierId name, semantic::SymbolKind kind, NodeId declaration = kNoNode);
+    bool starts_type_name(const Token& token) const;
+    bool starts_declaration(const Token& token) const;
+
+    // Declarations
+    NodeId external_declaration();
+    NodeId declaration(const Token& first, NodeId specifiers, NodeId name);
+    NodeId declaration_specifiers(bool storage_allowed);
+    NodeId record_specifier();
+    NodeId member_declaration();
+    NodeId enum_specifier();
+    NodeId declarator(bool abstract_allowed, bool concrete_allowed);
+    IdentifierId direct_declarator(bool abstract_allowed, bool concrete_allowed,
+                                   uint32_t& offset);
+    NodeId array_suffix();
+    NodeId function_suffix();
+    void declare_parameters(NodeId name);
+    void parameter_declarations(NodeId function);
+    NodeId type_name();
+    NodeId initializer();
+
+    // Statements
+    NodeId statement();
+    NodeId parenthesized();
+    NodeId for_statement();
+    NodeId compound_statement(bool new_scope);
+    NodeId block_item();
+
+    // Expressions
+    NodeId expression();
+    NodeId assignment();
+    NodeId conditional();
+    NodeId binary(uint8_t min_power);
+    NodeId cast();
+    NodeId unary();
+    NodeId postfix(NodeId operand);
+    NodeId primary();
+
+    const Token* next_;
+    const Token* end_;
+    lexer::IdentifierTable& identifiers_;
+    Ast ast_;
+    std::vector<Diagnostic> diagnostics_;
+    size_t depth_ = 0;
+    size_t deepest_ = 0;
+    bool recovering_ = false; // Since the last error, until a `;` or `}`
+
+    // Children of lists being built, innermost list last; each parse of a
+    // list appends here and moves its part into the Ast when done
+    std::vector<NodeId> pending_;
+
+    // Ordinary identifiers in scope, and whether each names a type
+    semantic::SymbolTable symbols_;
+};
+
+} // namespace parser
+
+#endif // PARSER_H
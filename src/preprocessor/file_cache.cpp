@@ -0,0 +1,233 @@
+#include "file_cache.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <sys/stat.h>
+
+namespace preprocessor {
+
+using lexer::IdentifierId;
+using lexer::Token;
+using lexer::TokenFlag;
+using lexer::TokenType;
+
+namespace {
+
+// Past any line splices at p
+const char* skip_splices(const char* p, const char* end) {
+    for (;;) {
+        const char* q = p;
+        if (q < end && *q == '\\') {
+            ++q;
+        } else if (end - q >= 3 && q[0] == '?' && q[1] == '?' && q[2] == '/') {
+            q += 3;
+        } else {
+            return p;
+        }
+        if (q < end && *q == '\r') {
+            ++q;
+        }
+        if (q == end || *q != '\n') {
+            return p;
+        }
+        p = q + 1;
+    }
+}
+
+// Whether the whitespace and comments in [p, end) hold a newline that ends a
+// line: not one in a line splice, nor one inside a block comment, which
+// phase 3 turns into a single space
+bool has_newline(const char* p, const char* end) {
+    while ((p = skip_splices(p, end)) < end) {
+        char c = *p++;
+        if (c == '\n') {
+            return true;
+        }
+        if (c != '/' || (p = skip_splices(p, end)) == end) {
+            continue;
+        }
+        if (*p == '/') {
+            // Runs to the newline, which still ends the line
+            while ((p = skip_splices(p, end)) < end) {
+                if (*p++ == '\n') {
+                    return true;
+                }
+            }
+        } else if (*p == '*') {
+            ++p;
+            for (;;) {
+                if ((p = skip_splices(p, end)) == end) {
+                    return false;
+                }
+                if (*p++ == '*') {
+                    const char* q = skip_splices(p, end);
+                    if (q < end && *q == '/') {
+                        p = q + 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool is_name(const Token& token, IdentifierId id) {
+    return token.type <= TokenType::IDENTIFIER && token.ident == id;
+}
+
+// The X of a file that is all one `#ifndef X` or `#if !defined X` group,
+// which is what makes including it again a no-op while X is defined
+IdentifierId find_guard(const std::vector<Token>& tokens, lexer::IdentifierTable& identifiers) {
+    IdentifierId if_ = identifiers.intern("if");
+    IdentifierId ifdef_ = identifiers.intern("ifdef");
+    IdentifierId ifndef_ = identifiers.intern("ifndef");
+    IdentifierId elif_ = identifiers.intern("elif");
+    IdentifierId else_ = identifiers.intern("else");
+    IdentifierId endif_ = identifiers.intern("endif");
+    IdentifierId defined_ = identifiers.intern("defined");
+
+    auto directive = [&](size_t i) {
+        return tokens[i].type == TokenType::PREPROCESSOR_HASH &&
+               tokens[i].has(TokenFlag::START_OF_LINE);
+    };
+    auto line_ends = [&](size_t i) {
+        return tokens[i].type == TokenType::END_OF_FILE || tokens[i].has(TokenFlag::START_OF_LINE);
+    };
+
+    size_t i = 0;
+    if (tokens.size() < 4 || !directive(0)) {
+        return lexer::kNoIdentifier;
+    }
+    IdentifierId guard = lexer::kNoIdentifier;
+    if (is_name(tokens[1], ifndef_)) {
+        guard = tokens[2].type <= TokenType::IDENTIFIER ? tokens[2].ident : lexer::kNoIdentifier;
+        i = 3;
+    } else if (is_name(tokens[1], if_) && tokens[2].type == TokenType::OP_NOT &&
+               is_name(tokens[3], defined_) && tokens.size() > 5) {
+        bool paren = tokens[4].type == TokenType::DELIMITER_LPAREN;
+        i = paren ? 5 : 4;
+        guard = tokens[i].type <= TokenType::IDENTIFIER ? tokens[i].ident : lexer::kNoIdentifier;
+        ++i;
+        if (paren && (i >= tokens.size() || tokens[i++].type != TokenType::DELIMITER_RPAREN)) {
+            return lexer::kNoIdentifier;
+        }
+    }
+    if (guard == lexer::kNoIdentifier || i >= tokens.size() || !line_ends(i)) {
+        return lexer::kNoIdentifier;
+    }
+
+    // Find the #endif that matches, with no #else or #elif in between
+    size_t depth = 1;
+    for (; i + 1 < tokens.size(); ++i) {
+        if (!directive(i) || tokens[i + 1].has(TokenFlag::START_OF_LINE)) {
+            continue;
+        }
+        const Token& name = tokens[i + 1];
+        if (is_name(name, if_) || is_name(name, ifdef_) || is_name(name, ifndef_)) {
+            ++depth;
+        } else if (depth == 1 && (is_name(name, elif_) || is_name(name, else_))) {
+            return lexer::kNoIdentifier;
+        } else if (is_name(name, endif_) && --depth == 0) {
+            break;
+        }
+    }
+    if (depth != 0) {
+        return lexer::kNoIdentifier;
+    }
+    // Only the rest of the #endif line may follow
+    for (i += 2; !line_ends(i); ++i) {
+    }
+    return tokens[i].type == TokenType::END_OF_FILE ? guard : lexer::kNoIdentifier;
+}
+
+} // namespace
+
+std::unique_ptr<SourceFile> lex_file(std::string path,
+                                     std::shared_ptr<const lexer::SourceBuffer> buffer,
+                                     lexer::IdentifierTable& identifiers) {
+    auto file = std::make_unique<SourceFile>();
+    file->path = std::move(path);
+    file->buffer = buffer;
+    file->lexer = std::make_unique<lexer::Lexer>(buffer, &identifiers);
+
+    // A rough guess, to avoid most of the regrowth
+    file->tokens.reserve(buffer->size() / 4 + 1);
+    const char* text = buffer->data();
+    uint32_t previous_end = 0;
+    for (;;) {
+        Token token = file->lexer->next_token();
+        if (token.offset != previous_end) {
+            token.set(TokenFlag::LEADING_SPACE);
+        }
+        if (file->tokens.empty() || has_newline(text + previous_end, text + token.offset)) {
+            token.set(TokenFlag::START_OF_LINE);
+        }
+        previous_end = file->lexer->position();
+        file->tokens.push_back(token);
+        if (token.type == TokenType::END_OF_FILE) {
+            break;
+        }
+    }
+    file->guard = find_guard(file->tokens, identifiers);
+    return file;
+}
+
+const SourceFile* FileCache::open(std::string_view name) {
+    ++stats_.lookups;
+    if (auto it = by_path_.find(name); it != by_path_.end()) {
+        ++stats_.hits;
+        return it->second;
+    }
+
+    std::string path(name);
+    const SourceFile*& entry = by_path_[path];
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || S_ISDIR(st.st_mode)) {
+        return entry = nullptr;
+    }
+    std::pair<uint64_t, uint64_t> inode(st.st_dev, st.st_ino);
+    if (auto it = by_inode_.find(inode); it != by_inode_.end()) {
+        return entry = it->second;
+    }
+
+    std::shared_ptr<const lexer::SourceBuffer> buffer;
+    try {
+        buffer = lexer::SourceBuffer::from_file(path);
+    } catch (const std::system_error&) {
+        return entry = nullptr;
+    }
+    files_.push_back(lex_file(path, std::move(buffer), identifiers_));
+    const SourceFile* file = files_.back().get();
+    ++stats_.files_read;
+    stats_.bytes_read += file->buffer->size();
+    stats_.tokens_lexed += file->tokens.size();
+    by_inode_[inode] = file;
+    return entry = file;
+}
+
+std::string FileCache::report() const {
+    auto rate = [](uint64_t part, uint64_t whole) { return whole ? 100.0 * part / whole : 0.0; };
+    char line[128];
+    std::string out = "File cache\n";
+    auto add = [&](const char* name, uint64_t value) {
+        std::snprintf(line, sizeof(line), " %-24s: %12" PRIu64 "\n", name, value);
+        out += line;
+    };
+    auto add_rate = [&](const char* name, uint64_t value, double percent) {
+        std::snprintf(line, sizeof(line), " %-24s: %12" PRIu64 " (%5.1f%%)\n", name, value, percent);
+        out += line;
+    };
+    add("path lookups", stats_.lookups);
+    add_rate("cache hits", stats_.hits, rate(stats_.hits, stats_.lookups));
+    add("files read", stats_.files_read);
+    add("bytes read", stats_.bytes_read);
+    add("tokens lexed", stats_.tokens_lexed);
+    add("includes", stats_.includes);
+    add_rate("skipped by guard", stats_.guard_skips, rate(stats_.guard_skips, stats_.includes));
+    add_rate("skipped by #pragma once", stats_.once_skips, rate(stats_.once_skips, stats_.includes));
+    return out;
+}
+
+} // namespace preprocessor
@@ -0,0 +1,93 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include "../lexer/identifier_table.h"
+#include "../lexer/lexer.h"
+#include "../lexer/source_buffer.h"
+#include "../lexer/token.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace preprocessor {
+
+// A source file lexed once for every inclusion of it. Tokens carry the
+// START_OF_LINE and LEADING_SPACE flags the preprocessor needs, and end with
+// END_OF_FILE; their offsets are offsets in buffer.
+struct SourceFile {
+    std::string path;
+    std::shared_ptr<const lexer::SourceBuffer> buffer;
+    std::vector<lexer::Token> tokens;
+    std::unique_ptr<lexer::Lexer> lexer; // Owns the decoded string literals
+
+    // Macro of the #ifndef/#define/#endif guard wrapping the whole file, if
+    // it has one: while it is defined, including the file again does nothing.
+    lexer::IdentifierId guard = lexer::kNoIdentifier;
+};
+
+// Lexes buffer into a SourceFile and looks for an include guard. Every file
+// the preprocessor reads, included or not, goes through this.
+std::unique_ptr<SourceFile> lex_file(std::string path,
+                                     std::shared_ptr<const lexer::SourceBuffer> buffer,
+                                     lexer::IdentifierTable& identifiers);
+
+// Files read for #include, shared by every Preprocessor made with it: a
+// header is mapped, lexed and checked for a guard once per process however
+// many times it is included. Lookups are by the path the include resolved
+// to, with files that do not exist remembered as well, and different paths
+// to one file share its entry. Entries live as long as the cache. Not
+// thread-safe.
+class FileCache {
+public:
+    struct Stats {
+        uint64_t lookups = 0;     // Paths tried while resolving includes
+        uint64_t hits = 0;        // ... found in the cache, existing or not
+        uint64_t files_read = 0;  // Files mapped and lexed
+        uint64_t bytes_read = 0;
+        uint64_t tokens_lexed = 0;
+        uint64_t includes = 0;    // #includes resolved, by any Preprocessor
+        uint64_t guard_skips = 0; // ... skipped because of an include guard
+        uint64_t once_skips = 0;  // ... skipped because of #pragma once
+    };
+
+    // Identifiers in cached tokens are interned into identifiers, which every
+    // Preprocessor using the cache must share.
+    explicit FileCache(lexer::IdentifierTable& identifiers) : identifiers_(identifiers) {}
+
+    FileCache(const FileCache&) = delete;
+    FileCache& operator=(const FileCache&) = delete;
+
+    // The file at path, or nullptr if it cannot be read.
+    const SourceFile* open(std::string_view path);
+
+    lexer::IdentifierTable& identifiers() { return identifiers_; }
+    Stats& stats() { return stats_; }
+    const Stats& stats() const { return stats_; }
+
+    // The statistics as a table, with hit rates.
+    std::string report() const;
+
+private:
+    // Lets by_path_ be searched with a string_view
+    struct PathHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view path) const { return std::hash<std::string_view>()(path); }
+    };
+
+    lexer::IdentifierTable& identifiers_;
+    std::unordered_map<std::string, const SourceFile*, PathHash, std::equal_to<>>
+        by_path_; // nullptr if missing
+    std::map<std::pair<uint64_t, uint64_t>, const SourceFile*> by_inode_;
+    std::vector<std::unique_ptr<SourceFile>> files_;
+    Stats stats_;
+};
+
+} // namespace preprocessor
+
+#endif // FILE_CACHE_H
@@ -0,0 +1,1354 @@
+#include "preprocessor.h"
+#include "../lexer/instrument.h"
+#include "../lexer/keywords.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <tuple>
+
+namespace preprocessor {
+
+using lexer::NumericType;
+using lexer::TokenFlag;
+
+namespace {
+
+constexpr uint8_t kPositionFlags = static_cast<uint8_t>(TokenFlag::START_OF_LINE) |
+                                   static_cast<uint8_t>(TokenFlag::LEADING_SPACE);
+
+// Keywords are names to the preprocessor
+bool is_name(const Token& token) {
+    return token.type <= TokenType::IDENTIFIER;
+}
+
+// Whether a redefinition of a with b is allowed (C99 6.10.3p2): both
+// object-like, or function-like with the same parameters, and replacement
+// lists that are spelled the same with whitespace in the same places
+bool same_definition(const Macro& a, const Macro& b) {
+    if (a.function_like != b.function_like || a.variadic != b.variadic ||
+        a.parameters != b.parameters || a.size != b.size ||
+        !std::equal(a.parameter_names, a.parameter_names + a.parameters, b.parameter_names)) {
+        return false;
+    }
+    constexpr uint8_t kCompared = static_cast<uint8_t>(TokenFlag::WIDE) |
+                                  static_cast<uint8_t>(TokenFlag::LEADING_SPACE) |
+                                  static_cast<uint8_t>(TokenFlag::PARAMETER);
+    for (uint32_t i = 0; i < a.size; ++i) {
+        const Token& x = a.body[i];
+        const Token& y = b.body[i];
+        uint8_t mask = i == 0 ? kCompared & ~static_cast<uint8_t>(TokenFlag::LEADING_SPACE) : kCompared;
+        if (x.type != y.type || x.value != y.value || (x.flags & mask) != (y.flags & mask)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_identifier_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+Token make_int(uint64_t value, std::string_view spelling, uint32_t offset) {
+    Token token(TokenType::CONSTANT_INT, spelling, offset);
+    token.numeric = NumericType::INT;
+    token.int_value = value;
+    return token;
+}
+
+// Evaluates the controlling expression of #if or #elif (C99 6.10.1) after
+// macro expansion, in intmax_t and uintmax_t arithmetic. Identifiers left
+// over count as 0, and operands that are not evaluated cannot fail.
+class Evaluator {
+public:
+    explicit Evaluator(std::span<const Token> tokens)
+        : next_(tokens.data()), end_(tokens.data() + tokens.size()) {}
+
+    // False, with error() set, if the expression is malformed
+    bool evaluate(bool& result) {
+        Value value = conditional(true);
+        if (!error_ && next_ != end_) {
+            error_ = next_->type == TokenType::DELIMITER_RPAREN ? "Missing '(' in expression"
+                                                                 : "Missing binary operator";
+        }
+        result = value.bits != 0;
+        return !error_;
+    }
+
+    const char* error() const { return error_; }
+
+private:
+    struct Value {
+        uint64_t bits;
+        bool is_unsigned;
+    };
+
+    static int precedence(TokenType type) {
+        switch (type) {
+        case TokenType::OP_STAR:
+        case TokenType::OP_SLASH:
+        case TokenType::OP_PERCENT:
+            return 10;
+        case TokenType::OP_PLUS:
+        case TokenType::OP_MINUS:
+            return 9;
+        case TokenType::OP_LEFT_SHIFT:
+        case TokenType::OP_RIGHT_SHIFT:
+            return 8;
+        case TokenType::OP_LT:
+        case TokenType::OP_GT:
+        case TokenType::OP_LE:
+        case TokenType::OP_GE:
+            return 7;
+        case TokenType::OP_EQ:
+        case TokenType::OP_NE:
+            return 6;
+        case TokenType::OP_BITWISE_AND:
+            return 5;
+        case TokenType::OP_BITWISE_XOR:
+            return 4;
+        case TokenType::OP_BITWISE_OR:
+            return 3;
+        case TokenType::OP_AND:
+            return 2;
+        case TokenType::OP_OR:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    bool at(TokenType type) const { return next_ != end_ && next_->type == type; }
+
+    Value conditional(bool live) {
+        Value condition = binary(1, live);
+        if (error_ || !at(TokenType::OP_QUESTION)) {
+            return condition;
+        }
+        ++next_;
+        bool taken = condition.bits != 0;
+        Value left = conditional(live && taken);
+        if (!error_ && !at(TokenType::DELIMITER_COLON)) {
+            error_ = "Missing ':' in conditional expression";
+        }
+        if (error_) {
+            return left;
+        }
+        ++next_;
+        Value right = conditional(live && !taken);
+        return {taken ? left.bits : right.bits, left.is_unsigned || right.is_unsigned};
+    }
+
+    Value binary(int min_precedence, bool live) {
+        Value left = unary(live);
+        while (!error_ && next_ != end_) {
+            TokenType op = next_->type;
+            int p = precedence(op);
+            if (p == 0 || p < min_precedence) {
+                break;
+            }
+            ++next_;
+            if (op == TokenType::OP_AND || op == TokenType::OP_OR) {
+                bool known = (left.bits != 0) == (op == TokenType::OP_OR);
+                Value right = binary(p + 1, live && !known);
+                left = {known ? op == TokenType::OP_OR : right.bits != 0, false};
+                continue;
+            }
+            Value right = binary(p + 1, live);
+            left = apply(op, left, right, live);
+        }
+        return left;
+    }
+
+    Value unary(bool live) {
+        if (next_ == end_) {
+            error_ = "Missing expression";
+            return {0, false};
+        }
+        const Token& token = *next_++;
+        switch (token.type) {
+        case TokenType::OP_PLUS:
+            return unary(live);
+        case TokenType::OP_MINUS: {
+            Value value = unary(live);
+            return {0 - value.bits, value.is_unsigned};
+        }
+        case TokenType::OP_BITWISE_NOT: {
+            Value value = unary(live);
+            return {~value.bits, value.is_unsigned};
+        }
+        case TokenType::OP_NOT:
+            return {unary(live).bits == 0, false};
+        case TokenType::DELIMITER_LPAREN: {
+            Value value = conditional(live);
+            if (!error_ && !at(TokenType::DELIMITER_RPAREN)) {
+                error_ = "Missing ')' in expression";
+            }
+            if (!error_) {
+                ++next_;
+            }
+            return value;
+        }
+        case TokenType::CONSTANT_INT:
+            return {token.int_value, token.numeric == NumericType::UNSIGNED_INT ||
+                                         token.numeric == NumericType::UNSIGNED_LONG ||
+                                         token.numeric == NumericType::UNSIGNED_LONG_LONG};
+        case TokenType::CONSTANT_CHAR:
+            return {token.int_value, false};
+        case TokenType::CONSTANT_FLOAT:
+            error_ = "Floating constant in preprocessor expression";
+            return {0, false};
+        default:
+            if (is_name(token)) {
+                return {0, false};
+            }
+            error_ = "Invalid token in preprocessor expression";
+            return {0, false};
+        }
+    }
+
+    Value apply(TokenType op, Value left, Value right, bool live) {
+        bool is_unsigned = left.is_unsigned || right.is_unsigned;
+        uint64_t a = left.bits;
+        uint64_t b = right.bits;
+        auto less = [&](uint64_t x, uint64_t y) {
+            return is_unsigned ? x < y : static_cast<int64_t>(x) < static_cast<int64_t>(y);
+        };
+        switch (op) {
+        case TokenType::OP_STAR:
+            return {a * b, is_unsigned};
+        case TokenType::OP_SLASH:
+        case TokenType::OP_PERCENT: {
+            if (b == 0) {
+                if (live) {
+                    error_ = "Division by zero in preprocessor expression";
+                }
+                return {0, is_unsigned};
+            }
+            bool divide = op == TokenType::OP_SLASH;
+            if (is_unsigned) {
+                return {divide ? a / b : a % b, true};
+            }
+            // INTMAX_MIN / -1 wraps rather than trapping
+            if (static_cast<int64_t>(b) == -1) {
+                return {divide ? 0 - a : 0, false};
+            }
+            int64_t x = static_cast<int64_t>(a);
+            int64_t y = static_cast<int64_t>(b);
+            return {static_cast<uint64_t>(divide ? x / y : x % y), false};
+        }
+        case TokenType::OP_PLUS:
+            return {a + b, is_unsigned};
+        case TokenType::OP_MINUS:
+            return {a - b, is_unsigned};
+        case TokenType::OP_LEFT_SHIFT:
+        case TokenType::OP_RIGHT_SHIFT: {
+            // The result has the type of the left operand, and shifting by a
+            // negative count shifts the other way
+            bool shift_left = op == TokenType::OP_LEFT_SHIFT;
+            if (!right.is_unsigned && static_cast<int64_t>(b) < 0) {
+                shift_left = !shift_left;
+                b = 0 - b;
+            }
+            if (shift_left) {
+                return {b >= 64 ? 0 : a << b, left.is_unsigned};
+            }
+            if (left.is_unsigned || static_cast<int64_t>(a) >= 0) {
+                return {b >= 64 ? 0 : a >> b, left.is_unsigned};
+            }
+            return {static_cast<uint64_t>(static_cast<int64_t>(a) >> (b >= 64 ? 63 : b)), false};
+        }
+        case TokenType::OP_LT:
+            return {less(a, b), false};
+        case TokenType::OP_GT:
+            return {less(b, a), false};
+        case TokenType::OP_LE:
+            return {!less(b, a), false};
+        case TokenType::OP_GE:
+            return {!less(a, b), false};
+        case TokenType::OP_EQ:
+            return {a == b, false};
+        case TokenType::OP_NE:
+            return {a != b, false};
+        case TokenType::OP_BITWISE_AND:
+            return {a & b, is_unsigned};
+        case TokenType::OP_BITWISE_XOR:
+            return {a ^ b, is_unsigned};
+        case TokenType::OP_BITWISE_OR:
+            return {a | b, is_unsigned};
+        default:
+            return left;
+        }
+    }
+
+    const Token* next_;
+    const Token* end_;
+    const char* error_ = nullptr;
+};
+
+} // namespace
+
+void append_spelling(std::string& out, const Token& token) {
+    if (token.type == TokenType::ERROR_TOKEN && token.string) {
+        // A character that is no other token, such as @, is one by itself
+        // (C99 6.10.3.5p7)
+        out += token.string->bytes;
+        return;
+    }
+    if (token.type != TokenType::CONSTANT_STRING && token.type != TokenType::CONSTANT_CHAR) {
+        out += token.value;
+        return;
+    }
+    char quote = token.type == TokenType::CONSTANT_STRING ? '"' : '\'';
+    if (token.has(TokenFlag::WIDE)) {
+        out += 'L';
+    }
+    out += quote;
+    out += token.value;
+    out += quote;
+}
+
+Preprocessor::Preprocessor(std::shared_ptr<const lexer::SourceBuffer> buffer, FileCache& cache,
+                           std::string path)
+    : cache_(cache), identifiers_(cache.identifiers()) {
+    start(std::move(buffer), std::move(path));
+}
+
+Preprocessor::Preprocessor(const std::string& path, FileCache& cache)
+    : Preprocessor(lexer::SourceBuffer::from_file(path), cache, path) {}
+
+Preprocessor::Preprocessor(std::shared_ptr<const lexer::SourceBuffer> buffer,
+                           lexer::IdentifierTable& identifiers)
+    : own_cache_(std::make_unique<FileCache>(identifiers)), cache_(*own_cache_),
+      identifiers_(identifiers) {
+    start(std::move(buffer), std::string());
+}
+
+void Preprocessor::start(std::shared_ptr<const lexer::SourceBuffer> buffer, std::string path) {
+    lexer::IdentifierTable& identifiers = identifiers_;
+    define_ = identifiers.intern("define");
+    undef_ = identifiers.intern("undef");
+    if_ = identifiers.intern("if");
+    ifdef_ = identifiers.intern("ifdef");
+    ifndef_ = identifiers.intern("ifndef");
+    elif_ = identifiers.intern("elif");
+    else_ = identifiers.intern("else");
+    endif_ = identifiers.intern("endif");
+    include_ = identifiers.intern("include");
+    line_ = identifiers.intern("line");
+    error_ = identifiers.intern("error");
+    pragma_ = identifiers.intern("pragma");
+    defined_ = identifiers.intern("defined");
+    va_args_ = identifiers.intern("__VA_ARGS__");
+    once_id_ = identifiers.intern("once");
+
+    for (auto [name, builtin] : {std::pair("__LINE__", Macro::Builtin::LINE),
+                                 std::pair("__FILE__", Macro::Builtin::FILE)}) {
+        IdentifierId id = identifiers.intern(name);
+        if (id >= macros_.size()) {
+            macros_.resize(id + 1);
+        }
+        macros_[id] = arena_.make<Macro>();
+        macros_[id]->builtin = builtin;
+    }
+
+    main_ = lex_file(std::move(path), std::move(buffer), identifiers);
+    frames_.push_back(Frame{main_.get(), main_->tokens.data(), 0, 0});
+    inclusions_.push_back(Inclusion{0, main_.get()});
+    next_base_ = main_->buffer->size() + 1;
+}
+
+void Preprocessor::add_include_directory(std::string directory) {
+    include_directories_.push_back(std::move(directory));
+}
+
+Location Preprocessor::location(uint32_t offset) const {
+    auto it = std::upper_bound(inclusions_.begin(), inclusions_.end(), offset,
+                               [](uint32_t offset, const Inclusion& inclusion) {
+                                   return offset < inclusion.base;
+                               });
+    const Inclusion& inclusion = it[-1];
+    lexer::SourceLocation location = inclusion.file->buffer->location(offset - inclusion.base);
+    auto mark = std::upper_bound(line_marks_.begin(), line_marks_.end(), offset,
+                                 [](uint32_t offset, const LineMark& mark) {
+                                     return offset < mark.offset;
+                                 });
+    if (mark == line_marks_.begin() || mark[-1].offset < inclusion.base) {
+        return Location{inclusion.file->path, location.line, location.column};
+    }
+    return Location{mark[-1].name, mark[-1].line + (location.line - mark[-1].physical_line),
+                    location.column};
+}
+
+const Macro* Preprocessor::macro(std::string_view name) const {
+    return find(identifiers_.find(name));
+}
+
+Token Preprocessor::next_token() {
+    Token token(TokenType::END_OF_FILE, std::string_view(), 0);
+    next_expanded(token);
+    return token;
+}
+
+// The next token of the file being read; its END_OF_FILE again at the end
+Token Preprocessor::lex() {
+    if (pending_) {
+        Token token = *pending_;
+        pending_.reset();
+        return token;
+    }
+    Frame& frame = frames_.back();
+    Token token = *frame.next;
+    if (token.type != TokenType::END_OF_FILE) {
+        ++frame.next;
+    }
+    token.offset += frame.base;
+    return token;
+}
+
+// The next token from the source that is not part of a directive or a
+// skipped group. The end of an included file goes back to the includer.
+Token Preprocessor::next_source_token() {
+    for (;;) {
+        Token token = lex();
+        if (token.type == TokenType::PREPROCESSOR_HASH && token.has(TokenFlag::START_OF_LINE)) {
+            if (std::optional<Token> error = directive(token)) {
+                return *error;
+            }
+            continue;
+        }
+        if (token.type != TokenType::END_OF_FILE) {
+            return token;
+        }
+        // Conditionals cannot span files
+        std::optional<Token> error;
+        if (conditionals_.size() > frames_.back().conditionals) {
+            error = make_error(conditionals_.back().offset, "Unterminated conditional directive");
+            conditionals_.resize(frames_.back().conditionals);
+        }
+        if (frames_.size() == 1) {
+            if (error) {
+                pending_ = token;
+                return *error;
+            }
+            return token;
+        }
+        frames_.pop_back();
+        if (error) {
+            return *error;
+        }
+    }
+}
+
+// The next unexpanded token: from the innermost context that has any left,
+// or else from the source. Stops at the end of an argument being expanded.
+Preprocessor::Source Preprocessor::fetch(Token& token) {
+    while (!contexts_.empty()) {
+        Context& context = contexts_.back();
+        if (context.next != context.end) {
+            token = *context.next;
+            if (context.next++ == context.begin && context.macro) {
+                token.flags = (token.flags & ~kPositionFlags) | context.leading;
+            }
+            return Source::CONTEXT;
+        }
+        if (context.barrier) {
+            return Source::BARRIER;
+        }
+        pop_context();
+    }
+    token = next_source_token();
+    return Source::LEXER;
+}
+
+// The next fully expanded token; false at the end of an argument being
+// expanded
+bool Preprocessor::next_expanded(Token& token) {
+    for (;;) {
+        if (fetch(token) == Source::BARRIER) {
+            padding_ = 0;
+            return false;
+        }
+        token.flags |= std::exchange(padding_, 0);
+        if (!is_name(token) || token.has(TokenFlag::NO_EXPAND)) {
+            return true;
+        }
+        Macro* macro = find(token.ident);
+        if (!macro) {
+            return true;
+        }
+        if (macro->disabled) {
+            token.set(TokenFlag::NO_EXPAND);
+            return true;
+        }
+        if (!expand(token, *macro)) {
+            return true;
+        }
+    }
+}
+
+// Replaces an invocation of macro by a context reading its expansion.
+// Returns false if name is to be returned instead: a function-like macro's
+// name without arguments, or a token that stands for the whole invocation.
+bool Preprocessor::expand(Token& name, Macro& macro) {
+    LEXER_PHASE(MACRO_EXPANSION);
+    uint8_t position = name.flags & kPositionFlags;
+    if (macro.builtin != Macro::Builtin::NONE) {
+        // Where the source has got to, which is the end of the invocation
+        // that __LINE__ is part of
+        const Frame& frame = frames_.back();
+        const Token* last = frame.next - (frame.next != frame.file->tokens.data());
+        Location here = location(last->offset + frame.base);
+        if (macro.builtin == Macro::Builtin::LINE) {
+            size_t line = directive_line_ ? directive_line_ : here.line;
+            char digits[24];
+            char* end = std::to_chars(digits, digits + sizeof(digits), line).ptr;
+            name = make_int(line, arena_.copy(std::string_view(digits, end - digits)), name.offset);
+        } else {
+            escaped_.clear();
+            for (char c : here.file) {
+                if (c == '"' || c == '\\') {
+                    escaped_ += '\\';
+                }
+                escaped_ += c;
+            }
+            name = Token(TokenType::CONSTANT_STRING, arena_.copy(escaped_), name.offset);
+            name.string = arena_.make<lexer::StringLiteral>(arena_.copy(here.file));
+        }
+        name.flags = position;
+        return false;
+    }
+    if (!macro.function_like && !macro.pastes) {
+        if (macro.size) {
+            push_context(macro.body, macro.body + macro.size, &macro, position);
+        } else {
+            padding_ = position;
+        }
+        return true;
+    }
+
+    std::unique_ptr<Arguments> args;
+    if (macro.function_like) {
+        // Only an invocation if '(' comes next; otherwise put that token back
+        Token paren = name;
+        Source source = fetch(paren);
+        if (source == Source::BARRIER) {
+            return false;
+        }
+        if (paren.type != TokenType::DELIMITER_LPAREN) {
+            if (source == Source::CONTEXT) {
+                --contexts_.back().next;
+            } else {
+                pending_ = paren;
+            }
+            return false;
+        }
+        args = take_arguments();
+        Token error = name;
+        if (!collect_arguments(name, macro, *args, error)) {
+            give_back(std::move(args));
+            name = error;
+            return false;
+        }
+    } else {
+        args = take_arguments();
+    }
+    std::vector<Token> out = take_buffer();
+    substitute(macro, *args, out);
+    give_back(std::move(args));
+    if (out.empty()) {
+        give_back(std::move(out));
+        padding_ = position;
+        return true;
+    }
+    const Token* begin = out.data();
+    const Token* end = begin + out.size();
+    push_context(begin, end, &macro, position, std::move(out));
+    return true;
+}
+
+// Reads the arguments of an invocation, after its '(', up to the matching ')'
+bool Preprocessor::collect_arguments(const Token& name, const Macro& macro, Arguments& args,
+                                     Token& error) {
+    args.raw.clear();
+    args.raw_ends.clear();
+    size_t depth = 0;
+    for (;;) {
+        Token token = name;
+        Source source = fetch(token);
+        if (source == Source::BARRIER || token.type == TokenType::END_OF_FILE) {
+            if (source == Source::LEXER) {
+                pending_ = token;
+            }
+            spelling_ = "Unterminated argument list invoking macro \"";
+            spelling_ += name.value;
+            spelling_ += '"';
+            error = make_error(name.offset, spelling_);
+            return false;
+        }
+        if (token.type == TokenType::DELIMITER_LPAREN) {
+            ++depth;
+        } else if (token.type == TokenType::DELIMITER_RPAREN) {
+            if (depth-- == 0) {
+                break;
+            }
+        } else if (token.type == TokenType::DELIMITER_COMMA && depth == 0 &&
+                   !(macro.variadic && args.raw_ends.size() + 1 >= macro.parameters)) {
+            args.raw_ends.push_back(static_cast<uint32_t>(args.raw.size()));
+            continue;
+        } else if (is_name(token) && !token.has(TokenFlag::NO_EXPAND)) {
+            // A name whose macro is being expanded stays unexpandable even if
+            // that expansion ends before the argument is used
+            if (const Macro* m = find(token.ident); m && m->disabled) {
+                token.set(TokenFlag::NO_EXPAND);
+            }
+        }
+        args.raw.push_back(token);
+    }
+    args.raw_ends.push_back(static_cast<uint32_t>(args.raw.size()));
+
+    // f() passes no arguments to a macro without parameters, and a variadic
+    // macro may be given none for its ...
+    size_t count = args.raw_ends.size();
+    if (macro.parameters == 0 && count == 1 && args.raw.empty()) {
+        args.raw_ends.clear();
+        count = 0;
+    } else if (macro.variadic && count + 1 == macro.parameters) {
+        args.raw_ends.push_back(static_cast<uint32_t>(args.raw.size()));
+        ++count;
+    }
+    if (count != macro.parameters) {
+        spelling_ = count < macro.parameters ? "Too few" : "Too many";
+        spelling_ += " arguments in invocation of macro \"";
+        spelling_ += name.value;
+        spelling_ += '"';
+        error = make_error(name.offset, spelling_);
+        return false;
+    }
+    args.expanded.clear();
+    args.expanded_begins.assign(count, UINT32_MAX);
+    args.expanded_ends.assign(count, UINT32_MAX);
+    return true;
+}
+
+// Builds the replacement list of an invocation (C99 6.10.3.1-3): parameters
+// are replaced by their fully expanded argument, except next to ## or after
+// #, where the argument is used as written, and ## operands are pasted
+void Preprocessor::substitute(const Macro& macro, Arguments& args, std::vector<Token>& out) {
+    auto raw = [&](uint32_t i) -> std::pair<const Token*, const Token*> {
+        const Token* data = args.raw.data();
+        return {data + (i ? args.raw_ends[i - 1] : 0), data + args.raw_ends[i]};
+    };
+    // Whether the last operand was an empty argument, a placemarker for ##,
+    // and the position flags it would have passed on
+    bool placemarker = false;
+    uint8_t placemarker_position = 0;
+    for (uint32_t i = 0; i < macro.size; ++i) {
+        const Token& token = macro.body[i];
+        if (token.type == TokenType::PREPROCESSOR_HASH_HASH) {
+            const Token& right = macro.body[++i];
+            const Token* begin = &right;
+            const Token* end = begin + 1;
+            Token stringified = right;
+            if (right.has(TokenFlag::PARAMETER)) {
+                std::tie(begin, end) = raw(right.ident);
+                if (right.type == TokenType::PREPROCESSOR_HASH) {
+                    stringified = stringify(begin, end, right.offset);
+                    begin = &stringified;
+                    end = begin + 1;
+                }
+            }
+            if (begin == end) {
+                continue;
+            }
+            if (placemarker) {
+                size_t first = out.size();
+                out.insert(out.end(), begin, end);
+                out[first].flags = (out[first].flags & ~kPositionFlags) | placemarker_position;
+            } else if (Token pasted = out.back(); paste(pasted, *begin)) {
+                out.back() = pasted;
+                out.insert(out.end(), begin + 1, end);
+            } else {
+                spelling_ = "Pasting \"";
+                append_spelling(spelling_, out.back());
+                spelling_ += "\" and \"";
+                append_spelling(spelling_, *begin);
+                spelling_ += "\" does not give a valid preprocessing token";
+                out.push_back(make_error(begin->offset, spelling_));
+                out.insert(out.end(), begin, end);
+            }
+            placemarker = false;
+            continue;
+        }
+        if (!token.has(TokenFlag::PARAMETER)) {
+            out.push_back(token);
+            placemarker = false;
+            continue;
+        }
+        if (token.type == TokenType::PREPROCESSOR_HASH) {
+            auto [begin, end] = raw(token.ident);
+            out.push_back(stringify(begin, end, token.offset));
+            out.back().flags = token.flags & kPositionFlags;
+            placemarker = false;
+            continue;
+        }
+        bool operand = i + 1 < macro.size && macro.body[i + 1].type == TokenType::PREPROCESSOR_HASH_HASH;
+        auto [begin, end] = operand ? raw(token.ident) : expanded_argument(args, token.ident);
+        if (begin != end) {
+            size_t first = out.size();
+            out.insert(out.end(), begin, end);
+            out[first].flags = (out[first].flags & ~kPositionFlags) | (token.flags & kPositionFlags);
+        }
+        placemarker = begin == end;
+        placemarker_position = token.flags & kPositionFlags;
+    }
+}
+
+// Argument i fully macro-expanded, expanding it on first use
+std::pair<const Token*, const Token*> Preprocessor::expanded_argument(Arguments& args, uint32_t i) {
+    if (args.expanded_ends[i] == UINT32_MAX) {
+        const Token* data = args.raw.data();
+        args.expanded_begins[i] = static_cast<uint32_t>(args.expanded.size());
+        expand_range(data + (i ? args.raw_ends[i - 1] : 0), data + args.raw_ends[i], args.expanded);
+        args.expanded_ends[i] = static_cast<uint32_t>(args.expanded.size());
+    }
+    const Token* data = args.expanded.data();
+    return {data + args.expanded_begins[i], data + args.expanded_ends[i]};
+}
+
+// Expands [begin, end) as if it were the rest of the file, appending the
+// result to out
+void Preprocessor::expand_range(const Token* begin, const Token* end, std::vector<Token>& out) {
+    contexts_.push_back(Context{begin, begin, end, nullptr, true, 0, {}});
+    Token token(TokenType::END_OF_FILE, std::string_view(), 0);
+    while (next_expanded(token)) {
+        out.push_back(token);
+    }
+    contexts_.pop_back();
+}
+
+void Preprocessor::push_context(const Token* begin, const Token* end, Macro* macro,
+                                uint8_t leading, std::vector<Token> owned) {
+    macro->disabled = true;
+    contexts_.push_back(Context{begin, begin, end, macro, false, leading, std::move(owned)});
+}
+
+void Preprocessor::pop_context() {
+    Context& context = contexts_.back();
+    if (context.macro) {
+        context.macro->disabled = false;
+    }
+    if (context.owned.capacity()) {
+        give_back(std::move(context.owned));
+    }
+    contexts_.pop_back();
+}
+
+// The string literal `# param` makes of an argument (C99 6.10.3.2): its
+// spelling with the spacing between tokens reduced to single spaces. The
+// token's value escapes '"' and '\' inside literals; its contents do not.
+Token Preprocessor::stringify(const Token* begin, const Token* end, uint32_t offset) {
+    spelling_.clear();
+    escaped_.clear();
+    for (const Token* p = begin; p != end; ++p) {
+        if (p != begin && p->has(TokenFlag::LEADING_SPACE)) {
+            spelling_ += ' ';
+            escaped_ += ' ';
+        }
+        size_t from = spelling_.size();
+        append_spelling(spelling_, *p);
+        if (p->type != TokenType::CONSTANT_STRING && p->type != TokenType::CONSTANT_CHAR) {
+            escaped_.append(spelling_, from);
+            continue;
+        }
+        for (size_t i = from; i < spelling_.size(); ++i) {
+            if (spelling_[i] == '"' || spelling_[i] == '\\') {
+                escaped_ += '\\';
+            }
+            escaped_ += spelling_[i];
+        }
+    }
+    Token token(TokenType::CONSTANT_STRING, arena_.copy(escaped_), offset);
+    token.string = arena_.make<lexer::StringLiteral>(arena_.copy(spelling_));
+    return token;
+}
+
+// Pastes right onto the end of left (C99 6.10.3.3). Returns false, leaving
+// left alone, if the result is not a single token.
+bool Preprocessor::paste(Token& left, const Token& right) {
+    spelling_.clear();
+    append_spelling(spelling_, left);
+    append_spelling(spelling_, right);
+    std::string_view text = arena_.copy(spelling_);
+    uint8_t position = left.flags & kPositionFlags;
+
+    // Names are the usual result, and need no lexer
+    if (!text.empty() && !(text[0] >= '0' && text[0] <= '9')) {
+        size_t i = 0;
+        while (i < text.size() && is_identifier_char(text[i])) {
+            ++i;
+        }
+        if (i == text.size()) {
+            left = Token(lexer::c99_keyword_table.lookup(text), text, left.offset);
+            left.ident = identifiers_.intern(text);
+            left.flags = position;
+            return true;
+        }
+    }
+
+    lexer::Lexer lexer(lexer::SourceBuffer::borrow(text), &identifiers_);
+    Token token = lexer.next_token();
+    if (token.type == TokenType::ERROR_TOKEN || token.offset != 0 ||
+        lexer.position() != text.size()) {
+        return false;
+    }
+    // Decoded string contents belong to the lexer, which is going away
+    if (token.type == TokenType::CONSTANT_STRING) {
+        token.string = arena_.make<lexer::StringLiteral>(arena_.copy(token.string->bytes),
+                                                         token.string->wide);
+    }
+    token.offset = left.offset;
+    token.flags = position | (token.flags & static_cast<uint8_t>(TokenFlag::WIDE));
+    left = token;
+    return true;
+}
+
+// Handles the directive whose '#' has just been read. Returns an error
+// token for a malformed one.
+std::optional<Token> Preprocessor::directive(const Token& hash) {
+    LEXER_PHASE(DIRECTIVE);
+    Token name = hash;
+    if (!line_token(name)) {
+        return std::nullopt; // The null directive
+    }
+    std::optional<Token> error;
+    if (!is_name(name)) {
+        error = make_error(name.offset, "Invalid preprocessing directive");
+    } else if (name.ident == define_) {
+        return define(hash);
+    } else if (name.ident == undef_) {
+        Token token = name;
+        if (!line_token(token) || !is_name(token)) {
+            error = make_error(name.offset, "Macro name missing");
+        } else if (find(token.ident) && find(token.ident)->builtin == Macro::Builtin::NONE) {
+            macros_[token.ident] = nullptr;
+        }
+    } else if (name.ident == if_ || name.ident == ifdef_ || name.ident == ifndef_ ||
+               name.ident == elif_ || name.ident == else_ || name.ident == endif_) {
+        return conditional(hash, name.ident);
+    } else if (name.ident == error_) {
+        spelling_ = "#error";
+        for (Token token = name; line_token(token);) {
+            spelling_ += ' ';
+            append_spelling(spelling_, token);
+        }
+        return make_error(hash.offset, spelling_);
+    } else if (name.ident == include_) {
+        return include(hash);
+    } else if (name.ident == pragma_) {
+        Token token = name;
+        if (line_token(token) && is_name(token) && token.ident == once_id_) {
+            once_.insert(frames_.back().file);
+        }
+    } else if (name.ident == line_) {
+        return line_directive(hash, name);
+    } else {
+        error = make_error(name.offset, "Invalid preprocessing directive");
+    }
+    skip_line();
+    return error;
+}
+
+// Reads the next token of the directive line, if the line goes on
+bool Preprocessor::line_token(Token& token) {
+    token = lex();
+    if (token.has(TokenFlag::START_OF_LINE) || token.type == TokenType::END_OF_FILE) {
+        pending_ = token;
+        return false;
+    }
+    return true;
+}
+
+void Preprocessor::skip_line() {
+    Token token(TokenType::END_OF_FILE, std::string_view(), 0);
+    while (line_token(token)) {
+    }
+}
+
+std::optional<Token> Preprocessor::define(const Token& hash) {
+    std::vector<Token> body = take_buffer();
+    parameters_.clear();
+    auto fail = [&](uint32_t offset, std::string_view message) {
+        skip_line();
+        give_back(std::move(body));
+        return make_error(offset, message);
+    };
+    auto parameter = [&](const Token& token) -> uint32_t {
+        for (uint32_t i = 0; i < parameters_.size(); ++i) {
+            if (parameters_[i] == token.ident) {
+                return i;
+            }
+        }
+        return UINT32_MAX;
+    };
+
+    Token name = hash;
+    if (!line_token(name) || !is_name(name)) {
+        return fail(hash.offset, "Macro name missing");
+    }
+    if (name.ident == defined_ ||
+        (find(name.ident) && find(name.ident)->builtin != Macro::Builtin::NONE)) {
+        return fail(name.offset, "Invalid macro name");
+    }
+
+    Macro macro;
+    Token token = name;
+    bool more = line_token(token);
+    if (more && token.type == TokenType::DELIMITER_LPAREN &&
+        !token.has(TokenFlag::LEADING_SPACE)) {
+        macro.function_like = true;
+        for (bool first = true;; first = false) {
+            if (!line_token(token)) {
+                return fail(token.offset, "Missing ')' in macro parameter list");
+            }
+            if (first && token.type == TokenType::DELIMITER_RPAREN) {
+                break;
+            }
+            if (token.type == TokenType::DELIMITER_ELLIPSIS) {
+                macro.variadic = true;
+                parameters_.push_back(va_args_);
+                if (!line_token(token) || token.type != TokenType::DELIMITER_RPAREN) {
+                    return fail(token.offset, "Missing ')' after \"...\"");
+                }
+                break;
+            }
+            if (!is_name(token) || token.ident == va_args_) {
+                return fail(token.offset, "Invalid macro parameter");
+            }
+            if (parameter(token) != UINT32_MAX) {
+                return fail(token.offset, "Duplicate macro parameter");
+            }
+            parameters_.push_back(token.ident);
+            if (!line_token(token)) {
+                return fail(token.offset, "Missing ')' in macro parameter list");
+            }
+            if (token.type == TokenType::DELIMITER_RPAREN) {
+                break;
+            }
+            if (token.type != TokenType::DELIMITER_COMMA) {
+                return fail(token.offset, "Expected ',' or ')' in macro parameter list");
+            }
+        }
+        more = line_token(token);
+    }
+
+    for (; more; more = line_token(token)) {
+        if (is_name(token)) {
+            if (uint32_t i = parameter(token); i != UINT32_MAX) {
+                token.set(TokenFlag::PARAMETER);
+                token.ident = i;
+            } else if (token.ident == va_args_) {
+                return fail(token.offset, "__VA_ARGS__ can only appear in a variadic macro");
+            }
+        } else if (macro.function_like && token.type == TokenType::PREPROCESSOR_HASH) {
+            Token operand = token;
+            uint32_t i = UINT32_MAX;
+            if (!line_token(operand) || !is_name(operand) ||
+                (i = parameter(operand)) == UINT32_MAX) {
+                return fail(token.offset, "'#' is not followed by a macro parameter");
+            }
+            token.set(TokenFlag::PARAMETER);
+            token.ident = i;
+        }
+        body.push_back(token);
+    }
+    if (!body.empty() && (body.front().type == TokenType::PREPROCESSOR_HASH_HASH ||
+                          body.back().type == TokenType::PREPROCESSOR_HASH_HASH)) {
+        return fail(body.front().offset, "'##' cannot appear at either end of a macro expansion");
+    }
+
+    for (const Token& token : body) {
+        macro.pastes = macro.pastes || token.type == TokenType::PREPROCESSOR_HASH_HASH;
+    }
+    Token* stored = static_cast<Token*>(arena_.allocate(body.size() * sizeof(Token), alignof(Token)));
+    std::uninitialized_copy(body.begin(), body.end(), stored);
+    macro.body = stored;
+    macro.size = static_cast<uint32_t>(body.size());
+    macro.parameters = static_cast<uint32_t>(parameters_.size());
+    if (!parameters_.empty()) {
+        IdentifierId* names = static_cast<IdentifierId*>(
+            arena_.allocate(parameters_.size() * sizeof(IdentifierId), alignof(IdentifierId)));
+        std::copy(parameters_.begin(), parameters_.end(), names);
+        macro.parameter_names = names;
+    }
+    give_back(std::move(body));
+
+    // An incompatible redefinition is diagnosed, and still replaces the old one
+    std::optional<Token> error;
+    if (const Macro* previous = find(name.ident); previous && !same_definition(*previous, macro)) {
+        spelling_ = "'";
+        spelling_ += name.value;
+        spelling_ += "' redefined";
+        error = make_error(name.offset, spelling_);
+    }
+    if (name.ident >= macros_.size()) {
+        macros_.resize(name.ident + 1);
+    }
+    macros_[name.ident] = arena_.make<Macro>(macro);
+    return error;
+}
+
+// #include "name" or <name>, written out or produced by macros (C99 6.10.2)
+std::optional<Token> Preprocessor::include(const Token& hash) {
+    std::vector<Token> line = take_buffer();
+    for (Token token = hash; line_token(token);) {
+        line.push_back(token);
+    }
+    bool expanded = !line.empty() && line[0].type != TokenType::CONSTANT_STRING &&
+                    line[0].type != TokenType::OP_LT;
+    if (expanded) {
+        std::vector<Token> out = take_buffer();
+        expand_range(line.data(), line.data() + line.size(), out);
+        std::swap(line, out);
+        give_back(std::move(out));
+    }
+
+    // The header name, in spelling_
+    bool angled = false;
+    bool valid = false;
+    spelling_.clear();
+    if (!line.empty() && line[0].type == TokenType::CONSTANT_STRING &&
+        !line[0].has(TokenFlag::WIDE)) {
+        spelling_ = line[0].value;
+        valid = true;
+    } else if (!line.empty() && line[0].type == TokenType::OP_LT) {
+        angled = true;
+        size_t close = 1;
+        while (close < line.size() && line[close].type != TokenType::OP_GT) {
+            ++close;
+        }
+        valid = close < line.size();
+        if (valid && !expanded) {
+            // As written, which the tokens between < and > need not spell
+            const Frame& frame = frames_.back();
+            uint32_t begin = line[0].offset + 1 - frame.base;
+            spelling_ = frame.file->buffer->text().substr(begin, line[close].offset - frame.base - begin);
+        } else if (valid) {
+            for (size_t i = 1; i < close; ++i) {
+                if (i > 1 && line[i].has(TokenFlag::LEADING_SPACE)) {
+                    spelling_ += ' ';
+                }
+                append_spelling(spelling_, line[i]);
+            }
+        }
+    }
+    give_back(std::move(line));
+    if (!valid || spelling_.empty()) {
+        return make_error(hash.offset, "#include expects \"FILENAME\" or <FILENAME>");
+    }
+
+    const SourceFile* file = find_include(spelling_, angled);
+    if (!file) {
+        spelling_.insert(0, "'");
+        spelling_ += "' file not found";
+        return make_error(hash.offset, spelling_);
+    }
+    return push_file(file, hash.offset);
+}
+
+// The file name refers to: by absolute path, or next to the including file
+// for a quoted name, or in the include directories
+const SourceFile* Preprocessor::find_include(std::string_view name, bool angled) {
+    if (name[0] == '/') {
+        return cache_.open(name);
+    }
+    std::string& path = path_;
+    path.clear();
+    if (!angled) {
+        const std::string& includer = frames_.back().file->path;
+        size_t slash = includer.rfind('/');
+        if (slash != std::string::npos) {
+            path.assign(includer, 0, slash + 1);
+        }
+        path += name;
+        if (const SourceFile* file = cache_.open(path)) {
+            return file;
+        }
+    }
+    for (const std::string& directory : include_directories_) {
+        path = directory;
+        if (!path.empty() && path.back() != '/') {
+            path += '/';
+        }
+        path += name;
+        if (const SourceFile* file = cache_.open(path)) {
+            return file;
+        }
+    }
+    return nullptr;
+}
+
+// #line digit-sequence "s-char-sequence"opt, after macro expansion (C99
+// 6.10.4): numbers the next line, and renames the file if a name is given
+std::optional<Token> Preprocessor::line_directive(const Token& hash, const Token& name) {
+    std::vector<Token> line = take_buffer();
+    uint32_t last = name.offset; // Of the directive's last token
+    for (Token token = name; line_token(token);) {
+        last = token.offset;
+        line.push_back(token);
+    }
+    std::vector<Token> expanded = take_buffer();
+    directive_line_ = location(last).line;
+    expand_range(line.data(), line.data() + line.size(), expanded);
+    directive_line_ = 0;
+
+    uint64_t number = 0;
+    bool valid = (expanded.size() == 1 || expanded.size() == 2) &&
+                 expanded[0].type == TokenType::CONSTANT_INT;
+    if (valid) {
+        std::string_view digits = expanded[0].value;
+        auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), number);
+        valid = error == std::errc() && end == digits.data() + digits.size() &&
+                number >= 1 && number <= INT32_MAX;
+    }
+    if (valid && expanded.size() == 2) {
+        valid = expanded[1].type == TokenType::CONSTANT_STRING &&
+                !expanded[1].has(TokenFlag::WIDE);
+    }
+    if (valid) {
+        const Frame& frame = frames_.back();
+        std::string_view file = expanded.size() == 2 ? arena_.copy(expanded[1].string->bytes)
+                                                     : location(last).file;
+        LineMark mark{last + 1, frame.file->buffer->location(last - frame.base).line + 1, number,
+                      file};
+        auto at = std::upper_bound(line_marks_.begin(), line_marks_.end(), mark.offset,
+                                   [](uint32_t offset, const LineMark& mark) {
+                                       return offset < mark.offset;
+                                   });
+        line_marks_.insert(at, mark);
+    }
+    give_back(std::move(expanded));
+    give_back(std::move(line));
+    if (!valid) {
+        return make_error(hash.offset, "#line expects a line number and optional \"FILENAME\"");
+    }
+    return std::nullopt;
+}
+
+// Starts reading file where an #include of it was, unless a guard or
+// #pragma once says it would add nothing
+std::optional<Token> Preprocessor::push_file(const SourceFile* file, uint32_t offset) {
+    FileCache::Stats& stats = cache_.stats();
+    ++stats.includes;
+    if (once_.count(file)) {
+        ++stats.once_skips;
+        return std::nullopt;
+    }
+    if (file->guard != lexer::kNoIdentifier && find(file->guard)) {
+        ++stats.guard_skips;
+        return std::nullopt;
+    }
+    if (frames_.size() >= kMaxIncludeDepth) {
+        return make_error(offset, "#include nested too deeply");
+    }
+    if (next_base_ + file->buffer->size() + 1 > UINT32_MAX) {
+        return make_error(offset, "Included text does not fit in 32-bit offsets");
+    }
+
+    // The includer goes on from the line after the #include, which has
+    // already been read
+    if (pending_) {
+        if (pending_->type != TokenType::END_OF_FILE) {
+            --frames_.back().next;
+        }
+        pending_.reset();
+    }
+    uint32_t base = static_cast<uint32_t>(next_base_);
+    next_base_ += file->buffer->size() + 1;
+    inclusions_.push_back(Inclusion{base, file});
+    frames_.push_back(Frame{file, file->tokens.data(), base, conditionals_.size()});
+    return std::nullopt;
+}
+
+// #if, #ifdef, #ifndef, #elif, #else or #endif met outside a skipped group
+std::optional<Token> Preprocessor::conditional(const Token& hash, IdentifierId kind) {
+    if (kind == if_ || kind == ifdef_ || kind == ifndef_) {
+        bool value = false;
+        std::optional<Token> error;
+        if (kind == if_) {
+            error = evaluate_condition(hash, value);
+        } else {
+            Token name = hash;
+            if (!line_token(name) || !is_name(name)) {
+                error = make_error(hash.offset, "Macro name missing");
+            } else {
+                value = (find(name.ident) != nullptr) == (kind == ifdef_);
+            }
+            skip_line();
+        }
+        conditionals_.push_back(Conditional{hash.offset, value, false});
+        if (!value) {
+            std::optional<Token> skip_error = skip_group();
+            return error ? error : skip_error;
+        }
+        return error;
+    }
+
+    skip_line();
+    if (conditionals_.empty()) {
+        return make_error(hash.offset, "Conditional directive without #if");
+    }
+    if (kind == endif_) {
+        conditionals_.pop_back();
+        return std::nullopt;
+    }
+    // The group that just ended was the one taken, so the rest is skipped
+    Conditional& conditional = conditionals_.back();
+    std::optional<Token> error;
+    if (conditional.seen_else) {
+        error = make_error(hash.offset, "Conditional directive after #else");
+    }
+    conditional.seen_else = conditional.seen_else || kind == else_;
+    std::optional<Token> skip_error = skip_group();
+    return error ? error : skip_error;
+}
+
+// Evaluates the rest of an #if or #elif line. value is false if it fails.
+std::optional<Token> Preprocessor::evaluate_condition(const Token& hash, bool& value) {
+    value = false;
+    std::vector<Token> line = take_buffer();
+    std::optional<Token> error;
+    uint32_t last = hash.offset; // Of the directive's last token
+
+    // `defined` is replaced before macros are expanded
+    for (Token token = hash; !error && line_token(token);) {
+        last = token.offset;
+        if (!is_name(token) || token.ident != defined_) {
+            line.push_back(token);
+            continue;
+        }
+        Token operand = token;
+        bool paren = line_token(operand) && operand.type == TokenType::DELIMITER_LPAREN;
+        if ((paren && !line_token(operand)) || !is_name(operand) || operand.has(TokenFlag::START_OF_LINE)) {
+            error = make_error(token.offset, "Macro name missing after \"defined\"");
+            break;
+        }
+        Token close = operand;
+        if (paren && (!line_token(close) || close.type != TokenType::DELIMITER_RPAREN)) {
+            error = make_error(token.offset, "Missing ')' after \"defined\"");
+            break;
+        }
+        last = close.offset;
+        bool is_defined = find(operand.ident) != nullptr;
+        line.push_back(make_int(is_defined, is_defined ? "1" : "0", token.offset));
+    }
+    skip_line();
+
+    if (!error) {
+        // By now the next line has been read, so __LINE__ is taken from here
+        directive_line_ = location(last).line;
+        std::vector<Token> expanded = take_buffer();
+        expand_range(line.data(), line.data() + line.size(), expanded);
+        directive_line_ = 0;
+        Evaluator evaluator(expanded);
+        if (!evaluator.evaluate(value)) {
+            error = make_error(hash.offset, evaluator.error());
+            value = false;
+        }
+        give_back(std::move(expanded));
+    }
+    give_back(std::move(line));
+    return error;
+}
+
+// Skips lines up to the #elif whose condition holds, #else or #endif that
+// ends the group being skipped, at this nesting level (C99 6.10.1p6)
+std::optional<Token> Preprocessor::skip_group() {
+    std::optional<Token> error;
+    size_t depth = 0;
+    for (;;) {
+        Token hash = lex();
+        if (hash.type == TokenType::END_OF_FILE) {
+            pending_ = hash;
+            return error;
+        }
+        Token name = hash;
+        if (hash.type != TokenType::PREPROCESSOR_HASH || !hash.has(TokenFlag::START_OF_LINE) ||
+            !line_token(name) || !is_name(name)) {
+            continue;
+        }
+        IdentifierId id = name.ident;
+        if (id == if_ || id == ifdef_ || id == ifndef_) {
+            ++depth;
+            continue;
+        }
+        if (depth > 0) {
+            depth -= id == endif_;
+            continue;
+        }
+        Conditional& conditional = conditionals_.back();
+        if (id == endif_) {
+            skip_line();
+            conditionals_.pop_back();
+            return error;
+        }
+        if (id != elif_ && id != else_) {
+            continue;
+        }
+        if (conditional.seen_else && !error) {
+            error = make_error(hash.offset, "Conditional directive after #else");
+        }
+        if (id == else_) {
+            skip_line();
+            conditional.seen_else = true;
+            if (!conditional.taken) {
+                conditional.taken = true;
+                return error;
+            }
+        } else if (!conditional.taken && !conditional.seen_else) {
+            bool value;
+            std::optional<Token> condition_error = evaluate_condition(hash, value);
+            if (!error) {
+                error = condition_error;
+            }
+            if (value) {
+                conditional.taken = true;
+                return error;
+            }
+        }
+    }
+}
+
+Token Preprocessor::make_error(uint32_t offset, std::string_view message) {
+    return Token(TokenType::ERROR_TOKEN, arena_.copy(message), offset);
+}
+
+std::vector<Token> Preprocessor::take_buffer() {
+    if (spare_buffers_.empty()) {
+        return {};
+    }
+    std::vector<Token> buffer = std::move(spare_buffers_.back());
+    spare_buffers_.pop_back();
+    return buffer;
+}
+
+void Preprocessor::give_back(std::vector<Token>&& buffer) {
+    buffer.clear();
+    spare_buffers_.push_back(std::move(buffer));
+}
+
+std::unique_ptr<Preprocessor::Arguments> Preprocessor::take_arguments() {
+    if (spare_arguments_.empty()) {
+        return std::make_unique<Arguments>();
+    }
+    std::unique_ptr<Arguments> args = std::move(spare_arguments_.back());
+    spare_arguments_.pop_back();
+    return args;
+}
+
+void Preprocessor::give_back(std::unique_ptr<Arguments> args) {
+    spare_arguments_.push_back(std::move(args));
+}
+
+} // namespace preprocessor
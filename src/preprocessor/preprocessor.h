@@ -0,0 +1,243 @@
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
+#include "../lexer/arena.h"
+#include "../lexer/identifier_table.h"
+#include "../lexer/source_buffer.h"
+#include "../lexer/token.h"
+#include "file_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace preprocessor {
+
+using lexer::IdentifierId;
+using lexer::Token;
+using lexer::TokenType;
+
+// A macro definition. The body is the replacement list as lexed, stored in
+// the preprocessor's arena: its tokens view the source buffer, so defining a
+// macro copies no spellings. Parameter uses are PARAMETER-flagged tokens
+// whose ident is the argument number, and `# param` is a single
+// PREPROCESSOR_HASH token flagged the same way.
+struct Macro {
+    const Token* body = nullptr;
+    uint32_t size = 0;
+    uint32_t parameters = 0; // Named parameters, plus one for __VA_ARGS__
+    const IdentifierId* parameter_names = nullptr; // Of the parameters, in order
+    bool function_like = false;
+    bool variadic = false;
+    bool pastes = false;     // The body has ##, so it cannot be read in place
+    bool disabled = false;   // Being expanded, so its name is not replaced again
+    enum class Builtin : uint8_t { NONE, LINE, FILE } builtin = Builtin::NONE;
+};
+
+// Where a token offset points, through the include stack
+struct Location {
+    std::string_view file; // As it was found; empty for a buffer with no name
+    size_t line;
+    size_t column;
+};
+
+// Translation phase 4 (directives and macro expansion) on top of the lexer:
+// #define and #undef, object-like and function-like macros with # and ##,
+// #if, #ifdef, #ifndef, #elif, #else and #endif, #include and #line.
+//
+// Each file is lexed once into a SourceFile, and included files come from a
+// FileCache, so a header is never lexed twice however often it is included;
+// one whose include guard is defined, or that said #pragma once, is not even
+// read again. Files being read form a stack of cursors into their token
+// arrays, and no text is ever concatenated.
+//
+// Expanding a macro pushes a context that reads the tokens of its body in
+// place; only function-like macros build a substituted copy, in buffers that
+// are recycled once read.
+// A macro is disabled while any context of its expansion is being read,
+// which is what stops recursion, and a name met while its macro is disabled
+// is flagged NO_EXPAND for good.
+//
+// Every token returned carries START_OF_LINE and LEADING_SPACE flags. Tokens
+// stay valid as long as the preprocessor and its cache; those from a macro
+// body keep the offset of their spelling in the definition. Offsets are
+// positions in the main buffer followed by every inclusion of a file in
+// turn, which location() maps back to a file, line and column as #line has
+// renumbered and renamed them. Malformed
+// directives and invocations produce ERROR_TOKENs, after which
+// preprocessing goes on.
+class Preprocessor {
+public:
+    // Most nested #includes allowed
+    static constexpr size_t kMaxIncludeDepth = 200;
+
+    // Preprocesses buffer, reading included files through cache. path names
+    // the buffer in __FILE__ and locations, and quoted includes are looked
+    // for in its directory first.
+    Preprocessor(std::shared_ptr<const lexer::SourceBuffer> buffer, FileCache& cache,
+                 std::string path = {});
+
+    // Preprocesses the file at path. Throws std::system_error if it cannot be
+    // read.
+    Preprocessor(const std::string& path, FileCache& cache);
+
+    // Preprocesses buffer with a cache of its own. Identifiers and keywords
+    // are interned into identifiers, and macros looked up by their ID.
+    Preprocessor(std::shared_ptr<const lexer::SourceBuffer> buffer,
+                 lexer::IdentifierTable& identifiers);
+
+    Preprocessor(const Preprocessor&) = delete;
+    Preprocessor& operator=(const Preprocessor&) = delete;
+
+    // The next token after preprocessing; END_OF_FILE at the end, forever.
+    Token next_token();
+
+    // The definition of name, or nullptr if it is not a macro.
+    const Macro* macro(std::string_view name) const;
+
+    // Directories searched for #include <...>, and after the including
+    // file's own directory for #include "...", in the order added.
+    void add_include_directory(std::string directory);
+
+    Location location(uint32_t offset) const;
+
+    lexer::IdentifierTable& identifiers() { return identifiers_; }
+    FileCache& cache() { return cache_; }
+    const std::shared_ptr<const lexer::SourceBuffer>& buffer() const { return main_->buffer; }
+
+private:
+    // Tokens being read in place of the source: a macro's body or
+    // substituted replacement list, or an argument being pre-expanded
+    struct Context {
+        const Token* begin;
+        const Token* next;
+        const Token* end;
+        Macro* macro;             // Re-enabled when the context runs out
+        bool barrier;             // An argument: reading stops at its end
+        uint8_t leading;          // START_OF_LINE and LEADING_SPACE of the macro name,
+                                  // given to the first token
+        std::vector<Token> owned; // Storage for a substituted list
+    };
+
+    // Unexpanded arguments of one invocation, and their expansions once needed
+    struct Arguments {
+        std::vector<Token> raw;
+        std::vector<uint32_t> raw_ends;      // Argument i is raw[raw_ends[i - 1], raw_ends[i])
+        std::vector<Token> expanded;
+        std::vector<uint32_t> expanded_ends; // UINT32_MAX until argument i is expanded
+        std::vector<uint32_t> expanded_begins;
+    };
+
+    struct Conditional {
+        uint32_t offset; // Of the #if, for diagnostics
+        bool taken;      // Some group of it has been included
+        bool seen_else;
+    };
+
+    // A file being read
+    struct Frame {
+        const SourceFile* file;
+        const Token* next;
+        uint32_t base;        // Added to its token offsets
+        size_t conditionals;  // Open when it was entered
+    };
+
+    // Where an inclusion starts in the offset space
+    struct Inclusion {
+        uint32_t base;
+        const SourceFile* file;
+    };
+
+    // A #line: from offset on, within its inclusion, physical_line is
+    // numbered line and the file is called name
+    struct LineMark {
+        uint32_t offset;
+        size_t physical_line;
+        size_t line;
+        std::string_view name;
+    };
+
+    enum class Source { CONTEXT, LEXER, BARRIER };
+
+    void start(std::shared_ptr<const lexer::SourceBuffer> buffer, std::string path);
+    Token lex();
+    Token next_source_token();
+    Source fetch(Token& token);
+    bool next_expanded(Token& token);
+    bool expand(Token& name, Macro& macro);
+    bool collect_arguments(const Token& name, const Macro& macro, Arguments& args,
+                           Token& error);
+    void substitute(const Macro& macro, Arguments& args, std::vector<Token>& out);
+    std::pair<const Token*, const Token*> expanded_argument(Arguments& args, uint32_t i);
+    void expand_range(const Token* begin, const Token* end, std::vector<Token>& out);
+    void push_context(const Token* begin, const Token* end, Macro* macro, uint8_t leading,
+                      std::vector<Token> owned = {});
+    void pop_context();
+    Token stringify(const Token* begin, const Token* end, uint32_t offset);
+    bool paste(Token& left, const Token& right);
+
+    std::optional<Token> directive(const Token& hash);
+    bool line_token(Token& token);
+    void skip_line();
+    std::optional<Token> define(const Token& hash);
+    std::optional<Token> include(const Token& hash);
+    const SourceFile* find_include(std::string_view name, bool angled);
+    std::optional<Token> line_directive(const Token& hash, const Token& name);
+    std::optional<Token> push_file(const SourceFile* file, uint32_t offset);
+    std::optional<Token> conditional(const Token& hash, IdentifierId kind);
+    std::optional<Token> evaluate_condition(const Token& hash, bool& value);
+    std::optional<Token> skip_group();
+
+    Macro* find(IdentifierId id) const {
+        return id < macros_.size() ? macros_[id] : nullptr;
+    }
+    Token make_error(uint32_t offset, std::string_view message);
+
+    std::vector<Token> take_buffer();
+    void give_back(std::vector<Token>&& buffer);
+    std::unique_ptr<Arguments> take_arguments();
+    void give_back(std::unique_ptr<Arguments> args);
+
+    std::unique_ptr<FileCache> own_cache_;
+    FileCache& cache_;
+    lexer::IdentifierTable& identifiers_;
+    std::unique_ptr<SourceFile> main_;
+    std::vector<Frame> frames_;            // The include stack, main file first
+    std::vector<Inclusion> inclusions_;    // By base
+    std::vector<LineMark> line_marks_;     // By offset
+    uint64_t next_base_ = 0;
+    std::vector<std::string> include_directories_;
+    std::unordered_set<const SourceFile*> once_; // Files that said #pragma once
+    std::optional<Token> pending_;     // Source token read ahead and put back
+    uint8_t padding_ = 0;              // Position flags of an expansion that came out
+                                       // empty, for the token after it
+    size_t directive_line_ = 0;        // Line of the #if or #elif being evaluated, for
+                                       // __LINE__; 0 outside one
+
+    lexer::Arena arena_;               // Macro bodies, pasted and stringified spellings
+    std::vector<Macro*> macros_;       // Indexed by IdentifierId
+    std::vector<Context> contexts_;
+    std::vector<Conditional> conditionals_;
+    std::vector<std::vector<Token>> spare_buffers_;
+    std::vector<std::unique_ptr<Arguments>> spare_arguments_;
+    std::vector<IdentifierId> parameters_; // Of the macro being defined
+    std::string spelling_, escaped_;       // Scratch text for #, ## and #include
+    std::string path_;                     // Scratch path for include lookups
+
+    // IDs of the names directives and expressions look for
+    IdentifierId define_, undef_, if_, ifdef_, ifndef_, elif_, else_, endif_;
+    IdentifierId include_, line_, error_, pragma_, defined_, va_args_, once_id_;
+};
+
+// Appends the spelling of token as it would appear in source: literals get
+// their quotes and prefix back, and lexer ERROR_TOKENs their source text.
+void append_spelling(std::string& out, const Token& token);
+
+} // namespace preprocessor
+
+#endif // PREPROCESSOR_H
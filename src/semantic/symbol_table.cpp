@@ -0,0 +1,35 @@
+#include "symbol_table.h"
+
+namespace semantic {
+
+void SymbolTable::pop_scope() {
+    if (scopes_.empty()) {
+        return;
+    }
+    uint32_t mark = scopes_.back();
+    scopes_.pop_back();
+    while (bindings_.size() > mark) {
+        const Symbol& symbol = bindings_.back();
+        heads_[symbol.name] = symbol.shadowed;
+        bindings_.pop_back();
+    }
+}
+
+Symbol& SymbolTable::declare(IdentifierId name, SymbolKind kind, uint32_t declaration) {
+    if (name >= heads_.size()) {
+        heads_.resize(name + 1 + name / 2);
+    }
+    uint32_t scope = static_cast<uint32_t>(scopes_.size());
+    uint32_t head = heads_[name];
+    if (head != 0 && bindings_[head - 1].scope == scope) {
+        Symbol& symbol = bindings_[head - 1];
+        symbol.kind = kind;
+        symbol.declaration = declaration;
+        return symbol;
+    }
+    bindings_.push_back(Symbol{name, kind, scope, declaration, head});
+    heads_[name] = static_cast<uint32_t>(bindings_.size());
+    return bindings_.back();
+}
+
+} // namespace semantic
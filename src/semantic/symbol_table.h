@@ -0,0 +1,85 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include "../lexer/identifier_table.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace semantic {
+
+using lexer::IdentifierId;
+
+// What an ordinary identifier (6.2.3) is declared as. Tags and labels live
+// in name spaces of their own.
+enum class SymbolKind : uint8_t {
+    OBJECT,
+    FUNCTION,
+    TYPEDEF,
+    ENUM_CONSTANT
+};
+
+// One declaration of a name in one scope.
+struct Symbol {
+    IdentifierId name;
+    SymbolKind kind;
+    uint32_t scope;       // Depth of the scope it is in, 0 for file scope
+    uint32_t declaration; // Chosen by the declarer, e.g. the parser's NodeId
+    uint32_t shadowed;    // The binding of name it hides, plus one; 0 if none
+};
+
+// Bindings of ordinary identifiers in nested scopes, as a shadow stack.
+//
+// Every binding goes on one stack, in declaration order, and remembers the
+// binding of the same name it hides. The innermost binding of each name is
+// found through an array indexed by IdentifierId, which stays small because
+// IDs are dense, so a lookup is one index and never compares spellings.
+// Leaving a scope pops the bindings made in it, restoring the ones they hid,
+// so it costs the number of declarations in the scope. The stack and the
+// arrays keep their capacity, so once they have grown to a program's size
+// entering and leaving scopes allocates nothing.
+class SymbolTable {
+public:
+    // Starts at file scope. names, if known, is how many IdentifierIds there
+    // will be (IdentifierTable::size()), to size the index once.
+    explicit SymbolTable(size_t names = 0) : heads_(names) {}
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    void push_scope() { scopes_.push_back(static_cast<uint32_t>(bindings_.size())); }
+    // Drops the innermost scope's bindings; does nothing at file scope.
+    void pop_scope();
+
+    // Number of scopes entered and not left; 0 at file scope.
+    size_t depth() const { return scopes_.size(); }
+
+    // Binds name in the innermost scope, replacing the binding it already
+    // has there if any, and returns the binding. The reference is valid
+    // until the next declare() or pop_scope().
+    Symbol& declare(IdentifierId name, SymbolKind kind, uint32_t declaration = 0);
+
+    // The innermost binding of name, or nullptr.
+    const Symbol* lookup(IdentifierId name) const {
+        uint32_t index = name < heads_.size() ? heads_[name] : 0;
+        return index != 0 ? &bindings_[index - 1] : nullptr;
+    }
+
+    // The binding of name in the innermost scope, or nullptr.
+    const Symbol* lookup_local(IdentifierId name) const {
+        const Symbol* symbol = lookup(name);
+        return symbol && symbol->scope == depth() ? symbol : nullptr;
+    }
+
+    // Bindings visible or hidden, across all open scopes.
+    size_t size() const { return bindings_.size(); }
+
+private:
+    std::vector<Symbol> bindings_; // Outermost scope first
+    std::vector<uint32_t> heads_;  // Indexed by IdentifierId: innermost binding plus one
+    std::vector<uint32_t> scopes_; // Size of bindings_ when each scope was entered
+};
+
+} // namespace semantic
+
+#endif // SYMBOL_TABLE_H
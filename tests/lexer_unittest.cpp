@@ -1,5 +1,24 @@
 #include <gtest/gtest.h>
 #include "../src/lexer/lexer.h"
+#include "../src/lexer/hash.h"
+#include "../src/lexer/keywords.h"
+#include "../src/lexer/scan.h"
+#include "../src/lexer/incremental_lexer.h"
+#include "../src/lexer/instrument.h"
+#include "../src/lexer/parallel_lexer.h"
+#include "../src/lexer/pipelined_lexer.h"
+#include "../src/lexer/spsc_queue.h"
+#include "../src/lexer/streaming_lexer.h"
+#include "../src/lexer/token_cache.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <system_error>
+#include <unistd.h>
 
 // Test fixture for lexer tests
 class LexerTest : public ::testing::Test {
@@ -129,6 +148,114 @@ TEST_F(LexerTest, FloatLiterals) {
     EXPECT_EQ(token.type, lexer::TokenType::END_OF_FILE);
 }
 
+// Lexes source, which should hold a single numeric constant. The returned
+// token's value only stays valid for error messages.
+static lexer::Token lex_number(const std::string& source) {
+    lexer::Lexer lexer(source);
+    lexer::Token token = lexer.next_token();
+    if (token.type != lexer::TokenType::ERROR_TOKEN) {
+        EXPECT_EQ(token.value, source);
+    }
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::END_OF_FILE) << source;
+    return token;
+}
+
+// Test integer constants get their value and the C99 type for their suffix
+// and base
+TEST_F(LexerTest, IntegerValuesAndTypes) {
+    using lexer::NumericType;
+    struct Case {
+        const char* source;
+        uint64_t value;
+        NumericType type;
+    } cases[] = {
+        {"0", 0, NumericType::INT},
+        {"42", 42, NumericType::INT},
+        {"0x1A", 26, NumericType::INT},
+        {"0XfF", 255, NumericType::INT},
+        {"077", 63, NumericType::INT},
+        {"2147483647", 2147483647, NumericType::INT},
+        {"2147483648", 2147483648u, NumericType::LONG},           // Decimal skips unsigned int
+        {"0x80000000", 0x80000000u, NumericType::UNSIGNED_INT},  // Hex does not
+        {"42u", 42, NumericType::UNSIGNED_INT},
+        {"42U", 42, NumericType::UNSIGNED_INT},
+        {"42l", 42, NumericType::LONG},
+        {"42ul", 42, NumericType::UNSIGNED_LONG},
+        {"42LU", 42, NumericType::UNSIGNED_LONG},
+        {"42ll", 42, NumericType::LONG_LONG},
+        {"42ULL", 42, NumericType::UNSIGNED_LONG_LONG},
+        {"42llu", 42, NumericType::UNSIGNED_LONG_LONG},
+        {"0xFFFFFFFFFFFFFFFF", UINT64_MAX, NumericType::UNSIGNED_LONG},
+        {"18446744073709551615", UINT64_MAX, NumericType::UNSIGNED_LONG_LONG},
+        {"0xFFFFFFFFFFFFFFFFll", UINT64_MAX, NumericType::UNSIGNED_LONG_LONG},
+    };
+    for (const Case& c : cases) {
+        lexer::Token token = lex_number(c.source);
+        EXPECT_EQ(token.type, lexer::TokenType::CONSTANT_INT) << c.source;
+        EXPECT_EQ(token.int_value, c.value) << c.source;
+        EXPECT_EQ(token.numeric, c.type) << c.source;
+    }
+}
+
+// Test floating constants, including hex and leading-dot forms, are
+// correctly rounded to the type their suffix names
+TEST_F(LexerTest, FloatValuesAndTypes) {
+    using lexer::NumericType;
+    struct Case {
+        const char* source;
+        double value;
+        NumericType type;
+    } cases[] = {
+        {"3.14", 3.14, NumericType::DOUBLE},
+        {"1.", 1.0, NumericType::DOUBLE},
+        {".5", 0.5, NumericType::DOUBLE},
+        {"1e3", 1000.0, NumericType::DOUBLE},
+        {"2.5E-3", 2.5e-3, NumericType::DOUBLE},
+        {"0.1f", static_cast<double>(0.1f), NumericType::FLOAT},
+        {"0.1F", static_cast<double>(0.1f), NumericType::FLOAT},
+        {"0.1L", 0.1, NumericType::LONG_DOUBLE},
+        {"0x1p-2", 0.25, NumericType::DOUBLE},
+        {"0x1.8P3", 12.0, NumericType::DOUBLE},
+        {"0x.8p1f", 1.0, NumericType::FLOAT},
+        {"0.30000000000000004", 0.30000000000000004, NumericType::DOUBLE},
+        {"1e400", HUGE_VAL, NumericType::DOUBLE},
+        {"1e40f", static_cast<double>(HUGE_VALF), NumericType::FLOAT},
+        {"1e-400", 0.0, NumericType::DOUBLE},
+        {"4.9406564584124654e-324", 4.9406564584124654e-324, NumericType::DOUBLE},
+    };
+    for (const Case& c : cases) {
+        lexer::Token token = lex_number(c.source);
+        EXPECT_EQ(token.type, lexer::TokenType::CONSTANT_FLOAT) << c.source;
+        EXPECT_EQ(token.float_value, c.value) << c.source;
+        EXPECT_EQ(token.numeric, c.type) << c.source;
+    }
+
+    // A dot not followed by a digit is still a punctuator
+    lexer::Lexer lexer("s.x ...");
+    lexer.next_token();
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::DELIMITER_DOT);
+    lexer.next_token();
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::DELIMITER_ELLIPSIS);
+}
+
+// Test malformed constants become single error tokens
+TEST_F(LexerTest, MalformedNumbers) {
+    struct Case {
+        const char* source;
+        const char* message;
+    } cases[] = {
+        {"09", "Invalid digit in octal constant"},
+        {"1e+", "Exponent has no digits"},
+        {"0x1.8", "Hexadecimal floating constant requires an exponent"},
+        {"18446744073709551616", "Integer constant is too large"},
+    };
+    for (const Case& c : cases) {
+        lexer::Token token = lex_number(c.source);
+        EXPECT_EQ(token.type, lexer::TokenType::ERROR_TOKEN) << c.source;
+        EXPECT_EQ(token.value, c.message);
+    }
+}
+
 // Test string literals
 TEST_F(LexerTest, StringLiterals) {
     std::string source = "\"Hello, World!\" \"\" \"\\n\\t\\\"\"";
@@ -184,6 +311,239 @@ TEST_F(LexerTest, CharacterLiterals) {
     EXPECT_EQ(token.type, lexer::TokenType::END_OF_FILE);
 }
 
+// Test string literals decode every C99 escape
+TEST_F(LexerTest, StringEscapes) {
+    struct Case {
+        const char* source;
+        std::string decoded;
+    };
+    const Case cases[] = {
+        {R"("plain")", "plain"},
+        {R"("\a\b\f\n\r\t\v\?\'\"\\")", "\a\b\f\n\r\t\v?'\"\\"},
+        {R"("\0\12\101\1234")", std::string("\0\n" "A" "S4", 5)},
+        {R"("\x41\x7e\x000041g")", "A~Ag"},
+        {R"("\u00e9\u20AC\U0001F600")", "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"},
+        {R"("\u0024\u0040\u0060")", "$@`"},
+        {R"("\q\%")", "q%"},
+        {"\"ab\\\ncd\\\r\nef\"", "abcdef"},
+    };
+    for (const Case& c : cases) {
+        lexer::Lexer lexer{std::string(c.source)};
+        lexer::Token token = lexer.next_token();
+        ASSERT_EQ(token.type, lexer::TokenType::CONSTANT_STRING) << c.source;
+        EXPECT_EQ(token.string->bytes, c.decoded) << c.source;
+        EXPECT_FALSE(token.string->wide);
+        EXPECT_EQ(lexer.next_token().type, lexer::TokenType::END_OF_FILE) << c.source;
+    }
+
+    // Literals without escapes are not copied
+    lexer::Lexer lexer("\"no escapes here\"");
+    lexer::Token token = lexer.next_token();
+    EXPECT_EQ(token.string->bytes.data(), token.value.data());
+}
+
+// Test character constants carry their int value
+TEST_F(LexerTest, CharacterValues) {
+    struct Case {
+        const char* source;
+        int64_t value;
+    };
+    const Case cases[] = {
+        {"'a'", 'a'},      {"'\\n'", '\n'},      {"'\\0'", 0},
+        {"'\\''", '\''},   {"'\"'", '"'},       {"'\\x7f'", 0x7F},
+        {"'\\xff'", -1},   {"'\\377'", -1},     {"'\\200'", -128},
+        {"'ab'", 0x6162},  {"'abcd'", 0x61626364},
+        {"L'a'", 'a'},     {"L'\\u20ac'", 0x20AC}, {"L'\xE2\x82\xAC'", 0x20AC},
+        {"L'\\xFFFFFFFF'", -1},
+    };
+    for (const Case& c : cases) {
+        lexer::Lexer lexer{std::string(c.source)};
+        lexer::Token token = lexer.next_token();
+        ASSERT_EQ(token.type, lexer::TokenType::CONSTANT_CHAR) << c.source;
+        EXPECT_EQ(token.numeric, lexer::NumericType::INT) << c.source;
+        EXPECT_EQ(static_cast<int64_t>(token.int_value), c.value) << c.source;
+        EXPECT_EQ(lexer.next_token().type, lexer::TokenType::END_OF_FILE) << c.source;
+    }
+}
+
+// Test L prefixes make wide literals with 4-byte code units
+TEST_F(LexerTest, WideLiterals) {
+    lexer::Lexer lexer("L\"a\\u00e9\xE2\x82\xAC\\x100\" L 'x' Lx L'y'");
+    lexer::Token token = lexer.next_token();
+    ASSERT_EQ(token.type, lexer::TokenType::CONSTANT_STRING);
+    EXPECT_EQ(token.offset, 0u);
+    EXPECT_EQ(token.value, "a\\u00e9\xE2\x82\xAC\\x100");
+    ASSERT_TRUE(token.string->wide);
+    EXPECT_TRUE(token.has(lexer::TokenFlag::WIDE));
+    ASSERT_EQ(token.string->length(), 4u);
+    uint32_t units[4];
+    std::memcpy(units, token.string->bytes.data(), sizeof(units));
+    EXPECT_EQ(units[0], 'a');
+    EXPECT_EQ(units[1], 0xE9u);
+    EXPECT_EQ(units[2], 0x20ACu);
+    EXPECT_EQ(units[3], 0x100u);
+
+    // "L" apart from the quote is an identifier
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::IDENTIFIER);
+    token = lexer.next_token();
+    EXPECT_EQ(token.type, lexer::TokenType::CONSTANT_CHAR);
+    EXPECT_FALSE(token.has(lexer::TokenFlag::WIDE));
+    EXPECT_EQ(lexer.next_token().value, "Lx");
+    token = lexer.next_token();
+    EXPECT_EQ(token.type, lexer::TokenType::CONSTANT_CHAR);
+    EXPECT_EQ(token.value, "y");
+    EXPECT_TRUE(token.has(lexer::TokenFlag::WIDE));
+
+    lexer::TokenStream tokens = lexer::Lexer("L\"ab\" L'c' \"d\"").tokenize_all();
+    EXPECT_EQ(tokens.spelling(0), "L\"ab\"");
+    EXPECT_EQ(tokens.value(0), "ab");
+    EXPECT_EQ(tokens.value(1), "c");
+    EXPECT_EQ(tokens.value(2), "d");
+}
+
+// Test malformed literals become single error tokens
+TEST_F(LexerTest, MalformedLiterals) {
+    struct Case {
+        const char* source;
+        const char* message;
+        uint32_t end;
+    };
+    const Case cases[] = {
+        {"\"\\777\"", "Octal escape sequence out of range", 6},
+        {"\"\\x100\"", "Hex escape sequence out of range", 7},
+        {"\"\\xg\"", "\\x used with no following hex digits", 5},
+        {"\"\\u12\"", "Incomplete universal character name", 6},
+        {"\"\\u0041\"", "Invalid universal character name", 8},
+        {"\"\\uD800\"", "Invalid universal character name", 8},
+        {"\"\\U00110000\"", "Invalid universal character name", 12},
+        {"''", "Empty character constant", 2},
+        {"'\\xfff'", "Hex escape sequence out of range", 7},
+        {"\"abc\nx\"", "Unterminated string literal", 4},
+        {"'a\n'", "Unterminated character literal", 2},
+        {"\"abc\\", "Unterminated string literal", 5},
+    };
+    for (const Case& c : cases) {
+        lexer::Lexer lexer{std::string(c.source)};
+        lexer::Token token = lexer.next_token();
+        EXPECT_EQ(token.type, lexer::TokenType::ERROR_TOKEN) << c.source;
+        EXPECT_EQ(token.value, c.message) << c.source;
+        EXPECT_EQ(lexer.position(), c.end) << c.source;
+    }
+}
+
+// Test adjacent literals concatenate into one decoded string
+TEST_F(LexerTest, StringConcatenation) {
+    lexer::Lexer lexer("\"ab\" \"c\\x64\" \"\" \"\\u00e9\" L\"x\"");
+    std::vector<lexer::Token> strings;
+    for (lexer::Token token = lexer.next_token(); token.type != lexer::TokenType::END_OF_FILE;
+         token = lexer.next_token()) {
+        strings.push_back(token);
+    }
+    ASSERT_EQ(strings.size(), 5u);
+
+    const lexer::StringLiteral* narrow = lexer.concatenate(std::span(strings).first(4));
+    EXPECT_FALSE(narrow->wide);
+    EXPECT_EQ(narrow->bytes, "abcd\xC3\xA9");
+    EXPECT_EQ(narrow->bytes.data()[narrow->bytes.size()], '\0');
+
+    // Narrow pieces are widened a character at a time
+    const lexer::StringLiteral* wide = lexer.concatenate(strings);
+    ASSERT_TRUE(wide->wide);
+    ASSERT_EQ(wide->length(), 6u);
+    std::vector<uint32_t> units(6);
+    std::memcpy(units.data(), wide->bytes.data(), wide->bytes.size());
+    EXPECT_EQ(units, (std::vector<uint32_t>{'a', 'b', 'c', 'd', 0xE9, 'x'}));
+
+    EXPECT_EQ(lexer.concatenate(std::span(strings).first(1)), strings[0].string);
+}
+
+// Test phases 1 and 2 leave buffers without trigraphs or splices alone
+TEST_F(LexerTest, SplicedTextFastPath) {
+    EXPECT_EQ(lexer::SplicedText::build(""), nullptr);
+    EXPECT_EQ(lexer::SplicedText::build("int x = y ? a : b; // ?? \"\\n\" \\t ??? ??x\n"), nullptr);
+    EXPECT_EQ(lexer::SplicedText::build("trailing ??"), nullptr);
+    EXPECT_EQ(lexer::SplicedText::build("backslash \\\r not a splice"), nullptr);
+    EXPECT_EQ(lexer::SourceBuffer::from_string("int main;\n")->spliced(), nullptr);
+}
+
+// Test trigraph replacement, line splicing and the offset map between them
+TEST_F(LexerTest, SplicedTextMapping) {
+    std::string source = "a?\?=b\\\ncd\\\r\n\\\n?\?\?/\nef";
+    auto spliced = lexer::SplicedText::build(source);
+    ASSERT_NE(spliced, nullptr);
+    EXPECT_EQ(spliced->text(), "a#bcd?ef");
+    EXPECT_EQ(spliced->text().data()[spliced->text().size()], '\0');
+
+    const uint32_t to_source[] = {0, 1, 4, 7, 8, 14, 19, 20, 21};
+    for (uint32_t i = 0; i < std::size(to_source); ++i) {
+        EXPECT_EQ(spliced->to_source(i), to_source[i]) << i;
+        EXPECT_EQ(spliced->to_spliced(to_source[i]), i) << i;
+    }
+    EXPECT_EQ(spliced->to_spliced(2), 2u);  // Inside "??="
+    EXPECT_EQ(spliced->to_spliced(5), 3u);  // Inside "\\\n"
+    EXPECT_EQ(spliced->to_spliced(12), 5u); // Inside "\\\n"
+    EXPECT_EQ(spliced->to_spliced(16), 6u); // Inside "??/\n"
+
+    const char* trigraphs = "?\?= ?\?( ?\?/ ?\?) ?\?' ?\?< ?\?! ?\?> ?\?-";
+    EXPECT_EQ(lexer::SplicedText::build(trigraphs)->text(), "# [ \\ ] ^ { | } ~");
+}
+
+// Test the lexer sees spliced text but reports offsets in the buffer
+TEST_F(LexerTest, LineSplicesAndTrigraphs) {
+    std::string source = "?\?=define MAX\\\n_LEN 1\\\n0\nch\\\r\nar s[] = \"abc\\\ndef?\?/n\";\n"
+                         "// comment \\\n continued\nx ?\?( 1 ?\?) ?\?!?\?! y ?\?'= ~z";
+    lexer::Lexer lexer(source);
+    struct Expected {
+        lexer::TokenType type;
+        std::string_view value;
+        uint32_t offset;
+    };
+    const Expected expected[] = {
+        {lexer::TokenType::PREPROCESSOR_HASH, "#", 0},
+        {lexer::TokenType::IDENTIFIER, "define", 3},
+        {lexer::TokenType::IDENTIFIER, "MAX_LEN", 10},
+        {lexer::TokenType::CONSTANT_INT, "10", 20},
+        {lexer::TokenType::KW_CHAR, "char", 25},
+        {lexer::TokenType::IDENTIFIER, "s", 33},
+        {lexer::TokenType::DELIMITER_LBRACKET, "[", 34},
+        {lexer::TokenType::DELIMITER_RBRACKET, "]", 35},
+        {lexer::TokenType::OP_ASSIGN, "=", 37},
+        {lexer::TokenType::CONSTANT_STRING, "abcdef\\n", 39},
+        {lexer::TokenType::DELIMITER_SEMICOLON, ";", 53},
+        {lexer::TokenType::IDENTIFIER, "x", 79},
+        {lexer::TokenType::DELIMITER_LBRACKET, "[", 81},
+        {lexer::TokenType::CONSTANT_INT, "1", 85},
+        {lexer::TokenType::DELIMITER_RBRACKET, "]", 87},
+        {lexer::TokenType::OP_OR, "||", 91},
+        {lexer::TokenType::IDENTIFIER, "y", 98},
+        {lexer::TokenType::OP_XOR_ASSIGN, "^=", 100},
+        {lexer::TokenType::OP_BITWISE_NOT, "~", 105},
+        {lexer::TokenType::IDENTIFIER, "z", 106},
+    };
+    for (const Expected& e : expected) {
+        lexer::Token token = lexer.next_token();
+        EXPECT_EQ(token.type, e.type) << e.value;
+        EXPECT_EQ(token.value, e.value);
+        EXPECT_EQ(token.offset, e.offset) << e.value;
+        if (token.type == lexer::TokenType::CONSTANT_STRING) {
+            EXPECT_EQ(token.string->bytes, "abcdef\n");
+        }
+    }
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::END_OF_FILE);
+    EXPECT_EQ(lexer.position(), source.size());
+
+    // Locations and stream spellings refer to the buffer as written
+    EXPECT_EQ(lexer.location(20).line, 2u);
+    lexer::TokenStream tokens = lexer::Lexer(source).tokenize_all();
+    EXPECT_EQ(tokens.spelling(2), "MAX\\\n_LEN");
+    EXPECT_EQ(tokens.spelling(4), "ch\\\r\nar");
+
+    // Lexing can resume at any token boundary
+    lexer.reset(25);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::KW_CHAR);
+    EXPECT_EQ(lexer.position(), 32u);
+}
+
 // Test identifiers
 TEST_F(LexerTest, Identifiers) {
     std::string source = "variable_name _underscore camelCase _123";
@@ -406,6 +766,91 @@ TEST_F(LexerTest, Delimiters) {
     EXPECT_EQ(token.type, lexer::TokenType::END_OF_FILE);
 }
 
+// Test digraphs, the conditional operator, token pasting and maximal munch
+TEST_F(LexerTest, PunctuatorMaximalMunch) {
+    std::string source = "<: :> <% %> %: %:%: ## ? .. %:% <<<= a+++b";
+    lexer::Lexer lexer(source);
+
+    const std::pair<lexer::TokenType, const char*> expected[] = {
+        {lexer::TokenType::DELIMITER_LBRACKET, "<:"},
+        {lexer::TokenType::DELIMITER_RBRACKET, ":>"},
+        {lexer::TokenType::DELIMITER_LBRACE, "<%"},
+        {lexer::TokenType::DELIMITER_RBRACE, "%>"},
+        {lexer::TokenType::PREPROCESSOR_HASH, "%:"},
+        {lexer::TokenType::PREPROCESSOR_HASH_HASH, "%:%:"},
+        {lexer::TokenType::PREPROCESSOR_HASH_HASH, "##"},
+        {lexer::TokenType::OP_QUESTION, "?"},
+        {lexer::TokenType::DELIMITER_DOT, "."},
+        {lexer::TokenType::DELIMITER_DOT, "."},
+        {lexer::TokenType::PREPROCESSOR_HASH, "%:"},
+        {lexer::TokenType::OP_PERCENT, "%"},
+        {lexer::TokenType::OP_LEFT_SHIFT, "<<"},
+        {lexer::TokenType::OP_LE, "<="},
+        {lexer::TokenType::IDENTIFIER, "a"},
+        {lexer::TokenType::OP_INCREMENT, "++"},
+        {lexer::TokenType::OP_PLUS, "+"},
+        {lexer::TokenType::IDENTIFIER, "b"},
+        {lexer::TokenType::END_OF_FILE, ""},
+    };
+    for (const auto& [type, value] : expected) {
+        lexer::Token token = lexer.next_token();
+        EXPECT_EQ(token.type, type) << value;
+        EXPECT_EQ(token.value, value);
+    }
+}
+
+// Test increment and decrement have their own kinds
+TEST_F(LexerTest, IncrementDecrement) {
+    std::string source = "i++ --j - -k +=+";
+    lexer::Lexer lexer(source);
+
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::IDENTIFIER);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::OP_INCREMENT);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::OP_DECREMENT);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::IDENTIFIER);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::OP_MINUS);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::OP_MINUS);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::IDENTIFIER);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::OP_PLUS_ASSIGN);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::OP_PLUS);
+}
+
+// Test identifiers are interned into IDs shared across lexers
+TEST_F(LexerTest, IdentifierInterning) {
+    lexer::IdentifierTable identifiers;
+    lexer::Lexer first("count int count total", &identifiers);
+    lexer::Lexer second("total + count", &identifiers);
+
+    lexer::Token count = first.next_token();
+    lexer::Token kw_int = first.next_token();
+    lexer::Token count_again = first.next_token();
+    lexer::Token total = first.next_token();
+    EXPECT_NE(count.ident, lexer::kNoIdentifier);
+    EXPECT_NE(kw_int.ident, lexer::kNoIdentifier);
+    EXPECT_EQ(count.ident, count_again.ident);
+    EXPECT_NE(count.ident, total.ident);
+    EXPECT_NE(count.ident, kw_int.ident);
+
+    EXPECT_EQ(second.next_token().ident, total.ident);
+    EXPECT_EQ(second.next_token().ident, lexer::kNoIdentifier);
+    EXPECT_EQ(second.next_token().ident, count.ident);
+
+    EXPECT_EQ(identifiers.spelling(count.ident), "count");
+    EXPECT_EQ(identifiers.find("total"), total.ident);
+    EXPECT_EQ(identifiers.find("missing"), lexer::kNoIdentifier);
+
+    // Growing the table keeps every ID and spelling stable
+    std::vector<lexer::IdentifierId> ids;
+    for (int i = 0; i < 5000; ++i) {
+        ids.push_back(identifiers.intern("name_" + std::to_string(i)));
+    }
+    for (int i = 0; i < 5000; ++i) {
+        EXPECT_EQ(identifiers.intern("name_" + std::to_string(i)), ids[i]);
+        EXPECT_EQ(identifiers.spelling(ids[i]), "name_" + std::to_string(i));
+    }
+    EXPECT_EQ(identifiers.find("count"), count.ident);
+}
+
 // Test C99 keywords
 TEST_F(LexerTest, C99Keywords) {
     std::string source = "auto break case char const continue default do double else enum extern float for goto if inline int long register restrict return short signed sizeof static struct switch typedef union unsigned void volatile while _Bool _Complex _Imaginary";
@@ -564,6 +1009,18 @@ TEST_F(LexerTest, C99Keywords) {
     EXPECT_EQ(token.type, lexer::TokenType::END_OF_FILE);
 }
 
+// Test the keyword table rejects identifiers that share a keyword's hash inputs
+TEST_F(LexerTest, KeywordLookup) {
+    for (const lexer::Keyword& keyword : lexer::c99_keywords) {
+        EXPECT_EQ(lexer::c99_keyword_table.lookup(keyword.spelling), keyword.type);
+    }
+
+    for (const char* name : {"i", "in", "ints", "Int", "dt", "doe", "doubles", "_Boo",
+                             "_Bool_", "whilee", "sizeof_", "restricT", "x", ""}) {
+        EXPECT_EQ(lexer::c99_keyword_table.lookup(name), lexer::TokenType::IDENTIFIER) << name;
+    }
+}
+
 // Test comments
 TEST_F(LexerTest, Comments) {
     std::string source = "int a; // This is a comment\n/* This is a \n   multi-line comment */ int b;";
@@ -604,6 +1061,94 @@ TEST_F(LexerTest, Comments) {
     EXPECT_EQ(token.type, lexer::TokenType::END_OF_FILE);
 }
 
+// Test each dialect's keyword set, and that C89 has no line comments or digraphs
+TEST_F(LexerTest, Dialects) {
+    std::string source = "inline _Bool _Alignof _Static_assert a //* b */ c";
+    auto kinds = [&](auto lexer) {
+        std::vector<lexer::TokenType> result;
+        for (lexer::Token token = lexer.next_token(); token.type != lexer::TokenType::END_OF_FILE;
+             token = lexer.next_token()) {
+            result.push_back(token.type);
+        }
+        return result;
+    };
+    using T = lexer::TokenType;
+    EXPECT_EQ(kinds(lexer::C89Lexer(source)),
+              (std::vector<T>{T::IDENTIFIER, T::IDENTIFIER, T::IDENTIFIER, T::IDENTIFIER,
+                              T::IDENTIFIER, T::OP_SLASH, T::IDENTIFIER}));
+    EXPECT_EQ(kinds(lexer::Lexer(source)),
+              (std::vector<T>{T::KW_INLINE, T::KW__BOOL, T::IDENTIFIER, T::IDENTIFIER,
+                              T::IDENTIFIER}));
+    EXPECT_EQ(kinds(lexer::C11Lexer(source)),
+              (std::vector<T>{T::KW_INLINE, T::KW__BOOL, T::KW__ALIGNOF, T::KW__STATIC_ASSERT,
+                              T::IDENTIFIER}));
+
+    for (const lexer::Keyword& keyword : lexer::c11_keywords) {
+        EXPECT_EQ(lexer::c11_keyword_table.lookup(keyword.spelling), keyword.type);
+    }
+    for (const lexer::Keyword& keyword : lexer::c89_keywords) {
+        EXPECT_EQ(lexer::c89_keyword_table.lookup(keyword.spelling), keyword.type);
+    }
+
+    std::string digraphs = "<: :> <% %> %:%:";
+    EXPECT_EQ(kinds(lexer::C89Lexer(digraphs)),
+              (std::vector<T>{T::OP_LT, T::DELIMITER_COLON, T::DELIMITER_COLON, T::OP_GT, T::OP_LT,
+                              T::OP_PERCENT, T::OP_PERCENT, T::OP_GT, T::OP_PERCENT,
+                              T::DELIMITER_COLON, T::OP_PERCENT, T::DELIMITER_COLON}));
+    EXPECT_EQ(kinds(lexer::Lexer(digraphs)),
+              (std::vector<T>{T::DELIMITER_LBRACKET, T::DELIMITER_RBRACKET, T::DELIMITER_LBRACE,
+                              T::DELIMITER_RBRACE, T::PREPROCESSOR_HASH_HASH}));
+}
+
+// Test a comment-keeping lexer returns comments in place, spliced ones included
+TEST_F(LexerTest, KeepComments) {
+    std::string source = "int a; // line \\\n still\n/* block */ b /* unterminated";
+    lexer::CommentLexer lexer(source);
+    struct Expected {
+        lexer::TokenType type;
+        std::string_view value;
+        uint32_t offset;
+    };
+    const Expected expected[] = {
+        {lexer::TokenType::KW_INT, "int", 0},
+        {lexer::TokenType::IDENTIFIER, "a", 4},
+        {lexer::TokenType::DELIMITER_SEMICOLON, ";", 5},
+        {lexer::TokenType::COMMENT, "// line  still", 7},
+        {lexer::TokenType::COMMENT, "/* block */", 24},
+        {lexer::TokenType::IDENTIFIER, "b", 36},
+        {lexer::TokenType::COMMENT, "/* unterminated", 38},
+        {lexer::TokenType::END_OF_FILE, "", 53},
+    };
+    for (const Expected& e : expected) {
+        lexer::Token token = lexer.next_token();
+        EXPECT_EQ(token.type, e.type) << e.value;
+        EXPECT_EQ(token.value, e.value);
+        EXPECT_EQ(token.offset, e.offset) << e.value;
+    }
+
+    lexer::TokenStream tokens = lexer::CommentLexer(source).tokenize_all();
+    ASSERT_EQ(tokens.size(), 8u);
+    EXPECT_EQ(tokens.spelling(3), "// line \\\n still");
+}
+
+// Test a positionless lexer yields the same tokens with every offset 0
+TEST_F(LexerTest, PositionlessTokens) {
+    std::string source = "x = a\\\n[1] + \"s\"; /* c */ 'q' @";
+    lexer::Lexer positioned(source);
+    lexer::PositionlessLexer positionless(source);
+    for (;;) {
+        lexer::Token expected = positioned.next_token();
+        lexer::Token token = positionless.next_token();
+        EXPECT_EQ(token.type, expected.type);
+        EXPECT_EQ(token.value, expected.value);
+        EXPECT_EQ(token.offset, 0u);
+        EXPECT_EQ(positionless.position(), positioned.position());
+        if (token.type == lexer::TokenType::END_OF_FILE) {
+            break;
+        }
+    }
+}
+
 // Test preprocessor directives
 TEST_F(LexerTest, PreprocessorDirectives) {
     std::string source = "#include <stdio.h>\n#define MAX 100";
@@ -669,6 +1214,826 @@ TEST_F(LexerTest, PreprocessorDirectives) {
     EXPECT_EQ(token.type, lexer::TokenType::END_OF_FILE);
 }
 
+// Test error tokens keep their message after later tokens are lexed
+TEST_F(LexerTest, UnknownCharacter) {
+    std::string source = "a @ b $";
+    lexer::Lexer lexer(source);
+
+    lexer::Token token = lexer.next_token();
+    EXPECT_EQ(token.type, lexer::TokenType::IDENTIFIER);
+
+    lexer::Token at = lexer.next_token();
+    EXPECT_EQ(at.type, lexer::TokenType::ERROR_TOKEN);
+
+    token = lexer.next_token();
+    EXPECT_EQ(token.type, lexer::TokenType::IDENTIFIER);
+    EXPECT_EQ(token.value, "b");
+
+    lexer::Token dollar = lexer.next_token();
+    EXPECT_EQ(dollar.type, lexer::TokenType::ERROR_TOKEN);
+    EXPECT_EQ(dollar.value, "Unknown character: $");
+    EXPECT_EQ(at.value, "Unknown character: @");
+}
+
+// Test the bulk token stream matches next_token() token for token
+TEST_F(LexerTest, TokenizeAll) {
+    std::string source = "int main(void) {\n"
+                         "    /* comment */ char *s = \"a\\\"b\";\n"
+                         "    return s[0] == 'x' && 0x1F; // done\n"
+                         "}\n";
+    lexer::Lexer sequential(source);
+    lexer::Lexer bulk(source);
+    lexer::TokenStream stream = bulk.tokenize_all();
+
+    ASSERT_FALSE(stream.empty());
+    for (size_t i = 0; i < stream.size(); ++i) {
+        lexer::Token token = sequential.next_token();
+        EXPECT_EQ(stream.kind(i), token.type) << i;
+        EXPECT_EQ(stream.value(i), token.value) << i;
+        EXPECT_EQ(stream.offset(i), token.offset) << i;
+    }
+    EXPECT_EQ(stream.kind(stream.size() - 1), lexer::TokenType::END_OF_FILE);
+
+    // "a\"b" is stored with its quotes
+    EXPECT_EQ(stream.spelling(10), "\"a\\\"b\"");
+    EXPECT_EQ(stream.location(10).line, 2u);
+    EXPECT_EQ(stream.location(10).column, 29u);
+}
+
+// Test peeked tokens are the ones next_token() goes on to return
+TEST_F(LexerTest, PeekToken) {
+    std::string source = "(unsigned long) x + y->z;";
+    lexer::Lexer lexer(source);
+
+    EXPECT_EQ(lexer.peek_token().type, lexer::TokenType::DELIMITER_LPAREN);
+    EXPECT_EQ(lexer.peek_token(1).type, lexer::TokenType::KW_UNSIGNED);
+    EXPECT_EQ(lexer.peek_token(3).type, lexer::TokenType::DELIMITER_RPAREN);
+    EXPECT_EQ(lexer.position(), 0u);
+
+    lexer::Token paren = lexer.next_token();
+    EXPECT_EQ(paren.type, lexer::TokenType::DELIMITER_LPAREN);
+    EXPECT_EQ(lexer.position(), 1u);
+
+    // Peeking far past the end grows the ring and yields END_OF_FILE
+    EXPECT_EQ(lexer.peek_token(40).type, lexer::TokenType::END_OF_FILE);
+    std::vector<std::string_view> values;
+    for (lexer::Token token = lexer.next_token(); token.type != lexer::TokenType::END_OF_FILE;
+         token = lexer.next_token()) {
+        values.push_back(token.value);
+    }
+    EXPECT_EQ(values, (std::vector<std::string_view>{"unsigned", "long", ")", "x", "+", "y",
+                                                     "->", "z", ";"}));
+    EXPECT_EQ(lexer.position(), source.size());
+
+    lexer.reset();
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::DELIMITER_LPAREN);
+}
+
+// Test speculative lexing: restore() replays tokens, commit() keeps going
+TEST_F(LexerTest, CheckpointRestore) {
+    std::string source = "a (b) c d e f g h i j k l m n o p q r s t u v w x y z";
+    lexer::Lexer lexer(source);
+    lexer.next_token();
+
+    lexer::Lexer::Checkpoint outer = lexer.checkpoint();
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::DELIMITER_LPAREN);
+    lexer::Lexer::Checkpoint inner = lexer.checkpoint();
+    EXPECT_EQ(lexer.next_token().value, "b");
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::DELIMITER_RPAREN);
+    lexer.restore(inner);
+    EXPECT_EQ(lexer.position(), 3u);
+    EXPECT_EQ(lexer.next_token().value, "b");
+
+    // Enough tokens to grow the ring while the outer checkpoint pins it
+    for (int i = 0; i < 20; ++i) {
+        lexer.next_token();
+    }
+    EXPECT_EQ(lexer.peek_token().value, "v");
+    lexer.restore(outer);
+    EXPECT_EQ(lexer.position(), 1u);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::DELIMITER_LPAREN);
+
+    lexer::Lexer::Checkpoint again = lexer.checkpoint();
+    EXPECT_EQ(lexer.next_token().value, "b");
+    lexer.commit(again);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::DELIMITER_RPAREN);
+
+    // Tokens match a lexer that never backtracked, offsets included
+    lexer::Lexer straight(source);
+    for (int i = 0; i < 4; ++i) {
+        straight.next_token();
+    }
+    for (lexer::Token expected = straight.next_token();; expected = straight.next_token()) {
+        lexer::Token token = lexer.next_token();
+        ASSERT_EQ(token.type, expected.type);
+        ASSERT_EQ(token.offset, expected.offset);
+        ASSERT_EQ(lexer.position(), straight.position());
+        if (expected.type == lexer::TokenType::END_OF_FILE) {
+            break;
+        }
+    }
+}
+
+// Test token offsets map back to lines and columns through the newline table
+TEST_F(LexerTest, TokenLocations) {
+    std::string source = "int a;\n\n  /* two\nlines */ b\n\"s\"";
+    lexer::Lexer lexer(source);
+
+    lexer::Token token = lexer.next_token();
+    EXPECT_EQ(token.offset, 0u);
+    EXPECT_EQ(lexer.location(token.offset).line, 1u);
+    EXPECT_EQ(lexer.location(token.offset).column, 1u);
+
+    lexer.next_token(); // a
+    token = lexer.next_token(); // ;
+    EXPECT_EQ(token.offset, 5u);
+    EXPECT_EQ(lexer.location(token.offset).column, 6u);
+
+    token = lexer.next_token(); // b
+    EXPECT_EQ(token.value, "b");
+    EXPECT_EQ(lexer.location(token.offset).line, 4u);
+    EXPECT_EQ(lexer.location(token.offset).column, 10u);
+
+    token = lexer.next_token(); // "s" starts at its opening quote
+    EXPECT_EQ(token.value, "s");
+    EXPECT_EQ(source[token.offset], '"');
+    EXPECT_EQ(lexer.location(token.offset).line, 5u);
+    EXPECT_EQ(lexer.location(token.offset).column, 1u);
+
+    token = lexer.next_token();
+    EXPECT_EQ(token.type, lexer::TokenType::END_OF_FILE);
+    EXPECT_EQ(token.offset, source.size());
+
+    lexer::LineIndex index(source);
+    EXPECT_EQ(index.line_count(), 5u);
+    EXPECT_EQ(index.line_start(4), 17u);
+}
+
+// Builds a pseudo-random source out of fragments that exercise the scanners'
+// block boundaries: long whitespace runs, long identifiers and comments
+static std::string random_source(unsigned seed, size_t fragments) {
+    static const char* const pieces[] = {
+        " ", "\t", "\n", "\r\n", "                                       ",
+        "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n", "x", "_", "int",
+        "a_very_long_identifier_name_that_spans_several_vector_blocks_0123456789",
+        "// line comment with * and / characters\n", "/**/", "/* short */",
+        "/* a multi-line comment\n * with stars * and / slashes **\n spanning lines */",
+        "/*****************************************************************/",
+        "42", "0x1F", "3.5e+7", "\"str\\\"ing\"", "'c'", "'\\n'", "+", "<<=", "->",
+        "\"a string literal long enough to span vector blocks \\x41\\t\\u00e9 0123456789\"",
+        "...", ";", "{", "}", "(", ")", "==", "&&", "identifier\xC3\xA9",
+        "spliced_\\\nidentifier", "\\\r\n", "?\?=", "?\?/\n", "?\?\?\?!",
+    };
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> pick(0, sizeof(pieces) / sizeof(pieces[0]) - 1);
+
+    std::string source;
+    for (size_t i = 0; i < fragments; ++i) {
+        source += pieces[pick(rng)];
+        source += ' ';
+    }
+    return source;
+}
+
+// Test every vectorized scanner produces the same tokens as the scalar one
+TEST_F(LexerTest, ScanIsaEquivalence) {
+    lexer::scan::Isa saved = lexer::scan::active_isa();
+    for (unsigned seed = 1; seed <= 20; ++seed) {
+        std::string source = random_source(seed, 400);
+
+        lexer::scan::use_isa(lexer::scan::Isa::SCALAR);
+        lexer::Lexer expected_lexer(source);
+        std::vector<lexer::Token> expected;
+        do {
+            expected.push_back(expected_lexer.next_token());
+        } while (expected.back().type != lexer::TokenType::END_OF_FILE);
+
+        for (lexer::scan::Isa isa : {lexer::scan::Isa::SSE2, lexer::scan::Isa::AVX2}) {
+            if (static_cast<int>(isa) > static_cast<int>(lexer::scan::best_isa())) {
+                continue;
+            }
+            lexer::scan::use_isa(isa);
+            lexer::Lexer lexer(source);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                lexer::Token token = lexer.next_token();
+                ASSERT_EQ(token.type, expected[i].type) << lexer::scan::isa_name(isa) << " " << i;
+                ASSERT_EQ(token.value, expected[i].value) << lexer::scan::isa_name(isa) << " " << i;
+                ASSERT_EQ(token.offset, expected[i].offset) << lexer::scan::isa_name(isa) << " " << i;
+            }
+        }
+    }
+    lexer::scan::use_isa(saved);
+}
+
+// Test scanners stop exactly at the first non-matching byte near block edges
+TEST_F(LexerTest, ScanBoundaries) {
+    for (size_t length = 0; length < 80; ++length) {
+        std::string spaces(length, ' ');
+        std::string ident(length, 'a');
+        std::string comment = std::string(length, '*') + "x*/";
+        std::string lines(length, '\n');
+        std::string literal(length, 'a');
+        for (lexer::scan::Isa isa : {lexer::scan::Isa::SCALAR, lexer::scan::Isa::SSE2,
+                                     lexer::scan::Isa::AVX2}) {
+            lexer::scan::use_isa(isa);
+            std::string s = spaces + "z";
+            EXPECT_EQ(lexer::scan::skip_whitespace(s.data(), s.data() + s.size()) - s.data(),
+                      static_cast<ptrdiff_t>(length));
+            s = ident + "-";
+            EXPECT_EQ(lexer::scan::skip_identifier(s.data(), s.data() + s.size()) - s.data(),
+                      static_cast<ptrdiff_t>(length));
+            EXPECT_EQ(lexer::scan::find_comment_end(comment.data(), comment.data() + comment.size()) -
+                          comment.data(),
+                      static_cast<ptrdiff_t>(length + 1));
+            EXPECT_EQ(lexer::scan::count_newlines(lines.data(), lines.data() + lines.size()), length);
+            for (char stop : {'"', '\n'}) {
+                s = literal + stop + "\"";
+                EXPECT_EQ(lexer::scan::find_literal_stop(s.data(), s.data() + s.size(), '"') - s.data(),
+                          static_cast<ptrdiff_t>(length));
+            }
+            EXPECT_EQ(lexer::scan::find_literal_stop(literal.data(), literal.data() + length, '\'') -
+                          literal.data(),
+                      static_cast<ptrdiff_t>(length));
+        }
+    }
+    lexer::scan::use_isa(lexer::scan::best_isa());
+}
+
+// Checks the parallel tokenizer reproduces the sequential token stream
+static void expect_parallel_matches(const std::shared_ptr<const lexer::SourceBuffer>& buffer,
+                                    unsigned threads, size_t min_chunk_size) {
+    lexer::TokenStream expected = lexer::Lexer(buffer).tokenize_all();
+    lexer::TokenStream actual = lexer::tokenize_parallel(buffer, threads, min_chunk_size);
+
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(actual.kind(i), expected.kind(i)) << i;
+        ASSERT_EQ(actual.offset(i), expected.offset(i)) << i;
+        ASSERT_EQ(actual.length(i), expected.length(i)) << i;
+    }
+}
+
+// Test parallel lexing over this file's own test inputs
+TEST_F(LexerTest, ParallelMatchesSequentialOnTestInputs) {
+    auto buffer = lexer::SourceBuffer::from_file(__FILE__);
+    for (size_t chunk : {64, 256, 4096}) {
+        expect_parallel_matches(buffer, 4, chunk);
+    }
+}
+
+// Test parallel lexing over a random corpus, with chunks that start inside
+// comments and literals
+TEST_F(LexerTest, ParallelMatchesSequentialOnRandomCorpus) {
+    for (unsigned seed = 100; seed < 110; ++seed) {
+        auto buffer = lexer::SourceBuffer::from_string(random_source(seed, 5000));
+        for (size_t chunk : {16, 100, 1000}) {
+            expect_parallel_matches(buffer, 8, chunk);
+        }
+    }
+
+    std::string tricky = "int a;\n/* x = 1;\n y = 2;\n z = 3;\n*/ b;\n"
+                         "\"s = 1;\\\" t = 2;\" c;\n// d = 4;\n e;\n";
+    std::string source;
+    for (int i = 0; i < 50; ++i) {
+        source += tricky;
+    }
+    auto buffer = lexer::SourceBuffer::from_string(source);
+    for (size_t chunk = 4; chunk < 64; chunk += 3) {
+        expect_parallel_matches(buffer, 6, chunk);
+    }
+}
+
+// Checks a StreamingLexer fed `chunk` bytes at a time matches a whole-buffer Lexer
+static void expect_streaming_matches(const std::string& source, size_t chunk, size_t window) {
+    size_t fed = 0;
+    lexer::StreamingLexer streaming([&](char* data, size_t size) {
+        size_t n = std::min({chunk, size, source.size() - fed});
+        std::memcpy(data, source.data() + fed, n);
+        fed += n;
+        return n;
+    }, window);
+    lexer::Lexer expected(source);
+
+    for (;;) {
+        lexer::Token want = expected.next_token();
+        lexer::Token got = streaming.next_token();
+        ASSERT_EQ(got.type, want.type) << "offset " << want.offset;
+        ASSERT_EQ(got.offset, want.offset);
+        ASSERT_EQ(got.value, want.value);
+        lexer::SourceLocation want_location = expected.location(want.offset);
+        lexer::SourceLocation got_location = streaming.location(got.offset);
+        ASSERT_EQ(got_location.line, want_location.line) << "offset " << want.offset;
+        ASSERT_EQ(got_location.column, want_location.column) << "offset " << want.offset;
+        if (want.type == lexer::TokenType::END_OF_FILE) {
+            break;
+        }
+    }
+}
+
+// Test tokens straddling chunk and window boundaries come out whole
+TEST_F(LexerTest, StreamingMatchesWholeBuffer) {
+    std::string source = "int x = 12345; /* a comment\n spanning */ \"a \\\" string\" %:%: "
+                         "<<= ... a_rather_long_identifier_name // tail\n";
+    for (size_t chunk : {1, 2, 3, 7, 64}) {
+        for (size_t window : {64, 100, 4096}) {
+            expect_streaming_matches(source, chunk, window);
+        }
+    }
+    for (unsigned seed = 200; seed < 205; ++seed) {
+        expect_streaming_matches(random_source(seed, 2000), 13, 256);
+    }
+}
+
+// Test a token longer than the window grows it instead of being split
+TEST_F(LexerTest, StreamingGrowsForLongTokens) {
+    std::string source = "a " + std::string(1000, 'x') + " b";
+    expect_streaming_matches(source, 5, 64);
+}
+
+// Test streaming from a pipe, with memory bounded by the window
+TEST_F(LexerTest, StreamingFromPipe) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::string line = "value = table[index] + 42;\n";
+    std::thread writer([&] {
+        for (int i = 0; i < 2000; ++i) {
+            ASSERT_EQ(write(fds[1], line.data(), line.size()), static_cast<ssize_t>(line.size()));
+        }
+        close(fds[1]);
+    });
+
+    lexer::StreamingLexer streaming = lexer::StreamingLexer::from_fd(fds[0], 256);
+    size_t tokens = 0;
+    lexer::Token token = streaming.next_token();
+    for (; token.type != lexer::TokenType::END_OF_FILE; token = streaming.next_token()) {
+        ++tokens;
+    }
+    writer.join();
+    close(fds[0]);
+
+    EXPECT_EQ(tokens, 2000u * 9);
+    EXPECT_EQ(token.offset, 2000u * line.size());
+    EXPECT_EQ(streaming.window_size(), 256u);
+}
+
+// Test the queue hands over every element once and in order, with the
+// producer regularly finding it full
+TEST_F(LexerTest, SpscQueueAcrossThreads) {
+    lexer::SpscQueue<uint64_t> queue(3);
+    EXPECT_EQ(queue.capacity(), 4u);
+    EXPECT_EQ(queue.front(), nullptr);
+
+    const uint64_t count = 100000;
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t* slot;
+            while (!(slot = queue.back())) {
+                std::this_thread::yield();
+            }
+            *slot = i;
+            queue.push();
+        }
+    });
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t* slot;
+        while (!(slot = queue.front())) {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(*slot, i);
+        queue.pop();
+    }
+    producer.join();
+    EXPECT_EQ(queue.front(), nullptr);
+}
+
+// Test a pipelined lexer returns what a Lexer would, at any batch size
+TEST_F(LexerTest, PipelinedMatchesLexer) {
+    for (unsigned seed = 300; seed < 304; ++seed) {
+        auto buffer = lexer::SourceBuffer::from_string(random_source(seed, 2000));
+        for (size_t batch : {1, 7, 256}) {
+            for (size_t depth : {1, 4}) {
+                lexer::Lexer expected(buffer);
+                lexer::PipelinedLexer pipelined(buffer, nullptr, batch, depth);
+                for (;;) {
+                    lexer::Token want = expected.next_token();
+                    lexer::Token got = pipelined.next_token();
+                    ASSERT_EQ(got.type, want.type) << "offset " << want.offset;
+                    ASSERT_EQ(got.offset, want.offset);
+                    ASSERT_EQ(got.value, want.value);
+                    if (want.type == lexer::TokenType::CONSTANT_STRING) {
+                        ASSERT_EQ(got.string->bytes, want.string->bytes);
+                    }
+                    if (want.type == lexer::TokenType::END_OF_FILE) {
+                        break;
+                    }
+                }
+                EXPECT_EQ(pipelined.next_token().type, lexer::TokenType::END_OF_FILE);
+            }
+        }
+    }
+}
+
+// Test identifiers are interned by the producer, and that a lexer abandoned
+// halfway stops its producer
+TEST_F(LexerTest, PipelinedInterningAndEarlyExit) {
+    lexer::IdentifierTable identifiers;
+    {
+        lexer::PipelinedLexer pipelined(lexer::SourceBuffer::from_string("alpha beta alpha"),
+                                        &identifiers, 2);
+        lexer::Token alpha = pipelined.next_token();
+        lexer::Token beta = pipelined.next_token();
+        EXPECT_EQ(pipelined.next_token().ident, alpha.ident);
+        EXPECT_EQ(pipelined.next_token().type, lexer::TokenType::END_OF_FILE);
+        EXPECT_EQ(beta.ident, identifiers.intern("beta"));
+    }
+
+    std::string source;
+    for (int i = 0; i < 10000; ++i) {
+        source += "x = y + 1;\n";
+    }
+    lexer::PipelinedLexer pipelined(lexer::SourceBuffer::from_string(source), nullptr, 16, 2);
+    EXPECT_EQ(pipelined.next_token().type, lexer::TokenType::IDENTIFIER);
+}
+
+// Test a failure on the producer thread is rethrown by next_token(), and
+// again by later calls rather than leaving them waiting for a batch
+TEST_F(LexerTest, PipelinedRethrowsProducerFailure) {
+    // Reserving the batch throws std::length_error
+    lexer::PipelinedLexer pipelined(lexer::SourceBuffer::from_string("a b c"), nullptr,
+                                    SIZE_MAX, 2);
+    EXPECT_THROW(pipelined.next_token(), std::length_error);
+    EXPECT_THROW(pipelined.next_token(), std::length_error);
+    EXPECT_THROW(pipelined.next_token(), std::length_error);
+}
+
+// Test the instrumentation counts tokens, bytes and phases, and reports them
+TEST_F(LexerTest, InstrumentationCounters) {
+    if (!lexer::instrument::kEnabled) {
+        GTEST_SKIP() << "built without LEXER_INSTRUMENT";
+    }
+    using lexer::instrument::Phase;
+    std::string source = "int x = 1; /* c */ \"s\" 'c' + y;\n";
+    lexer::Lexer lexer(source);
+    lexer::instrument::reset();
+    while (lexer.next_token().type != lexer::TokenType::END_OF_FILE) {
+    }
+
+    const lexer::instrument::Stats& stats = lexer::instrument::stats();
+    EXPECT_EQ(stats.tokens[static_cast<size_t>(lexer::TokenType::IDENTIFIER)], 2u);
+    EXPECT_EQ(stats.tokens[static_cast<size_t>(lexer::TokenType::DELIMITER_SEMICOLON)], 2u);
+    EXPECT_EQ(stats.tokens[static_cast<size_t>(lexer::TokenType::END_OF_FILE)], 1u);
+    EXPECT_EQ(stats.bytes_scanned, source.size());
+    EXPECT_EQ(stats.phase_calls[static_cast<size_t>(Phase::NEXT_TOKEN)], 11u);
+    EXPECT_EQ(stats.phase_calls[static_cast<size_t>(Phase::PARSE_IDENTIFIER)], 3u);
+    EXPECT_EQ(stats.phase_calls[static_cast<size_t>(Phase::PARSE_STRING)], 1u);
+    EXPECT_EQ(stats.phase_calls[static_cast<size_t>(Phase::PARSE_CHAR_LITERAL)], 1u);
+    EXPECT_EQ(stats.current, Phase::COUNT);
+
+    std::string report = lexer::instrument::report();
+    EXPECT_NE(report.find("parse_identifier"), std::string::npos) << report;
+    EXPECT_NE(report.find("IDENTIFIER"), std::string::npos) << report;
+    std::string json = lexer::instrument::report_json();
+    EXPECT_NE(json.find("\"IDENTIFIER\": 2"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"bytes_scanned\": " + std::to_string(source.size())), std::string::npos);
+}
+
+// Test lexing allocates a fixed amount no matter how long the input is,
+// apart from arena chunks for decoded literals
+TEST_F(LexerTest, AllocationBudgets) {
+    if (!lexer::instrument::kEnabled) {
+        GTEST_SKIP() << "built without LEXER_INSTRUMENT";
+    }
+    for (size_t lines : {100, 100000}) {
+        std::string plain;
+        std::string escaped;
+        for (size_t i = 0; i < lines; ++i) {
+            plain += "total += values[i] * 3; /* sum */\n";
+            escaped += "puts(\"line\\t\\x41\");\n";
+        }
+        auto plain_buffer = lexer::SourceBuffer::from_string(plain);
+        auto escaped_buffer = lexer::SourceBuffer::from_string(escaped);
+
+        lexer::instrument::AllocationScope scope;
+        lexer::Lexer lexer(plain_buffer);
+        while (lexer.next_token().type != lexer::TokenType::END_OF_FILE) {
+        }
+        EXPECT_LE(scope.allocations(), 4u) << lines << " lines";
+        EXPECT_GT(scope.bytes(), 0u); // The lexer itself allocates a little
+
+        lexer::instrument::AllocationScope literals;
+        lexer::Lexer literal_lexer(escaped_buffer);
+        while (literal_lexer.next_token().type != lexer::TokenType::END_OF_FILE) {
+        }
+        // Each literal takes its StringLiteral plus 7 bytes of contents
+        size_t chunks = lines * (sizeof(lexer::StringLiteral) + 8) / lexer::Arena::kChunkSize + 1;
+        EXPECT_LE(literals.allocations(), 4u + 2 * chunks) << lines << " lines";
+    }
+}
+
+// Applies edit to tokens incrementally and checks the result matches lexing
+// the edited text from scratch
+static lexer::RelexRange expect_relex_matches(lexer::TokenStream& tokens,
+                                              const lexer::TextEdit& edit) {
+    auto edited = lexer::apply_edit(*tokens.buffer(), edit);
+    lexer::RelexRange range = lexer::relex(tokens, edited, edit);
+    lexer::TokenStream expected = lexer::Lexer(edited).tokenize_all();
+
+    EXPECT_EQ(tokens.buffer(), edited);
+    EXPECT_EQ(tokens.size(), expected.size());
+    for (size_t i = 0; i < std::min(tokens.size(), expected.size()); ++i) {
+        if (tokens.kind(i) != expected.kind(i) || tokens.offset(i) != expected.offset(i) ||
+            tokens.length(i) != expected.length(i)) {
+            ADD_FAILURE() << "token " << i << " differs after editing " << edit.offset << "+"
+                          << edit.removed << " -> \"" << edit.inserted << "\"";
+            break;
+        }
+    }
+    return range;
+}
+
+// Test typing inside a line only re-lexes the tokens it touches
+TEST_F(LexerTest, RelexSmallEdits) {
+    std::string source = "int count = 10;\nfloat ratio = count / 2.5;\n";
+    lexer::TokenStream tokens = lexer::Lexer(source).tokenize_all();
+
+    // "count" -> "counter"
+    lexer::RelexRange range = expect_relex_matches(tokens, {9, 0, "er"});
+    EXPECT_EQ(range.first, 1u);
+    EXPECT_EQ(range.removed, 1u);
+    EXPECT_EQ(range.inserted, 1u);
+    EXPECT_EQ(tokens.spelling(1), "counter");
+    EXPECT_EQ(tokens.spelling(8), "count");
+    EXPECT_EQ(tokens.offset(8), 32u);
+
+    // "10" -> "10.5f": the "=" is within lookahead of the edit and is re-lexed
+    // too, then "10" becomes a float
+    range = expect_relex_matches(tokens, {16, 0, ".5f"});
+    EXPECT_EQ(range.first, 2u);
+    EXPECT_EQ(range.removed, 2u);
+    EXPECT_EQ(range.inserted, 2u);
+    EXPECT_EQ(tokens.kind(3), lexer::TokenType::CONSTANT_FLOAT);
+
+    // Deleting the space in "/ 2.5" re-lexes the two tokens before it, and
+    // "2.5" is the old token shifted
+    range = expect_relex_matches(tokens, {42, 1, ""});
+    EXPECT_EQ(tokens.spelling(range.first + 1), "/");
+    EXPECT_EQ(range.removed, 2u);
+    EXPECT_EQ(range.inserted, 2u);
+
+    // Edits at both ends of the buffer
+    expect_relex_matches(tokens, {0, 0, "static "});
+    expect_relex_matches(tokens, {static_cast<uint32_t>(tokens.buffer()->size()), 0, "x"});
+    expect_relex_matches(tokens, {0, static_cast<uint32_t>(tokens.buffer()->size()), ""});
+    EXPECT_EQ(tokens.size(), 1u);
+}
+
+// Test edits that open or close comments and literals re-lex as far as they
+// change tokens and no further
+TEST_F(LexerTest, RelexCommentsAndLiterals) {
+    std::string source = "a = 1;\nb = 2;\nc = \"three\";\nd = 4;\n";
+    lexer::TokenStream original = lexer::Lexer(source).tokenize_all();
+    lexer::TokenStream tokens = original;
+
+    // Opening a comment swallows the rest of the buffer, closing it brings
+    // back everything after the second line
+    lexer::RelexRange range = expect_relex_matches(tokens, {7, 0, "/*"});
+    EXPECT_EQ(tokens.size(), 5u);
+    range = expect_relex_matches(tokens, {16, 0, "*/"});
+    EXPECT_EQ(tokens.size(), original.size() - 4);
+    EXPECT_EQ(range.first, 4u);
+
+    // An unbalanced quote turns code into string contents and back
+    expect_relex_matches(tokens, {20, 0, "\""});
+    expect_relex_matches(tokens, {20, 1, ""});
+    expect_relex_matches(tokens, {23, 0, "// "});
+
+    EXPECT_THROW(lexer::relex(tokens, {1000, 0, "x"}), std::out_of_range);
+    EXPECT_THROW(lexer::relex(tokens, {0, 1000, ""}), std::out_of_range);
+}
+
+// Test long runs of random edits, each checked against a full re-lex
+TEST_F(LexerTest, RelexRandomEdits) {
+    static const char* const insertions[] = {
+        "", "x", " ", "\n", "/*", "*/", "//", "\"", "'", "\\", ".", "..", "%:", "%:%",
+        "<", "=", "0x", "1e", "+", "identifier", "/* closed */", "?", "??", "/", "\\\n", "\r",
+    };
+    std::mt19937 rng(7);
+    for (unsigned seed = 300; seed < 305; ++seed) {
+        lexer::TokenStream tokens = lexer::Lexer(random_source(seed, 300)).tokenize_all();
+        for (int i = 0; i < 200; ++i) {
+            size_t size = tokens.buffer()->size();
+            uint32_t offset = static_cast<uint32_t>(rng() % (size + 1));
+            uint32_t removed = static_cast<uint32_t>(std::min<size_t>(rng() % 4, size - offset));
+            const char* inserted = insertions[rng() % (sizeof(insertions) / sizeof(insertions[0]))];
+            expect_relex_matches(tokens, {offset, removed, inserted});
+            if (HasFailure()) {
+                return;
+            }
+        }
+    }
+}
+
+// Writes contents to a fresh temporary file and returns its path
+static std::string write_temp_file(const std::string& contents) {
+    char path[] = "/tmp/lexer_unittest_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    std::ofstream(path, std::ios::binary) << contents;
+    return path;
+}
+
+// Test lexing a memory-mapped file
+TEST_F(LexerTest, MappedFile) {
+    std::string path = write_temp_file("int x = 42;");
+    auto buffer = lexer::SourceBuffer::from_file(path);
+    std::remove(path.c_str());
+
+    EXPECT_TRUE(buffer->is_mapped());
+    EXPECT_EQ(buffer->text(), "int x = 42;");
+    EXPECT_EQ(buffer->data()[buffer->size()], '\0');
+
+    lexer::Lexer lexer(buffer);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::KW_INT);
+    EXPECT_EQ(lexer.next_token().value, "x");
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::OP_ASSIGN);
+    EXPECT_EQ(lexer.next_token().value, "42");
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::DELIMITER_SEMICOLON);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::END_OF_FILE);
+}
+
+// Test a file that ends exactly on a page boundary still has its sentinel
+TEST_F(LexerTest, MappedFilePageBoundary) {
+    std::string contents(static_cast<size_t>(sysconf(_SC_PAGESIZE)) - 1, ' ');
+    contents += 'z';
+    std::string path = write_temp_file(contents);
+    lexer::Lexer lexer = lexer::Lexer::from_file(path);
+    std::remove(path.c_str());
+
+    lexer::Token token = lexer.next_token();
+    EXPECT_EQ(token.type, lexer::TokenType::IDENTIFIER);
+    EXPECT_EQ(token.value, "z");
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::END_OF_FILE);
+}
+
+// Test the read fallback for descriptors that cannot be mapped
+TEST_F(LexerTest, PipeInput) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::string source = "while (i) --i;";
+    ASSERT_EQ(write(fds[1], source.data(), source.size()), static_cast<ssize_t>(source.size()));
+    close(fds[1]);
+
+    auto buffer = lexer::SourceBuffer::from_fd(fds[0]);
+    close(fds[0]);
+    EXPECT_FALSE(buffer->is_mapped());
+    EXPECT_EQ(buffer->text(), source);
+
+    lexer::Lexer lexer(buffer);
+    EXPECT_EQ(lexer.next_token().type, lexer::TokenType::KW_WHILE);
+}
+
+// Test opening a missing file reports an error
+TEST_F(LexerTest, MissingFile) {
+    EXPECT_THROW(lexer::SourceBuffer::from_file("/nonexistent/input.c"), std::system_error);
+}
+
+// Checks two streams hold the same tokens and identifier IDs
+static void expect_same_tokens(const lexer::TokenStream& actual,
+                               const lexer::TokenStream& expected) {
+    ASSERT_EQ(actual.size(), expected.size());
+    ASSERT_EQ(actual.has_identifiers(), expected.has_identifiers());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(actual.kind(i), expected.kind(i)) << i;
+        ASSERT_EQ(actual.offset(i), expected.offset(i)) << i;
+        ASSERT_EQ(actual.length(i), expected.length(i)) << i;
+        ASSERT_EQ(actual.ident(i), expected.ident(i)) << i;
+    }
+}
+
+// Test encoded token streams decode to the original, identifiers included
+TEST_F(LexerTest, TokenCacheRoundTrip) {
+    auto buffer = lexer::SourceBuffer::from_file(__FILE__);
+    lexer::IdentifierTable identifiers;
+    lexer::TokenStream tokens = lexer::Lexer(buffer, &identifiers).tokenize_all();
+
+    std::string data = lexer::encode_tokens(tokens);
+    EXPECT_LT(data.size(), tokens.size() * 4);
+
+    std::optional<lexer::TokenStream> decoded = lexer::decode_tokens(data, buffer, &identifiers);
+    ASSERT_TRUE(decoded);
+    expect_same_tokens(*decoded, tokens);
+
+    // A fresh table hands out the same IDs in the same order of first use
+    lexer::IdentifierTable fresh;
+    decoded = lexer::decode_tokens(data, buffer, &fresh);
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(fresh.size(), identifiers.size());
+
+    decoded = lexer::decode_tokens(data, buffer);
+    ASSERT_TRUE(decoded);
+    expect_same_tokens(*decoded, lexer::Lexer(buffer).tokenize_all());
+
+    auto empty = lexer::SourceBuffer::from_string("");
+    decoded = lexer::decode_tokens(lexer::encode_tokens(lexer::Lexer(empty).tokenize_all()), empty);
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->size(), 1u);
+}
+
+// Test entries for other content, and truncated or corrupted entries, are
+// rejected rather than misread
+TEST_F(LexerTest, TokenCacheRejectsBadData) {
+    auto buffer = lexer::SourceBuffer::from_string("int main(void) { return 0x2A; } // x\n");
+    std::string data = lexer::encode_tokens(lexer::Lexer(buffer).tokenize_all());
+
+    EXPECT_FALSE(lexer::decode_tokens(data, lexer::SourceBuffer::from_string("int main(void) { return 0x2B; } // x\n")));
+    for (size_t size = 0; size < data.size(); ++size) {
+        EXPECT_FALSE(lexer::decode_tokens(std::string_view(data).substr(0, size), buffer)) << size;
+    }
+    EXPECT_FALSE(lexer::decode_tokens(data + '\0', buffer));
+
+    // An entry whose hash matches but whose spellings are not the source's,
+    // as a hash collision would give
+    std::string renamed = data;
+    renamed[renamed.find("main") + 2] = 'y';
+    EXPECT_FALSE(lexer::decode_tokens(renamed, buffer));
+
+    // Flipping any bit after the header must not read out of bounds
+    for (size_t i = 40; i < data.size(); ++i) {
+        for (int bit = 0; bit < 8; ++bit) {
+            std::string corrupt = data;
+            corrupt[i] = static_cast<char>(corrupt[i] ^ (1 << bit));
+            std::optional<lexer::TokenStream> decoded = lexer::decode_tokens(corrupt, buffer);
+            if (decoded) {
+                EXPECT_LE(decoded->offset(decoded->size() - 1), buffer->size());
+            }
+        }
+    }
+}
+
+// Test a cache directory misses once, then serves the stored entry
+TEST_F(LexerTest, TokenCacheDirectory) {
+    char directory[] = "/tmp/lexer_cache_XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory));
+    lexer::TokenCache cache(directory);
+
+    auto buffer = lexer::SourceBuffer::from_string("typedef int T; T value = 1;");
+    EXPECT_FALSE(cache.load(buffer));
+
+    lexer::IdentifierTable identifiers;
+    lexer::TokenStream lexed = cache.tokenize(buffer, &identifiers);
+    std::string path = cache.path(lexer::hash_bytes(buffer->text()));
+    EXPECT_EQ(access(path.c_str(), R_OK), 0);
+
+    std::optional<lexer::TokenStream> loaded = cache.load(buffer, &identifiers);
+    ASSERT_TRUE(loaded);
+    expect_same_tokens(*loaded, lexed);
+    expect_same_tokens(cache.tokenize(buffer, &identifiers), lexed);
+
+    std::remove(path.c_str());
+    rmdir(directory);
+    EXPECT_THROW(cache.store(lexed), std::system_error);
+}
+
+// Test threads storing the same entry at once each write their own temporary
+// file, and leave one complete entry behind
+TEST_F(LexerTest, TokenCacheConcurrentStores) {
+    char directory[] = "/tmp/lexer_cache_XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory));
+    lexer::TokenCache cache(directory);
+
+    std::string source;
+    for (int i = 0; i < 2000; ++i) {
+        source += "int value" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    }
+    auto buffer = lexer::SourceBuffer::from_string(source);
+    lexer::TokenStream lexed = lexer::Lexer(buffer).tokenize_all();
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 20; ++i) {
+                try {
+                    cache.store(lexed);
+                } catch (const std::system_error&) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(failures.load(), 0);
+
+    std::optional<lexer::TokenStream> loaded = cache.load(buffer);
+    ASSERT_TRUE(loaded);
+    expect_same_tokens(*loaded, lexed);
+
+    std::remove(cache.path(lexer::hash_bytes(buffer->text())).c_str());
+    EXPECT_EQ(rmdir(directory), 0); // No temporary file was left behind
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
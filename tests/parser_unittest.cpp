@@ -0,0 +1,369 @@
+#include <gtest/gtest.h>
+#include "../src/parser/parser.h"
+#include "../src/preprocessor/preprocessor.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using lexer::Token;
+using lexer::TokenType;
+using parser::NodeKind;
+
+// Test fixture for parser tests
+class ParserTest : public ::testing::Test {
+protected:
+    // Preprocesses source and makes a parser over its tokens
+    parser::Parser& start(const std::string& source) {
+        preprocessor_ = std::make_unique<preprocessor::Preprocessor>(
+            lexer::SourceBuffer::from_string(source), identifiers_);
+        tokens_.clear();
+        do {
+            tokens_.push_back(preprocessor_->next_token());
+        } while (tokens_.back().type != TokenType::END_OF_FILE);
+        parser_ = std::make_unique<parser::Parser>(tokens_, identifiers_);
+        return *parser_;
+    }
+
+    // The translation unit as S-expressions, one external declaration per line
+    std::string parse(const std::string& source) {
+        parser::NodeId root = start(source).parse_translation_unit();
+        return parser_->ast().dump(root, identifiers_);
+    }
+
+    std::string expression(const std::string& source) {
+        parser::NodeId root = start(source).parse_expression();
+        return parser_->ast().dump(root, identifiers_);
+    }
+
+    // Diagnostics of the last parse as "line:column: message"
+    std::vector<std::string> diagnostics() {
+        std::vector<std::string> result;
+        for (const parser::Diagnostic& diagnostic : parser_->diagnostics()) {
+            preprocessor::Location location = preprocessor_->location(diagnostic.offset);
+            result.push_back(std::to_string(location.line) + ":" +
+                             std::to_string(location.column) + ": " + diagnostic.message);
+        }
+        return result;
+    }
+
+    lexer::IdentifierTable identifiers_;
+    std::unique_ptr<preprocessor::Preprocessor> preprocessor_;
+    std::vector<Token> tokens_;
+    std::unique_ptr<parser::Parser> parser_;
+};
+
+TEST_F(ParserTest, NodeLayout) {
+    EXPECT_EQ(sizeof(parser::Node), 16u);
+
+    parser::Parser& parser = start("x + 1");
+    parser::NodeId root = parser.parse_expression();
+    const parser::Ast& ast = parser.ast();
+    ASSERT_EQ(ast[root].kind, NodeKind::BINARY);
+    EXPECT_EQ(ast[root].token_type(), TokenType::OP_PLUS);
+    EXPECT_EQ(ast[root].offset, 2u);
+    EXPECT_EQ(ast[ast[root].a].kind, NodeKind::IDENTIFIER);
+    EXPECT_EQ(identifiers_.spelling(ast[ast[root].a].a), "x");
+    EXPECT_EQ(ast[ast[root].a].offset, 0u);
+    EXPECT_EQ(ast[ast[root].b].int_value(), 1u);
+    EXPECT_EQ(ast.size(), 4u); // Node 0 and three nodes
+}
+
+TEST_F(ParserTest, Precedence) {
+    EXPECT_EQ(expression("a + b * c"), "(+ a (* b c))");
+    EXPECT_EQ(expression("a * b + c"), "(+ (* a b) c)");
+    EXPECT_EQ(expression("a - b - c"), "(- (- a b) c)");
+    EXPECT_EQ(expression("a = b = c"), "(= a (= b c))");
+    EXPECT_EQ(expression("a || b && c | d ^ e & f == g < h << i + j * k"),
+              "(|| a (&& b (| c (^ d (& e (== f (< g (<< h (+ i (* j k))))))))))");
+    EXPECT_EQ(expression("a ? b : c ? d : e"), "(? a b (? c d e))");
+    EXPECT_EQ(expression("a ? b, c : d"), "(? a (, b c) d)");
+    EXPECT_EQ(expression("a, b = c, d"), "(, (, a (= b c)) d)");
+    EXPECT_EQ(expression("x += y <<= 2"), "(+= x (<<= y 2))");
+    EXPECT_EQ(expression("(a + b) * c"), "(* (+ a b) c)");
+    EXPECT_EQ(expression("a * b / c % d"), "(% (/ (* a b) c) d)");
+    EXPECT_EQ(expression("a < b == c > d"), "(== (< a b) (> c d))");
+    EXPECT_EQ(expression("a = b ? c : d = e"), "(= a (= (? b c d) e))");
+    EXPECT_EQ(expression("a || b ? c && d : e | f"), "(? (|| a b) (&& c d) (| e f))");
+    EXPECT_EQ(expression("(int)a * -b + c"), "(+ (* (cast (type (specifiers int)) a) (- b)) c)");
+}
+
+TEST_F(ParserTest, LongExpressionsStayShallow) {
+    // Left-associative chains fold in a loop however long they are
+    std::string sum = "x";
+    for (int i = 0; i < 100000; ++i) {
+        sum += i % 2 ? " + x" : " * x";
+    }
+    start("int y = " + sum + ";").parse_translation_unit();
+    EXPECT_TRUE(parser_->diagnostics().empty());
+    EXPECT_LE(parser_->max_depth(), 8u);
+
+    // Rising precedence costs a level per step, not per operand
+    parse("int z = a || b && c | d ^ e & f == g < h << i + j * k;");
+    EXPECT_TRUE(parser_->diagnostics().empty());
+    EXPECT_LE(parser_->max_depth(), 24u);
+}
+
+TEST_F(ParserTest, UnaryAndPostfix) {
+    EXPECT_EQ(expression("-a * !b"), "(* (- a) (! b))");
+    EXPECT_EQ(expression("*p++"), "(* (post++ p))");
+    EXPECT_EQ(expression("++*p"), "(++ (* p))");
+    EXPECT_EQ(expression("&a[i].b->c"), "(& (-> (. ([] a i) b) c))");
+    EXPECT_EQ(expression("f(a, b = 1, (c, d))()"), "(call (call f a (= b 1) (, c d)))");
+    EXPECT_EQ(expression("sizeof x + sizeof(int) + sizeof (x)"),
+              "(+ (+ (sizeof x) (sizeof (type (specifiers int)))) (sizeof x))");
+    EXPECT_EQ(expression("~-x--"), "(~ (- (post-- x)))");
+}
+
+TEST_F(ParserTest, Constants) {
+    EXPECT_EQ(expression("42 + 0x10 + 'a' + L'b'"), "(+ (+ (+ 42 16) 97) 98)");
+    EXPECT_EQ(expression("1.5 + 2e3f"), "(+ 1.5 2000)");
+    EXPECT_EQ(expression("\"ab\" \"c\\n\""), "\"abc\\xa\"");
+    EXPECT_EQ(expression("L\"a\" \"b\""), "L\"ab\"");
+
+    parser::Parser& parser = start("18446744073709551615ULL");
+    const parser::Node& node = parser.ast()[parser.parse_expression()];
+    EXPECT_EQ(node.kind, NodeKind::INT_CONSTANT);
+    EXPECT_EQ(node.int_value(), 18446744073709551615ULL);
+    EXPECT_EQ(static_cast<lexer::NumericType>(node.op), lexer::NumericType::UNSIGNED_LONG_LONG);
+}
+
+TEST_F(ParserTest, CastsAndTypeNames) {
+    EXPECT_EQ(expression("(int)x"), "(cast (type (specifiers int)) x)");
+    EXPECT_EQ(expression("(unsigned long long *)p"),
+              "(cast (type (specifiers unsigned long long) (declarator pointer)) p)");
+    EXPECT_EQ(expression("(int (*)[3])p"),
+              "(cast (type (specifiers int) (declarator pointer (array 3))) p)");
+    EXPECT_EQ(expression("(void (*)(int, ...))f"),
+              "(cast (type (specifiers void) (declarator pointer (function "
+              "(parameter (specifiers int) (declarator)) ...))) f)");
+    EXPECT_EQ(expression("(const struct s *)p"),
+              "(cast (type (specifiers const (struct s)) (declarator pointer)) p)");
+    EXPECT_EQ(expression("(struct point){1, .y = 2}.x"),
+              "(. (literal (type (specifiers (struct point))) {1 (= .y 2)}) x)");
+    // Not a type name, so a parenthesized expression
+    EXPECT_EQ(expression("(x)(y)"), "(call x y)");
+}
+
+TEST_F(ParserTest, Declarators) {
+    EXPECT_EQ(parse("int x, *p, a[10], f(void);"),
+              "(declaration (specifiers int) (declarator x) (declarator p pointer) "
+              "(declarator a (array 10)) (declarator f (function)))");
+    // Array of pointers, pointer to array, function returning a pointer to
+    // a function
+    EXPECT_EQ(parse("int *a[3];"), "(declaration (specifiers int) (declarator a (array 3) pointer))");
+    EXPECT_EQ(parse("int (*a)[3];"),
+              "(declaration (specifiers int) (declarator a pointer (array 3)))");
+    EXPECT_EQ(parse("void (*signal(int sig, void (*handler)(int)))(int);"),
+              "(declaration (specifiers void) (declarator signal (function "
+              "(parameter (specifiers int) (declarator sig)) "
+              "(parameter (specifiers void) (declarator handler pointer (function "
+              "(parameter (specifiers int) (declarator)))))) pointer (function "
+              "(parameter (specifiers int) (declarator)))))");
+    EXPECT_EQ(parse("char *const *volatile p;"),
+              "(declaration (specifiers char) (declarator p (pointer volatile) (pointer const)))");
+    EXPECT_EQ(parse("void f(int n, int a[static restrict n], int b[*]);"),
+              "(declaration (specifiers void) (declarator f (function "
+              "(parameter (specifiers int) (declarator n)) "
+              "(parameter (specifiers int) (declarator a (array static restrict n))) "
+              "(parameter (specifiers int) (declarator b (array *))))))");
+    EXPECT_EQ(parse("static inline const unsigned x = 1, y;"),
+              "(declaration (specifiers static inline const unsigned) "
+              "(init (declarator x) 1) (declarator y))");
+}
+
+TEST_F(ParserTest, StructsUnionsAndEnums) {
+    EXPECT_EQ(parse("struct s { int a, *b; unsigned c : 3, : 0; union { float f; }; } v;"),
+              "(declaration (specifiers (struct s { "
+              "(declaration (specifiers int) (declarator a) (declarator b pointer)) "
+              "(declaration (specifiers unsigned) (bitfield (declarator c) 3) (bitfield - 0)) "
+              "(declaration (specifiers (union - { (declaration (specifiers float) "
+              "(declarator f)) }))) })) (declarator v))");
+    EXPECT_EQ(parse("enum e { A, B = 2, C, };"),
+              "(declaration (specifiers (enum e { A (B 2) C })))");
+    EXPECT_EQ(parse("struct s;"), "(declaration (specifiers (struct s)))");
+    // Enumerators are ordinary identifiers and hide typedefs
+    EXPECT_EQ(parse("typedef int T; enum { T }; int x = T * 2;"),
+              "(declaration (specifiers typedef int) (declarator T))\n"
+              "(declaration (specifiers (enum - { T })))\n"
+              "(declaration (specifiers int) (init (declarator x) (* T 2)))");
+}
+
+TEST_F(ParserTest, TypedefNames) {
+    // T * x declares x once T is a typedef name, and multiplies otherwise
+    EXPECT_EQ(parse("void f(void) { T * x; }"),
+              "(function (specifiers void) (declarator f (function)) "
+              "(compound (expr (* T x))))");
+    EXPECT_EQ(parse("typedef int T; void f(void) { T * x; }"),
+              "(declaration (specifiers typedef int) (declarator T))\n"
+              "(function (specifiers void) (declarator f (function)) "
+              "(compound (declaration (specifiers T) (declarator x pointer))))");
+
+    // Redeclaring T as a variable hides the typedef until the block ends
+    EXPECT_EQ(parse("typedef int T;\n"
+                    "void f(void) { { int T; T * x; } T * y; }"),
+              "(declaration (specifiers typedef int) (declarator T))\n"
+              "(function (specifiers void) (declarator f (function)) (compound "
+              "(compound (declaration (specifiers int) (declarator T)) (expr (* T x))) "
+              "(declaration (specifiers T) (declarator y pointer))))");
+
+    // So does a parameter, in the function's body
+    EXPECT_EQ(parse("typedef int T; int f(int T) { return T * 2; }"),
+              "(declaration (specifiers typedef int) (declarator T))\n"
+              "(function (specifiers int) (declarator f (function "
+              "(parameter (specifiers int) (declarator T)))) (compound (return (* T 2))))");
+
+    // A typedef name after a type specifier is the declarator's name
+    EXPECT_EQ(parse("typedef int T; void f(void) { long T; }"),
+              "(declaration (specifiers typedef int) (declarator T))\n"
+              "(function (specifiers void) (declarator f (function)) "
+              "(compound (declaration (specifiers long) (declarator T))))");
+
+    // Casts and sizeof see typedef names too
+    EXPECT_EQ(parse("typedef struct node node; int n = sizeof(node) + (int)(node *)0;"),
+              "(declaration (specifiers typedef (struct node)) (declarator node))\n"
+              "(declaration (specifiers int) (init (declarator n) (+ (sizeof (type "
+              "(specifiers node))) (cast (type (specifiers int)) (cast (type (specifiers node) "
+              "(declarator pointer)) 0)))))");
+
+    parser::Parser& parser = start("size_t n;");
+    parser.declare_typedef(identifiers_.intern("size_t"));
+    EXPECT_EQ(parser.ast().dump(parser.parse_translation_unit(), identifiers_),
+              "(declaration (specifiers size_t) (declarator n))");
+}
+
+TEST_F(ParserTest, Statements) {
+    EXPECT_EQ(parse("int f(int n) {\n"
+                    "  int i, s = 0;\n"
+                    "  for (i = 0; i < n; ++i) s += i;\n"
+                    "  for (int j = 0;;) break;\n"
+                    "  while (n--) continue;\n"
+                    "  do ; while (0);\n"
+                    "  if (s) return s; else if (n) goto out;\n"
+                    "  switch (n) { case 1: default: s = 2; }\n"
+                    "out:\n"
+                    "  return;\n"
+                    "}"),
+              "(function (specifiers int) (declarator f (function (parameter (specifiers int) "
+              "(declarator n)))) (compound "
+              "(declaration (specifiers int) (declarator i) (init (declarator s) 0)) "
+              "(for (= i 0) (< i n) (++ i) (expr (+= s i))) "
+              "(for (declaration (specifiers int) (init (declarator j) 0)) - - (break)) "
+              "(while (post-- n) (continue)) "
+              "(do (expr) 0) "
+              "(if s (return s) (if n (goto out))) "
+              "(switch n (compound (case 1 (default (expr (= s 2)))))) "
+              "(label out (return))))");
+}
+
+TEST_F(ParserTest, Initializers) {
+    EXPECT_EQ(parse("int a[] = {1, [2] = 3, [4][5] = {6}}, *p = &a[0];"),
+              "(declaration (specifiers int) "
+              "(init (declarator a (array)) {1 (= [2] 3) (= [4] [5] {6})}) "
+              "(init (declarator p pointer) (& ([] a 0))))");
+    EXPECT_EQ(parse("struct s v = {.a.b = 1, .c = {2, 3,},};"),
+              "(declaration (specifiers (struct s)) "
+              "(init (declarator v) {(= .a .b 1) (= .c {2 3})}))");
+}
+
+TEST_F(ParserTest, FunctionDefinitions) {
+    EXPECT_EQ(parse("static int max(int a, int b) { return a > b ? a : b; }"),
+              "(function (specifiers static int) (declarator max (function "
+              "(parameter (specifiers int) (declarator a)) "
+              "(parameter (specifiers int) (declarator b)))) "
+              "(compound (return (? (> a b) a b))))");
+    EXPECT_EQ(parse("int printf(const char *, ...);"),
+              "(declaration (specifiers int) (declarator printf (function "
+              "(parameter (specifiers const char) (declarator pointer)) ...)))");
+    EXPECT_EQ(parse("int old(a, b) { return a; }"),
+              "(function (specifiers int) (declarator old (function (parameter "
+              "(declarator a)) (parameter (declarator b)))) (compound (return a)))");
+    // Old-style, with a declaration list giving the parameters' types
+    EXPECT_EQ(parse("int k(a, b, c) int a; char *b; { return a; }\nint z;"),
+              "(function (specifiers int) (declarator k (function (parameter (specifiers int) "
+              "(declarator a)) (parameter (specifiers char) (declarator b pointer)) "
+              "(parameter (declarator c)))) (compound (return a)))\n"
+              "(declaration (specifiers int) (declarator z))");
+    EXPECT_TRUE(diagnostics().empty());
+    parse("typedef int T;\nint k(x) T x, y; { return x; }\nint z;");
+    EXPECT_EQ(diagnostics(), std::vector<std::string>{
+                                 "2:16: declaration of a name not in the parameter list"});
+}
+
+TEST_F(ParserTest, MacrosExpandBeforeParsing) {
+    EXPECT_EQ(parse("#define MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+                    "int m = MAX(1, 2);"),
+              "(declaration (specifiers int) (init (declarator m) (? (> 1 2) 1 2)))");
+}
+
+TEST_F(ParserTest, Errors) {
+    EXPECT_EQ(parse("int x = ;\n"
+                    "int y = 1 2;\n"
+                    "int z;"),
+              "(declaration (specifiers int) (init (declarator x) (error)))\n"
+              "(declaration (specifiers int) (init (declarator y) 1))\n"
+              "(declaration (specifiers int) (declarator z))");
+    EXPECT_EQ(diagnostics(),
+              (std::vector<std::string>{"1:9: expected expression", "2:11: expected ';'"}));
+
+    // A bad statement is skipped to its end, and the rest of the block parsed
+    parse("void f(void) {\n"
+          "  if (a b) x;\n"
+          "  g(;\n"
+          "  return 1\n"
+          "}\n"
+          "}\n"
+          "int ok;");
+    EXPECT_EQ(diagnostics(), (std::vector<std::string>{"2:9: expected ')'",
+                                                       "3:5: expected expression",
+                                                       "5:1: expected ';'",
+                                                       "6:1: expected declaration"}));
+
+    // Errors from the preprocessor are passed on
+    parse("#error stop\nint x;");
+    EXPECT_EQ(diagnostics(), (std::vector<std::string>{"1:1: #error stop"}));
+
+    parse("struct { int a; } ; int;");
+    EXPECT_TRUE(diagnostics().empty());
+
+    // Running out of input
+    EXPECT_EQ(parse("void f(void) { if (x"), "(function (specifiers void) (declarator f "
+                                              "(function)) (compound (if x (expr (error)))))");
+    EXPECT_EQ(diagnostics(), (std::vector<std::string>{"1:21: expected ')'"}));
+}
+
+TEST_F(ParserTest, DeepNesting) {
+    // Nesting beyond kMaxDepth is an error rather than a stack overflow
+    std::string deep(100000, '(');
+    parse("int x = " + deep + "1;");
+    ASSERT_EQ(parser_->diagnostics().size(), 1u);
+    EXPECT_EQ(parser_->diagnostics()[0].message, "nesting too deep");
+
+    std::string blocks;
+    for (int i = 0; i < 100000; ++i) {
+        blocks += "{";
+    }
+    parse("void f(void) " + blocks);
+    ASSERT_FALSE(parser_->diagnostics().empty());
+    EXPECT_EQ(parser_->diagnostics()[0].message, "nesting too deep");
+
+    // Prefix increments, sizeof and struct definitions nest without brackets
+    std::string increments;
+    std::string sizes;
+    std::string records;
+    for (int i = 0; i < 100000; ++i) {
+        increments += "++";
+        sizes += "sizeof ";
+        records += "struct{";
+    }
+    for (const std::string& source : {"int x = " + increments + "y;", "int x = " + sizes + "y;",
+                                      records + "int a;"}) {
+        start(source).parse_translation_unit();
+        ASSERT_FALSE(parser_->diagnostics().empty());
+        EXPECT_EQ(parser_->diagnostics()[0].message, "nesting too deep");
+    }
+
+    // Within the limit, fine
+    std::string nested = std::string(100, '(') + "1" + std::string(100, ')');
+    parse("int x = " + nested + ";");
+    EXPECT_TRUE(parser_->diagnostics().empty());
+}
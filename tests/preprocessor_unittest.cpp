@@ -0,0 +1,531 @@
+#include <gtest/gtest.h>
+#include "../src/preprocessor/preprocessor.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using lexer::Token;
+using lexer::TokenFlag;
+using lexer::TokenType;
+
+// Test fixture for preprocessor tests
+class PreprocessorTest : public ::testing::Test {
+protected:
+    // Every token up to END_OF_FILE
+    std::vector<Token> tokens(const std::string& source) {
+        preprocessor_ = std::make_unique<preprocessor::Preprocessor>(
+            lexer::SourceBuffer::from_string(source), identifiers_);
+        std::vector<Token> result;
+        for (Token token = preprocessor_->next_token(); token.type != TokenType::END_OF_FILE;
+             token = preprocessor_->next_token()) {
+            result.push_back(token);
+        }
+        return result;
+    }
+
+    // The output as spellings separated by single spaces, with a line break
+    // before each token that starts a line. Errors show as <message>.
+    std::string preprocess(const std::string& source) {
+        std::string out;
+        for (const Token& token : tokens(source)) {
+            if (!out.empty()) {
+                out += token.has(TokenFlag::START_OF_LINE) ? '\n' : ' ';
+            }
+            if (token.type == TokenType::ERROR_TOKEN) {
+                out += '<';
+                out += token.value;
+                out += '>';
+            } else {
+                preprocessor::append_spelling(out, token);
+            }
+        }
+        return out;
+    }
+
+    lexer::IdentifierTable identifiers_;
+    std::unique_ptr<preprocessor::Preprocessor> preprocessor_;
+};
+
+TEST_F(PreprocessorTest, PassesTokensThrough) {
+    EXPECT_EQ(preprocess("int main() { return 0; }"), "int main ( ) { return 0 ; }");
+    EXPECT_EQ(preprocess("a\nb c\n\n  d"), "a\nb c\nd");
+    EXPECT_EQ(preprocess(""), "");
+}
+
+TEST_F(PreprocessorTest, PositionFlags) {
+    std::vector<Token> result = tokens("a b/**/c\n  d \\\n e");
+    ASSERT_EQ(result.size(), 5u);
+    EXPECT_TRUE(result[0].has(TokenFlag::START_OF_LINE));
+    EXPECT_FALSE(result[0].has(TokenFlag::LEADING_SPACE));
+    EXPECT_FALSE(result[1].has(TokenFlag::START_OF_LINE));
+    EXPECT_TRUE(result[1].has(TokenFlag::LEADING_SPACE));
+    EXPECT_TRUE(result[2].has(TokenFlag::LEADING_SPACE)); // A comment is a space
+    EXPECT_TRUE(result[3].has(TokenFlag::START_OF_LINE));
+    EXPECT_TRUE(result[3].has(TokenFlag::LEADING_SPACE));
+    EXPECT_FALSE(result[4].has(TokenFlag::START_OF_LINE)); // Spliced onto d's line
+
+    // The first token of an expansion takes the macro name's place
+    result = tokens("#define F(x) x\n#define G g\nf F( b ) G\n   G");
+    ASSERT_EQ(result.size(), 4u);
+    EXPECT_EQ(result[1].value, "b");
+    EXPECT_TRUE(result[1].has(TokenFlag::LEADING_SPACE));
+    EXPECT_EQ(result[2].value, "g");
+    EXPECT_TRUE(result[2].has(TokenFlag::LEADING_SPACE));
+    EXPECT_FALSE(result[2].has(TokenFlag::START_OF_LINE));
+    EXPECT_TRUE(result[3].has(TokenFlag::START_OF_LINE));
+}
+
+TEST_F(PreprocessorTest, ObjectLikeMacros) {
+    EXPECT_EQ(preprocess("#define N 10\n#define EMPTY\nint a[N]; EMPTY x"), "int a [ 10 ] ; x");
+    EXPECT_EQ(preprocess("#define A B\n#define B 1\nA\n#undef B\nA"), "1\nB");
+    EXPECT_EQ(preprocess("# define  X  1 + \\\n 2\nX"), "1 + 2");
+
+    std::vector<Token> result = tokens("#define N 10\nN");
+    ASSERT_EQ(result.size(), 1u);
+    EXPECT_EQ(result[0].type, TokenType::CONSTANT_INT);
+    EXPECT_EQ(result[0].int_value, 10u);
+    ASSERT_NE(preprocessor_->macro("N"), nullptr);
+    EXPECT_EQ(preprocessor_->macro("N")->size, 1u);
+    EXPECT_EQ(preprocessor_->macro("M"), nullptr);
+}
+
+TEST_F(PreprocessorTest, FunctionLikeMacros) {
+    EXPECT_EQ(preprocess("#define max(a, b) ((a) > (b) ? (a) : (b))\nmax(x, f(y, z))"),
+              "( ( x ) > ( f ( y , z ) ) ? ( x ) : ( f ( y , z ) ) )");
+    // Without '(' the name is left alone, and the token after it is kept
+    EXPECT_EQ(preprocess("#define f(x) x\nf + f\n(1)"), "f + 1");
+    // A space before '(' makes the macro object-like
+    EXPECT_EQ(preprocess("#define f (x) x\nf(1)"), "( x ) x ( 1 )");
+    EXPECT_EQ(preprocess("#define none() 1\n#define one(x) [x]\nnone() one() one((a, b))"),
+              "1 [ ] [ ( a , b ) ]");
+}
+
+TEST_F(PreprocessorTest, RecursionIsStopped) {
+    std::vector<Token> result = tokens("#define foo foo + 1\nfoo");
+    ASSERT_EQ(result.size(), 3u);
+    EXPECT_EQ(result[0].value, "foo");
+    EXPECT_TRUE(result[0].has(TokenFlag::NO_EXPAND));
+
+    EXPECT_EQ(preprocess("#define a b\n#define b a\na b"), "a b");
+    // f is still being expanded when g turns into f again, as with GCC
+    EXPECT_EQ(preprocess("#define f(x) x g\n#define g f\ng(1)(2)"), "1 f ( 2 )");
+    EXPECT_EQ(preprocess("#define id(x) x\nid(id(id(1)))"), "1");
+}
+
+// C99 6.10.3.5 EXAMPLE 3
+TEST_F(PreprocessorTest, StandardExample3) {
+    std::string source =
+        "#define x 3\n"
+        "#define f(a) f(x * (a))\n"
+        "#undef x\n"
+        "#define x 2\n"
+        "#define g f\n"
+        "#define z z[0]\n"
+        "#define h g(~\n"
+        "#define m(a) a(w)\n"
+        "#define w 0,1\n"
+        "#define t(a) a\n"
+        "#define p() int\n"
+        "#define q(x) x\n"
+        "#define r(x,y) x ## y\n"
+        "#define str(x) # x\n"
+        "f(y+1) + f(f(z)) % t(t(g)(0) + t)(1);\n"
+        "g(x+(3,4)-w) | h 5) & m\n"
+        "(f)^m(m);\n"
+        "p() i[q()] = { q(1), r(2,3), r(4,), r(,5), r(,) };\n"
+        "char c[2][6] = { str(hello), str() };\n";
+    EXPECT_EQ(preprocess(source),
+              "f ( 2 * ( y + 1 ) ) + f ( 2 * ( f ( 2 * ( z [ 0 ] ) ) ) ) % "
+              "f ( 2 * ( 0 ) ) + t ( 1 ) ;\n"
+              "f ( 2 * ( 2 + ( 3 , 4 ) - 0 , 1 ) ) | f ( 2 * ( ~ 5 ) ) & "
+              "f ( 2 * ( 0 , 1 ) ) ^ m ( 0 , 1 ) ;\n"
+              "int i [ ] = { 1 , 23 , 4 , 5 , } ;\n"
+              "char c [ 2 ] [ 6 ] = { \"hello\" , \"\" } ;");
+}
+
+// C99 6.10.3.5 EXAMPLE 4, less the part that needs #include
+TEST_F(PreprocessorTest, StandardExample4) {
+    std::string source =
+        "#define str(s) # s\n"
+        "#define xstr(s) str(s)\n"
+        "#define debug(s, t) printf(\"x\" # s \"= %d, x\" # t \"= %s\", \\\n"
+        " x ## s, x ## t)\n"
+        "#define INCFILE(n) vers ## n\n"
+        "#define glue(a, b) a ## b\n"
+        "#define xglue(a, b) glue(a, b)\n"
+        "#define HIGHLOW \"hello\"\n"
+        "#define LOW LOW \", world\"\n"
+        "debug(1, 2);\n"
+        "fputs(str(strncmp(\"abc\\0d\", \"abc\", '\\4') // this goes away\n"
+        " == 0), s);\n"
+        "xstr(INCFILE(2).h)\n"
+        "glue(HIGH, LOW);\n"
+        "xglue(HIGH, LOW)\n"
+        "str(: @\\n)\n";
+    EXPECT_EQ(preprocess(source),
+              "printf ( \"x\" \"1\" \"= %d, x\" \"2\" \"= %s\" , x1 , x2 ) ;\n"
+              "fputs ( \"strncmp(\\\"abc\\\\0d\\\", \\\"abc\\\", '\\\\4') == 0\" , s ) ;\n"
+              "\"vers2.h\"\n"
+              "\"hello\" ;\n"
+              "\"hello\" \", world\"\n"
+              "\": @\\n\"");
+}
+
+// C99 6.10.3.5 EXAMPLE 6: redefinitions that are allowed, then ones that
+// are not, each of which still replaces the definition
+TEST_F(PreprocessorTest, StandardExample6) {
+    std::string valid =
+        "#define OBJ_LIKE (1-1)\n"
+        "#define OBJ_LIKE /* white space */ (1-1) /* other */\n"
+        "#define FUNC_LIKE(a) ( a )\n"
+        "#define FUNC_LIKE( a )( /* note the white space */ \\\n"
+        "a /* other stuff on this line\n"
+        " */ )\n";
+    EXPECT_EQ(preprocess(valid + "OBJ_LIKE FUNC_LIKE(x)"), "( 1 - 1 ) ( x )");
+
+    EXPECT_EQ(preprocess(valid + "#define OBJ_LIKE (0)\nOBJ_LIKE"), "<'OBJ_LIKE' redefined>\n( 0 )");
+    EXPECT_EQ(preprocess(valid + "#define OBJ_LIKE (1 - 1)\n"), "<'OBJ_LIKE' redefined>");
+    EXPECT_EQ(preprocess(valid + "#define FUNC_LIKE(b) ( a )\nFUNC_LIKE(x)"),
+              "<'FUNC_LIKE' redefined>\n( a )");
+    EXPECT_EQ(preprocess(valid + "#define FUNC_LIKE(b) ( b )\n"), "<'FUNC_LIKE' redefined>");
+
+    // Object-like against function-like, and variadic against not
+    EXPECT_EQ(preprocess("#define F(x) x\n#define F (x) x\n"), "<'F' redefined>");
+    EXPECT_EQ(preprocess("#define V(x, ...) x\n#define V(x, ...) x\n#define V(x, y) x\n"),
+              "<'V' redefined>");
+    EXPECT_EQ(preprocess("#define S \"a\"\n#define S L\"a\"\n"), "<'S' redefined>");
+    EXPECT_EQ(preprocess("#define E\n#define E\n#undef E\n#define E 1\n"), "");
+}
+
+TEST_F(PreprocessorTest, Stringizing) {
+    std::vector<Token> result = tokens("#define str(x) #x\nstr( a  +\n b ) str(\"\\n\") str() str(L'x')");
+    ASSERT_EQ(result.size(), 4u);
+    EXPECT_EQ(result[0].type, TokenType::CONSTANT_STRING);
+    EXPECT_EQ(result[0].value, "a + b");
+    EXPECT_EQ(result[0].string->bytes, "a + b");
+    // The value is escaped like source; the contents are what it decodes to
+    EXPECT_EQ(result[1].value, "\\\"\\\\n\\\"");
+    EXPECT_EQ(result[1].string->bytes, "\"\\n\"");
+    EXPECT_EQ(result[2].value, "");
+    EXPECT_EQ(result[2].string->bytes, "");
+    EXPECT_EQ(result[3].string->bytes, "L'x'");
+}
+
+TEST_F(PreprocessorTest, TokenPasting) {
+    EXPECT_EQ(preprocess("#define cat(a, b) a ## b\ncat(x, 1) cat(1, e5) cat(+, =) cat(<<, =) cat(-, >)"),
+              "x1 1e5 += <<= ->");
+    EXPECT_EQ(preprocess("#define cat(a, b) a ## b\ncat(L, \"wide\") cat(L, 'c')"), "L\"wide\" L'c'");
+    EXPECT_EQ(preprocess("#define cat3(a, b, c) a ## b ## c\ncat3(x, , z) cat3(, , z) cat3(, , ) cat3(a b, c d, e f)"),
+              "xz z a bc de f");
+
+    // Pasting makes a keyword, and a name that is then expanded
+    std::vector<Token> result = tokens("#define cat(a, b) a ## b\n#define xy 42\ncat(in, t) cat(x, y)");
+    ASSERT_EQ(result.size(), 2u);
+    EXPECT_EQ(result[0].type, TokenType::KW_INT);
+    EXPECT_EQ(result[1].type, TokenType::CONSTANT_INT);
+    EXPECT_EQ(result[1].int_value, 42u);
+
+    result = tokens("#define cat(a, b) a ## b\ncat(L, \"s\")");
+    ASSERT_EQ(result.size(), 1u);
+    EXPECT_TRUE(result[0].string->wide);
+    EXPECT_TRUE(result[0].has(TokenFlag::WIDE));
+
+    // Object-like macros paste too
+    EXPECT_EQ(preprocess("#define AB a ## b\nAB"), "ab");
+}
+
+// C99 6.10.3.3 EXAMPLE
+TEST_F(PreprocessorTest, HashHash) {
+    std::string source =
+        "#define hash_hash # ## #\n"
+        "#define mkstr(a) # a\n"
+        "#define in_between(a) mkstr(a)\n"
+        "#define join(c, d) in_between(c hash_hash d)\n"
+        "char p[] = join(x, y);\n";
+    EXPECT_EQ(preprocess(source), "char p [ ] = \"x ## y\" ;");
+}
+
+// C99 6.10.3.5 EXAMPLE 7
+TEST_F(PreprocessorTest, VariadicMacros) {
+    std::string source =
+        "#define debug(...) fprintf(stderr, __VA_ARGS__)\n"
+        "#define showlist(...) puts(#__VA_ARGS__)\n"
+        "#define report(test, ...) ((test)?puts(#test):\\\n"
+        " printf(__VA_ARGS__))\n"
+        "debug(\"Flag\");\n"
+        "debug(\"X = %d\\n\", x);\n"
+        "showlist(The first, second, and third items.);\n"
+        "report(x>y, \"x is %d but y is %d\", x, y);\n";
+    EXPECT_EQ(preprocess(source),
+              "fprintf ( stderr , \"Flag\" ) ;\n"
+              "fprintf ( stderr , \"X = %d\\n\" , x ) ;\n"
+              "puts ( \"The first, second, and third items.\" ) ;\n"
+              "( ( x > y ) ? puts ( \"x>y\" ) : printf ( \"x is %d but y is %d\" , x , y ) ) ;");
+    EXPECT_EQ(preprocess("#define f(a, ...) a __VA_ARGS__\nf(1) f(1, )"), "1 1");
+}
+
+TEST_F(PreprocessorTest, Conditionals) {
+    std::string source =
+        "#define A 1\n"
+        "#if defined(A) && !defined B\n"
+        "yes1\n"
+        "#endif\n"
+        "#if A == 2\n"
+        "no\n"
+        "#elif A == 1\n"
+        "yes2\n"
+        "#elif 1\n"
+        "no\n"
+        "#else\n"
+        "no\n"
+        "#endif\n"
+        "#ifdef B\n"
+        "# if 1/0\n"
+        "no\n"
+        "# else\n"
+        "no\n"
+        "# endif\n"
+        "#else\n"
+        "yes3\n"
+        "#endif\n"
+        "#ifndef A\n"
+        "#error not reached\n"
+        "#endif\n";
+    EXPECT_EQ(preprocess(source), "yes1\nyes2\nyes3");
+}
+
+TEST_F(PreprocessorTest, ConditionalArithmetic) {
+    auto holds = [&](const std::string& condition) {
+        std::string result = preprocess("#define TWO 2\n#define F(x) x\n#if " + condition + "\n1\n#else\n0\n#endif");
+        EXPECT_TRUE(result == "1" || result == "0") << condition << ": " << result;
+        return result == "1";
+    };
+    EXPECT_TRUE(holds("1 + 2 * 3 == 7"));
+    EXPECT_TRUE(holds("(1 + 2) * 3 == 9"));
+    EXPECT_TRUE(holds("-1 < 0"));
+    EXPECT_FALSE(holds("-1 < 0u")); // -1 converts to UINTMAX_MAX
+    EXPECT_TRUE(holds("-1 > 0u"));
+    EXPECT_TRUE(holds("0xffffffffffffffff == -1"));
+    EXPECT_TRUE(holds("-1 >> 1 == -1"));
+    EXPECT_TRUE(holds("1 << 62 > 0 && 1 << 63 < 0"));
+    EXPECT_TRUE(holds("-7 / 2 == -3 && -7 % 2 == -1"));
+    EXPECT_TRUE(holds("'a' == 97 && '\\0' == 0"));
+    EXPECT_TRUE(holds("(2 || 1/0) && 0 ? 1 : 2"));
+    EXPECT_TRUE(holds("0 && 1/0 || 1"));
+    EXPECT_TRUE(holds("TWO == 2 && F(TWO) == 2"));
+    EXPECT_TRUE(holds("undefined_name == 0"));
+    EXPECT_TRUE(holds("defined TWO && defined(F) && !defined(G)"));
+    EXPECT_TRUE(holds("(1 ? 2 : 3) == 2 && (0 ? 2 : 3) == 3"));
+    EXPECT_TRUE(holds("~0 == -1 && !0 == 1 && (5 & 3) == 1 && (5 | 3) == 7 && (5 ^ 3) == 6"));
+}
+
+TEST_F(PreprocessorTest, Directives) {
+    // The null directive, and #pragma, which is ignored
+    EXPECT_EQ(preprocess("#\n#pragma once\na"), "a");
+    // '#' that does not start a line is an ordinary token, even when it does
+    // after expansion (C99 6.10.3.4p3)
+    EXPECT_EQ(preprocess("a # b\n#define EMPTY\nEMPTY # define X 1\nX"), "a # b\n# define X 1\nX");
+    // Nor after a comment spanning lines, which is one space; a line comment
+    // still ends its line
+    EXPECT_EQ(preprocess("int a /*\n*/ # define X 1\nX"), "int a # define X 1\nX");
+    EXPECT_EQ(preprocess("a /* // */ # b\nc // /*\n#define X 1\nX"), "a # b\nc\n1");
+}
+
+TEST_F(PreprocessorTest, Line) {
+    EXPECT_EQ(preprocess("__LINE__\n\n__LINE__\n#define L __LINE__\nL"), "1\n3\n5");
+    // In a condition, the line of the directive, though the next line has
+    // been read
+    EXPECT_EQ(preprocess("#if __LINE__ == 1\na\n#endif"), "a");
+    EXPECT_EQ(preprocess("\n#if __LINE__ == 2\n\n\nb\n#endif"), "b");
+    EXPECT_EQ(preprocess("#define L __LINE__\n#if 0\n#elif L == 3\n\nc\n#endif"), "c");
+    EXPECT_EQ(preprocess("#if __LINE__ == \\\n2\nd\n#endif"), "d");
+
+    // #line numbers the next line, and can rename the file; its operands are
+    // macro-expanded
+    EXPECT_EQ(preprocess("#line 10\n__LINE__\n\n__LINE__"), "10\n12");
+    EXPECT_EQ(preprocess("#line 10 \"foo.c\"\n__LINE__ __FILE__"), "10 \"foo.c\"");
+    EXPECT_EQ(preprocess("#define N 20\n#define F \"f\\\\g.c\"\n#line N F\n__FILE__"), "\"f\\\\g.c\"");
+    EXPECT_EQ(preprocess("#line 5 \"a.c\"\n#line 7\n#if __LINE__ == 7\n__FILE__ __LINE__\n#endif"),
+              "\"a.c\" 8");
+
+    std::vector<Token> result = tokens("a\n#line 100 \"b.c\"\n\n  b");
+    ASSERT_EQ(result.size(), 2u);
+    EXPECT_EQ(preprocessor_->location(result[0].offset).line, 1u);
+    EXPECT_EQ(preprocessor_->location(result[0].offset).file, "");
+    preprocessor::Location location = preprocessor_->location(result[1].offset);
+    EXPECT_EQ(location.file, "b.c");
+    EXPECT_EQ(location.line, 101u);
+    EXPECT_EQ(location.column, 3u);
+
+    const std::string message = "<#line expects a line number and optional \"FILENAME\">";
+    for (const char* bad : {"#line\n", "#line 0\n", "#line 2147483648\n", "#line 0x10\n",
+                            "#line 1u\n", "#line 10 foo\n", "#line \"a.c\"\n",
+                            "#line 10 \"a.c\" 1\n", "#line 10 L\"a.c\"\n"}) {
+        EXPECT_EQ(preprocess(std::string(bad) + "__LINE__"), message + "\n2") << bad;
+    }
+}
+
+TEST_F(PreprocessorTest, Errors) {
+    EXPECT_EQ(preprocess("#if 1/0\na\n#endif\nb"), "<Division by zero in preprocessor expression>\nb");
+    EXPECT_EQ(preprocess("#if 1 +\n#endif\nb"), "<Missing expression>\nb");
+    EXPECT_EQ(preprocess("#if 1\na"), "a <Unterminated conditional directive>");
+    EXPECT_EQ(preprocess("#endif\na"), "<Conditional directive without #if>\na");
+    EXPECT_EQ(preprocess("#error stop here\na"), "<#error stop here>\na");
+    EXPECT_EQ(preprocess("#foo\na"), "<Invalid preprocessing directive>\na");
+    EXPECT_EQ(preprocess("#define\na"), "<Macro name missing>\na");
+    EXPECT_EQ(preprocess("#define f(x) #y\na"), "<'#' is not followed by a macro parameter>\na");
+    EXPECT_EQ(preprocess("#define f(x) ## x\na"), "<'##' cannot appear at either end of a macro expansion>\na");
+    EXPECT_EQ(preprocess("#define f(x, x) x\na"), "<Duplicate macro parameter>\na");
+    EXPECT_EQ(preprocess("#define f(x) x\nf(1, 2) b"), "<Too many arguments in invocation of macro \"f\"> b");
+    EXPECT_EQ(preprocess("#define f(x, y) x\nf(1) b"), "<Too few arguments in invocation of macro \"f\"> b");
+    EXPECT_EQ(preprocess("#define f(x) x\nf(1"), "<Unterminated argument list invoking macro \"f\">");
+    EXPECT_EQ(preprocess("#define cat(a, b) a ## b\ncat(+, -)"),
+              "+ <Pasting \"+\" and \"-\" does not give a valid preprocessing token> -");
+    EXPECT_EQ(preprocess("#include <no_such_header.h>\na"), "<'no_such_header.h' file not found>\na");
+    EXPECT_EQ(preprocess("#include stdio.h\na"), "<#include expects \"FILENAME\" or <FILENAME>>\na");
+}
+
+// Files in a temporary directory, preprocessed with a shared cache
+class IncludeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char path[] = "/tmp/preprocessor_unittest_XXXXXX";
+        ASSERT_NE(mkdtemp(path), nullptr);
+        directory_ = path;
+    }
+
+    void TearDown() override { std::filesystem::remove_all(directory_); }
+
+    std::string write(const std::string& name, const std::string& text) {
+        std::string path = directory_ + "/" + name;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+        std::ofstream(path, std::ios::binary) << text;
+        return path;
+    }
+
+    // Preprocesses the file name like PreprocessorTest::preprocess()
+    std::string preprocess(const std::string& name) {
+        preprocessor_ = std::make_unique<preprocessor::Preprocessor>(directory_ + "/" + name, cache_);
+        preprocessor_->add_include_directory(directory_ + "/include");
+        std::string out;
+        for (Token token = preprocessor_->next_token(); token.type != TokenType::END_OF_FILE;
+             token = preprocessor_->next_token()) {
+            tokens_.push_back(token);
+            if (!out.empty()) {
+                out += token.has(TokenFlag::START_OF_LINE) ? '\n' : ' ';
+            }
+            if (token.type == TokenType::ERROR_TOKEN) {
+                out += '<';
+                out += token.value;
+                out += '>';
+            } else {
+                preprocessor::append_spelling(out, token);
+            }
+        }
+        return out;
+    }
+
+    std::string directory_;
+    lexer::IdentifierTable identifiers_;
+    preprocessor::FileCache cache_{identifiers_};
+    std::unique_ptr<preprocessor::Preprocessor> preprocessor_;
+    std::vector<Token> tokens_;
+};
+
+TEST_F(IncludeTest, QuotedAndAngled) {
+    write("main.c", "#include \"local.h\"\n#include <sys.h>\nmain");
+    write("local.h", "#define LOCAL 1\nlocal LOCAL");
+    write("include/sys.h", "#include \"sys_detail.h\"\nsys");
+    write("include/sys_detail.h", "detail");
+    EXPECT_EQ(preprocess("main.c"), "local 1\ndetail\nsys\nmain");
+    ASSERT_NE(preprocessor_->macro("LOCAL"), nullptr);
+
+    // Quoted names fall back on the include directories; angled ones never
+    // look next to the includer
+    write("fallback.c", "#include \"sys_detail.h\"\n#include <local.h>");
+    EXPECT_EQ(preprocess("fallback.c"), "detail <'local.h' file not found>");
+}
+
+TEST_F(IncludeTest, NamesFromMacros) {
+    write("main.c", "#define HEADER \"a.h\"\n#define SYS <sys.h>\n#include HEADER\n#include SYS\n");
+    write("a.h", "a");
+    write("include/sys.h", "sys");
+    EXPECT_EQ(preprocess("main.c"), "a\nsys");
+}
+
+TEST_F(IncludeTest, FileAndLine) {
+    write("main.c", "__FILE__ __LINE__\n#include \"dir/a.h\"\n__LINE__");
+    write("dir/a.h", "\n__FILE__ __LINE__");
+    std::string main = directory_ + "/main.c";
+    std::string header = directory_ + "/dir/a.h";
+    EXPECT_EQ(preprocess("main.c"), "\"" + main + "\" 1\n\"" + header + "\" 2\n3");
+
+    // Offsets of included tokens map back to their file
+    ASSERT_EQ(tokens_.size(), 5u);
+    preprocessor::Location location = preprocessor_->location(tokens_[3].offset);
+    EXPECT_EQ(location.file, header);
+    EXPECT_EQ(location.line, 2u);
+    EXPECT_EQ(location.column, 10u);
+    location = preprocessor_->location(tokens_[4].offset);
+    EXPECT_EQ(location.file, main);
+    EXPECT_EQ(location.line, 3u);
+}
+
+// Test #line in an included file renumbers that inclusion only
+TEST_F(IncludeTest, LineInInclude) {
+    write("main.c", "#include \"a.h\"\n__FILE__ __LINE__\n#include \"a.h\"");
+    write("a.h", "#line 50 \"renamed.h\"\n__FILE__ __LINE__");
+    std::string main = directory_ + "/main.c";
+    EXPECT_EQ(preprocess("main.c"),
+              "\"renamed.h\" 50\n\"" + main + "\" 2\n\"renamed.h\" 50");
+    ASSERT_EQ(tokens_.size(), 6u);
+    EXPECT_EQ(preprocessor_->location(tokens_[2].offset).line, 2u);
+    EXPECT_EQ(preprocessor_->location(tokens_[5].offset).file, "renamed.h");
+}
+
+TEST_F(IncludeTest, GuardedHeadersAreSkipped) {
+    write("guarded.h", "// comment\n#ifndef GUARDED_H\n#define GUARDED_H\n#if 1\nguarded\n#endif\n#endif /* GUARDED_H */\n");
+    write("defined.h", "#if !defined(DEFINED_H)\n#define DEFINED_H\ndefined\n#endif\n");
+    write("else.h", "#ifndef ELSE_H\n#define ELSE_H\nelse\n#else\n#endif\n");
+    write("trailing.h", "#ifndef TRAILING_H\n#define TRAILING_H\ntrailing\n#endif\n;\n");
+    write("main.c",
+          "#include \"guarded.h\"\n#include \"guarded.h\"\n"
+          "#include \"defined.h\"\n#include \"defined.h\"\n"
+          "#include \"else.h\"\n#include \"else.h\"\n"
+          "#include \"trailing.h\"\n#include \"trailing.h\"\n");
+    EXPECT_EQ(preprocess("main.c"), "guarded\ndefined\nelse\ntrailing\n;\n;");
+
+    // The comment before #ifndef counts as nothing; the #else and the
+    // trailing ';' keep the other two from being recognized
+    const preprocessor::FileCache::Stats& stats = cache_.stats();
+    EXPECT_EQ(stats.includes, 8u);
+    EXPECT_EQ(stats.guard_skips, 2u);
+    EXPECT_EQ(stats.files_read, 4u);
+
+    // A second translation unit finds everything in the cache
+    uint64_t lookups = stats.lookups;
+    EXPECT_EQ(preprocess("main.c"), "guarded\ndefined\nelse\ntrailing\n;\n;");
+    EXPECT_EQ(stats.files_read, 4u);
+    EXPECT_EQ(stats.lookups - lookups, 8u);
+    EXPECT_EQ(stats.hits, stats.lookups - 4);
+    EXPECT_NE(cache_.report().find("skipped by guard"), std::string::npos);
+}
+
+TEST_F(IncludeTest, PragmaOnce) {
+    write("once.h", "#pragma once\nonce\n");
+    write("main.c", "#include \"once.h\"\n#include \"once.h\"\n#include \"./once.h\"\nend");
+    EXPECT_EQ(preprocess("main.c"), "once\nend");
+    EXPECT_EQ(cache_.stats().once_skips, 2u);
+    // One entry serves both spellings of the path
+    EXPECT_EQ(cache_.stats().files_read, 1u);
+}
+
+TEST_F(IncludeTest, Errors) {
+    write("open.h", "#if 1\nopen\n");
+    write("main.c", "#include \"open.h\"\nafter\n#include \"missing.h\"\n#include \"self.h\"\n");
+    write("self.h", "#include \"self.h\"\n");
+    EXPECT_EQ(preprocess("main.c"), "open <Unterminated conditional directive>\nafter "
+                                    "<'missing.h' file not found> <#include nested too deeply>");
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "../src/lexer/identifier_table.h"
+#include "../src/lexer/instrument.h"
+#include "../src/semantic/symbol_table.h"
+#include <string>
+
+using semantic::Symbol;
+using semantic::SymbolKind;
+using semantic::SymbolTable;
+
+// Test fixture for semantic analysis tests
+class SymbolTableTest : public ::testing::Test {
+protected:
+    lexer::IdentifierId id(const std::string& spelling) { return identifiers_.intern(spelling); }
+
+    lexer::IdentifierTable identifiers_;
+    SymbolTable symbols_;
+};
+
+TEST_F(SymbolTableTest, DeclareAndLookup) {
+    EXPECT_EQ(symbols_.lookup(id("x")), nullptr);
+    EXPECT_EQ(symbols_.lookup(lexer::kNoIdentifier), nullptr);
+
+    symbols_.declare(id("x"), SymbolKind::OBJECT, 7);
+    symbols_.declare(id("T"), SymbolKind::TYPEDEF);
+    const Symbol* x = symbols_.lookup(id("x"));
+    ASSERT_NE(x, nullptr);
+    EXPECT_EQ(x->name, id("x"));
+    EXPECT_EQ(x->kind, SymbolKind::OBJECT);
+    EXPECT_EQ(x->scope, 0u);
+    EXPECT_EQ(x->declaration, 7u);
+    EXPECT_EQ(symbols_.lookup(id("T"))->kind, SymbolKind::TYPEDEF);
+    EXPECT_EQ(symbols_.lookup(id("y")), nullptr);
+
+    // Declaring again in the same scope replaces the binding
+    symbols_.declare(id("x"), SymbolKind::FUNCTION, 9);
+    EXPECT_EQ(symbols_.lookup(id("x"))->kind, SymbolKind::FUNCTION);
+    EXPECT_EQ(symbols_.lookup(id("x"))->declaration, 9u);
+    EXPECT_EQ(symbols_.size(), 2u);
+}
+
+TEST_F(SymbolTableTest, ShadowingAndScopes) {
+    symbols_.declare(id("T"), SymbolKind::TYPEDEF);
+    symbols_.declare(id("n"), SymbolKind::OBJECT);
+
+    symbols_.push_scope();
+    EXPECT_EQ(symbols_.depth(), 1u);
+    EXPECT_EQ(symbols_.lookup_local(id("T")), nullptr);
+    symbols_.declare(id("T"), SymbolKind::OBJECT); // Hides the typedef
+    EXPECT_EQ(symbols_.lookup(id("T"))->kind, SymbolKind::OBJECT);
+    EXPECT_EQ(symbols_.lookup(id("T"))->scope, 1u);
+    EXPECT_NE(symbols_.lookup_local(id("T")), nullptr);
+
+    symbols_.push_scope();
+    symbols_.declare(id("T"), SymbolKind::ENUM_CONSTANT);
+    symbols_.declare(id("inner"), SymbolKind::OBJECT);
+    EXPECT_EQ(symbols_.lookup(id("T"))->kind, SymbolKind::ENUM_CONSTANT);
+    EXPECT_EQ(symbols_.lookup(id("n"))->scope, 0u);
+
+    symbols_.pop_scope();
+    EXPECT_EQ(symbols_.lookup(id("T"))->kind, SymbolKind::OBJECT);
+    EXPECT_EQ(symbols_.lookup(id("inner")), nullptr);
+
+    symbols_.pop_scope();
+    EXPECT_EQ(symbols_.depth(), 0u);
+    EXPECT_EQ(symbols_.lookup(id("T"))->kind, SymbolKind::TYPEDEF);
+    EXPECT_EQ(symbols_.size(), 2u);
+
+    // Leaving file scope is not possible
+    symbols_.pop_scope();
+    EXPECT_EQ(symbols_.depth(), 0u);
+    EXPECT_EQ(symbols_.lookup(id("T"))->kind, SymbolKind::TYPEDEF);
+}
+
+TEST_F(SymbolTableTest, DeepNesting) {
+    lexer::IdentifierId i = id("i");
+    for (uint32_t depth = 1; depth <= 100000; ++depth) {
+        symbols_.push_scope();
+        symbols_.declare(i, SymbolKind::OBJECT, depth);
+    }
+    EXPECT_EQ(symbols_.lookup(i)->declaration, 100000u);
+    for (uint32_t depth = 100000; depth > 0; --depth) {
+        ASSERT_EQ(symbols_.lookup(i)->declaration, depth);
+        symbols_.pop_scope();
+    }
+    EXPECT_EQ(symbols_.lookup(i), nullptr);
+    EXPECT_EQ(symbols_.size(), 0u);
+}
+
+// Once the table has grown to a program's size, entering and leaving scopes
+// allocates nothing
+TEST_F(SymbolTableTest, ScopesDoNotAllocate) {
+    if (!lexer::instrument::kEnabled) {
+        GTEST_SKIP() << "built without LEXER_INSTRUMENT";
+    }
+    lexer::IdentifierId names[] = {id("a"), id("b"), id("c"), id("d")};
+    auto block = [&] {
+        for (int depth = 0; depth < 64; ++depth) {
+            symbols_.push_scope();
+            for (lexer::IdentifierId name : names) {
+                symbols_.declare(name, SymbolKind::OBJECT);
+            }
+        }
+        for (int depth = 0; depth < 64; ++depth) {
+            symbols_.pop_scope();
+        }
+    };
+    block();
+
+    lexer::instrument::AllocationScope scope;
+    for (int i = 0; i < 100; ++i) {
+        block();
+    }
+    EXPECT_EQ(scope.allocations(), 0u);
+}